@@ -0,0 +1,318 @@
+#include "merian/vk/extension/extension_resources.hpp"
+#include "merian/vk/shader/shader_compiler_system_glslc.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/prng/PRNG.hpp"
+#include "src/device/prng/philox/Philox.hpp"
+#include "src/device/wrs/alias/AliasTable.hpp"
+#include "src/host/export/csv.hpp"
+#include "src/host/export/logscale.hpp"
+#include "src/host/types/quantized_alias_table.hpp"
+#include "vulkan/vulkan_enums.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fmt/base.h>
+#include <random>
+#include <spdlog/spdlog.h>
+
+namespace device::alias_quantization {
+
+using Buffers = AliasTable::Buffers;
+using Entry = host::AliasTableEntry<float, host::glsl::uint>;
+
+struct NamedConfig {
+    std::string name;
+    AliasTable::Config config;
+};
+
+static const NamedConfig CONFIGURATIONS[] = {
+    NamedConfig{.name = "PSA-(Inline-2)-Float",
+                .config = AliasTableConfig(PSAConfig(AtomicMeanConfig(),
+                                                     DecoupledPrefixPartitionConfig(),
+                                                     InlineSplitPackConfig(2),
+                                                     false),
+                                           SampleAliasTableConfig(128))},
+    NamedConfig{.name = "PSA-(Inline-2)-Quantized",
+                .config = AliasTableConfig(PSAConfig(AtomicMeanConfig(),
+                                                     DecoupledPrefixPartitionConfig(),
+                                                     InlineSplitPackConfig(2),
+                                                     false),
+                                           SampleAliasTableConfig(128),
+                                           std::nullopt,
+                                           AliasTableQuantizeConfig())},
+};
+
+static constexpr std::size_t N = (1 << 26);
+static constexpr std::size_t N_min = (1 << 16);
+// the error is evaluated on the host, which gets expensive for large N.
+static constexpr std::size_t N_maxError = (1 << 24);
+static constexpr std::size_t ticks = 20;
+static constexpr std::size_t iterations = 100;
+static constexpr std::size_t S = 1e7;
+
+struct ConfigResult {
+    std::size_t N;
+    std::size_t S;
+    std::string format;
+    double latencySample; // ms
+    double stdVarSample;  // ms
+    double sampleThroughput; // samples / second
+    double maxError;      // max |p_quantized(i) - p_float(i)|, negative if not evaluated
+    double errorBound;    // max of host::AliasTableQuantization::sampleProbabilityErrorBound
+    double tvDistance;    // total variation distance between both distributions
+};
+
+struct BenchmarkResult {
+    NamedConfig configuration;
+    std::vector<ConfigResult> entries;
+};
+
+/// Reconstructs the alias table which is effectively sampled by the quantized sampler.
+static std::vector<Entry> dequantizeAliasTable(const host::AliasTableQuantization& quantization,
+                                               std::span<const host::glsl::uint> quantizedTable,
+                                               std::span<const host::glsl::uint> probabilities) {
+    std::vector<Entry> table(quantizedTable.size());
+    for (std::size_t i = 0; i < table.size(); ++i) {
+        if (quantization.format == host::AliasTableFormat::PACKED) {
+            table[i] = quantization.unpack(quantizedTable[i]);
+        } else {
+            const host::glsl::uint q = (probabilities[i / 2] >> (16 * (i % 2))) & 0xFFFFu;
+            table[i] = Entry(quantization.dequantize(q), quantizedTable[i]);
+        }
+    }
+    return table;
+}
+
+/// Compares the quantized table of the device against the host reference and
+/// evaluates the error of the sampled distribution.
+static void evaluateError(const host::AliasTableQuantization& quantization,
+                          std::span<const Entry> aliasTable,
+                          std::span<const host::glsl::uint> quantizedTable,
+                          std::span<const host::glsl::uint> probabilities,
+                          ConfigResult& result) {
+    const host::glsl::uint n = static_cast<host::glsl::uint>(aliasTable.size());
+    // float rounding on the device may differ by one quantization step from the host.
+    const auto close = [](host::glsl::uint a, host::glsl::uint b) {
+        return (a > b ? a - b : b - a) <= 1;
+    };
+    std::size_t mismatches = 0;
+    if (quantization.format == host::AliasTableFormat::PACKED) {
+        const std::vector<host::glsl::uint> reference =
+            host::packAliasTable(aliasTable, quantization);
+        const host::glsl::uint aliasMask = (1u << quantization.aliasBits) - 1;
+        for (std::size_t i = 0; i < reference.size(); ++i) {
+            if ((quantizedTable[i] & aliasMask) != (reference[i] & aliasMask) ||
+                !close(quantizedTable[i] >> quantization.aliasBits,
+                       reference[i] >> quantization.aliasBits)) {
+                ++mismatches;
+            }
+        }
+    } else {
+        const std::vector<host::glsl::uint> reference =
+            host::splitAliasTableProbabilities(aliasTable, quantization);
+        for (std::size_t i = 0; i < reference.size(); ++i) {
+            if (!close(probabilities[i] & 0xFFFFu, reference[i] & 0xFFFFu) ||
+                !close(probabilities[i] >> 16, reference[i] >> 16)) {
+                ++mismatches;
+            }
+        }
+        for (host::glsl::uint i = 0; i < n; ++i) {
+            mismatches += quantizedTable[i] != aliasTable[i].a;
+        }
+    }
+    if (mismatches != 0) {
+        SPDLOG_WARN("Quantized alias table differs from the host reference in {} entries",
+                    mismatches);
+    }
+
+    const std::vector<Entry> dequantized =
+        dequantizeAliasTable(quantization, quantizedTable, probabilities);
+    const std::vector<double> expected = host::aliasTableDistribution(aliasTable);
+    const std::vector<double> got = host::aliasTableDistribution(dequantized);
+
+    std::vector<host::glsl::uint> aliasCount(n, 0);
+    for (const auto& entry : aliasTable) {
+        aliasCount[entry.a]++;
+    }
+
+    result.maxError = 0;
+    result.errorBound = 0;
+    result.tvDistance = 0;
+    for (host::glsl::uint i = 0; i < n; ++i) {
+        const double err = std::abs(got[i] - expected[i]);
+        result.maxError = std::max(result.maxError, err);
+        result.errorBound = std::max(result.errorBound,
+                                     quantization.sampleProbabilityErrorBound(n, aliasCount[i]));
+        result.tvDistance += 0.5 * err;
+    }
+}
+
+static std::vector<ConfigResult>
+benchmarkConfiguration(const merian::ContextHandle& context,
+                       const merian::ShaderCompilerHandle& shaderCompiler,
+                       const merian::QueueHandle& queue,
+                       const AliasTable::Config& config) {
+    merian::CommandPoolHandle cmdPool = std::make_shared<merian::CommandPool>(queue);
+
+    AliasTable aliasTable{context, shaderCompiler, config};
+
+    const auto& resourceExt = context->get_extension<merian::ExtensionResources>();
+    assert(resourceExt != nullptr);
+    auto alloc = resourceExt->resource_allocator();
+
+    Buffers local = Buffers::allocate(alloc, merian::MemoryMappingType::NONE, config, N, S);
+    merian::BufferHandle stageAliasTable;
+    AliasTableQuantize::Buffers stageQuantized;
+    if (config.quantizeConfig.has_value()) {
+        stageAliasTable = device::details::allocateAliasTableBuffer(
+            alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+            vk::BufferUsageFlagBits::eTransferDst, N_maxError);
+        stageQuantized = AliasTableQuantize::Buffers::allocate(
+            alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM, *config.quantizeConfig,
+            N_maxError);
+    }
+
+    PRNG prng{context, shaderCompiler, PhiloxConfig(512)};
+    PRNGBuffers prngBuffers;
+    prngBuffers.samples = local.weights;
+
+    std::mt19937 rng;
+    std::uniform_int_distribution<host::glsl::uint> dist;
+
+    std::vector<ConfigResult> results;
+    results.reserve(ticks);
+    for (const std::size_t n : host::exp::log10scale<std::size_t>(N_min, N, ticks)) {
+        const host::glsl::uint n32 = static_cast<host::glsl::uint>(n);
+        merian::ProfilerHandle profiler = std::make_shared<merian::Profiler>(context);
+        merian::QueryPoolHandle<vk::QueryType::eTimestamp> query_pool =
+            std::make_shared<merian::QueryPool<vk::QueryType::eTimestamp>>(context, 2 * iterations);
+        query_pool->reset();
+        profiler->set_query_pool(query_pool);
+
+        { // Generate weights and build
+            merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(cmdPool);
+            cmd->begin();
+            prng.run(cmd, prngBuffers, n, dist(rng));
+            cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                         vk::PipelineStageFlagBits::eComputeShader,
+                         prngBuffers.samples->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                             vk::AccessFlagBits::eShaderRead));
+            aliasTable.build(cmd, local, n32);
+            cmd->end();
+            queue->submit_wait(cmd);
+        }
+
+        for (std::size_t i = 0; i < iterations; ++i) {
+            merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(cmdPool);
+            cmd->begin();
+            profiler->start("Sample");
+            profiler->cmd_start(cmd, "Sample");
+            aliasTable.sample(cmd, local, n32, S, dist(rng));
+            profiler->end();
+            profiler->cmd_end(cmd);
+            cmd->end();
+            queue->submit_wait(cmd);
+            profiler->collect(true, true);
+        }
+
+        auto report = profiler->get_report();
+        auto entrySample = std::ranges::find_if(
+            report.gpu_report, [](const auto& entry) { return entry.name == "Sample"; });
+
+        ConfigResult result{
+            .N = n,
+            .S = S,
+            .format = "FLOAT",
+            .latencySample = entrySample->duration,
+            .stdVarSample = entrySample->std_deviation,
+            .sampleThroughput = static_cast<double>(S) / (entrySample->duration * 1e-3),
+            .maxError = -1,
+            .errorBound = 0,
+            .tvDistance = -1,
+        };
+
+        if (config.quantizeConfig.has_value()) {
+            const host::AliasTableQuantization quantization = host::AliasTableQuantization::select(
+                n32, config.quantizeConfig->minProbabilityBits);
+            result.format =
+                quantization.format == host::AliasTableFormat::PACKED ? "PACKED" : "SPLIT16";
+            if (n <= N_maxError) {
+                merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(cmdPool);
+                cmd->begin();
+                Buffers::AliasTableView localTable{local.m_aliasTable, n};
+                Buffers::AliasTableView stageTable{stageAliasTable, n};
+                localTable.expectComputeWrite();
+                localTable.copyTo(cmd, stageTable);
+                stageTable.expectHostRead(cmd);
+
+                AliasTableQuantize::Buffers::QuantizedTableView localQuantized{
+                    local.m_quantizeBuffers.quantizedTable, n};
+                AliasTableQuantize::Buffers::QuantizedTableView stageQuantizedTable{
+                    stageQuantized.quantizedTable, n};
+                localQuantized.expectComputeWrite();
+                localQuantized.copyTo(cmd, stageQuantizedTable);
+                stageQuantizedTable.expectHostRead(cmd);
+                if (quantization.format == host::AliasTableFormat::SPLIT16) {
+                    AliasTableQuantize::Buffers::ProbabilitiesView localProbabilities{
+                        local.m_quantizeBuffers.probabilities, (n + 1) / 2};
+                    AliasTableQuantize::Buffers::ProbabilitiesView stageProbabilities{
+                        stageQuantized.probabilities, (n + 1) / 2};
+                    localProbabilities.expectComputeWrite();
+                    localProbabilities.copyTo(cmd, stageProbabilities);
+                    stageProbabilities.expectHostRead(cmd);
+                }
+                cmd->end();
+                queue->submit_wait(cmd);
+
+                const auto table =
+                    device::details::downloadAliasTableFromBuffer(stageAliasTable, n32);
+                const auto quantizedTable =
+                    AliasTableQuantize::Buffers::QuantizedTableView{stageQuantized.quantizedTable,
+                                                                    n}
+                        .download<host::glsl::uint>();
+                std::vector<host::glsl::uint> probabilities;
+                if (quantization.format == host::AliasTableFormat::SPLIT16) {
+                    probabilities = AliasTableQuantize::Buffers::ProbabilitiesView{
+                        stageQuantized.probabilities, (n + 1) / 2}
+                                        .download<host::glsl::uint>();
+                }
+                evaluateError(quantization, table, quantizedTable, probabilities, result);
+            }
+        }
+        results.push_back(result);
+    }
+    return results;
+}
+
+void benchmark(const merian::ContextHandle& context) {
+    // Setup vulkan resources
+    merian::QueueHandle queue = context->get_queue_GCT();
+
+    merian::ShaderCompilerHandle shaderCompiler =
+        std::make_shared<merian::SystemGlslcCompiler>(context);
+
+    std::vector<BenchmarkResult> results;
+    for (const auto& config : CONFIGURATIONS) {
+        SPDLOG_INFO("Benchmarking {}", config.name);
+        results.push_back(BenchmarkResult{
+            .configuration = config,
+            .entries = benchmarkConfiguration(context, shaderCompiler, queue, config.config),
+        });
+    }
+
+    // export
+
+    std::string path = "wrs_benchmark_alias_quantization.csv";
+    host::exp::CSVWriter<10> csv({"N", "S", "method", "format", "sample_latency",
+                                  "sample_std_derivation", "sample_throughput", "max_error",
+                                  "error_bound", "tv_distance"},
+                                 path);
+    for (const auto& r1 : results) {
+        for (const auto& r2 : r1.entries) {
+            csv.pushRow(r2.N, r2.S, r1.configuration.name, r2.format, r2.latencySample,
+                        r2.stdVarSample, r2.sampleThroughput, r2.maxError, r2.errorBound,
+                        r2.tvDistance);
+        }
+    }
+}
+
+} // namespace device::alias_quantization
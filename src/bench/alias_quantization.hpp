@@ -0,0 +1,10 @@
+#pragma once
+
+#include "merian/vk/context.hpp"
+
+
+namespace device::alias_quantization {
+
+void benchmark(const merian::ContextHandle& context);
+
+}
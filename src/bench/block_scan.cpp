@@ -1,3 +1,4 @@
+#include "src/bench/peak_bandwidth.hpp"
 #include "merian/vk/extension/extension_resources.hpp"
 #include "merian/vk/shader/shader_compiler_system_glslc.hpp"
 #include "merian/vk/utils/profiler.hpp"
@@ -7,6 +8,7 @@
 #include "src/device/prng/philox/Philox.hpp"
 #include "src/host/export/csv.hpp"
 #include "src/host/export/logscale.hpp"
+#include "src/host/export/roofline.hpp"
 #include <algorithm>
 #include <csignal>
 #include <cwchar>
@@ -321,6 +323,7 @@ struct ConfigResult {
     double latency;         // ms
     double stdVar;          // ms
     double memoryBandwidth; // Gb per second.
+    double peakFraction;    // memoryBandwidth / peak bandwidth
     double throughput;      // billion items per second
 };
 
@@ -340,7 +343,8 @@ struct BenchmarkResults {
 ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
                                        const merian::ShaderCompilerHandle& shaderCompiler,
                                        const merian::QueueHandle& queue,
-                                       const BlockScanConfig& config) {
+                                       const BlockScanConfig& config,
+                                       double peakBandwidth) {
 
     merian::CommandPoolHandle cmdPool = std::make_shared<merian::CommandPool>(queue);
 
@@ -425,8 +429,7 @@ ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
         double latency = entry->duration;
         double stdVar = entry->std_deviation;
 
-        std::size_t requireTransactionsByte = 2 * n * sizeof(weight_type);
-        double memoryBandwidth = ((requireTransactionsByte * 1e-9) / (entry->duration * 1e-3));
+        const auto roofline = host::exp::roofline(scan.cost(n), latency, peakBandwidth);
         double itemsPerSecond = (n / (entry->duration * 1e-3)) / 1e9;
 
         results.entries.push_back(
@@ -435,7 +438,8 @@ ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
                          .seq = config.sequentialScanLength > 1,
                          .latency = latency,
                          .stdVar = stdVar,
-                         .memoryBandwidth = memoryBandwidth,
+                         .memoryBandwidth = roofline.memoryBandwidth,
+                         .peakFraction = roofline.peakFraction,
                          .throughput = itemsPerSecond});
     }
 
@@ -449,6 +453,8 @@ void benchmark(const merian::ContextHandle& context) {
     merian::ShaderCompilerHandle shaderCompiler =
         std::make_shared<merian::SystemGlslcCompiler>(context);
 
+    const double peakBandwidth = peak_bandwidth::measure(context, shaderCompiler, queue);
+
     std::size_t i = 0;
     BenchmarkResults results;
     for (const auto& config : CONFIGURATIONS) {
@@ -458,7 +464,7 @@ void benchmark(const merian::ContextHandle& context) {
                 100.0f,
             config.name);
         auto configBenchmark =
-            benchmarkConfiguration(context, shaderCompiler, queue, config.config);
+            benchmarkConfiguration(context, shaderCompiler, queue, config.config, peakBandwidth);
         results.entries.push_back(BenchmarkResult{
             .configuration = config,
             .results = configBenchmark,
@@ -469,14 +475,16 @@ void benchmark(const merian::ContextHandle& context) {
     // export
 
     std::string path = "block_scan_benchmark.csv";
-    host::exp::CSVWriter<9> csv({"N", "block_size", "seq", "method", "group", "latency",
-                                 "std_derivation", "throughput", "memory_throughput"},
-                                path);
+    host::exp::CSVWriter<10> csv({"N", "block_size", "seq", "method", "group", "latency",
+                                  "std_derivation", "throughput", "memory_throughput",
+                                  "peak_fraction"},
+                                 path);
     for (const auto& r1 : results.entries) {
         std::string method = r1.configuration.name;
         for (const auto& r2 : r1.results.entries) {
             csv.pushRow(r2.N, r2.blockSize, r2.seq, method, r1.configuration.methodGroup,
-                        r2.latency, r2.stdVar, r2.throughput, r2.memoryBandwidth);
+                        r2.latency, r2.stdVar, r2.throughput, r2.memoryBandwidth,
+                        r2.peakFraction);
         }
     }
 }
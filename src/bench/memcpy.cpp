@@ -1,4 +1,5 @@
 #include "src/device/memcpy/Memcpy.hpp"
+#include "src/bench/peak_bandwidth.hpp"
 #include "merian/vk/extension/extension_resources.hpp"
 #include "merian/vk/shader/shader_compiler_system_glslc.hpp"
 #include "merian/vk/utils/profiler.hpp"
@@ -6,6 +7,7 @@
 #include "src/device/prng/philox/Philox.hpp"
 #include "src/host/export/csv.hpp"
 #include "src/host/export/logscale.hpp"
+#include "src/host/export/roofline.hpp"
 #include "vulkan/vulkan_enums.hpp"
 #include <algorithm>
 #include <csignal>
@@ -124,6 +126,7 @@ struct ConfigResult {
     double latency;         // ms
     double stdVar;          // ms
     double memoryBandwidth; // Gb per second.
+    double peakFraction;    // memoryBandwidth / peak bandwidth
     double throughput;      // billion items per second
 };
 
@@ -145,7 +148,8 @@ ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
                                        const merian::QueueHandle& queue,
                                        const Variant variant,
                                        std::size_t rows,
-                                       bool flushL2) {
+                                       bool flushL2,
+                                       double peakBandwidth) {
     merian::CommandPoolHandle cmdPool = std::make_shared<merian::CommandPool>(queue);
 
     Buffers local;
@@ -259,18 +263,19 @@ ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
             double latency = entry->duration;
             double stdVar = entry->std_deviation;
 
-            std::size_t requireTransactionsByte = 2 * n * sizeof(weight_type); // in bytes
-            double memoryBandwidth = ((requireTransactionsByte * 1e-9f) / (entry->duration * 1e-3));
+            const auto roofline =
+                host::exp::roofline(Memcpy<weight_type>::cost(n), latency, peakBandwidth);
             double itemsPerSecond = (n / (entry->duration * 1e-3)) / 1e9;
 
-            SPDLOG_DEBUG("memory-throughput: {}Gb/s", memoryBandwidth);
-            SPDLOG_DEBUG("utilization: {}%", (memoryBandwidth / 504.20f) * 100);
+            SPDLOG_DEBUG("memory-throughput: {}Gb/s", roofline.memoryBandwidth);
+            SPDLOG_DEBUG("utilization: {}%", roofline.peakFraction * 100);
 
             results.entries.push_back(ConfigResult{.N = n,
                                                    .bytes = n * sizeof(float),
                                                    .latency = latency,
                                                    .stdVar = stdVar,
-                                                   .memoryBandwidth = memoryBandwidth,
+                                                   .memoryBandwidth = roofline.memoryBandwidth,
+                                                   .peakFraction = roofline.peakFraction,
                                                    .throughput = itemsPerSecond});
         }
 
@@ -365,15 +370,17 @@ ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
             double latency = entry->duration;
             double stdVar = entry->std_deviation;
 
-            std::size_t requireTransactionsByte = n * sizeof(weight_type);
-            double memoryBandwidth = ((requireTransactionsByte * 1e-9) / (entry->duration * 1e-3));
+            // same traffic as the compute copy, every element is read and written once.
+            const auto roofline =
+                host::exp::roofline(Memcpy<weight_type>::cost(n), latency, peakBandwidth);
             double itemsPerSecond = (n / (entry->duration * 1e-3)) / 1e9;
 
             results.entries.push_back(ConfigResult{.N = n,
                                                    .bytes = n * sizeof(float),
                                                    .latency = latency,
                                                    .stdVar = stdVar,
-                                                   .memoryBandwidth = memoryBandwidth,
+                                                   .memoryBandwidth = roofline.memoryBandwidth,
+                                                   .peakFraction = roofline.peakFraction,
                                                    .throughput = itemsPerSecond});
         }
     }
@@ -387,10 +394,13 @@ void benchmark(const merian::ContextHandle& context) {
     merian::ShaderCompilerHandle shaderCompiler =
         std::make_shared<merian::SystemGlslcCompiler>(context);
 
+    const double peakBandwidth = peak_bandwidth::measure(context, shaderCompiler, queue);
+
     BenchmarkResults results;
     for (const auto& config : CONFIGURATIONS) {
-        auto configBenchmark = benchmarkConfiguration(context, shaderCompiler, queue,
-                                                      config.variant, config.ROWS, config.flushL2);
+        auto configBenchmark =
+            benchmarkConfiguration(context, shaderCompiler, queue, config.variant, config.ROWS,
+                                   config.flushL2, peakBandwidth);
         results.entries.push_back(BenchmarkResult{
             .configuration = config,
             .results = configBenchmark,
@@ -400,14 +410,14 @@ void benchmark(const merian::ContextHandle& context) {
     // export
 
     std::string path = "memcpy_benchmark.csv";
-    host::exp::CSVWriter<7> csv(
-        {"N", "bytes", "method", "latency", "std_derivation", "throughput", "memory_throughput"},
-        path);
+    host::exp::CSVWriter<8> csv({"N", "bytes", "method", "latency", "std_derivation", "throughput",
+                                 "memory_throughput", "peak_fraction"},
+                                path);
     for (const auto& r1 : results.entries) {
         std::string method = r1.configuration.name;
         for (const auto& r2 : r1.results.entries) {
             csv.pushRow(r2.N, r2.bytes, method, r2.latency, r2.stdVar, r2.throughput,
-                        r2.memoryBandwidth);
+                        r2.memoryBandwidth, r2.peakFraction);
         }
     }
 }
@@ -0,0 +1,71 @@
+#include "./peak_bandwidth.hpp"
+#include "merian/vk/extension/extension_resources.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/memcpy/Memcpy.hpp"
+#include "src/host/export/roofline.hpp"
+#include "vulkan/vulkan_enums.hpp"
+#include <algorithm>
+#include <optional>
+#include <spdlog/spdlog.h>
+
+namespace device::peak_bandwidth {
+
+using weight_type = float;
+
+static constexpr host::glsl::uint N = (1 << 26); // 256MB per buffer, far beyond any L2
+static constexpr host::glsl::uint ROWS[] = {4, 8, 16};
+static constexpr std::size_t iterations = 10;
+
+static std::optional<double> s_peakBandwidth;
+
+double measure(const merian::ContextHandle& context,
+               const merian::ShaderCompilerHandle& shaderCompiler,
+               const merian::QueueHandle& queue) {
+    if (s_peakBandwidth.has_value()) {
+        return *s_peakBandwidth;
+    }
+    merian::CommandPoolHandle cmdPool = std::make_shared<merian::CommandPool>(queue);
+
+    const auto& resourceExt = context->get_extension<merian::ExtensionResources>();
+    assert(resourceExt != nullptr);
+    auto alloc = resourceExt->resource_allocator();
+    using Buffers = Memcpy<weight_type>::Buffers;
+    Buffers local = Buffers::allocate(alloc, merian::MemoryMappingType::NONE, N);
+
+    double peakBandwidth = 0.0;
+    for (const host::glsl::uint rows : ROWS) {
+        Memcpy<weight_type> memcpy{context, shaderCompiler, MemcpyConfig(512, rows)};
+
+        merian::ProfilerHandle profiler = std::make_shared<merian::Profiler>(context);
+        merian::QueryPoolHandle<vk::QueryType::eTimestamp> query_pool =
+            std::make_shared<merian::QueryPool<vk::QueryType::eTimestamp>>(context, 2 * iterations);
+        query_pool->reset();
+        profiler->set_query_pool(query_pool);
+
+        for (std::size_t i = 0; i < iterations; ++i) {
+            merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(cmdPool);
+            cmd->begin();
+            profiler->start("Peak");
+            profiler->cmd_start(cmd, "Peak");
+            memcpy.run(cmd, local, N);
+            profiler->end();
+            profiler->cmd_end(cmd);
+            cmd->end();
+            queue->submit_wait(cmd);
+            profiler->collect(true, true);
+        }
+
+        auto report = profiler->get_report();
+        auto entry = std::ranges::find_if(report.gpu_report,
+                                          [](const auto& entry) { return entry.name == "Peak"; });
+        const auto point =
+            host::exp::roofline(Memcpy<weight_type>::cost(N), entry->duration, 0.0);
+        peakBandwidth = std::max(peakBandwidth, point.memoryBandwidth);
+    }
+
+    SPDLOG_INFO("Peak memory bandwidth (memcpy): {}GB/s", peakBandwidth);
+    s_peakBandwidth = peakBandwidth;
+    return peakBandwidth;
+}
+
+} // namespace device::peak_bandwidth
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "merian/vk/context.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+
+namespace device::peak_bandwidth {
+
+/**
+ * Achievable device memory bandwidth in GB per second, the best device::Memcpy run
+ * over a large buffer. Measured on the first call and cached for the rest of the run,
+ * such that the benchmarks can report their bandwidth as a fraction of it.
+ */
+double measure(const merian::ContextHandle& context,
+               const merian::ShaderCompilerHandle& shaderCompiler,
+               const merian::QueueHandle& queue);
+
+} // namespace device::peak_bandwidth
@@ -1,4 +1,5 @@
 #include "src/bench/prefix_partition.hpp"
+#include "src/bench/peak_bandwidth.hpp"
 #include "merian/vk/extension/extension_resources.hpp"
 #include "merian/vk/shader/shader_compiler_system_glslc.hpp"
 #include "merian/vk/utils/profiler.hpp"
@@ -8,6 +9,7 @@
 #include "src/device/prng/philox/Philox.hpp"
 #include "src/host/export/csv.hpp"
 #include "src/host/export/logscale.hpp"
+#include "src/host/export/roofline.hpp"
 #include "vulkan/vulkan_enums.hpp"
 #include <algorithm>
 #include <csignal>
@@ -119,6 +121,7 @@ struct ConfigResult {
     double latency;         // ms
     double stdVar;          // ms
     double memoryBandwidth; // Gb per second.
+    double peakFraction;    // memoryBandwidth / peak bandwidth
     double throughput;      // billion items per second
 };
 
@@ -140,7 +143,8 @@ ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
                                        const merian::QueueHandle& queue,
                                        const PrefixPartition<weight_type>::Config& config,
                                        bool flushL2,
-                                       bool writePartition) {
+                                       bool writePartition,
+                                       double peakBandwidth) {
 
     merian::CommandPoolHandle cmdPool = std::make_shared<merian::CommandPool>(queue);
 
@@ -243,19 +247,14 @@ ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
         double latency = entry->duration;
         double stdVar = entry->std_deviation;
 
-        std::size_t requireTransactionsByte;
-        if (writePartition) {
-          requireTransactionsByte = (sizeof(weight_type) * 4) * n;
-        } else {
-          requireTransactionsByte = (sizeof(weight_type) * 3) * n;
-        }
-        double memoryBandwidth = ((requireTransactionsByte * 1e-9) / (entry->duration * 1e-3));
+        const auto roofline = host::exp::roofline(parscan.cost(n), latency, peakBandwidth);
         double itemsPerSecond = (n / (entry->duration * 1e-3)) / 1e9;
 
         results.entries.push_back(ConfigResult{.N = n,
                                                .latency = latency,
                                                .stdVar = stdVar,
-                                               .memoryBandwidth = memoryBandwidth,
+                                               .memoryBandwidth = roofline.memoryBandwidth,
+                                               .peakFraction = roofline.peakFraction,
                                                .throughput = itemsPerSecond});
     }
 
@@ -269,6 +268,8 @@ void benchmark(const merian::ContextHandle& context) {
     merian::ShaderCompilerHandle shaderCompiler =
         std::make_shared<merian::SystemGlslcCompiler>(context);
 
+    const double peakBandwidth = peak_bandwidth::measure(context, shaderCompiler, queue);
+
     BenchmarkResults results;
     std::size_t i = 0;
     for (const auto& config : CONFIGURATIONS) {
@@ -278,7 +279,8 @@ void benchmark(const merian::ContextHandle& context) {
                 100.0f,
             config.name);
         auto configBenchmark =
-            benchmarkConfiguration(context, shaderCompiler, queue, config.config, config.flushL2, config.writePartition);
+            benchmarkConfiguration(context, shaderCompiler, queue, config.config, config.flushL2,
+                                   config.writePartition, peakBandwidth);
         results.entries.push_back(BenchmarkResult{
             .configuration = config,
             .results = configBenchmark,
@@ -289,14 +291,15 @@ void benchmark(const merian::ContextHandle& context) {
     // export
 
     std::string path = "partition_scan_benchmark.csv";
-    host::exp::CSVWriter<9> csv({"N", "method", "group", "latency", "std_derivation", "throughput",
-                                 "memory_throughput", "write-partition", "flushL2"},
-                                path);
+    host::exp::CSVWriter<10> csv({"N", "method", "group", "latency", "std_derivation",
+                                  "throughput", "memory_throughput", "peak_fraction",
+                                  "write-partition", "flushL2"},
+                                 path);
     for (const auto& r1 : results.entries) {
         std::string method = r1.configuration.name;
         for (const auto& r2 : r1.results.entries) {
             csv.pushRow(r2.N, method, r1.configuration.group, r2.latency, r2.stdVar, r2.throughput,
-                        r2.memoryBandwidth, r1.configuration.writePartition,
+                        r2.memoryBandwidth, r2.peakFraction, r1.configuration.writePartition,
                         r1.configuration.flushL2);
         }
     }
@@ -1,3 +1,4 @@
+#include "src/bench/peak_bandwidth.hpp"
 #include "merian/vk/extension/extension_resources.hpp"
 #include "merian/vk/shader/shader_compiler_system_glslc.hpp"
 #include "merian/vk/utils/profiler.hpp"
@@ -12,6 +13,7 @@
 #include "src/device/wrs/alias/psa/split/SplitAllocFlags.hpp"
 #include "src/device/wrs/alias/psa/split/scalar/ScalarSplit.hpp"
 #include "src/host/export/csv.hpp"
+#include "src/host/export/roofline.hpp"
 #include "vulkan/vulkan_enums.hpp"
 #include <algorithm>
 #include <csignal>
@@ -56,8 +58,10 @@ static constexpr PrefixPartitionConfig prefixPartitionConfig = DecoupledPrefixPa
 struct ConfigResult {
     std::size_t N;
     std::size_t splitSize;
-    double latency; // ms
-    double stdVar;  // ms
+    double latency;         // ms
+    double stdVar;          // ms
+    double memoryBandwidth; // Gb per second.
+    double peakFraction;    // memoryBandwidth / peak bandwidth
 };
 
 struct ConfigBenchmark {
@@ -76,7 +80,8 @@ struct BenchmarkResults {
 ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
                                        const merian::ShaderCompilerHandle& shaderCompiler,
                                        const merian::QueueHandle& queue,
-                                       bool flushL2) {
+                                       bool flushL2,
+                                       double peakBandwidth) {
 
     merian::CommandPoolHandle cmdPool = std::make_shared<merian::CommandPool>(queue);
 
@@ -199,12 +204,15 @@ ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
                                           [](const auto& entry) { return entry.name == "Split"; });
         double latency = entry->duration;
         double stdVar = entry->std_deviation;
+        const auto roofline = host::exp::roofline(split.cost(N), latency, peakBandwidth);
 
         results.entries.push_back(ConfigResult{
             .N = N,
             .splitSize = splitSize,
             .latency = latency,
             .stdVar = stdVar,
+            .memoryBandwidth = roofline.memoryBandwidth,
+            .peakFraction = roofline.peakFraction,
         });
     }
 
@@ -218,6 +226,8 @@ void benchmark(const merian::ContextHandle& context) {
     merian::ShaderCompilerHandle shaderCompiler =
         std::make_shared<merian::SystemGlslcCompiler>(context);
 
+    const double peakBandwidth = peak_bandwidth::measure(context, shaderCompiler, queue);
+
     BenchmarkResults results;
     std::size_t i = 0;
     SPDLOG_INFO("Benchmarking PSA-Split (average subgroup latency based on split size)");
@@ -228,7 +238,7 @@ void benchmark(const merian::ContextHandle& context) {
                 100.0f,
             config.name);
         auto configBenchmark =
-            benchmarkConfiguration(context, shaderCompiler, queue, config.flushL2);
+            benchmarkConfiguration(context, shaderCompiler, queue, config.flushL2, peakBandwidth);
         results.entries.push_back(BenchmarkResult{
             .configuration = config,
             .results = configBenchmark,
@@ -239,13 +249,14 @@ void benchmark(const merian::ContextHandle& context) {
     // export
 
     std::string path = "psa_split_benchmark_fixed_N.csv";
-    host::exp::CSVWriter<7> csv(
-        {"N", "splitSize", "method", "group", "latency", "std_derivation", "flushL2"}, path);
+    host::exp::CSVWriter<9> csv({"N", "splitSize", "method", "group", "latency", "std_derivation",
+                                 "memory_throughput", "peak_fraction", "flushL2"},
+                                path);
     for (const auto& r1 : results.entries) {
         std::string method = r1.configuration.name;
         for (const auto& r2 : r1.results.entries) {
             csv.pushRow(r2.N, r2.splitSize, method, r1.configuration.group, r2.latency, r2.stdVar,
-                        r1.configuration.flushL2);
+                        r2.memoryBandwidth, r2.peakFraction, r1.configuration.flushL2);
         }
     }
 }
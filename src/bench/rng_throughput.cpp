@@ -0,0 +1,191 @@
+#include "./rng_throughput.hpp"
+#include "merian/vk/extension/extension_resources.hpp"
+#include "merian/vk/shader/shader_compiler_system_glslc.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/prng/PRNG.hpp"
+#include "src/device/prng/philox/Philox.hpp"
+#include "src/device/wrs/alias/AliasTable.hpp"
+#include "src/host/export/csv.hpp"
+#include "src/host/export/logscale.hpp"
+#include "src/host/types/rng.hpp"
+#include "vulkan/vulkan_enums.hpp"
+#include <algorithm>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <random>
+#include <spdlog/spdlog.h>
+
+namespace device::rng_throughput {
+
+static constexpr host::RNGAlgorithm ALGORITHMS[] = {
+    host::RNGAlgorithm::PHILOX,
+    host::RNGAlgorithm::PCG,
+    host::RNGAlgorithm::XOSHIRO,
+    host::RNGAlgorithm::HASH,
+    host::RNGAlgorithm::SOBOL,
+    host::RNGAlgorithm::R2,
+    host::RNGAlgorithm::STRATIFIED,
+};
+
+static constexpr std::size_t N = (1 << 20); // alias table size
+static constexpr std::size_t S = (1 << 27);
+static constexpr std::size_t S_min = (1 << 16);
+static constexpr std::size_t ticks = 20;
+static constexpr std::size_t iterations = 50;
+
+struct ConfigResult {
+    std::size_t S;
+    std::string kernel;
+    double latency;          // ms
+    double stdVar;           // ms
+    double nsPerSample;      // ns
+    double sampleThroughput; // samples / second
+};
+
+struct BenchmarkResult {
+    host::RNGAlgorithm rng;
+    std::vector<ConfigResult> entries;
+};
+
+/// Profiles the "Run" scope recorded by record for every sample count.
+template <typename Record>
+static std::vector<ConfigResult> profile(const merian::ContextHandle& context,
+                                         const merian::QueueHandle& queue,
+                                         const merian::CommandPoolHandle& cmdPool,
+                                         const std::string& kernel,
+                                         Record&& record) {
+    std::vector<ConfigResult> results;
+    results.reserve(ticks);
+    for (const std::size_t s : host::exp::log10scale<std::size_t>(S_min, S, ticks)) {
+        const host::glsl::uint s32 = static_cast<host::glsl::uint>(s);
+        merian::ProfilerHandle profiler = std::make_shared<merian::Profiler>(context);
+        merian::QueryPoolHandle<vk::QueryType::eTimestamp> query_pool =
+            std::make_shared<merian::QueryPool<vk::QueryType::eTimestamp>>(context, 2 * iterations);
+        query_pool->reset();
+        profiler->set_query_pool(query_pool);
+
+        for (std::size_t i = 0; i < iterations; ++i) {
+            merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(cmdPool);
+            cmd->begin();
+            profiler->start("Run");
+            profiler->cmd_start(cmd, "Run");
+            record(cmd, s32, static_cast<host::glsl::uint>(i));
+            profiler->end();
+            profiler->cmd_end(cmd);
+            cmd->end();
+            queue->submit_wait(cmd);
+            profiler->collect(true, true);
+        }
+
+        auto report = profiler->get_report();
+        auto entry = std::ranges::find_if(report.gpu_report,
+                                          [](const auto& entry) { return entry.name == "Run"; });
+        results.push_back(ConfigResult{
+            .S = s,
+            .kernel = kernel,
+            .latency = entry->duration,
+            .stdVar = entry->std_deviation,
+            .nsPerSample = entry->duration * 1e6 / static_cast<double>(s),
+            .sampleThroughput = static_cast<double>(s) / (entry->duration * 1e-3),
+        });
+    }
+    return results;
+}
+
+static std::vector<ConfigResult>
+benchmarkAlgorithm(const merian::ContextHandle& context,
+                   const merian::ShaderCompilerHandle& shaderCompiler,
+                   const merian::QueueHandle& queue,
+                   host::RNGAlgorithm rng) {
+    merian::CommandPoolHandle cmdPool = std::make_shared<merian::CommandPool>(queue);
+
+    const auto& resourceExt = context->get_extension<merian::ExtensionResources>();
+    assert(resourceExt != nullptr);
+    auto alloc = resourceExt->resource_allocator();
+
+    std::vector<ConfigResult> results;
+
+    // 1. Uniforms only (one uniform per invocation written to global memory).
+    PRNG prng{context, shaderCompiler, PhiloxConfig(512, rng)};
+    PRNGBuffers uniforms;
+    uniforms.samples =
+        PhiloxBuffers::allocate(alloc, merian::MemoryMappingType::NONE, S).samples;
+    auto prngResults = profile(context, queue, cmdPool, "uniforms",
+                               [&](const merian::CommandBufferHandle& cmd, host::glsl::uint s,
+                                   host::glsl::uint seed) { prng.run(cmd, uniforms, s, seed); });
+    results.insert(results.end(), prngResults.begin(), prngResults.end());
+
+    // vectorized philox4x32 kernel, compared against the philox2x32 uniforms above.
+    if (rng == host::RNGAlgorithm::PHILOX) {
+        for (const host::glsl::uint rows : {1u, 4u, 8u}) {
+            PRNG prng4x32{context, shaderCompiler, Philox4x32Config(512, rows)};
+            auto rowResults =
+                profile(context, queue, cmdPool, fmt::format("uniforms-4x32-rows{}", rows),
+                        [&](const merian::CommandBufferHandle& cmd, host::glsl::uint s,
+                            host::glsl::uint seed) { prng4x32.run(cmd, uniforms, s, seed); });
+            results.insert(results.end(), rowResults.begin(), rowResults.end());
+        }
+    }
+
+    // 2. Alias table sampling, which draws two uniforms per sample.
+    const AliasTableConfig config{PSAConfig(AtomicMeanConfig(), DecoupledPrefixPartitionConfig(),
+                                            InlineSplitPackConfig(2), false),
+                                  SampleAliasTableConfig(128, 512, host::SampleIndexWidth::U32,
+                                                         rng)};
+    AliasTable aliasTable{context, shaderCompiler, config};
+    AliasTable::Buffers buffers = AliasTable::Buffers::allocate(
+        alloc, merian::MemoryMappingType::NONE, config, N, S);
+    {
+        PRNG weightGenerator{context, shaderCompiler, PhiloxConfig(512)};
+        PRNGBuffers weights;
+        weights.samples = buffers.weights;
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(cmdPool);
+        cmd->begin();
+        weightGenerator.run(cmd, weights, N);
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     weights.samples->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                     vk::AccessFlagBits::eShaderRead));
+        aliasTable.build(cmd, buffers, N);
+        cmd->end();
+        queue->submit_wait(cmd);
+    }
+    auto aliasResults =
+        profile(context, queue, cmdPool, "alias-sampling",
+                [&](const merian::CommandBufferHandle& cmd, host::glsl::uint s,
+                    host::glsl::uint seed) { aliasTable.sample(cmd, buffers, N, s, seed); });
+    results.insert(results.end(), aliasResults.begin(), aliasResults.end());
+    return results;
+}
+
+void benchmark(const merian::ContextHandle& context) {
+    // Setup vulkan resources
+    merian::QueueHandle queue = context->get_queue_GCT();
+
+    merian::ShaderCompilerHandle shaderCompiler =
+        std::make_shared<merian::SystemGlslcCompiler>(context);
+
+    std::vector<BenchmarkResult> results;
+    for (const auto rng : ALGORITHMS) {
+        SPDLOG_INFO("Benchmarking {}", host::rngAlgorithmName(rng));
+        results.push_back(BenchmarkResult{
+            .rng = rng,
+            .entries = benchmarkAlgorithm(context, shaderCompiler, queue, rng),
+        });
+    }
+
+    // export
+
+    std::string path = "wrs_benchmark_rng_throughput.csv";
+    host::exp::CSVWriter<7> csv({"S", "kernel", "rng", "latency", "std_derivation",
+                                 "ns_per_sample", "sample_throughput"},
+                                path);
+    for (const auto& r1 : results) {
+        for (const auto& r2 : r1.entries) {
+            csv.pushRow(r2.S, r2.kernel, host::rngAlgorithmName(r1.rng), r2.latency, r2.stdVar,
+                        r2.nsPerSample, r2.sampleThroughput);
+        }
+    }
+}
+
+} // namespace device::rng_throughput
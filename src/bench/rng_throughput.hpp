@@ -0,0 +1,10 @@
+#pragma once
+
+#include "merian/vk/context.hpp"
+
+
+namespace device::rng_throughput {
+
+void benchmark(const merian::ContextHandle& context);
+
+}
@@ -1,6 +1,7 @@
 #include "merian/vk/extension/extension_resources.hpp"
 #include "merian/vk/shader/shader_compiler_system_glslc.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/pipeline/PipelineRegistry.hpp"
 #include "src/device/prefix_sum/PrefixSum.hpp"
 #include "src/device/prefix_sum/block_scan/BlockScanVariant.hpp"
 #include "src/device/prng/PRNG.hpp"
@@ -294,6 +295,8 @@ void benchmark(const merian::ContextHandle& context) {
 
     BenchmarkResults results;
     std::size_t i = 0;
+    // every configuration destroys its WRS before the next one is created.
+    const pipeline::PipelineRegistry::RetainScope retainPipelines;
     for (const auto& config : CONFIGURATIONS) {
         SPDLOG_INFO(
             "[{}%] Benchmarking {}",
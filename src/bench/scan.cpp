@@ -1,4 +1,5 @@
 #include "./wrs.hpp"
+#include "./peak_bandwidth.hpp"
 #include "merian/vk/extension/extension_resources.hpp"
 #include "merian/vk/shader/shader_compiler_system_glslc.hpp"
 #include "merian/vk/utils/profiler.hpp"
@@ -9,6 +10,7 @@
 #include "src/device/prng/philox/Philox.hpp"
 #include "src/host/export/csv.hpp"
 #include "src/host/export/logscale.hpp"
+#include "src/host/export/roofline.hpp"
 #include "src/host/gen/weight_generator.h"
 #include "vulkan/vulkan_enums.hpp"
 #include <algorithm>
@@ -340,6 +342,7 @@ struct ConfigResult {
     double latency;         // ms
     double stdVar;          // ms
     double memoryBandwidth; // Gb per second.
+    double peakFraction;    // memoryBandwidth / peak bandwidth
     double throughput;      // billion items per second
 };
 
@@ -359,7 +362,8 @@ struct BenchmarkResults {
 ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
                                        const merian::ShaderCompilerHandle& shaderCompiler,
                                        const merian::QueueHandle& queue,
-                                       const PrefixSum<weight_type>::Config& config) {
+                                       const PrefixSum<weight_type>::Config& config,
+                                       double peakBandwidth) {
 
     merian::CommandPoolHandle cmdPool = std::make_shared<merian::CommandPool>(queue);
 
@@ -450,14 +454,14 @@ ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
         double latency = entry->duration;
         double stdVar = entry->std_deviation;
 
-        std::size_t requireTransactionsByte = 2 * n * sizeof(weight_type);
-        double memoryBandwidth = ((requireTransactionsByte * 1e-9) / (entry->duration * 1e-3));
+        const auto roofline = host::exp::roofline(scan.cost(n), latency, peakBandwidth);
         double itemsPerSecond = (n / (entry->duration * 1e-3)) / 1e9;
 
         results.entries.push_back(ConfigResult{.N = n,
                                                .latency = latency,
                                                .stdVar = stdVar,
-                                               .memoryBandwidth = memoryBandwidth,
+                                               .memoryBandwidth = roofline.memoryBandwidth,
+                                               .peakFraction = roofline.peakFraction,
                                                .throughput = itemsPerSecond});
     }
 
@@ -471,6 +475,8 @@ void benchmark(const merian::ContextHandle& context) {
     merian::ShaderCompilerHandle shaderCompiler =
         std::make_shared<merian::SystemGlslcCompiler>(context);
 
+    const double peakBandwidth = peak_bandwidth::measure(context, shaderCompiler, queue);
+
     BenchmarkResults results;
     std::size_t i = 0;
     for (const auto& config : CONFIGURATIONS) {
@@ -480,7 +486,7 @@ void benchmark(const merian::ContextHandle& context) {
                 100.0f,
             config.name);
         auto configBenchmark =
-            benchmarkConfiguration(context, shaderCompiler, queue, config.config);
+            benchmarkConfiguration(context, shaderCompiler, queue, config.config, peakBandwidth);
         results.entries.push_back(BenchmarkResult{
             .configuration = config,
             .results = configBenchmark,
@@ -491,12 +497,14 @@ void benchmark(const merian::ContextHandle& context) {
     // export
 
     std::string path = "scan_benchmark.csv";
-    host::exp::CSVWriter<7> csv(
-        {"N", "method", "group", "latency", "std_derivation", "throughput", "memory_throughput"}, path);
+    host::exp::CSVWriter<8> csv({"N", "method", "group", "latency", "std_derivation", "throughput",
+                                 "memory_throughput", "peak_fraction"},
+                                path);
     for (const auto& r1 : results.entries) {
         std::string method = r1.configuration.name;
         for (const auto& r2 : r1.results.entries) {
-            csv.pushRow(r2.N, method, r1.configuration.group, r2.latency, r2.stdVar, r2.throughput, r2.memoryBandwidth);
+            csv.pushRow(r2.N, method, r1.configuration.group, r2.latency, r2.stdVar, r2.throughput,
+                        r2.memoryBandwidth, r2.peakFraction);
         }
     }
 }
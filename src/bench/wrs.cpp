@@ -2,12 +2,16 @@
 #include "merian/vk/extension/extension_resources.hpp"
 #include "merian/vk/shader/shader_compiler_system_glslc.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/PipelineRegistry.hpp"
 #include "src/device/wrs/WRS.hpp"
+#include "src/host/export/chrome_trace.hpp"
 #include "src/host/export/csv.hpp"
 #include "src/host/export/logscale.hpp"
 #include "src/host/gen/weight_generator.h"
 #include <csignal>
 #include <fmt/base.h>
+#include <optional>
 #include <spdlog/spdlog.h>
 #include <tuple>
 
@@ -93,6 +97,11 @@ static constexpr std::size_t S_min = (1 << 21);
 static constexpr std::size_t ticks = 25;
 static constexpr std::size_t iterations = 1;
 
+// passes the profiler to the build and sampling and writes the raw timestamps of all scopes
+// to wrs_benchmark_trace.json, the nested scopes add timestamp writes between the dispatches.
+static constexpr bool TRACE = false;
+static constexpr std::size_t traceScopes = TRACE ? 16 : 1; // timestamp scopes per build
+
 struct ConfigResult {
     std::size_t N;
     std::size_t S;
@@ -125,7 +134,8 @@ ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
                                        const std::size_t S,
                                        const std::size_t S_ticks,
                                        const std::size_t iterations,
-                                       std::span<const float> weights) {
+                                       std::span<const float> weights,
+                                       host::exp::ChromeTraceWriter* trace) {
     SPDLOG_INFO("Benchmarking {}", wrsConfigName(config));
     assert(N > 1024);
     assert(S > 1024);
@@ -138,6 +148,17 @@ ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
 
     WRS wrs{context, shaderCompiler, config};
 
+    bool stageScopes = trace != nullptr;
+    device::instrumentation::TimestampTraceHandle timestamps;
+    if (trace != nullptr) {
+        timestamps = device::instrumentation::TimestampTrace::enable(context);
+    }
+#ifdef WRS_PIPELINE_STATISTICS
+    // invocations are only counted in the stage scopes.
+    const auto statistics = device::instrumentation::PipelineStatistics::enable(context);
+    stageScopes = true;
+#endif
+
     WRS::Buffers local;
     { // Setup
         const auto& resourceExt = context->get_extension<merian::ExtensionResources>();
@@ -171,29 +192,26 @@ ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
         merian::ProfilerHandle profiler = std::make_shared<merian::Profiler>(context);
         merian::QueryPoolHandle<vk::QueryType::eTimestamp> query_pool =
             std::make_shared<merian::QueryPool<vk::QueryType::eTimestamp>>(
-                context, 8 * 2 * (S_ticks * iterations + iterations));
+                context, 8 * 2 * (S_ticks * iterations + traceScopes * iterations));
         query_pool->reset();
         profiler->set_query_pool(query_pool);
 
+        const std::optional<merian::ProfilerHandle> stageProfiler =
+            stageScopes ? std::make_optional(profiler) : std::nullopt;
+
         merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(cmdPool);
 
         cmd->begin();
         for (std::size_t i = 0; i < iterations; ++i) {
-            profiler->start("Build");
-            profiler->cmd_start(cmd, "Build");
-            wrs.build(cmd, local, n);
-            profiler->end();
-            profiler->cmd_end(cmd);
+            const device::instrumentation::ProfileScope scope{profiler, cmd, "Build"};
+            wrs.build(cmd, local, n, stageProfiler);
         }
 
         for (const std::size_t s : host::exp::log10scale<std::size_t>(S_min, S, S_ticks)) {
             std::string label = fmt::format("{}", s);
             for (std::size_t i = 0; i < iterations; ++i) {
-                profiler->start(label);
-                profiler->cmd_start(cmd, label);
-                wrs.sample(cmd, local, n, s);
-                profiler->end();
-                profiler->cmd_end(cmd);
+                const device::instrumentation::ProfileScope scope{profiler, cmd, label};
+                wrs.sample(cmd, local, n, s, 12345u, {}, stageProfiler);
             }
 
             cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
@@ -203,10 +221,25 @@ ConfigBenchmark benchmarkConfiguration(const merian::ContextHandle& context,
         }
 
         cmd->end();
-        queue->submit_wait(cmd);
+        device::instrumentation::submitWait(queue, cmd, profiler);
         profiler->collect(true, true);
+#ifdef WRS_PIPELINE_STATISTICS
+        for (const auto& [label, invocations] : statistics->collect()) {
+            SPDLOG_INFO("{}: {} invocations", label, invocations);
+        }
+#endif
 
         /* fmt::println("{}", merian::Profiler::get_report_str(profiler->get_report())); */
+        if (trace != nullptr) {
+            std::vector<host::exp::TraceSlice> cpuSlices;
+            std::vector<host::exp::TraceSlice> gpuSlices;
+            for (const auto& scope : timestamps->collect()) {
+                cpuSlices.push_back({scope.label, scope.cpuBeginNs, scope.cpuEndNs});
+                gpuSlices.push_back({scope.label, scope.gpuBeginNs, scope.gpuEndNs});
+            }
+            trace->pushTimestamps(fmt::format("{} N={}", wrsConfigName(config), n), cpuSlices,
+                                  gpuSlices);
+        }
 
         double buildLatency;
         double buildStdVar;
@@ -248,10 +281,18 @@ void benchmark(const merian::ContextHandle& context) {
 
     auto weights = host::generate_weights<float>(host::Distribution::PSEUDO_RANDOM_UNIFORM, N);
 
+    std::optional<host::exp::ChromeTraceWriter> trace;
+    if (TRACE) {
+        trace.emplace("wrs_benchmark_trace.json");
+    }
+
     BenchmarkResults results;
+    // every configuration destroys its WRS before the next one is created.
+    const pipeline::PipelineRegistry::RetainScope retainPipelines;
     for (const auto& config : CONFIGURATIONS) {
-        auto configBenchmark = benchmarkConfiguration(context, shaderCompiler, queue, config.config,
-                                                      N, ticks, S, ticks, iterations, weights);
+        auto configBenchmark =
+            benchmarkConfiguration(context, shaderCompiler, queue, config.config, N, ticks, S,
+                                   ticks, iterations, weights, trace ? &*trace : nullptr);
         results.entries.push_back(BenchmarkResult{
             .configuration = config,
             .results = configBenchmark,
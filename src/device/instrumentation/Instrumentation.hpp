@@ -0,0 +1,146 @@
+#pragma once
+/**
+ * Per-stage instrumentation, which is used by every kernel and compiled out when disabled.
+ *
+ * WRS_INSTRUMENTATION is defined if merian's profiler is enabled (MERIAN_PROFILER_ENABLE)
+ * and the meson option 'instrumentation' is not disabled. Without it the macros expand to
+ * nothing, neither the labels nor the profiler are evaluated.
+ *
+ * WRS_PROFILE_SCOPE(profiler, cmd, label)
+ *     CPU (recording) and GPU timestamp scope until the end of the enclosing block,
+ *     profiler is a std::optional<merian::ProfilerHandle>.
+ *     With the meson option 'pipeline_statistics' it also counts the compute shader
+ *     invocations of the scope (see PipelineStatistics.hpp).
+ *     If a TimestampTrace is enabled, it also records the raw timestamps of the scope.
+ *
+ * WRS_PROFILE_HOST_SCOPE(profiler, label)
+ *     CPU only scope, e.g. around queue submits (see submitWait).
+ *
+ * Example:
+ * {
+ *     WRS_PROFILE_SCOPE(profiler, cmd, "Split");
+ *     cmd->dispatch(workgroupCount, 1, 1);
+ * }
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/command/queue.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/TimestampTrace.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#if defined(MERIAN_PROFILER_ENABLE) && !defined(WRS_DISABLE_INSTRUMENTATION)
+#define WRS_INSTRUMENTATION
+#endif
+
+#ifdef WRS_PIPELINE_STATISTICS
+#include "src/device/instrumentation/PipelineStatistics.hpp"
+#endif
+
+namespace device::instrumentation {
+
+class ProfileScope {
+  public:
+    ProfileScope(const std::optional<merian::ProfilerHandle>& profiler,
+                 const merian::CommandBufferHandle& cmd,
+                 const std::string& label)
+        : m_profiler(profiler), m_cmd(cmd) {
+        if (!m_profiler.has_value()) {
+            return;
+        }
+        m_profiler.value()->start(label);
+        m_profiler.value()->cmd_start(m_cmd, label);
+        m_trace = TimestampTrace::active();
+        if (m_trace != nullptr) {
+            m_traceScope = m_trace->begin(m_cmd, label);
+        }
+#ifdef WRS_PIPELINE_STATISTICS
+        if (const auto statistics = PipelineStatistics::active(); statistics != nullptr) {
+            statistics->begin(m_cmd, label);
+        }
+#endif
+    }
+
+    ~ProfileScope() {
+        if (!m_profiler.has_value()) {
+            return;
+        }
+#ifdef WRS_PIPELINE_STATISTICS
+        if (const auto statistics = PipelineStatistics::active(); statistics != nullptr) {
+            statistics->end(m_cmd);
+        }
+#endif
+        if (m_trace != nullptr) {
+            m_trace->end(m_cmd, m_traceScope);
+        }
+        m_profiler.value()->end();
+        m_profiler.value()->cmd_end(m_cmd);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+  private:
+    const std::optional<merian::ProfilerHandle> m_profiler;
+    const merian::CommandBufferHandle m_cmd;
+    TimestampTraceHandle m_trace;
+    std::uint32_t m_traceScope = TimestampTrace::INVALID_SCOPE;
+};
+
+class HostScope {
+  public:
+    HostScope(const std::optional<merian::ProfilerHandle>& profiler, const std::string& label)
+        : m_profiler(profiler) {
+        if (m_profiler.has_value()) {
+            m_profiler.value()->start(label);
+        }
+    }
+
+    ~HostScope() {
+        if (m_profiler.has_value()) {
+            m_profiler.value()->end();
+        }
+    }
+
+    HostScope(const HostScope&) = delete;
+    HostScope& operator=(const HostScope&) = delete;
+
+  private:
+    const std::optional<merian::ProfilerHandle> m_profiler;
+};
+
+} // namespace device::instrumentation
+
+#define WRS_INSTRUMENTATION_CONCAT_INNER(a, b) a##b
+#define WRS_INSTRUMENTATION_CONCAT(a, b) WRS_INSTRUMENTATION_CONCAT_INNER(a, b)
+
+#ifdef WRS_INSTRUMENTATION
+#define WRS_PROFILE_SCOPE(profiler, cmd, label)                                                    \
+    const device::instrumentation::ProfileScope WRS_INSTRUMENTATION_CONCAT(wrsProfileScope,       \
+                                                                           __LINE__) {             \
+        profiler, cmd, label                                                                       \
+    }
+#define WRS_PROFILE_HOST_SCOPE(profiler, label)                                                    \
+    const device::instrumentation::HostScope WRS_INSTRUMENTATION_CONCAT(wrsHostScope, __LINE__) {  \
+        profiler, label                                                                            \
+    }
+#else
+#define WRS_PROFILE_SCOPE(profiler, cmd, label) static_cast<void>(profiler)
+#define WRS_PROFILE_HOST_SCOPE(profiler, label) static_cast<void>(profiler)
+#endif
+
+namespace device::instrumentation {
+
+/// queue->submit_wait with a host scope, which measures the submit including the wait.
+inline void submitWait(const merian::QueueHandle& queue,
+                       const merian::CommandBufferHandle& cmd,
+                       [[maybe_unused]] const std::optional<merian::ProfilerHandle>& profiler,
+                       [[maybe_unused]] const std::string& label = "Submit") {
+    WRS_PROFILE_HOST_SCOPE(profiler, label);
+    queue->submit_wait(cmd);
+}
+
+} // namespace device::instrumentation
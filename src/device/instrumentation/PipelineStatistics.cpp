@@ -0,0 +1,121 @@
+#include "./PipelineStatistics.hpp"
+#include <algorithm>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+namespace device::instrumentation::details {
+
+static std::mutex s_activeMutex;
+static std::weak_ptr<PipelineStatistics> s_active;
+
+} // namespace device::instrumentation::details
+
+device::instrumentation::PipelineStatistics::PipelineStatistics(
+    const merian::ContextHandle& context, std::uint32_t capacity)
+    : m_context(context), m_capacity(capacity) {
+    vk::QueryPoolCreateInfo createInfo{};
+    createInfo.queryType = vk::QueryType::ePipelineStatistics;
+    createInfo.queryCount = m_capacity;
+    createInfo.pipelineStatistics = vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations;
+    m_queryPool = m_context->device.createQueryPool(createInfo);
+    m_context->device.resetQueryPool(m_queryPool, 0, m_capacity);
+    m_queryLabels.reserve(m_capacity);
+}
+
+device::instrumentation::PipelineStatistics::~PipelineStatistics() {
+    m_context->device.destroyQueryPool(m_queryPool);
+}
+
+std::shared_ptr<device::instrumentation::PipelineStatistics>
+device::instrumentation::PipelineStatistics::enable(const merian::ContextHandle& context,
+                                                    std::uint32_t capacity) {
+    auto statistics = std::make_shared<PipelineStatistics>(context, capacity);
+    std::scoped_lock lock{details::s_activeMutex};
+    details::s_active = statistics;
+    return statistics;
+}
+
+std::shared_ptr<device::instrumentation::PipelineStatistics>
+device::instrumentation::PipelineStatistics::active() {
+    std::scoped_lock lock{details::s_activeMutex};
+    return details::s_active.lock();
+}
+
+void device::instrumentation::PipelineStatistics::openQuery(const merian::CommandBufferHandle& cmd,
+                                                            OpenScopes& scopes,
+                                                            const std::string& label) {
+    if (m_queryLabels.size() >= m_capacity) {
+        if (!m_overflow) {
+            SPDLOG_WARN("Pipeline statistics ran out of queries, collect() more often");
+            m_overflow = true;
+        }
+        return;
+    }
+    const auto query = static_cast<std::uint32_t>(m_queryLabels.size());
+    cmd->get_command_buffer().beginQuery(m_queryPool, query, {});
+    m_queryLabels.push_back(label);
+    scopes.query = query;
+}
+
+void device::instrumentation::PipelineStatistics::closeQuery(
+    const merian::CommandBufferHandle& cmd, OpenScopes& scopes) {
+    if (scopes.query.has_value()) {
+        cmd->get_command_buffer().endQuery(m_queryPool, *scopes.query);
+        scopes.query.reset();
+    }
+}
+
+void device::instrumentation::PipelineStatistics::begin(const merian::CommandBufferHandle& cmd,
+                                                        const std::string& label) {
+    std::scoped_lock lock{m_mutex};
+    OpenScopes& scopes = m_open[cmd.get()];
+    closeQuery(cmd, scopes); // suspends the parent
+    scopes.labels.push_back(label);
+    openQuery(cmd, scopes, label);
+}
+
+void device::instrumentation::PipelineStatistics::end(const merian::CommandBufferHandle& cmd) {
+    std::scoped_lock lock{m_mutex};
+    const auto it = m_open.find(cmd.get());
+    if (it == m_open.end()) {
+        return;
+    }
+    OpenScopes& scopes = it->second;
+    closeQuery(cmd, scopes);
+    scopes.labels.pop_back();
+    if (scopes.labels.empty()) {
+        m_open.erase(it);
+    } else {
+        openQuery(cmd, scopes, scopes.labels.back()); // resumes the parent
+    }
+}
+
+std::vector<std::pair<std::string, std::uint64_t>>
+device::instrumentation::PipelineStatistics::collect() {
+    std::scoped_lock lock{m_mutex};
+    std::vector<std::pair<std::string, std::uint64_t>> invocations;
+    const auto queryCount = static_cast<std::uint32_t>(m_queryLabels.size());
+    if (queryCount != 0) {
+        std::vector<std::uint64_t> results(queryCount);
+        const vk::Result result = m_context->device.getQueryPoolResults(
+            m_queryPool, 0, queryCount, results.size() * sizeof(std::uint64_t), results.data(),
+            sizeof(std::uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to read pipeline statistics");
+        }
+        for (std::uint32_t i = 0; i < queryCount; ++i) {
+            auto it = std::ranges::find_if(
+                invocations, [&](const auto& entry) { return entry.first == m_queryLabels[i]; });
+            if (it == invocations.end()) {
+                invocations.emplace_back(m_queryLabels[i], results[i]);
+            } else {
+                it->second += results[i];
+            }
+        }
+        m_context->device.resetQueryPool(m_queryPool, 0, queryCount);
+    }
+    m_queryLabels.clear();
+    m_overflow = false;
+    return invocations;
+}
@@ -0,0 +1,79 @@
+#pragma once
+/**
+ * Counts the compute shader invocations of every WRS_PROFILE_SCOPE (see Instrumentation.hpp),
+ * only compiled with the meson option 'pipeline_statistics', which also requests the
+ * pipelineStatisticsQuery device feature (see main.cpp).
+ *
+ * Scopes record into the active instance, which is the last one created with enable(),
+ * as long as a handle to it is alive.
+ *
+ * Vulkan does not allow nested queries of the same type within a command buffer,
+ * therefore an inner scope suspends the query of its parent. The reported invocations
+ * of a scope are exclusive, they do not include the invocations of its children.
+ *
+ * The open scopes are tracked per command buffer, such that command buffers can be
+ * recorded interleaved and from multiple threads.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/context.hpp"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace device::instrumentation {
+
+class PipelineStatistics {
+  public:
+    PipelineStatistics(const merian::ContextHandle& context, std::uint32_t capacity);
+
+    ~PipelineStatistics();
+
+    PipelineStatistics(const PipelineStatistics&) = delete;
+    PipelineStatistics& operator=(const PipelineStatistics&) = delete;
+
+    /// Creates an instance with room for capacity queries and makes it the active one.
+    static std::shared_ptr<PipelineStatistics> enable(const merian::ContextHandle& context,
+                                                      std::uint32_t capacity = 4096);
+
+    /// Returns the active instance or nullptr.
+    static std::shared_ptr<PipelineStatistics> active();
+
+    void begin(const merian::CommandBufferHandle& cmd, const std::string& label);
+
+    void end(const merian::CommandBufferHandle& cmd);
+
+    /// Compute shader invocations per label (summed over all captures) in order of first use.
+    /// Waits for the results and resets all queries, all recorded commands must be submitted.
+    std::vector<std::pair<std::string, std::uint64_t>> collect();
+
+  private:
+    struct OpenScopes {
+        std::vector<std::string> labels;    // innermost last
+        std::optional<std::uint32_t> query; // query of the innermost scope
+    };
+
+    void openQuery(const merian::CommandBufferHandle& cmd,
+                   OpenScopes& scopes,
+                   const std::string& label);
+
+    void closeQuery(const merian::CommandBufferHandle& cmd, OpenScopes& scopes);
+
+    const merian::ContextHandle m_context;
+    const std::uint32_t m_capacity;
+    vk::QueryPool m_queryPool;
+
+    std::mutex m_mutex;
+    std::vector<std::string> m_queryLabels; // label of every used query
+    std::unordered_map<const merian::CommandBuffer*, OpenScopes> m_open;
+    bool m_overflow = false;
+};
+
+using PipelineStatisticsHandle = std::shared_ptr<PipelineStatistics>;
+
+} // namespace device::instrumentation
@@ -0,0 +1,113 @@
+#include "./TimestampTrace.hpp"
+#include <chrono>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+namespace device::instrumentation::details {
+
+static std::mutex s_activeTraceMutex;
+static std::weak_ptr<TimestampTrace> s_activeTrace;
+
+static std::uint64_t steadyNs() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                          std::chrono::steady_clock::now().time_since_epoch())
+                                          .count());
+}
+
+} // namespace device::instrumentation::details
+
+device::instrumentation::TimestampTrace::TimestampTrace(const merian::ContextHandle& context,
+                                                        std::uint32_t capacity)
+    : m_context(context), m_capacity(capacity),
+      m_timestampPeriod(
+          context->physical_device.physical_device.getProperties().limits.timestampPeriod) {
+    vk::QueryPoolCreateInfo createInfo{};
+    createInfo.queryType = vk::QueryType::eTimestamp;
+    createInfo.queryCount = 2 * m_capacity;
+    m_queryPool = m_context->device.createQueryPool(createInfo);
+    m_context->device.resetQueryPool(m_queryPool, 0, 2 * m_capacity);
+    m_scopes.reserve(m_capacity);
+}
+
+device::instrumentation::TimestampTrace::~TimestampTrace() {
+    m_context->device.destroyQueryPool(m_queryPool);
+}
+
+std::shared_ptr<device::instrumentation::TimestampTrace>
+device::instrumentation::TimestampTrace::enable(const merian::ContextHandle& context,
+                                                std::uint32_t capacity) {
+    auto trace = std::make_shared<TimestampTrace>(context, capacity);
+    std::scoped_lock lock{details::s_activeTraceMutex};
+    details::s_activeTrace = trace;
+    return trace;
+}
+
+std::shared_ptr<device::instrumentation::TimestampTrace>
+device::instrumentation::TimestampTrace::active() {
+    std::scoped_lock lock{details::s_activeTraceMutex};
+    return details::s_activeTrace.lock();
+}
+
+std::uint32_t device::instrumentation::TimestampTrace::begin(const merian::CommandBufferHandle& cmd,
+                                                             const std::string& label) {
+    std::uint32_t scope;
+    {
+        std::scoped_lock lock{m_mutex};
+        if (m_scopes.size() >= m_capacity) {
+            if (!m_overflow) {
+                SPDLOG_WARN("Timestamp trace ran out of queries, collect() more often");
+                m_overflow = true;
+            }
+            return INVALID_SCOPE;
+        }
+        scope = static_cast<std::uint32_t>(m_scopes.size());
+        m_scopes.push_back(TimestampScope{
+            .label = label,
+            .cpuBeginNs = details::steadyNs(),
+            .cpuEndNs = 0,
+            .gpuBeginNs = 0,
+            .gpuEndNs = 0,
+        });
+    }
+    cmd->get_command_buffer().writeTimestamp(vk::PipelineStageFlagBits::eAllCommands,
+                                             m_queryPool, 2 * scope);
+    return scope;
+}
+
+void device::instrumentation::TimestampTrace::end(const merian::CommandBufferHandle& cmd,
+                                                  std::uint32_t scope) {
+    if (scope == INVALID_SCOPE) {
+        return;
+    }
+    cmd->get_command_buffer().writeTimestamp(vk::PipelineStageFlagBits::eAllCommands,
+                                             m_queryPool, 2 * scope + 1);
+    std::scoped_lock lock{m_mutex};
+    m_scopes[scope].cpuEndNs = details::steadyNs();
+}
+
+std::vector<device::instrumentation::TimestampScope>
+device::instrumentation::TimestampTrace::collect() {
+    std::scoped_lock lock{m_mutex};
+    const auto queryCount = static_cast<std::uint32_t>(2 * m_scopes.size());
+    if (queryCount != 0) {
+        std::vector<std::uint64_t> results(queryCount);
+        const vk::Result result = m_context->device.getQueryPoolResults(
+            m_queryPool, 0, queryCount, results.size() * sizeof(std::uint64_t), results.data(),
+            sizeof(std::uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to read the timestamp trace");
+        }
+        for (std::size_t i = 0; i < m_scopes.size(); ++i) {
+            m_scopes[i].gpuBeginNs =
+                static_cast<std::uint64_t>(static_cast<double>(results[2 * i]) * m_timestampPeriod);
+            m_scopes[i].gpuEndNs = static_cast<std::uint64_t>(
+                static_cast<double>(results[2 * i + 1]) * m_timestampPeriod);
+        }
+        m_context->device.resetQueryPool(m_queryPool, 0, queryCount);
+    }
+    std::vector<TimestampScope> scopes = std::move(m_scopes);
+    m_scopes.clear();
+    m_scopes.reserve(m_capacity);
+    m_overflow = false;
+    return scopes;
+}
@@ -0,0 +1,74 @@
+#pragma once
+/**
+ * Records the raw CPU (recording) and GPU timestamps of every WRS_PROFILE_SCOPE
+ * (see Instrumentation.hpp), unlike merian's profiler, which only reports the mean
+ * and standard deviation of all captures. Exported with host::exp::ChromeTraceWriter.
+ *
+ * Scopes record into the active instance, which is the last one created with enable(),
+ * as long as a handle to it is alive.
+ *
+ * Every scope writes a timestamp query pair, begin() returns the index of the scope,
+ * which is passed to end(). Scopes may be nested and recorded from multiple threads.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/context.hpp"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace device::instrumentation {
+
+struct TimestampScope {
+    std::string label;
+    // steady_clock, when the scope was recorded.
+    std::uint64_t cpuBeginNs;
+    std::uint64_t cpuEndNs;
+    // device timestamps, when the scope was executed.
+    std::uint64_t gpuBeginNs;
+    std::uint64_t gpuEndNs;
+};
+
+class TimestampTrace {
+  public:
+    static constexpr std::uint32_t INVALID_SCOPE = ~0u;
+
+    TimestampTrace(const merian::ContextHandle& context, std::uint32_t capacity);
+
+    ~TimestampTrace();
+
+    TimestampTrace(const TimestampTrace&) = delete;
+    TimestampTrace& operator=(const TimestampTrace&) = delete;
+
+    /// Creates an instance with room for capacity scopes and makes it the active one.
+    static std::shared_ptr<TimestampTrace> enable(const merian::ContextHandle& context,
+                                                  std::uint32_t capacity = 4096);
+
+    /// Returns the active instance or nullptr.
+    static std::shared_ptr<TimestampTrace> active();
+
+    /// Returns INVALID_SCOPE if the capacity is exhausted.
+    std::uint32_t begin(const merian::CommandBufferHandle& cmd, const std::string& label);
+
+    void end(const merian::CommandBufferHandle& cmd, std::uint32_t scope);
+
+    /// Scopes in order of begin(). Waits for the results and resets all queries,
+    /// all recorded commands must be submitted.
+    std::vector<TimestampScope> collect();
+
+  private:
+    const merian::ContextHandle m_context;
+    const std::uint32_t m_capacity;
+    const double m_timestampPeriod; // ns per tick
+    vk::QueryPool m_queryPool;
+
+    std::mutex m_mutex;
+    std::vector<TimestampScope> m_scopes;
+    bool m_overflow = false;
+};
+
+using TimestampTraceHandle = std::shared_ptr<TimestampTrace>;
+
+} // namespace device::instrumentation
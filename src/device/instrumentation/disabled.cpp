@@ -0,0 +1,21 @@
+// Compiles the instrumentation macros as with the meson option 'instrumentation' disabled,
+// independent of the options of the build (see test.cpp).
+#ifndef WRS_DISABLE_INSTRUMENTATION
+#define WRS_DISABLE_INSTRUMENTATION
+#endif
+#include "src/device/instrumentation/Instrumentation.hpp"
+
+#ifdef WRS_INSTRUMENTATION
+#error "WRS_DISABLE_INSTRUMENTATION has to disable WRS_INSTRUMENTATION"
+#endif
+
+namespace device::test::instrumentation {
+
+// The command buffer and the labels are not declared, this only compiles if the disabled
+// macros drop them and evaluate nothing but the profiler.
+void disabledScopes(const std::optional<merian::ProfilerHandle>& profiler) {
+    WRS_PROFILE_SCOPE(profiler, undeclaredCommandBuffer, undeclaredLabel);
+    WRS_PROFILE_HOST_SCOPE(profiler, undeclaredLabel);
+}
+
+} // namespace device::test::instrumentation
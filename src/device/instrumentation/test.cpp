@@ -0,0 +1,150 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/instrumentation/TimestampTrace.hpp"
+#include "src/device/wrs/WRS.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <set>
+#include <spdlog/spdlog.h>
+#include <string>
+
+#ifdef WRS_PIPELINE_STATISTICS
+#include "src/device/instrumentation/PipelineStatistics.hpp"
+#endif
+
+namespace device::test::instrumentation {
+
+// see disabled.cpp
+void disabledScopes(const std::optional<merian::ProfilerHandle>& profiler);
+
+static constexpr host::glsl::uint N = 1 << 20;
+static constexpr host::glsl::uint S = 1 << 16;
+
+/// The disabled macros must not record anything into the profiler.
+static bool testDisabledScopes(const host::test::TestContext& context) {
+    const merian::ProfilerHandle profiler = std::make_shared<merian::Profiler>(context.context);
+    disabledScopes(profiler);
+    profiler->collect(true, true);
+    const auto report = profiler->get_report();
+    if (!report.cpu_report.empty() || !report.gpu_report.empty()) {
+        SPDLOG_ERROR("The disabled instrumentation macros recorded a scope");
+        return true;
+    }
+    return false;
+}
+
+/// Every stage of the build has to be reported as its own scope within the build.
+static bool testStageScopes(const host::test::TestContext& context) {
+    const WRS::Config config{};
+    WRS wrs{context.context, context.shaderCompiler, config};
+
+    WRS::Buffers buffers =
+        WRS::Buffers::allocate(context.alloc, merian::MemoryMappingType::NONE, N, S, config);
+    WRS::Buffers stage = WRS::Buffers::allocate(
+        context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM, N, S, config);
+
+    const auto timestamps = device::instrumentation::TimestampTrace::enable(context.context);
+#ifdef WRS_PIPELINE_STATISTICS
+    const auto statistics = device::instrumentation::PipelineStatistics::enable(context.context);
+#endif
+
+    const merian::ProfilerHandle profiler = std::make_shared<merian::Profiler>(context.context);
+    merian::QueryPoolHandle<vk::QueryType::eTimestamp> queryPool =
+        std::make_shared<merian::QueryPool<vk::QueryType::eTimestamp>>(context.context, 256);
+    queryPool->reset();
+    profiler->set_query_pool(queryPool);
+
+    const auto weights =
+        host::generate_weights<float>(host::Distribution::PSEUDO_RANDOM_UNIFORM, N);
+
+    merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+    cmd->begin();
+    WRS::Buffers::WeightsView stageWeights{stage.weights, N};
+    WRS::Buffers::WeightsView localWeights{buffers.weights, N};
+    stageWeights.upload<float>(weights);
+    stageWeights.copyTo(cmd, localWeights);
+    localWeights.expectComputeRead(cmd);
+    {
+        const device::instrumentation::ProfileScope scope{profiler, cmd, "Build"};
+        wrs.build(cmd, buffers, N, profiler);
+    }
+    cmd->end();
+    context.queue->submit_wait(cmd);
+    profiler->collect(true, true);
+
+    bool failed = false;
+    const auto scopes = timestamps->collect();
+    if (scopes.empty() || scopes.front().label != "Build") {
+        SPDLOG_ERROR("The build scope was not recorded");
+        return true;
+    }
+    const auto& build = scopes.front();
+    std::set<std::string> stages;
+    for (std::size_t i = 1; i < scopes.size(); ++i) {
+        const auto& scope = scopes[i];
+        stages.insert(scope.label);
+        if (scope.gpuBeginNs < build.gpuBeginNs || scope.gpuEndNs > build.gpuEndNs ||
+            scope.gpuBeginNs > scope.gpuEndNs) {
+            SPDLOG_ERROR("The GPU timestamps of {} are not within the build", scope.label);
+            failed = true;
+        }
+        if (scope.cpuBeginNs < build.cpuBeginNs || scope.cpuEndNs > build.cpuEndNs) {
+            SPDLOG_ERROR("The CPU timestamps of {} are not within the build", scope.label);
+            failed = true;
+        }
+    }
+#ifdef WRS_INSTRUMENTATION
+    SPDLOG_INFO("Recorded stages: {}", fmt::join(stages, ", "));
+    if (stages.size() < 2) {
+        SPDLOG_ERROR("Expected a scope per stage of the build, got {}", stages.size());
+        failed = true;
+    }
+#else
+    if (!stages.empty()) {
+        SPDLOG_ERROR("The disabled instrumentation recorded {} stages", stages.size());
+        failed = true;
+    }
+#endif
+
+#ifdef WRS_PIPELINE_STATISTICS
+    std::size_t countedStages = 0;
+    for (const auto& [label, invocations] : statistics->collect()) {
+        SPDLOG_INFO("{}: {} invocations", label, invocations);
+        if (stages.contains(label) && invocations != 0) {
+            countedStages++;
+        }
+    }
+    if (countedStages != stages.size()) {
+        SPDLOG_ERROR("Counted the invocations of {} out of {} stages", countedStages,
+                     stages.size());
+        failed = true;
+    }
+#endif
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing instrumentation");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    uint32_t failCount = 0;
+    if (testDisabledScopes(testContext)) {
+        failCount++;
+    }
+    if (testStageScopes(testContext)) {
+        failCount++;
+    }
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount, 2));
+    }
+}
+
+} // namespace device::test::instrumentation
@@ -19,7 +19,9 @@
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
 #include "src/device/mean/MeanAllocFlags.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/layout/PrimitiveLayout.hpp"
@@ -104,43 +106,26 @@ class AtomicMean {
                         AtomicMeanConfig config = {})
         : m_partitionSize(config.rows * config.workgroupSize) {
 
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // elements
-                .add_binding_storage_buffer() // mean
-                .build_push_descriptor_layout(context);
-
         const std::string shaderPath = "src/device/mean/atomic/shader.comp";
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(config.workgroupSize);
-        specInfoBuilder.add_entry(config.rows);
-        specInfoBuilder.add_entry(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addStorageBuffer() // elements
+                         .addStorageBuffer() // mean
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(config.rows)
+                         .addSpecializationConstant(subgroupSize)
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd,
              const Buffers& buffers,
              host::glsl::uint N,
              std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->start("Atomic-Mean");
-            profiler.value()->cmd_start(cmd, "Atomic-Mean");
-        }
-#endif
+        WRS_PROFILE_SCOPE(profiler, cmd, "Atomic-Mean");
 
         cmd->fill(buffers.mean, 0);
         cmd->barrier(vk::PipelineStageFlagBits::eTransfer,
@@ -155,13 +140,6 @@ class AtomicMean {
                                                       });
         const uint32_t workgroupCount = (N + m_partitionSize - 1) / m_partitionSize;
         cmd->dispatch(workgroupCount, 1, 1);
-
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
-        }
-#endif
     }
 
   private:
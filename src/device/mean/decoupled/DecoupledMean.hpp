@@ -19,7 +19,9 @@
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
 #include "src/device/mean/MeanAllocFlags.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/Attribute.hpp"
 #include "src/host/layout/BufferView.hpp"
@@ -122,12 +124,6 @@ class DecoupledMean {
                   DecoupledMeanConfig config)
         : m_blockSize(config.blockSize()) {
         constexpr bool stable = false;
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // elements
-                .add_binding_storage_buffer() // mean
-                .add_binding_storage_buffer() // decoupled states
-                .build_push_descriptor_layout(context);
         std::string shaderPath;
         if (stable) {
             throw std::runtime_error("Not implemented yet");
@@ -135,34 +131,26 @@ class DecoupledMean {
         } else {
             shaderPath = "src/device/mean/decoupled/float.comp";
         }
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<uint32_t>() // size (N)
-                .build_pipeline_layout();
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(config.workgroupSize);
-        specInfoBuilder.add_entry(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        specInfoBuilder.add_entry(config.rows);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addStorageBuffer() // elements
+                         .addStorageBuffer() // mean
+                         .addStorageBuffer() // decoupled states
+                         .addPushConstant<uint32_t>() // size (N)
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(subgroupSize)
+                         .addSpecializationConstant(config.rows)
+                         .build();
     }
 
     void run(merian::CommandBufferHandle cmd,
              const DecoupledMeanBuffers& buffers,
              uint32_t N,
              std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->start("Decoupled-Mean");
-            profiler.value()->cmd_start(cmd, "Decoupled-Mean");
-        }
-#endif
+        WRS_PROFILE_SCOPE(profiler, cmd, "Decoupled-Mean");
 
         // NOTE restrictive API, would be nice to only zero a portion of the buffer
         cmd->fill(buffers.decoupledStates, 0);
@@ -178,13 +166,6 @@ class DecoupledMean {
 
         const uint32_t workgroupCount = (N + m_blockSize - 1) / m_blockSize;
         cmd->dispatch(workgroupCount, 1, 1);
-        
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
-        }
-#endif
     }
 
     inline uint32_t getPartitionSize() const {
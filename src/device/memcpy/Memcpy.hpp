@@ -8,10 +8,13 @@
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/device/prefix_sum/block_scan/BlockScanVariant.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/types/glsl.hpp"
+#include "src/host/types/kernel_cost.hpp"
 #include <fmt/base.h>
 #include <fmt/format.h>
 #include <memory>
@@ -91,35 +94,24 @@ template <typename T = float> class Memcpy {
                     MemcpyConfig config)
         : m_blockSize(config.blockSize()) {
 
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // elements
-                .add_binding_storage_buffer() // reductions
-                .add_binding_storage_buffer() // prefix sum
-                .build_push_descriptor_layout(context);
-
         const std::string shaderPath = "src/device/memcpy/shader.comp";
 
         std::map<std::string, std::string> defines;
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute, {"src/device/common/"},
-            defines);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(config.workgroupSize);
-        specInfoBuilder.add_entry(config.rows);
-        specInfoBuilder.add_entry(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addIncludePath("src/device/common/")
+                         .setDefines(defines)
+                         .addStorageBuffer() // elements
+                         .addStorageBuffer() // reductions
+                         .addStorageBuffer() // prefix sum
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(config.rows)
+                         .addSpecializationConstant(subgroupSize)
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd,
@@ -132,28 +124,23 @@ template <typename T = float> class Memcpy {
         cmd->push_constant<PushConstants>(m_pipeline, PushConstants{.N = N});
         const uint32_t workgroupCount = (N + m_blockSize - 1) / m_blockSize;
 
-        cmd->dispatch(workgroupCount, 1, 1);
-
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-          profiler.value()->start("Memcpy");
-          profiler.value()->cmd_start(cmd, "Memcpy", vk::PipelineStageFlagBits::eTopOfPipe);
-        }
-#endif
-
+        WRS_PROFILE_SCOPE(profiler, cmd, "Memcpy");
 
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-          profiler.value()->end();
-          profiler.value()->cmd_end(cmd, vk::PipelineStageFlagBits::eComputeShader);
-        }
-#endif
+        cmd->dispatch(workgroupCount, 1, 1);
     }
 
     inline host::glsl::uint blockSize() const {
         return m_blockSize;
     }
 
+    static host::KernelCost cost(host::glsl::uint N) {
+        return host::KernelCost{
+            .bytesRead = N * sizeof(T),
+            .bytesWritten = N * sizeof(T),
+            .operations = 0,
+        };
+    }
+
   private:
     merian::PipelineHandle m_pipeline;
     host::glsl::uint m_blockSize;
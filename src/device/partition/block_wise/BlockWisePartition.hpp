@@ -2,6 +2,7 @@
 
 #include "merian/vk/memory/resource_allocations.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
 #include "src/device/partition/PartitionAllocFlags.hpp"
 #include "src/device/partition/block_wise/block_scan/PartitionBlockScan.hpp"
 #include "src/device/partition/block_wise/combine/PartitionCombine.hpp"
@@ -211,15 +212,9 @@ struct BlockWisePartition {
 
         host::glsl::uint blockCount =
             (N + m_elementScan.blockSize() - 1) / m_elementScan.blockSize();
-        if (profiler.has_value()) {
-
-            profiler.value()->start(fmt::format("ElementScan {}", blockCount));
-            profiler.value()->cmd_start(cmd, fmt::format("ElementScan {}", blockCount));
-        }
-        m_elementScan.run(cmd, elementScanBuffers, N);
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, fmt::format("ElementScan {}", blockCount));
+            m_elementScan.run(cmd, elementScanBuffers, N);
         }
 
         cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
@@ -232,14 +227,9 @@ struct BlockWisePartition {
         blockScanBuffers.prefixSum = buffers.blockIndices;
         blockScanBuffers.reductions = buffers.heavyCount;
 
-        if (profiler.has_value()) {
-            profiler.value()->start("BlockScan");
-            profiler.value()->cmd_start(cmd, "BlockScan");
-        }
-        m_blockScan.run(cmd, blockScanBuffers, blockCount);
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "BlockScan");
+            m_blockScan.run(cmd, blockScanBuffers, blockCount);
         }
 
         cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
@@ -255,16 +245,10 @@ struct BlockWisePartition {
         combineBuffers.partitionIndices = buffers.partitionIndices;
         combineBuffers.partition = buffers.partition;
 
-        if (profiler.has_value()) {
-            host::glsl::uint count = (N + m_combine.tileSize() - 1) / m_combine.tileSize();
-            profiler.value()->start(fmt::format("Combine {}", count));
-            profiler.value()->cmd_start(cmd, fmt::format("Combine {}", count));
-        }
+        [[maybe_unused]] const host::glsl::uint tileCount =
+            (N + m_combine.tileSize() - 1) / m_combine.tileSize();
+        WRS_PROFILE_SCOPE(profiler, cmd, fmt::format("Combine {}", tileCount));
         m_combine.run(cmd, combineBuffers, N);
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
-        }
     }
 
     inline host::glsl::uint maxElementCount() const {
@@ -8,6 +8,7 @@
 #include "merian/vk/pipeline/specialization_info.hpp"
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/device/prefix_sum/block_scan/BlockScanVariant.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
@@ -119,14 +120,6 @@ class PartitionBlockScan {
                                 PartitionBlockScanConfig config)
         : m_blockSize(config.blockSize()) {
 
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // elements
-                .add_binding_storage_buffer() // pivot (condition)
-                .add_binding_storage_buffer() // indices
-                .add_binding_storage_buffer() // block counts
-                .build_push_descriptor_layout(context);
-
         const std::string shaderPath =
             "src/device/partition/block_wise/block_scan/shader.comp";
 
@@ -158,25 +151,22 @@ class PartitionBlockScan {
 
         defines["USE_FLOAT"]; // NOTE only support float partitions
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute, {"src/device/common"},
-            defines);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(config.workgroupSize);
-        specInfoBuilder.add_entry(config.rows);
-        specInfoBuilder.add_entry(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        specInfoBuilder.add_entry(config.sequentialScanLength);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addIncludePath("src/device/common")
+                         .setDefines(defines)
+                         .addStorageBuffer() // elements
+                         .addStorageBuffer() // pivot (condition)
+                         .addStorageBuffer() // indices
+                         .addStorageBuffer() // block counts
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(config.rows)
+                         .addSpecializationConstant(subgroupSize)
+                         .addSpecializationConstant(config.sequentialScanLength)
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd, const Buffers& buffers, host::glsl::uint N) {
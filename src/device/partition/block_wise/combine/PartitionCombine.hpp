@@ -7,6 +7,7 @@
 #include "merian/vk/pipeline/specialization_info.hpp"
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/types/glsl.hpp"
@@ -82,40 +83,29 @@ class PartitionCombine {
                               PartitionCombineConfig config)
         : m_tileSize(config.tileSize()) {
 
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // elements
-                .add_binding_storage_buffer() // pivot (condition)
-                .add_binding_storage_buffer() // indices
-                .add_binding_storage_buffer() // blockIndices
-                .add_binding_storage_buffer() // partitionIndices
-                .add_binding_storage_buffer() // partition
-                .build_push_descriptor_layout(context);
-
         const std::string shaderPath = "src/device/partition/block_wise/combine/shader.comp";
 
         std::map<std::string, std::string> defines;
         defines["USE_FLOAT"]; // currently only supports partition of floating values
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute, {}, defines);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(config.workgroupSize);
-        specInfoBuilder.add_entry(config.rows);
-        specInfoBuilder.add_entry(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        specInfoBuilder.add_entry(config.sequentialCombineLength);
-        specInfoBuilder.add_entry(config.blocksPerWorkgroup);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .setDefines(defines)
+                         .addStorageBuffer() // elements
+                         .addStorageBuffer() // pivot (condition)
+                         .addStorageBuffer() // indices
+                         .addStorageBuffer() // blockIndices
+                         .addStorageBuffer() // partitionIndices
+                         .addStorageBuffer() // partition
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(config.rows)
+                         .addSpecializationConstant(subgroupSize)
+                         .addSpecializationConstant(config.sequentialCombineLength)
+                         .addSpecializationConstant(config.blocksPerWorkgroup)
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd, const Buffers& buffers, host::glsl::uint N) {
@@ -0,0 +1,57 @@
+#include "./ComputePipelineBuilder.hpp"
+#include "merian/vk/descriptors/descriptor_set_layout_builder.hpp"
+#include "src/device/pipeline/PipelineCache.hpp"
+#include "src/device/shader/load.hpp"
+
+device::pipeline::ComputePipelineBuilder::ComputePipelineBuilder(
+    const merian::ContextHandle& context,
+    const merian::ShaderCompilerHandle& shaderCompiler,
+    const std::string& shaderPath)
+    : m_context(context), m_shaderCompiler(shaderCompiler) {
+    m_key.shaderPath = shaderPath;
+}
+
+device::pipeline::ComputePipelineBuilder&
+device::pipeline::ComputePipelineBuilder::addIncludePath(const std::string& includePath) {
+    m_key.includePaths.push_back(includePath);
+    return *this;
+}
+
+device::pipeline::ComputePipelineBuilder& device::pipeline::ComputePipelineBuilder::setDefines(
+    const std::map<std::string, std::string>& defines) {
+    m_key.defines = defines;
+    return *this;
+}
+
+device::pipeline::ComputePipelineBuilder&
+device::pipeline::ComputePipelineBuilder::addStorageBuffer() {
+    m_key.storageBufferCount++;
+    return *this;
+}
+
+merian::PipelineHandle device::pipeline::ComputePipelineBuilder::build() {
+    return PipelineRegistry::getOrCreate(m_context, m_key, [this]() { return create(); });
+}
+
+merian::PipelineHandle device::pipeline::ComputePipelineBuilder::create() {
+    merian::DescriptorSetLayoutBuilder descriptorSetBuilder;
+    for (host::glsl::uint i = 0; i < m_key.storageBufferCount; ++i) {
+        descriptorSetBuilder.add_binding_storage_buffer();
+    }
+    const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
+        descriptorSetBuilder.build_push_descriptor_layout(m_context);
+
+    const merian::ShaderModuleHandle shader = device::shader::loadComputeShader(
+        m_context, m_shaderCompiler, m_key.shaderPath, m_key.includePaths, m_key.defines);
+
+    merian::PipelineLayoutBuilder pipelineLayoutBuilder(m_context);
+    pipelineLayoutBuilder.add_descriptor_set_layout(descriptorSet0Layout);
+    for (const auto& addPushConstant : m_pushConstants) {
+        addPushConstant(pipelineLayoutBuilder);
+    }
+    const merian::PipelineLayoutHandle pipelineLayout = pipelineLayoutBuilder.build_pipeline_layout();
+
+    const merian::SpecializationInfoHandle specInfo = m_specInfoBuilder.build();
+
+    return createComputePipeline(m_context, pipelineLayout, shader, specInfo);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "merian/vk/context.hpp"
+#include "merian/vk/pipeline/pipeline.hpp"
+#include "merian/vk/pipeline/pipeline_layout_builder.hpp"
+#include "merian/vk/pipeline/specialization_info_builder.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/PipelineRegistry.hpp"
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace device::pipeline {
+
+/**
+ * Describes a compute pipeline with a single push descriptor set of storage buffers,
+ * which is the layout used by all kernels.
+ *
+ * build() only loads the shader and creates the pipeline if no equivalent
+ * pipeline is alive, otherwise the shared handle of the PipelineRegistry is returned.
+ *
+ * Example:
+ * m_pipeline = ComputePipelineBuilder(context, shaderCompiler, "src/device/.../shader.comp")
+ *                  .addStorageBuffer() // elements
+ *                  .addStorageBuffer() // mean
+ *                  .addPushConstant<PushConstants>()
+ *                  .addSpecializationConstant(config.workgroupSize)
+ *                  .build();
+ */
+class ComputePipelineBuilder {
+  public:
+    ComputePipelineBuilder(const merian::ContextHandle& context,
+                           const merian::ShaderCompilerHandle& shaderCompiler,
+                           const std::string& shaderPath);
+
+    ComputePipelineBuilder& addIncludePath(const std::string& includePath);
+
+    ComputePipelineBuilder& setDefines(const std::map<std::string, std::string>& defines);
+
+    ComputePipelineBuilder& addStorageBuffer();
+
+    template <typename T> ComputePipelineBuilder& addPushConstant() {
+        m_key.pushConstantSizes.push_back(sizeof(T));
+        m_pushConstants.push_back(
+            [](merian::PipelineLayoutBuilder& builder) { builder.add_push_constant<T>(); });
+        return *this;
+    }
+
+    template <typename T> ComputePipelineBuilder& addSpecializationConstant(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const std::size_t offset = m_key.specializationConstants.size();
+        m_key.specializationConstants.resize(offset + sizeof(T));
+        std::memcpy(m_key.specializationConstants.data() + offset, &value, sizeof(T));
+        m_specInfoBuilder.add_entry(value);
+        return *this;
+    }
+
+    merian::PipelineHandle build();
+
+  private:
+    merian::PipelineHandle create();
+
+    const merian::ContextHandle m_context;
+    const merian::ShaderCompilerHandle m_shaderCompiler;
+    ComputePipelineKey m_key;
+    std::vector<std::function<void(merian::PipelineLayoutBuilder&)>> m_pushConstants;
+    merian::SpecializationInfoBuilder m_specInfoBuilder;
+};
+
+} // namespace device::pipeline
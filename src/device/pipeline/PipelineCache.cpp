@@ -0,0 +1,169 @@
+#include "./PipelineCache.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+
+namespace device::pipeline::details {
+
+/// Layout of the version one header, which every implementation
+/// writes at the start of the cache data (see VkPipelineCacheHeaderVersionOne).
+struct PipelineCacheHeader {
+    std::uint32_t headerSize;
+    std::uint32_t headerVersion;
+    std::uint32_t vendorID;
+    std::uint32_t deviceID;
+    std::uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+static bool isCompatible(const merian::ContextHandle& context,
+                         const std::vector<std::uint8_t>& data) {
+    if (data.size() < sizeof(PipelineCacheHeader)) {
+        return false;
+    }
+    PipelineCacheHeader header;
+    std::memcpy(&header, data.data(), sizeof(PipelineCacheHeader));
+    const vk::PhysicalDeviceProperties properties =
+        context->physical_device.physical_device.getProperties();
+    return header.headerSize >= sizeof(PipelineCacheHeader) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+           std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+static std::vector<std::uint8_t> readCacheFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return {};
+    }
+    return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file),
+                                     std::istreambuf_iterator<char>());
+}
+
+class CachedComputePipeline : public merian::Pipeline {
+  public:
+    CachedComputePipeline(const merian::ContextHandle& context,
+                          const merian::PipelineLayoutHandle& pipelineLayout,
+                          const merian::ShaderModuleHandle& shader,
+                          const merian::SpecializationInfoHandle& specInfo,
+                          const PipelineCacheHandle& cache)
+        : merian::Pipeline(context, pipelineLayout), m_cache(cache) {
+        const vk::ComputePipelineCreateInfo info{
+            {}, shader->get_shader_stage_create_info(specInfo), *pipelineLayout};
+        pipeline = context->device.createComputePipeline(m_cache->get(), info).value;
+    }
+
+    ~CachedComputePipeline() {
+        context->device.destroyPipeline(pipeline);
+    }
+
+    vk::PipelineBindPoint get_pipeline_bind_point() const override {
+        return vk::PipelineBindPoint::eCompute;
+    }
+
+  private:
+    // the cache has to outlive all pipelines which were created from it.
+    const PipelineCacheHandle m_cache;
+};
+
+} // namespace device::pipeline::details
+
+device::pipeline::PipelineCache::PipelineCache(const merian::ContextHandle& context,
+                                                std::optional<std::filesystem::path> path)
+    : m_context(context), m_path(std::move(path)) {
+    std::vector<std::uint8_t> data;
+    if (m_path.has_value()) {
+        data = details::readCacheFile(*m_path);
+        if (!data.empty() && !details::isCompatible(context, data)) {
+            SPDLOG_INFO("Ignoring incompatible pipeline cache {}", m_path->string());
+            data.clear();
+        }
+    }
+    vk::PipelineCacheCreateInfo createInfo{};
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.data();
+    m_cache = m_context->device.createPipelineCache(createInfo);
+    SPDLOG_DEBUG("Created pipeline cache with {} bytes of initial data", data.size());
+}
+
+device::pipeline::PipelineCache::~PipelineCache() {
+    try {
+        save();
+    } catch (const std::exception& e) {
+        SPDLOG_WARN("Failed to save pipeline cache: {}", e.what());
+    }
+    m_context->device.destroyPipelineCache(m_cache);
+}
+
+std::shared_ptr<device::pipeline::PipelineCache>
+device::pipeline::PipelineCache::acquire(const merian::ContextHandle& context) {
+    static std::mutex mutex;
+    static std::map<const merian::Context*, std::weak_ptr<PipelineCache>> caches;
+
+    std::scoped_lock lock{mutex};
+    std::weak_ptr<PipelineCache>& weak = caches[context.get()];
+    std::shared_ptr<PipelineCache> cache = weak.lock();
+    if (cache == nullptr) {
+        cache = std::make_shared<PipelineCache>(context, defaultPath());
+        weak = cache;
+    }
+    return cache;
+}
+
+std::optional<std::filesystem::path> device::pipeline::PipelineCache::defaultPath() {
+    if (const char* path = std::getenv("WRS_PIPELINE_CACHE"); path != nullptr) {
+        if (*path == '\0') {
+            return std::nullopt;
+        }
+        return std::filesystem::path(path);
+    }
+    std::filesystem::path cacheDir;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg != nullptr && *xdg != '\0') {
+        cacheDir = xdg;
+    } else if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0') {
+        cacheDir = std::filesystem::path(home) / ".cache";
+    } else {
+        cacheDir = std::filesystem::temp_directory_path();
+    }
+    return cacheDir / "merian-wrs" / "pipeline_cache.bin";
+}
+
+void device::pipeline::PipelineCache::save() const {
+    if (!m_path.has_value()) {
+        return;
+    }
+    std::scoped_lock lock{m_saveMutex};
+    const std::vector<std::uint8_t> data = m_context->device.getPipelineCacheData(m_cache);
+
+    if (m_path->has_parent_path()) {
+        std::filesystem::create_directories(m_path->parent_path());
+    }
+    // write to a temporary file first, concurrent processes must never observe partial caches.
+    const std::filesystem::path tmp = m_path->string() + fmt::format(".{}.tmp", ::getpid());
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error(fmt::format("Failed to open {}", tmp.string()));
+        }
+        file.write(reinterpret_cast<const char*>(data.data()),
+                   static_cast<std::streamsize>(data.size()));
+    }
+    std::filesystem::rename(tmp, *m_path);
+    SPDLOG_DEBUG("Saved {} bytes of pipeline cache to {}", data.size(), m_path->string());
+}
+
+merian::PipelineHandle
+device::pipeline::createComputePipeline(const merian::ContextHandle& context,
+                                        const merian::PipelineLayoutHandle& pipelineLayout,
+                                        const merian::ShaderModuleHandle& shader,
+                                        const merian::SpecializationInfoHandle& specInfo) {
+    return std::make_shared<details::CachedComputePipeline>(
+        context, pipelineLayout, shader, specInfo, PipelineCache::acquire(context));
+}
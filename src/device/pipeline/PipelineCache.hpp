@@ -0,0 +1,70 @@
+#pragma once
+/**
+ * Process-wide VkPipelineCache which is persisted to disk between runs.
+ *
+ * All kernels create their compute pipelines through createComputePipeline,
+ * which compiles against the cache of the given context. The cache is loaded on first use
+ * and written back when the last handle is released (or when save() is called explicitly).
+ * Keep a handle alive for the lifetime of the application (see main.cpp),
+ * otherwise every WRS construction reloads the cache from disk.
+ *
+ * The location defaults to $XDG_CACHE_HOME/merian-wrs/pipeline_cache.bin and can be
+ * overwritten with the environment variable WRS_PIPELINE_CACHE. Setting it to an empty
+ * string disables persistence.
+ */
+
+#include "merian/vk/context.hpp"
+#include "merian/vk/pipeline/pipeline.hpp"
+#include "merian/vk/pipeline/pipeline_layout.hpp"
+#include "merian/vk/pipeline/specialization_info.hpp"
+#include "merian/vk/shader/shader_module.hpp"
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace device::pipeline {
+
+class PipelineCache {
+  public:
+    PipelineCache(const merian::ContextHandle& context, std::optional<std::filesystem::path> path);
+
+    ~PipelineCache();
+
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+    PipelineCache(PipelineCache&&) = delete;
+    PipelineCache& operator=(PipelineCache&&) = delete;
+
+    /// Returns the cache of the context, creates (and loads) it if no handle is alive.
+    static std::shared_ptr<PipelineCache> acquire(const merian::ContextHandle& context);
+
+    static std::optional<std::filesystem::path> defaultPath();
+
+    void save() const;
+
+    const vk::PipelineCache& get() const {
+        return m_cache;
+    }
+
+    const std::optional<std::filesystem::path>& path() const {
+        return m_path;
+    }
+
+  private:
+    const merian::ContextHandle m_context;
+    const std::optional<std::filesystem::path> m_path;
+    vk::PipelineCache m_cache;
+    mutable std::mutex m_saveMutex;
+};
+
+using PipelineCacheHandle = std::shared_ptr<PipelineCache>;
+
+/// Drop-in replacement for std::make_shared<merian::ComputePipeline>
+/// which uses the process-wide pipeline cache.
+merian::PipelineHandle createComputePipeline(const merian::ContextHandle& context,
+                                             const merian::PipelineLayoutHandle& pipelineLayout,
+                                             const merian::ShaderModuleHandle& shader,
+                                             const merian::SpecializationInfoHandle& specInfo);
+
+} // namespace device::pipeline
@@ -0,0 +1,113 @@
+#include "./PipelineRegistry.hpp"
+#include <future>
+#include <memory>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <utility>
+#include <vector>
+
+namespace device::pipeline::details {
+
+struct RegistryEntry {
+    std::weak_ptr<merian::Pipeline> pipeline;
+    // only set while a RetainScope is alive.
+    merian::PipelineHandle retained;
+    // valid while the pipeline is being created.
+    std::shared_future<merian::PipelineHandle> pending;
+};
+
+using RegistryKey = std::pair<const merian::Context*, ComputePipelineKey>;
+
+static std::mutex registryMutex;
+static std::map<RegistryKey, RegistryEntry> registry;
+static std::size_t retainScopeCount = 0;
+
+} // namespace device::pipeline::details
+
+merian::PipelineHandle device::pipeline::PipelineRegistry::getOrCreate(
+    const merian::ContextHandle& context,
+    const ComputePipelineKey& key,
+    const std::function<merian::PipelineHandle()>& create) {
+    using namespace details;
+    std::promise<merian::PipelineHandle> promise;
+    {
+        std::unique_lock lock{registryMutex};
+        RegistryEntry& entry = registry[RegistryKey{context.get(), key}];
+        if (merian::PipelineHandle pipeline = entry.pipeline.lock(); pipeline != nullptr) {
+            if (retainScopeCount != 0) {
+                entry.retained = pipeline;
+            }
+            return pipeline;
+        }
+        if (entry.pending.valid()) {
+            const std::shared_future<merian::PipelineHandle> pending = entry.pending;
+            lock.unlock();
+            return pending.get();
+        }
+        entry.pending = promise.get_future().share();
+    }
+
+    merian::PipelineHandle pipeline;
+    try {
+        pipeline = create();
+    } catch (...) {
+        {
+            std::scoped_lock lock{registryMutex};
+            registry.erase(RegistryKey{context.get(), key});
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    {
+        std::scoped_lock lock{registryMutex};
+        RegistryEntry& entry = registry[RegistryKey{context.get(), key}];
+        entry.pipeline = pipeline;
+        entry.pending = {};
+        if (retainScopeCount != 0) {
+            entry.retained = pipeline;
+        }
+        // drop entries of destroyed pipelines, keeps lookups cheap for long running processes.
+        std::erase_if(registry, [](const auto& e) {
+            return e.second.pipeline.expired() && !e.second.pending.valid();
+        });
+    }
+    promise.set_value(pipeline);
+    SPDLOG_DEBUG("Registered compute pipeline for {}", key.shaderPath);
+    return pipeline;
+}
+
+std::size_t device::pipeline::PipelineRegistry::size() {
+    using namespace details;
+    std::scoped_lock lock{registryMutex};
+    std::size_t alive = 0;
+    for (const auto& [key, entry] : registry) {
+        if (!entry.pipeline.expired()) {
+            alive++;
+        }
+    }
+    return alive;
+}
+
+device::pipeline::PipelineRegistry::RetainScope::RetainScope() {
+    using namespace details;
+    std::scoped_lock lock{registryMutex};
+    retainScopeCount++;
+}
+
+device::pipeline::PipelineRegistry::RetainScope::~RetainScope() {
+    using namespace details;
+    std::vector<merian::PipelineHandle> released;
+    {
+        std::scoped_lock lock{registryMutex};
+        if (--retainScopeCount != 0) {
+            return;
+        }
+        for (auto& [key, entry] : registry) {
+            if (entry.retained != nullptr) {
+                released.push_back(std::move(entry.retained));
+            }
+        }
+    }
+    // the pipelines are destroyed outside of the lock.
+}
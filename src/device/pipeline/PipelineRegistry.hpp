@@ -0,0 +1,71 @@
+#pragma once
+
+#include "merian/vk/context.hpp"
+#include "merian/vk/pipeline/pipeline.hpp"
+#include "src/host/types/glsl.hpp"
+#include <compare>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace device::pipeline {
+
+/// Everything which determines a compute pipeline
+/// independent of the kernel instance which requested it.
+struct ComputePipelineKey {
+    std::string shaderPath;
+    std::vector<std::string> includePaths;
+    std::map<std::string, std::string> defines;
+    // pipeline layout: one push descriptor set of storage buffers + push constant ranges.
+    host::glsl::uint storageBufferCount = 0;
+    std::vector<std::size_t> pushConstantSizes;
+    // raw bytes of all specialization constants in order of their constant_id.
+    std::vector<std::byte> specializationConstants;
+
+    auto operator<=>(const ComputePipelineKey&) const = default;
+};
+
+/**
+ * Deduplicates compute pipelines across kernel instances.
+ *
+ * Pipelines are shared as long as at least one kernel holds a handle,
+ * for example creating a second WRS with the same config (or ITS and Cutpoint
+ * sharing a PrefixSum config) does not create any new pipelines.
+ *
+ * By default the registry only holds weak references. Once all handles are released
+ * the pipeline is destroyed, such that the registry never keeps pipelines of a destroyed
+ * context alive and long running processes do not accumulate unused pipelines.
+ * Recreating it afterwards still loads the shader and creates the pipeline, only the
+ * compilation is cheap because of the pipeline cache (see PipelineCache.hpp).
+ * Code which destroys each kernel before creating the next one (e.g. benchmarks iterating
+ * over configurations) keeps the pipelines alive with a RetainScope.
+ */
+class PipelineRegistry {
+  public:
+    /// Returns the pipeline registered under the key or creates and registers it.
+    /// Concurrent requests for the same key wait for the first one instead of creating duplicates.
+    static merian::PipelineHandle getOrCreate(const merian::ContextHandle& context,
+                                              const ComputePipelineKey& key,
+                                              const std::function<merian::PipelineHandle()>& create);
+
+    /// Number of pipelines which are currently alive.
+    static std::size_t size();
+
+    /**
+     * While at least one scope is alive, the registry holds strong references to all
+     * pipelines it creates or returns. Destroying the last scope releases them again.
+     * Scopes have to be destroyed before the context.
+     */
+    class RetainScope {
+      public:
+        RetainScope();
+        ~RetainScope();
+
+        RetainScope(const RetainScope&) = delete;
+        RetainScope& operator=(const RetainScope&) = delete;
+    };
+};
+
+} // namespace device::pipeline
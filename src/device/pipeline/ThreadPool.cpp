@@ -0,0 +1,55 @@
+#include "./ThreadPool.hpp"
+#include <algorithm>
+
+device::pipeline::ThreadPool::ThreadPool(std::size_t threadCount) {
+    m_threads.reserve(threadCount);
+    for (std::size_t i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back([this]() { work(); });
+    }
+}
+
+device::pipeline::ThreadPool::~ThreadPool() {
+    {
+        std::scoped_lock lock{m_mutex};
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+device::pipeline::ThreadPool& device::pipeline::ThreadPool::global() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+bool device::pipeline::ThreadPool::runPendingTask() {
+    std::function<void()> task;
+    {
+        std::scoped_lock lock{m_mutex};
+        if (m_tasks.empty()) {
+            return false;
+        }
+        task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+    }
+    task();
+    return true;
+}
+
+void device::pipeline::ThreadPool::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock{m_mutex};
+            m_cv.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_stop && m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
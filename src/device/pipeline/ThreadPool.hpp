@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace device::pipeline {
+
+/**
+ * Small fixed size thread pool, which is used to create
+ * the pipelines of independent sub-kernels concurrently.
+ *
+ * Waiting on a future with wait() executes pending tasks on the calling thread,
+ * therefore tasks may submit (and wait on) further tasks without deadlocking the pool.
+ */
+class ThreadPool {
+  public:
+    explicit ThreadPool(std::size_t threadCount);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static ThreadPool& global();
+
+    template <typename F> std::future<std::invoke_result_t<F>> submit(F&& f) {
+        using R = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> future = task->get_future();
+        {
+            std::scoped_lock lock{m_mutex};
+            m_tasks.emplace_back([task]() { (*task)(); });
+        }
+        m_cv.notify_one();
+        return future;
+    }
+
+    template <typename T> void waitReady(const std::future<T>& future) {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!runPendingTask()) {
+                future.wait_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    template <typename T> T wait(std::future<T>& future) {
+        waitReady(future);
+        return future.get();
+    }
+
+  private:
+    bool runPendingTask();
+
+    void work();
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::function<void()>> m_tasks;
+    std::vector<std::thread> m_threads;
+    bool m_stop = false;
+};
+
+/**
+ * Invokes all factories concurrently on the global thread pool and
+ * returns their results in order.
+ * Used by composite algorithms to construct the pipelines of their sub-kernels in parallel.
+ *
+ * Example:
+ * auto [mean, sampling] = parallel([&] { return Mean(...); }, [&] { return Sampling(...); });
+ */
+template <typename... F> std::tuple<std::invoke_result_t<F>...> parallel(F&&... factories) {
+    ThreadPool& pool = ThreadPool::global();
+    std::tuple<std::future<std::invoke_result_t<F>>...> futures{
+        pool.submit(std::forward<F>(factories))...};
+    // factories usually capture by reference, therefore all of them have to
+    // finish before we are allowed to propagate any exception.
+    std::apply([&](auto&... future) { (pool.waitReady(future), ...); }, futures);
+    return std::apply(
+        [&](auto&... future) {
+            return std::tuple<std::invoke_result_t<F>...>{future.get()...};
+        },
+        futures);
+}
+
+} // namespace device::pipeline
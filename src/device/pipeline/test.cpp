@@ -0,0 +1,163 @@
+#include "./test.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/device/pipeline/PipelineRegistry.hpp"
+#include "src/device/prefix_sum/block_scan/BlockScanVariant.hpp"
+#include "src/device/wrs/WRS.hpp"
+#include "src/host/assert/test.hpp"
+#include <atomic>
+#include <chrono>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <optional>
+#include <spdlog/spdlog.h>
+#include <thread>
+#include <vector>
+
+namespace device::test::pipeline_registry {
+
+using Registry = pipeline::PipelineRegistry;
+
+static const WRS::Config CONFIG =
+    CutpointConfig(DecoupledPrefixSumConfig(512, 8, BlockScanVariant::RANKED_STRIDED), 32);
+
+static constexpr std::size_t THREAD_COUNT = 8;
+
+/// A second WRS with the same config does not create any new pipelines.
+static bool testDeduplication(const host::test::TestContext& context) {
+    bool failed = false;
+    const std::size_t before = Registry::size();
+    {
+        WRS first{context.context, context.shaderCompiler, CONFIG};
+        const std::size_t afterFirst = Registry::size();
+        WRS second{context.context, context.shaderCompiler, CONFIG};
+        if (Registry::size() != afterFirst) {
+            SPDLOG_ERROR("Second WRS created {} new pipelines", Registry::size() - afterFirst);
+            failed = true;
+        }
+    }
+    if (Registry::size() != before) {
+        SPDLOG_ERROR("{} pipelines outlived their kernels", Registry::size() - before);
+        failed = true;
+    }
+    return failed;
+}
+
+/// Pipelines survive the destruction of their kernel while a RetainScope is alive.
+static bool testRetainScope(const host::test::TestContext& context) {
+    bool failed = false;
+    const std::size_t before = Registry::size();
+    {
+        Registry::RetainScope retain;
+        std::size_t retained;
+        {
+            WRS wrs{context.context, context.shaderCompiler, CONFIG};
+            retained = Registry::size();
+        }
+        if (Registry::size() != retained) {
+            SPDLOG_ERROR("RetainScope did not keep the pipelines alive");
+            failed = true;
+        }
+        WRS wrs{context.context, context.shaderCompiler, CONFIG};
+        if (Registry::size() != retained) {
+            SPDLOG_ERROR("Retained pipelines were not reused");
+            failed = true;
+        }
+    }
+    if (Registry::size() != before) {
+        SPDLOG_ERROR("{} pipelines outlived the RetainScope", Registry::size() - before);
+        failed = true;
+    }
+    return failed;
+}
+
+/// Concurrent requests for the same key create the pipeline exactly once.
+static bool testConcurrentGetOrCreate(const host::test::TestContext& context) {
+    bool failed = false;
+    pipeline::ComputePipelineKey key;
+    key.shaderPath = "test/pipeline_registry/concurrent";
+
+    std::atomic<std::size_t> creations = 0;
+    const auto create = [&]() {
+        creations++;
+        // widens the window in which the other threads request the same key.
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return pipeline::ComputePipelineBuilder(context.context, context.shaderCompiler,
+                                                "src/device/mean/atomic/shader.comp")
+            .addStorageBuffer() // elements
+            .addStorageBuffer() // mean
+            .addPushConstant<host::glsl::uint>()
+            .addSpecializationConstant(host::glsl::uint{512})
+            .addSpecializationConstant(host::glsl::uint{4})
+            .addSpecializationConstant(host::glsl::uint{32})
+            .build();
+    };
+
+    std::vector<merian::PipelineHandle> pipelines(THREAD_COUNT);
+    {
+        std::vector<std::jthread> threads;
+        for (std::size_t t = 0; t < THREAD_COUNT; ++t) {
+            threads.emplace_back([&, t]() {
+                pipelines[t] = Registry::getOrCreate(context.context, key, create);
+            });
+        }
+    }
+    if (creations != 1) {
+        SPDLOG_ERROR("Concurrent getOrCreate created the pipeline {} times", creations.load());
+        failed = true;
+    }
+    for (const merian::PipelineHandle& pipeline : pipelines) {
+        if (pipeline == nullptr || pipeline != pipelines.front()) {
+            SPDLOG_ERROR("Concurrent getOrCreate returned different pipelines");
+            failed = true;
+            break;
+        }
+    }
+
+    // concurrent construction of kernels with the same config shares all pipelines.
+    const std::size_t before = Registry::size();
+    std::size_t single;
+    {
+        WRS wrs{context.context, context.shaderCompiler, CONFIG};
+        single = Registry::size();
+    }
+    {
+        std::vector<std::optional<WRS>> kernels(THREAD_COUNT);
+        {
+            std::vector<std::jthread> threads;
+            for (std::size_t t = 0; t < THREAD_COUNT; ++t) {
+                threads.emplace_back([&, t]() {
+                    kernels[t].emplace(context.context, context.shaderCompiler, CONFIG);
+                });
+            }
+        }
+        if (Registry::size() != single) {
+            SPDLOG_ERROR("Concurrent WRS construction created {} pipelines, expected {}",
+                         Registry::size() - before, single - before);
+            failed = true;
+        }
+    }
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing pipeline registry");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    uint32_t failCount = 0;
+    uint32_t testCount = 0;
+    for (const auto& testCase : {testDeduplication, testRetainScope, testConcurrentGetOrCreate}) {
+        testCount++;
+        if (testCase(testContext)) {
+            failCount++;
+        }
+    }
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount, testCount));
+    }
+}
+
+} // namespace device::test::pipeline_registry
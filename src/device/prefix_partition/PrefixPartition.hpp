@@ -4,6 +4,7 @@
 #include "src/device/prefix_partition/block_wise/BlockWisePrefixPartition.hpp"
 #include "src/device/prefix_partition/decoupled/DecoupledPrefixPartition.hpp"
 #include "src/device/prefix_sum/block_scan/BlockScanVariant.hpp"
+#include "src/host/types/kernel_cost.hpp"
 #include <cassert>
 #include <concepts>
 #include <glm/gtc/constants.hpp>
@@ -23,8 +24,12 @@ static std::string prefixPartitionConfigName(const PrefixPartitionConfig& config
     if (std::holds_alternative<DecoupledPrefixPartitionConfig>(config)) {
         const auto& methodConfig = std::get<DecoupledPrefixPartitionConfig>(config);
         std::string blockScanName = blockScanVariantName(methodConfig.blockScanVariant);
-        return fmt::format("SingleDispatch-{}-{}-{}", blockScanName, methodConfig.workgroupSize,
-                           methodConfig.rows);
+        std::string name = fmt::format("SingleDispatch-{}-{}-{}", blockScanName,
+                                       methodConfig.workgroupSize, methodConfig.rows);
+        if (methodConfig.maxPartitionsPerDispatch != 0) {
+            name += fmt::format("-Chained-{}", methodConfig.maxPartitionsPerDispatch);
+        }
+        return name;
     } else if (std::holds_alternative<BlockWisePrefixPartitionConfig>(config)) {
         const auto& methodConfig = std::get<BlockWisePrefixPartitionConfig>(config);
         std::string blockScanName = blockScanVariantName(methodConfig.scanConfig.variant);
@@ -162,7 +167,8 @@ template <prefix_partition_compatible T> class PrefixPartition {
                     const merian::ShaderCompilerHandle& shaderCompiler,
                     const PrefixPartitionConfig config,
                     bool writePartitionElements)
-        : m_method(createMethod(context, shaderCompiler, config, writePartitionElements)) {}
+        : m_method(createMethod(context, shaderCompiler, config, writePartitionElements)),
+          m_writePartitionElements(writePartitionElements) {}
 
     void run(const merian::CommandBufferHandle& cmd,
              const Buffers& buffers,
@@ -207,8 +213,7 @@ template <prefix_partition_compatible T> class PrefixPartition {
 
     std::size_t maxElementCount() const {
         if (std::holds_alternative<DecoupledPrefixPartition<T>>(m_method)) {
-            return (1 << 28);
-
+            return std::get<DecoupledPrefixPartition<T>>(m_method).maxElementCount();
         } else if (std::holds_alternative<BlockWisePrefixPartition<T>>(m_method)) {
             return std::get<BlockWisePrefixPartition<T>>(m_method).maxElementCount();
         } else {
@@ -216,8 +221,23 @@ template <prefix_partition_compatible T> class PrefixPartition {
         }
     }
 
+    /// Reads the elements and writes the partition indices, prefix and elements.
+    host::KernelCost cost(host::glsl::uint N) const {
+        const std::size_t written = m_writePartitionElements ? 2 * sizeof(T) : sizeof(T);
+        host::KernelCost cost{
+            .bytesRead = N * sizeof(T),
+            .bytesWritten = N * (sizeof(host::glsl::uint) + written),
+            .operations = 2 * N, // compare and add
+        };
+        if (std::holds_alternative<BlockWisePrefixPartition<T>>(m_method)) {
+            cost.bytesRead += N * sizeof(T); // block reduce
+        }
+        return cost;
+    }
+
   private:
     Method m_method;
+    bool m_writePartitionElements;
 };
 
 } // namespace device
@@ -4,6 +4,7 @@
 #include "merian/vk/memory/resource_allocations.hpp"
 #include "merian/vk/memory/resource_allocator.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
 #include "src/device/prefix_partition/PrefixPartitionAllocFlags.hpp"
 #include "src/device/prefix_partition/block_wise/block_reduce/PrefixPartitionBlockReduce.hpp"
 #include "src/device/prefix_partition/block_wise/block_scan/PrefixPartitionBlockScan.hpp"
@@ -227,12 +228,7 @@ template <block_wise_prefix_partition_compatible T> class BlockWisePrefixPartiti
              const Buffers& buffers,
              host::glsl::uint N,
              std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->start("Block-Wise-Prefix-Partition");
-            profiler.value()->cmd_start(cmd, "Block-Wise-Prefix-Partition");
-        }
-#endif
+        WRS_PROFILE_SCOPE(profiler, cmd, "Block-Wise-Prefix-Partition");
 
         typename BlockWisePrefixPartitionBlockReduce<T>::Buffers reduceBuffers;
         reduceBuffers.elements = buffers.elements;
@@ -241,21 +237,11 @@ template <block_wise_prefix_partition_compatible T> class BlockWisePrefixPartiti
         reduceBuffers.blockHeavyReductions = buffers.blockHeavyReductions;
         reduceBuffers.blockLightReductions = buffers.blockLightReductions;
 
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->start("Reduce");
-            profiler.value()->cmd_start(cmd, "Reduce");
-        }
-#endif
-
-        m_reduce.run(cmd, reduceBuffers, N);
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "Reduce");
 
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
+            m_reduce.run(cmd, reduceBuffers, N);
         }
-#endif
 
         cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
                      vk::PipelineStageFlagBits::eComputeShader,
@@ -266,40 +252,30 @@ template <block_wise_prefix_partition_compatible T> class BlockWisePrefixPartiti
                       buffers.blockLightReductions->buffer_barrier(
                           vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead)});
 
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->start("BlockScan");
-            profiler.value()->cmd_start(cmd, "BlockScan");
-        }
-#endif
-
-        host::glsl::uint blockCount = (N + m_reduce.blockSize() - 1) / m_reduce.blockSize();
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "BlockScan");
 
-        BlockScan<host::glsl::uint>::Buffers countBlockScanBuffers;
-        countBlockScanBuffers.elements = buffers.blockHeavyCount;
-        countBlockScanBuffers.prefixSum = buffers.blockHeavyCount;
-        countBlockScanBuffers.reductions = buffers.heavyCount;
+            host::glsl::uint blockCount = (N + m_reduce.blockSize() - 1) / m_reduce.blockSize();
 
-        m_countBlockScan.run(cmd, countBlockScanBuffers, blockCount);
+            BlockScan<host::glsl::uint>::Buffers countBlockScanBuffers;
+            countBlockScanBuffers.elements = buffers.blockHeavyCount;
+            countBlockScanBuffers.prefixSum = buffers.blockHeavyCount;
+            countBlockScanBuffers.reductions = buffers.heavyCount;
 
-        typename BlockScan<T>::Buffers heavyBlockScanBuffers;
-        heavyBlockScanBuffers.elements = buffers.blockHeavyReductions;
-        heavyBlockScanBuffers.prefixSum = buffers.blockHeavyReductions;
+            m_countBlockScan.run(cmd, countBlockScanBuffers, blockCount);
 
-        m_heavyBlockScan.run(cmd, heavyBlockScanBuffers, blockCount);
+            typename BlockScan<T>::Buffers heavyBlockScanBuffers;
+            heavyBlockScanBuffers.elements = buffers.blockHeavyReductions;
+            heavyBlockScanBuffers.prefixSum = buffers.blockHeavyReductions;
 
-        typename BlockScan<T>::Buffers lightBlockScanBuffers;
-        lightBlockScanBuffers.elements = buffers.blockLightReductions;
-        lightBlockScanBuffers.prefixSum = buffers.blockLightReductions;
+            m_heavyBlockScan.run(cmd, heavyBlockScanBuffers, blockCount);
 
-        m_lightBlockScan.run(cmd, lightBlockScanBuffers, blockCount);
+            typename BlockScan<T>::Buffers lightBlockScanBuffers;
+            lightBlockScanBuffers.elements = buffers.blockLightReductions;
+            lightBlockScanBuffers.prefixSum = buffers.blockLightReductions;
 
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
+            m_lightBlockScan.run(cmd, lightBlockScanBuffers, blockCount);
         }
-#endif
 
         cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
                      vk::PipelineStageFlagBits::eComputeShader,
@@ -320,26 +296,10 @@ template <block_wise_prefix_partition_compatible T> class BlockWisePrefixPartiti
         scanBuffers.partitionElements = buffers.partitionElements;
         scanBuffers.partitionPrefix = buffers.partitionPrefix;
 
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->start("PrefixPartitionScan");
-            profiler.value()->cmd_start(cmd, "PrefixPartitionScan");
-        }
-#endif
-        m_scan.run(cmd, scanBuffers, N);
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
-        }
-#endif
-
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "PrefixPartitionScan");
+            m_scan.run(cmd, scanBuffers, N);
         }
-#endif
     }
 
     std::size_t maxElementCount() const {
@@ -10,6 +10,7 @@
 #include "merian/vk/pipeline/specialization_info.hpp"
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/device/prefix_sum/block_scan/BlockScanVariant.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
@@ -158,18 +159,6 @@ template <block_wise_prefix_partition_compatible T> class BlockWisePrefixPartiti
                                                BlockWisePrefixPartitionBlockScanConfig config)
         : m_blockSize(config.blockSize()) {
 
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // elements
-                .add_binding_storage_buffer() // pivot (condition)
-                .add_binding_storage_buffer() // block heavy count
-                .add_binding_storage_buffer() // block heavy reductions
-                .add_binding_storage_buffer() // block light reductions
-                .add_binding_storage_buffer() // partition Indices
-                .add_binding_storage_buffer() // partition Prefix
-                .add_binding_storage_buffer() // partition Elements
-                .build_push_descriptor_layout(context);
-
         const std::string shaderPath =
             "src/device/prefix_partition/block_wise/block_scan/shader.comp";
 
@@ -206,24 +195,25 @@ template <block_wise_prefix_partition_compatible T> class BlockWisePrefixPartiti
             throw std::runtime_error("Uncompatible base type");
         }
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute, {"src/device/common"},
-            defines);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(config.workgroupSize);
-        specInfoBuilder.add_entry(config.rows);
-        specInfoBuilder.add_entry(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addIncludePath("src/device/common")
+                         .setDefines(defines)
+                         .addStorageBuffer() // elements
+                         .addStorageBuffer() // pivot (condition)
+                         .addStorageBuffer() // block heavy count
+                         .addStorageBuffer() // block heavy reductions
+                         .addStorageBuffer() // block light reductions
+                         .addStorageBuffer() // partition Indices
+                         .addStorageBuffer() // partition Prefix
+                         .addStorageBuffer() // partition Elements
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(config.rows)
+                         .addSpecializationConstant(subgroupSize)
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd, const Buffers& buffers, host::glsl::uint N) const {
@@ -2,6 +2,7 @@
 
 #include "merian/vk/memory/memory_allocator.hpp"
 #include "merian/vk/memory/resource_allocations.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
 
 #include "merian/vk/descriptors/descriptor_set_layout_builder.hpp"
 #include "merian/vk/memory/resource_allocations.hpp"
@@ -11,6 +12,7 @@
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/device/prefix_partition/PrefixPartitionAllocFlags.hpp"
 #include "src/device/prefix_sum/block_scan/BlockScanVariant.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
@@ -19,6 +21,8 @@
 #include "src/host/layout/PrimitiveLayout.hpp"
 #include "src/host/layout/StructLayout.hpp"
 #include "src/host/types/glsl.hpp"
+#include <algorithm>
+#include <limits>
 #include <memory>
 #include <unistd.h>
 #include <vulkan/vulkan_core.h>
@@ -115,16 +119,20 @@ class DecoupledPrefixPartitionConfig {
     host::glsl::uint rows;
     host::glsl::uint parallelLookbackDepth;
     BlockScanVariant blockScanVariant;
+    // partitions per dispatch, 0 selects maxComputeWorkGroupCount.
+    // Smaller values chain dispatches already for small N (see DecoupledPrefixPartition::run).
+    host::glsl::uint maxPartitionsPerDispatch;
 
     constexpr DecoupledPrefixPartitionConfig()
         : workgroupSize(512), rows(8), parallelLookbackDepth(32),
-          blockScanVariant(BlockScanVariant::RANKED_STRIDED) {}
+          blockScanVariant(BlockScanVariant::RANKED_STRIDED), maxPartitionsPerDispatch(0) {}
     explicit constexpr DecoupledPrefixPartitionConfig(host::glsl::uint workgroupSize,
                                                       host::glsl::uint rows,
                                                       BlockScanVariant variant,
-                                                      host::glsl::uint parallelLookbackDepth = 32)
+                                                      host::glsl::uint parallelLookbackDepth = 32,
+                                                      host::glsl::uint maxPartitionsPerDispatch = 0)
         : workgroupSize(workgroupSize), rows(rows), parallelLookbackDepth(parallelLookbackDepth),
-          blockScanVariant(variant) {}
+          blockScanVariant(variant), maxPartitionsPerDispatch(maxPartitionsPerDispatch) {}
 
     constexpr host::glsl::uint blockSize() const {
         return workgroupSize * rows;
@@ -141,19 +149,6 @@ template <decoupled_prefix_partition_compatible T> class DecoupledPrefixPartitio
                                       DecoupledPrefixPartitionConfig config,
                                       bool writePartitionElements)
         : m_blockSize(config.blockSize()), m_writePartitionElements(writePartitionElements) {
-        auto setBuilder = merian::DescriptorSetLayoutBuilder()
-                              .add_binding_storage_buffer()  // elements
-                              .add_binding_storage_buffer()  // pivot
-                              .add_binding_storage_buffer()  // decoupled states
-                              .add_binding_storage_buffer()  // heavy count
-                              .add_binding_storage_buffer()  // partition indices
-                              .add_binding_storage_buffer(); // partition prefix
-        if (m_writePartitionElements) {
-            setBuilder.add_binding_storage_buffer(); // partition elements
-        }
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            setBuilder.build_push_descriptor_layout(context);
-
         std::string shaderPath = "src/device/prefix_partition/decoupled/shader.comp";
 
         std::map<std::string, std::string> defines;
@@ -161,37 +156,53 @@ template <decoupled_prefix_partition_compatible T> class DecoupledPrefixPartitio
             defines["WRITE_PARTITION_ELEMENTS"];
         }
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute, {}, defines);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<uint32_t>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        assert(context->physical_device.physical_device_subgroup_properties.subgroupSize >=
-               config.parallelLookbackDepth);
-        specInfoBuilder.add_entry(config.workgroupSize);
-        specInfoBuilder.add_entry(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        specInfoBuilder.add_entry(config.rows);
-        specInfoBuilder.add_entry(config.parallelLookbackDepth);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+        assert(subgroupSize >= config.parallelLookbackDepth);
+
+        const vk::PhysicalDeviceLimits limits =
+            context->physical_device.physical_device.getProperties().limits;
+        m_maxWorkgroupCount = limits.maxComputeWorkGroupCount[0];
+        if (config.maxPartitionsPerDispatch != 0) {
+            m_maxWorkgroupCount = std::min(m_maxWorkgroupCount, config.maxPartitionsPerDispatch);
+        }
+        // the last partition must not overflow 32-bit element indices.
+        m_maxElementCount = std::min<std::size_t>(
+            std::numeric_limits<host::glsl::uint>::max() / m_blockSize * m_blockSize,
+            limits.maxStorageBufferRange / sizeof(host::glsl::f32));
+
+        pipeline::ComputePipelineBuilder pipelineBuilder(context, shaderCompiler, shaderPath);
+        pipelineBuilder.setDefines(defines)
+            .addStorageBuffer()  // elements
+            .addStorageBuffer()  // pivot
+            .addStorageBuffer()  // decoupled states
+            .addStorageBuffer()  // heavy count
+            .addStorageBuffer()  // partition indices
+            .addStorageBuffer(); // partition prefix
+        if (m_writePartitionElements) {
+            pipelineBuilder.addStorageBuffer(); // partition elements
+        }
+        m_pipeline = pipelineBuilder.addPushConstant<uint32_t>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(subgroupSize)
+                         .addSpecializationConstant(config.rows)
+                         .addSpecializationConstant(config.parallelLookbackDepth)
+                         .build();
     }
+
+    /**
+     * More than maxComputeWorkGroupCount (or maxPartitionsPerDispatch) partitions are
+     * partitioned in multiple dispatches. The workgroups draw their partition from the
+     * atomic counter of the decoupled states, which is only cleared once. Therefore the
+     * partitions of a dispatch continue after the (already published) partitions of the
+     * previous dispatches and their look-back carries the prefix and heavy count over.
+     */
     void run(const merian::CommandBufferHandle& cmd,
              const DecoupledPrefixPartitionBuffers& buffers,
              uint32_t N,
              std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->start("Decoupled-Prefix-Partition");
-            profiler.value()->cmd_start(cmd, "Decoupled-Prefix-Partition");
-        }
-#endif
+        WRS_PROFILE_SCOPE(profiler, cmd, "Decoupled-Prefix-Partition");
+        assert(N <= m_maxElementCount);
 
         cmd->fill(buffers.decoupledStates, 0);
         cmd->barrier(vk::PipelineStageFlagBits::eTransfer,
@@ -212,15 +223,24 @@ template <decoupled_prefix_partition_compatible T> class DecoupledPrefixPartitio
         }
 
         cmd->push_constant(m_pipeline, N);
-        uint32_t workgroupCount = (N + m_blockSize - 1) / m_blockSize;
-        cmd->dispatch(workgroupCount, 1, 1);
-
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
+        const uint32_t workgroupCount = (N + m_blockSize - 1) / m_blockSize;
+        for (uint32_t partitionOffset = 0; partitionOffset < workgroupCount;
+             partitionOffset += m_maxWorkgroupCount) {
+            if (partitionOffset != 0) {
+                cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                             vk::PipelineStageFlagBits::eComputeShader,
+                             buffers.decoupledStates->buffer_barrier(
+                                 vk::AccessFlagBits::eShaderWrite,
+                                 vk::AccessFlagBits::eShaderRead |
+                                     vk::AccessFlagBits::eShaderWrite));
+            }
+            cmd->dispatch(std::min(workgroupCount - partitionOffset, m_maxWorkgroupCount), 1, 1);
         }
-#endif
+    }
+
+    /// Largest N, which fits into 32-bit indices and a single storage buffer binding.
+    inline std::size_t maxElementCount() const {
+        return m_maxElementCount;
     }
 
     inline host::glsl::uint blockSize() const {
@@ -231,6 +251,8 @@ template <decoupled_prefix_partition_compatible T> class DecoupledPrefixPartitio
     const uint32_t m_blockSize;
     merian::PipelineHandle m_pipeline;
     const bool m_writePartitionElements;
+    uint32_t m_maxWorkgroupCount;
+    std::size_t m_maxElementCount;
 };
 
 } // namespace device
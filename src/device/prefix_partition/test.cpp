@@ -47,6 +47,15 @@ static constexpr TestCase TEST_CASES[] = {
         .pivot = 0.5, 
         .iterations = 5, 
     }, 
+    // 512 partitions in 8 chained dispatches, the partitions of every dispatch after the
+    // first one depend on the prefix and heavy count carried over by the look-back.
+    TestCase{
+        .config = DecoupledPrefixPartitionConfig(512, 8, BlockScanVariant::RANKED_STRIDED, 32, 64),
+        .N = 1024 * 2048 + 17,
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .pivot = 0.5,
+        .iterations = 2,
+    },
 };
 
 static void uploadTestCase(const merian::CommandBufferHandle& cmd,
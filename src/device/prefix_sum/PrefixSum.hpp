@@ -3,12 +3,14 @@
 #include "merian/vk/context.hpp"
 #include "merian/vk/memory/resource_allocations.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
 #include "src/device/partition/PartitionAllocFlags.hpp"
 #include "src/device/prefix_sum/PrefixSumAllocFlags.hpp"
 #include "src/device/prefix_sum/block_wise/BlockWiseScan.hpp"
 #include "src/device/prefix_sum/decoupled/DecoupledPrefixSum.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
+#include "src/host/types/kernel_cost.hpp"
 #include <concepts>
 #include <stdexcept>
 #include <variant>
@@ -20,9 +22,13 @@ using PrefixSumConfig = std::variant<DecoupledPrefixSumConfig, BlockWiseScanConf
 static std::string prefixSumConfigName(const PrefixSumConfig& config) {
     if (std::holds_alternative<DecoupledPrefixSumConfig>(config)) {
         auto methodConfig = std::get<DecoupledPrefixSumConfig>(config);
-        return fmt::format("SingleDispatch-{}-{}-{}",
-                           blockScanVariantName(methodConfig.blockScanVariant),
-                           methodConfig.workgroupSize, methodConfig.rows);
+        std::string name = fmt::format("SingleDispatch-{}-{}-{}",
+                                       blockScanVariantName(methodConfig.blockScanVariant),
+                                       methodConfig.workgroupSize, methodConfig.rows);
+        if (methodConfig.maxPartitionsPerDispatch != 0) {
+            name += fmt::format("-Chained-{}", methodConfig.maxPartitionsPerDispatch);
+        }
+        return name;
     } else if (std::holds_alternative<BlockWiseScanConfig>(config)) {
         auto methodConfig = std::get<BlockWiseScanConfig>(config);
         return fmt::format(
@@ -149,20 +155,9 @@ template <prefix_sum_compatible_type T> class PrefixSum {
             assert(std::holds_alternative<Buffers::DecoupledInternals>(buffers.m_internalBuffers));
             methodBuffers.decoupledStates =
                 std::get<Buffers::DecoupledInternals>(buffers.m_internalBuffers).decoupledStates;
-#ifdef MERIAN_PROFILER_ENABLE
-            if (profiler.has_value()) {
-                std::string label = fmt::format("SingleDispatchPrefixSum [with N={}]", N);
-                profiler.value()->start(label);
-                profiler.value()->cmd_start(cmd, label);
-            }
-#endif
+            WRS_PROFILE_SCOPE(profiler, cmd,
+                              fmt::format("SingleDispatchPrefixSum [with N={}]", N));
             method.run(cmd, methodBuffers, N);
-#ifdef MERIAN_PROFILER_ENABLE
-            if (profiler.has_value()) {
-                profiler.value()->end();
-                profiler.value()->cmd_end(cmd);
-            }
-#endif
         } else if (std::holds_alternative<BlockWiseScan>(m_method)) {
             auto method = std::get<BlockWiseScan>(m_method);
             using MethodBuffers = BlockWiseScan::Buffers;
@@ -172,21 +167,8 @@ template <prefix_sum_compatible_type T> class PrefixSum {
             assert(std::holds_alternative<Buffers::BlockWiseInternals>(buffers.m_internalBuffers));
             methodBuffers.reductions =
                 std::get<Buffers::BlockWiseInternals>(buffers.m_internalBuffers).blockScan;
-#ifdef MERIAN_PROFILER_ENABLE
-            if (profiler.has_value()) {
-                std::string label = fmt::format("BlockWisePrefixSum [with N={}]", N);
-                profiler.value()->start(label);
-                profiler.value()->cmd_start(cmd, label);
-            }
-#endif
+            WRS_PROFILE_SCOPE(profiler, cmd, fmt::format("BlockWisePrefixSum [with N={}]", N));
             method.run(cmd, methodBuffers, N, profiler);
-
-#ifdef MERIAN_PROFILER_ENABLE
-            if (profiler.has_value()) {
-                profiler.value()->end();
-                profiler.value()->cmd_end(cmd);
-            }
-#endif
         } else {
             throw std::runtime_error("NOT-IMPLEMENTED");
         }
@@ -194,12 +176,26 @@ template <prefix_sum_compatible_type T> class PrefixSum {
 
     inline host::glsl::uint maxElementCount() const {
         if (std::holds_alternative<DecoupledPrefixSum>(m_method)) {
-            return (1 << 28);
+            return static_cast<host::glsl::uint>(
+                std::get<DecoupledPrefixSum>(m_method).maxElementCount());
         } else {
             return std::get<BlockWiseScan>(m_method).maxElementCount();
         }
     }
 
+    host::KernelCost cost(host::glsl::uint N) const {
+        const std::size_t bytes = N * sizeof(T);
+        if (std::holds_alternative<DecoupledPrefixSum>(m_method)) {
+            return host::KernelCost{.bytesRead = bytes, .bytesWritten = bytes, .operations = N};
+        } else if (std::holds_alternative<BlockWiseScan>(m_method)) {
+            // element scan and combine both pass over all elements.
+            return host::KernelCost{
+                .bytesRead = 2 * bytes, .bytesWritten = 2 * bytes, .operations = 2 * N};
+        } else {
+            throw std::runtime_error("NOT-IMPLEMENTED");
+        }
+    }
+
   private:
     Method m_method;
 };
@@ -4,6 +4,7 @@
 namespace device {
 
 enum class PrefixSumAllocFlags {
+    ALLOC_NONE = 0x0,
     ALLOC_ELEMENTS = 0x1,
     ALLOC_PREFIX_SUM = 0x2,
     ALLOC_ALL = ALLOC_ELEMENTS | ALLOC_PREFIX_SUM,
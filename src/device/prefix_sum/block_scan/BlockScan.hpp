@@ -7,10 +7,12 @@
 #include "merian/vk/pipeline/specialization_info.hpp"
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/device/prefix_sum/block_scan/BlockScanVariant.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/types/glsl.hpp"
+#include "src/host/types/kernel_cost.hpp"
 #include <fmt/base.h>
 #include <fmt/format.h>
 #include <memory>
@@ -107,13 +109,6 @@ template <typename T = float> class BlockScan {
                        BlockScanConfig config = {})
         : m_blockSize(config.blockSize()), m_writeReductions(config.writeBlockReductions) {
 
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // elements
-                .add_binding_storage_buffer() // reductions
-                .add_binding_storage_buffer() // prefix sum
-                .build_push_descriptor_layout(context);
-
         const std::string shaderPath = "src/device/prefix_sum/block_scan/shader.comp";
 
         std::map<std::string, std::string> defines;
@@ -151,28 +146,24 @@ template <typename T = float> class BlockScan {
             throw std::runtime_error("unsupported type for BlockScans");
         }
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute, {"src/device/common/"},
-            defines);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(config.workgroupSize);
-        specInfoBuilder.add_entry(config.rows);
-        specInfoBuilder.add_entry(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        specInfoBuilder.add_entry(static_cast<host::glsl::uint>(config.variant));
-        specInfoBuilder.add_entry(config.sequentialScanLength);
-        specInfoBuilder.add_entry(
-            static_cast<host::glsl::uint>(config.writeBlockReductions ? 1 : 0));
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addIncludePath("src/device/common/")
+                         .setDefines(defines)
+                         .addStorageBuffer() // elements
+                         .addStorageBuffer() // reductions
+                         .addStorageBuffer() // prefix sum
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(config.rows)
+                         .addSpecializationConstant(subgroupSize)
+                         .addSpecializationConstant(static_cast<host::glsl::uint>(config.variant))
+                         .addSpecializationConstant(config.sequentialScanLength)
+                         .addSpecializationConstant(
+                             static_cast<host::glsl::uint>(config.writeBlockReductions ? 1 : 0))
+                         .build();
     }
 
     void
@@ -195,6 +186,15 @@ template <typename T = float> class BlockScan {
         return m_blockSize;
     }
 
+    host::KernelCost cost(host::glsl::uint N) const {
+        const std::size_t blockCount = (N + m_blockSize - 1) / m_blockSize;
+        return host::KernelCost{
+            .bytesRead = N * sizeof(T),
+            .bytesWritten = (N + (m_writeReductions ? blockCount : 0)) * sizeof(T),
+            .operations = N,
+        };
+    }
+
   private:
     merian::PipelineHandle m_pipeline;
     host::glsl::uint m_blockSize;
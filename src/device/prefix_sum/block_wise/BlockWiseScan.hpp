@@ -1,6 +1,7 @@
 #pragma once
 
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
 #include "src/device/prefix_sum/PrefixSumAllocFlags.hpp"
 #include "src/device/prefix_sum/block_scan/BlockScan.hpp"
 #include "src/device/prefix_sum/block_wise/combine/BlockCombine.hpp"
@@ -141,15 +142,9 @@ class BlockWiseScan {
         elementScanBuffers.reductions = buffers.reductions;
         elementScanBuffers.prefixSum = buffers.prefixSum;
 
-        if (profiler.has_value()) {
-            profiler.value()->start("ElementScan");
-            profiler.value()->cmd_start(cmd, "ElementScan");
-        }
-        m_elementScan.run(cmd, elementScanBuffers, N);
-
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "ElementScan");
+            m_elementScan.run(cmd, elementScanBuffers, N);
         }
 
         cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
@@ -167,15 +162,9 @@ class BlockWiseScan {
         blockScanBuffers.prefixSum = buffers.reductions;
         blockScanBuffers.reductions = nullptr; // disable write to reductions!
                                                //
-        if (profiler.has_value()) {
-            profiler.value()->start("BlockScan");
-            profiler.value()->cmd_start(cmd, "BlockScan");
-        }
-        m_blockScan.run(cmd, blockScanBuffers, blockCount);
-
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "BlockScan");
+            m_blockScan.run(cmd, blockScanBuffers, blockCount);
         }
 
         cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
@@ -190,16 +179,8 @@ class BlockWiseScan {
         blockCombineBuffers.blockScan = buffers.reductions;
         blockCombineBuffers.elementScan = buffers.prefixSum;
 
-        if (profiler.has_value()) {
-            profiler.value()->start("Combine");
-            profiler.value()->cmd_start(cmd, "Combine");
-        }
+        WRS_PROFILE_SCOPE(profiler, cmd, "Combine");
         m_combine.run(cmd, blockCombineBuffers, N);
-
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
-        }
     }
 
     inline host::glsl::uint maxElementCount() const {
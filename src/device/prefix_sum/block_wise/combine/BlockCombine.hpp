@@ -2,6 +2,7 @@
 
 #include "merian/vk/memory/resource_allocations.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/device/prefix_sum/block_scan/BlockScan.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
@@ -68,12 +69,6 @@ template <typename T = float> class BlockCombine {
                           BlockCombineConfig config)
         : m_tileSize(config.tileSize()) {
 
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // reductions
-                .add_binding_storage_buffer() // prefix sum
-                .build_push_descriptor_layout(context);
-
         const std::string shaderPath =
             "src/device/prefix_sum/block_wise/combine/shader.comp";
 
@@ -87,25 +82,20 @@ template <typename T = float> class BlockCombine {
             throw std::runtime_error("unsupported block combine base type");
         }
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute, {}, defines);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(config.workgroupSize);
-        specInfoBuilder.add_entry(config.rows);
-        specInfoBuilder.add_entry(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        specInfoBuilder.add_entry(config.sequentialCombineLength);
-        specInfoBuilder.add_entry(config.blocksPerWorkgroup);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .setDefines(defines)
+                         .addStorageBuffer() // reductions
+                         .addStorageBuffer() // prefix sum
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(config.rows)
+                         .addSpecializationConstant(subgroupSize)
+                         .addSpecializationConstant(config.sequentialCombineLength)
+                         .addSpecializationConstant(config.blocksPerWorkgroup)
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd, const Buffers& buffers, host::glsl::uint N) {
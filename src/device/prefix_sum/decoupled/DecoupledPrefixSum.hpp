@@ -8,6 +8,7 @@
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
 #include "src/device/partition/PartitionAllocFlags.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/device/prefix_sum/PrefixSumAllocFlags.hpp"
 #include "src/device/prefix_sum/block_scan/BlockScanVariant.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
@@ -16,8 +17,11 @@
 #include "src/host/layout/StaticString.hpp"
 #include "src/host/layout/StructLayout.hpp"
 #include "src/host/types/glsl.hpp"
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <iterator>
+#include <limits>
 #include <memory>
 #include <stdexcept>
 #include <vulkan/vulkan_handles.hpp>
@@ -68,16 +72,21 @@ class DecoupledPrefixSumConfig {
 
     const BlockScanVariant blockScanVariant;
 
+    // partitions per dispatch, 0 selects maxComputeWorkGroupCount.
+    // Smaller values chain dispatches already for small N (see DecoupledPrefixSum::run).
+    const host::glsl::uint maxPartitionsPerDispatch;
+
     constexpr DecoupledPrefixSumConfig()
         : workgroupSize(512), rows(8), parallelLookbackDepth(32),
-          blockScanVariant(BlockScanVariant::RANKED_STRIDED) {}
+          blockScanVariant(BlockScanVariant::RANKED_STRIDED), maxPartitionsPerDispatch(0) {}
     constexpr explicit DecoupledPrefixSumConfig(
         host::glsl::uint workgroupSize,
         host::glsl::uint rows,
         BlockScanVariant blockScanVariant = BlockScanVariant::RANKED_STRIDED,
-        host::glsl::uint parallelLookbackDepth = 32)
+        host::glsl::uint parallelLookbackDepth = 32,
+        host::glsl::uint maxPartitionsPerDispatch = 0)
         : workgroupSize(workgroupSize), rows(rows), parallelLookbackDepth(parallelLookbackDepth),
-          blockScanVariant(blockScanVariant) {}
+          blockScanVariant(blockScanVariant), maxPartitionsPerDispatch(maxPartitionsPerDispatch) {}
 
     inline constexpr host::glsl::uint partitionSize() const {
         return workgroupSize * rows;
@@ -87,28 +96,41 @@ class DecoupledPrefixSumConfig {
 class DecoupledPrefixSum {
     struct PushConstants {
         host::glsl::uint N;
+        host::glsl::uint partitionOffset;
     };
 
     struct ReversePushConstants {
         host::glsl::uint N;          // amount of elements to compute prefix sum for
         host::glsl::uint bufferSize; // size of buffers
+        host::glsl::uint partitionOffset;
+    };
+
+    struct Index64PushConstants {
+        vk::DeviceAddress elements;
+        vk::DeviceAddress prefixSum;
+        std::uint64_t N;
+        host::glsl::uint partitionOffset;
     };
 
   public:
     using Buffers = DecoupledPrefixSumBuffers;
 
+    /**
+     * With index64 the elements and the prefix sum are accessed by their device address
+     * and 64-bit indices (see runIndex64), requires the shaderInt64 and bufferDeviceAddress
+     * features.
+     */
     explicit DecoupledPrefixSum(const merian::ContextHandle& context,
                                 const merian::ShaderCompilerHandle& shaderCompiler,
                                 DecoupledPrefixSumConfig config = {},
-                                bool reverseMemoryOrder = false)
-        : m_partitionSize(config.partitionSize()), m_reverseMemoryOrder(reverseMemoryOrder) {
-
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer()
-                .add_binding_storage_buffer()
-                .add_binding_storage_buffer()
-                .build_push_descriptor_layout(context);
+                                bool reverseMemoryOrder = false,
+                                bool index64 = false)
+        : m_partitionSize(config.partitionSize()), m_reverseMemoryOrder(reverseMemoryOrder),
+          m_index64(index64) {
+        if (m_reverseMemoryOrder && m_index64) {
+            throw std::runtime_error(
+                "DecoupledPrefixSum: 64-bit indices are not implemented for the reverse order");
+        }
 
         std::string shaderPath;
         if (m_reverseMemoryOrder) {
@@ -145,33 +167,65 @@ class DecoupledPrefixSum {
             }
             defines["STRIDED"];
         }
+        if (m_index64) {
+            defines["INDEX_64"];
+        }
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute, {"src/device/common/"},
-            defines);
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+        assert(subgroupSize >= config.parallelLookbackDepth);
 
-        auto builder =
-            merian::PipelineLayoutBuilder(context).add_descriptor_set_layout(descriptorSet0Layout);
-        if (m_reverseMemoryOrder) {
-          builder.add_push_constant<ReversePushConstants>();
-        }else {
-          builder.add_push_constant<PushConstants>();
+        const vk::PhysicalDeviceLimits limits =
+            context->physical_device.physical_device.getProperties().limits;
+        m_maxWorkgroupCount = limits.maxComputeWorkGroupCount[0];
+        if (config.maxPartitionsPerDispatch != 0) {
+            m_maxWorkgroupCount = std::min(m_maxWorkgroupCount, config.maxPartitionsPerDispatch);
+        }
+        if (m_index64) {
+            // only the partition ids are 32-bit.
+            m_maxElementCount = static_cast<std::size_t>(m_partitionSize) *
+                                std::numeric_limits<host::glsl::uint>::max();
+        } else {
+            // the last partition must not overflow 32-bit element indices.
+            m_maxElementCount = std::min<std::size_t>(
+                std::numeric_limits<host::glsl::uint>::max() / m_partitionSize * m_partitionSize,
+                limits.maxStorageBufferRange / sizeof(host::glsl::f32));
         }
-        const merian::PipelineLayoutHandle pipelineLayout = builder.build_pipeline_layout();
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(config.workgroupSize);
-        specInfoBuilder.add_entry(config.rows);
-        specInfoBuilder.add_entry(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        assert(context->physical_device.physical_device_subgroup_properties.subgroupSize >=
-               config.parallelLookbackDepth);
-        specInfoBuilder.add_entry(config.parallelLookbackDepth);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+
+        pipeline::ComputePipelineBuilder pipelineBuilder(context, shaderCompiler, shaderPath);
+        pipelineBuilder.addIncludePath("src/device/common/").setDefines(defines);
+        if (m_index64) {
+            pipelineBuilder.addStorageBuffer() // decoupled states
+                .addPushConstant<Index64PushConstants>();
+        } else {
+            pipelineBuilder.addStorageBuffer()  // elements
+                .addStorageBuffer()  // prefix sum
+                .addStorageBuffer(); // decoupled states
+            if (m_reverseMemoryOrder) {
+                pipelineBuilder.addPushConstant<ReversePushConstants>();
+            } else {
+                pipelineBuilder.addPushConstant<PushConstants>();
+            }
+        }
+        m_pipeline = pipelineBuilder.addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(config.rows)
+                         .addSpecializationConstant(subgroupSize)
+                         .addSpecializationConstant(config.parallelLookbackDepth)
+                         .build();
     }
 
+    /**
+     * More than maxComputeWorkGroupCount (or maxPartitionsPerDispatch) partitions are
+     * scanned in multiple dispatches.
+     * The partition states are only cleared once, therefore the look-back of a dispatch
+     * continues into the (already published) partitions of the previous dispatches.
+     */
     void run(const merian::CommandBufferHandle cmd, const Buffers& buffers, host::glsl::uint N) {
+        assert(N <= m_maxElementCount);
+        if (m_index64) {
+            runIndex64(cmd, buffers, N);
+            return;
+        }
 
         cmd->fill(buffers.decoupledStates, 0);
         cmd->barrier(vk::PipelineStageFlagBits::eTransfer,
@@ -182,18 +236,84 @@ class DecoupledPrefixSum {
         cmd->bind(m_pipeline);
         cmd->push_descriptor_set(m_pipeline, buffers.elements, buffers.prefixSum,
                                  buffers.decoupledStates);
-        if (m_reverseMemoryOrder) {
-            cmd->push_constant<ReversePushConstants>(
-                m_pipeline,
-                ReversePushConstants{
-                    .N = N,
-                    .bufferSize = static_cast<host::glsl::uint>(buffers.elements->get_size() / sizeof(host::glsl::f32)),
-                });
-        } else {
-            cmd->push_constant<PushConstants>(m_pipeline, PushConstants{.N = N});
-        }
         const uint32_t workgroupCount = (N + m_partitionSize - 1) / m_partitionSize;
-        cmd->dispatch(workgroupCount, 1, 1);
+        for (uint32_t partitionOffset = 0; partitionOffset < workgroupCount;
+             partitionOffset += m_maxWorkgroupCount) {
+            if (partitionOffset != 0) {
+                cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                             vk::PipelineStageFlagBits::eComputeShader,
+                             buffers.decoupledStates->buffer_barrier(
+                                 vk::AccessFlagBits::eShaderWrite,
+                                 vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite));
+            }
+            if (m_reverseMemoryOrder) {
+                cmd->push_constant<ReversePushConstants>(
+                    m_pipeline,
+                    ReversePushConstants{
+                        .N = N,
+                        .bufferSize = static_cast<host::glsl::uint>(buffers.elements->get_size() / sizeof(host::glsl::f32)),
+                        .partitionOffset = partitionOffset,
+                    });
+            } else {
+                cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
+                                                                  .N = N,
+                                                                  .partitionOffset = partitionOffset,
+                                                              });
+            }
+            cmd->dispatch(std::min(workgroupCount - partitionOffset, m_maxWorkgroupCount), 1, 1);
+        }
+    }
+
+    /**
+     * Scan of more than 2^32 elements, only for index64 kernels.
+     * The elements and the prefix sum are accessed by their device address, therefore
+     * they have to be created with eShaderDeviceAddress and are not bound to the pipeline.
+     */
+    void runIndex64(const merian::CommandBufferHandle cmd,
+                    const Buffers& buffers,
+                    std::uint64_t N) const {
+        if (!m_index64) {
+            throw std::runtime_error("DecoupledPrefixSum: the kernel uses 32-bit indices");
+        }
+        assert(N <= m_maxElementCount);
+
+        cmd->fill(buffers.decoupledStates, 0);
+        cmd->barrier(vk::PipelineStageFlagBits::eTransfer,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     buffers.decoupledStates->buffer_barrier(vk::AccessFlagBits::eTransferWrite,
+                                                             vk::AccessFlagBits::eShaderRead));
+
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.decoupledStates);
+        const std::uint64_t workgroupCount = (N + m_partitionSize - 1) / m_partitionSize;
+        for (std::uint64_t partitionOffset = 0; partitionOffset < workgroupCount;
+             partitionOffset += m_maxWorkgroupCount) {
+            if (partitionOffset != 0) {
+                cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                             vk::PipelineStageFlagBits::eComputeShader,
+                             buffers.decoupledStates->buffer_barrier(
+                                 vk::AccessFlagBits::eShaderWrite,
+                                 vk::AccessFlagBits::eShaderRead |
+                                     vk::AccessFlagBits::eShaderWrite));
+            }
+            cmd->push_constant<Index64PushConstants>(
+                m_pipeline, Index64PushConstants{
+                                .elements = buffers.elements->get_device_address(),
+                                .prefixSum = buffers.prefixSum->get_device_address(),
+                                .N = N,
+                                .partitionOffset =
+                                    static_cast<host::glsl::uint>(partitionOffset),
+                            });
+            cmd->dispatch(static_cast<uint32_t>(std::min<std::uint64_t>(
+                              workgroupCount - partitionOffset, m_maxWorkgroupCount)),
+                          1, 1);
+        }
+    }
+
+    /// Largest N, which fits into 32-bit indices and a single storage buffer binding.
+    /// With index64 only the partition count is limited to 32-bit.
+    inline std::size_t maxElementCount() const {
+        return m_maxElementCount;
     }
 
     inline host::glsl::uint getPartitionSize() const {
@@ -204,6 +324,9 @@ class DecoupledPrefixSum {
     merian::PipelineHandle m_pipeline;
     const host::glsl::uint m_partitionSize;
     const bool m_reverseMemoryOrder;
+    const bool m_index64;
+    uint32_t m_maxWorkgroupCount;
+    std::size_t m_maxElementCount;
 };
 
 } // namespace device
@@ -0,0 +1,66 @@
+#include "./SegmentedPrefixSum.hpp"
+#include <cstddef>
+
+using Buffers = device::SegmentedPrefixSumBuffers;
+
+Buffers Buffers::allocate(const merian::ResourceAllocatorHandle& alloc,
+                          merian::MemoryMappingType memoryMapping,
+                          std::size_t N,
+                          std::size_t partitionSize,
+                          PrefixSumAllocFlags allocFlags) {
+
+    std::size_t partitionCount = (N + partitionSize - 1) / partitionSize;
+
+    Buffers buffers;
+    if (memoryMapping == merian::MemoryMappingType::NONE) {
+        if ((allocFlags & PrefixSumAllocFlags::ALLOC_ELEMENTS) != 0) {
+            buffers.elements = alloc->createBuffer(
+                Buffers::ElementsLayout::size(N),
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                merian::MemoryMappingType::NONE);
+        }
+        if ((allocFlags & PrefixSumAllocFlags::ALLOC_PREFIX_SUM) != 0) {
+            buffers.prefixSum = alloc->createBuffer(
+                Buffers::PrefixSumLayout::size(N),
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc,
+                merian::MemoryMappingType::NONE);
+        }
+        buffers.headFlags = alloc->createBuffer(
+            Buffers::HeadFlagsLayout::size(headFlagsSize(N)),
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+            merian::MemoryMappingType::NONE);
+        buffers.decoupledStates = alloc->createBuffer(
+            Buffers::DecoupledStatesLayout::size(partitionCount),
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+            merian::MemoryMappingType::NONE);
+    } else {
+        if ((allocFlags & PrefixSumAllocFlags::ALLOC_ELEMENTS) != 0) {
+            buffers.elements = alloc->createBuffer(Buffers::ElementsLayout::size(N),
+                                                   vk::BufferUsageFlagBits::eTransferSrc,
+                                                   memoryMapping);
+        }
+        if ((allocFlags & PrefixSumAllocFlags::ALLOC_PREFIX_SUM) != 0) {
+            buffers.prefixSum = alloc->createBuffer(Buffers::PrefixSumLayout::size(N),
+                                                    vk::BufferUsageFlagBits::eTransferDst,
+                                                    memoryMapping);
+        }
+        buffers.headFlags = alloc->createBuffer(Buffers::HeadFlagsLayout::size(headFlagsSize(N)),
+                                                vk::BufferUsageFlagBits::eTransferSrc,
+                                                memoryMapping);
+        buffers.decoupledStates =
+            alloc->createBuffer(Buffers::DecoupledStatesLayout::size(partitionCount),
+                                vk::BufferUsageFlagBits::eTransferSrc, memoryMapping);
+    }
+    return buffers;
+}
+
+std::vector<host::glsl::uint>
+device::segmentHeadFlags(std::span<const host::glsl::uint> segmentOffsets, std::size_t N) {
+    std::vector<host::glsl::uint> headFlags(Buffers::headFlagsSize(N), 0);
+    for (const host::glsl::uint offset : segmentOffsets) {
+        if (offset < N) {
+            headFlags[offset / 32] |= 1u << (offset % 32);
+        }
+    }
+    return headFlags;
+}
@@ -0,0 +1,160 @@
+#pragma once
+/**
+ * @filename    : SegmentedPrefixSum.hpp
+ *
+ * Segmented inclusive prefix sum, which computes many independent
+ * variable length scans in a single dispatch.
+ * Segments are described by packed head flags, bit (i % 32) of headFlags[i / 32]
+ * marks element i as the first element of a segment.
+ *
+ * Uses the same single pass decoupled look-back as DecoupledPrefixSum,
+ * the only additional memory traffic are the head flags (1 bit per element).
+ */
+
+#include "merian/vk/pipeline/pipeline.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/device/prefix_sum/PrefixSumAllocFlags.hpp"
+#include "src/device/prefix_sum/block_scan/BlockScanVariant.hpp"
+#include "src/device/prefix_sum/decoupled/DecoupledPrefixSum.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan_handles.hpp>
+
+#include "merian/vk/memory/resource_allocator.hpp"
+
+namespace device {
+
+struct SegmentedPrefixSumBuffers {
+    using Self = SegmentedPrefixSumBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle elements;
+    using ElementsLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using ElementsView = host::layout::BufferView<ElementsLayout>;
+
+    merian::BufferHandle headFlags; // (N + 31) / 32 words
+    using HeadFlagsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using HeadFlagsView = host::layout::BufferView<HeadFlagsLayout>;
+
+    merian::BufferHandle prefixSum;
+    using PrefixSumLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using PrefixSumView = host::layout::BufferView<PrefixSumLayout>;
+
+    merian::BufferHandle decoupledStates;
+    using DecoupledStatesLayout = DecoupledPrefixSumBuffers::DecoupledStatesLayout;
+    using DecoupledStatesView = DecoupledPrefixSumBuffers::DecoupledStatesView;
+
+    static inline constexpr std::size_t headFlagsSize(std::size_t N) {
+        return (N + 31) / 32;
+    }
+
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         merian::MemoryMappingType memoryMapping,
+                         std::size_t N,
+                         std::size_t partitionSize,
+                         PrefixSumAllocFlags allocFlags = PrefixSumAllocFlags::ALLOC_ALL);
+};
+
+/// Packs segment offsets (the first element of every segment) into head flags.
+std::vector<host::glsl::uint> segmentHeadFlags(std::span<const host::glsl::uint> segmentOffsets,
+                                               std::size_t N);
+
+class SegmentedPrefixSum {
+    struct PushConstants {
+        host::glsl::uint N;
+    };
+
+  public:
+    using Buffers = SegmentedPrefixSumBuffers;
+    using Config = DecoupledPrefixSumConfig;
+
+    explicit SegmentedPrefixSum(const merian::ContextHandle& context,
+                                const merian::ShaderCompilerHandle& shaderCompiler,
+                                DecoupledPrefixSumConfig config = {})
+        : m_partitionSize(config.partitionSize()) {
+
+        const std::string shaderPath = "src/device/prefix_sum/segmented/shader.comp";
+
+        std::map<std::string, std::string> defines;
+        const bool ranked =
+            (config.blockScanVariant & BlockScanVariant::RANKED) == BlockScanVariant::RANKED;
+        const bool raking =
+            (config.blockScanVariant & BlockScanVariant::RAKING) == BlockScanVariant::RAKING;
+        if (ranked == raking) {
+            throw std::runtime_error("Segmented prefix sums require either RANKED or RAKING");
+        }
+        if (ranked) {
+            defines["BLOCK_SCAN_USE_RANKED"];
+        } else {
+            defines["BLOCK_SCAN_USE_RAKING"];
+        }
+        // The segmented subgroup scan is always shuffle based (see segmented_scan.comp),
+        // therefore SUBGROUP_SCAN_SHFL does not require a define.
+        if ((config.blockScanVariant & BlockScanVariant::SUBGROUP_SCAN_INTRINSIC) ==
+            BlockScanVariant::SUBGROUP_SCAN_INTRINSIC) {
+            throw std::runtime_error("Segmented prefix sums do not support subgroup intrinsics");
+        }
+        if ((config.blockScanVariant & BlockScanVariant::EXCLUSIVE) ==
+            BlockScanVariant::EXCLUSIVE) {
+            throw std::runtime_error("Segmented prefix sums are always inclusive");
+        }
+        if ((config.blockScanVariant & BlockScanVariant::STRIDED) == BlockScanVariant::STRIDED) {
+            if (raking) {
+                throw std::runtime_error("Unsupported BlockScanVariant");
+            }
+            defines["STRIDED"];
+        }
+
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+        assert(subgroupSize >= config.parallelLookbackDepth);
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addIncludePath("src/device/common/")
+                         .setDefines(defines)
+                         .addStorageBuffer() // elements
+                         .addStorageBuffer() // headFlags
+                         .addStorageBuffer() // prefixSum
+                         .addStorageBuffer() // decoupledStates
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(config.rows)
+                         .addSpecializationConstant(subgroupSize)
+                         .addSpecializationConstant(config.parallelLookbackDepth)
+                         .build();
+    }
+
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N) const {
+
+        cmd->fill(buffers.decoupledStates, 0);
+        cmd->barrier(vk::PipelineStageFlagBits::eTransfer,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     buffers.decoupledStates->buffer_barrier(vk::AccessFlagBits::eTransferWrite,
+                                                             vk::AccessFlagBits::eShaderRead));
+
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.elements, buffers.headFlags,
+                                 buffers.prefixSum, buffers.decoupledStates);
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{.N = N});
+        const uint32_t workgroupCount = (N + m_partitionSize - 1) / m_partitionSize;
+        cmd->dispatch(workgroupCount, 1, 1);
+    }
+
+    inline host::glsl::uint getPartitionSize() const {
+        return m_partitionSize;
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+    host::glsl::uint m_partitionSize;
+};
+
+} // namespace device
@@ -0,0 +1,239 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include "src/host/memory/FallbackResource.hpp"
+#include "src/host/memory/SafeResource.hpp"
+#include "src/host/memory/StackResource.hpp"
+#include "src/host/reference/prefix_sum.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <limits>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <tuple>
+
+#include "./SegmentedPrefixSum.hpp"
+
+namespace device::test::segmented_prefix_sum {
+
+using Algorithm = SegmentedPrefixSum;
+using Buffers = Algorithm::Buffers;
+
+struct TestCase {
+    DecoupledPrefixSumConfig config;
+
+    host::glsl::uint N;
+    host::Distribution distribution;
+    host::glsl::uint averageSegmentSize;
+
+    uint32_t iterations;
+};
+
+static TestCase TEST_CASES[] = {
+    TestCase{
+        .config = DecoupledPrefixSumConfig(512, 8, BlockScanVariant::RANKED_STRIDED),
+        .N = 1024 * 2048,
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .averageSegmentSize = 100,
+        .iterations = 2,
+    },
+    TestCase{
+        .config = DecoupledPrefixSumConfig(512, 8, BlockScanVariant::RANKED),
+        .N = 1024 * 2048 + 17,
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .averageSegmentSize = 10000,
+        .iterations = 2,
+    },
+    TestCase{
+        .config = DecoupledPrefixSumConfig(256, 4, BlockScanVariant::RAKING),
+        .N = 1024 * 2048,
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .averageSegmentSize = 3,
+        .iterations = 2,
+    },
+};
+
+std::tuple<Buffers, Buffers> allocateBuffers(const host::test::TestContext& context) {
+    host::glsl::uint maxElementCount = 0;
+    host::glsl::uint minPartitionSize = std::numeric_limits<host::glsl::uint>::max();
+    for (auto testCase : TEST_CASES) {
+        maxElementCount = std::max(maxElementCount, testCase.N);
+        minPartitionSize = std::min(minPartitionSize, testCase.config.partitionSize());
+    }
+    Buffers stage = Buffers::allocate(context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+                                      maxElementCount, minPartitionSize);
+    Buffers local = Buffers::allocate(context.alloc, merian::MemoryMappingType::NONE,
+                                      maxElementCount, minPartitionSize);
+
+    return std::make_tuple(local, stage);
+}
+
+static std::pmr::vector<host::glsl::uint> generateSegmentOffsets(const TestCase& testCase,
+                                                                 std::pmr::memory_resource* resource) {
+    std::mt19937 rng{std::random_device{}()};
+    std::geometric_distribution<host::glsl::uint> dist{1.0 / testCase.averageSegmentSize};
+    std::pmr::vector<host::glsl::uint> offsets{resource};
+    host::glsl::uint offset = 0;
+    while (offset < testCase.N) {
+        offsets.push_back(offset);
+        offset += dist(rng) + 1;
+    }
+    return offsets;
+}
+
+static void uploadTestCase(const merian::CommandBufferHandle& cmd,
+                           const Buffers& buffers,
+                           const Buffers& stage,
+                           std::span<const float> elements,
+                           std::span<const host::glsl::uint> headFlags) {
+    {
+        Buffers::ElementsView stageView{stage.elements, elements.size()};
+        Buffers::ElementsView localView{buffers.elements, elements.size()};
+        stageView.upload(elements);
+        stageView.copyTo(cmd, localView);
+        localView.expectComputeRead(cmd);
+    }
+    {
+        Buffers::HeadFlagsView stageView{stage.headFlags, headFlags.size()};
+        Buffers::HeadFlagsView localView{buffers.headFlags, headFlags.size()};
+        stageView.upload(headFlags);
+        stageView.copyTo(cmd, localView);
+        localView.expectComputeRead(cmd);
+    }
+}
+
+static void downloadToStage(const merian::CommandBufferHandle& cmd,
+                            Buffers& buffers,
+                            Buffers& stage,
+                            std::size_t N) {
+    Buffers::PrefixSumView stageView{stage.prefixSum, N};
+    Buffers::PrefixSumView localView{buffers.prefixSum, N};
+    localView.expectComputeWrite();
+    localView.copyTo(cmd, stageView);
+    stageView.expectHostRead(cmd);
+}
+
+static bool runTestCase(const host::test::TestContext& context,
+                        const TestCase& testCase,
+                        Buffers& buffers,
+                        Buffers& stage,
+                        std::pmr::memory_resource* resource) {
+    std::string testName = fmt::format(
+        "{{variant={},workgroupSize={},rows={},N={},averageSegmentSize={}}}",
+        blockScanVariantName(testCase.config.blockScanVariant), testCase.config.workgroupSize,
+        testCase.config.rows, testCase.N, testCase.averageSegmentSize);
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    Algorithm kernel{context.context, context.shaderCompiler, testCase.config};
+
+    bool failed = false;
+    for (size_t it = 0; it < testCase.iterations; ++it) {
+        MERIAN_PROFILE_SCOPE(context.profiler, testName);
+        context.queue->wait_idle();
+
+        // 1. Generate input
+        context.profiler->start("Generate test input");
+        const auto elements =
+            host::pmr::generate_weights<float>(testCase.distribution, testCase.N, resource);
+        const auto segmentOffsets = generateSegmentOffsets(testCase, resource);
+        const auto headFlags = segmentHeadFlags(segmentOffsets, testCase.N);
+        context.profiler->end();
+
+        // 2. Begin recoding
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        std::string recordingLabel = fmt::format("Recording : {}", testName);
+        context.profiler->start(recordingLabel);
+        context.profiler->cmd_start(cmd, recordingLabel);
+
+        // 3. Upload test case
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Upload test case");
+            uploadTestCase(cmd, buffers, stage, elements, headFlags);
+        }
+
+        // 4. Run test case
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Execute algorithm");
+            kernel.run(cmd, buffers, testCase.N);
+        }
+
+        // 5. Download results to stage
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Download results to stage");
+            downloadToStage(cmd, buffers, stage, testCase.N);
+        }
+
+        // 6. Submit to device
+        context.profiler->end();
+        context.profiler->cmd_end(cmd);
+        cmd->end();
+        context.queue->submit_wait(cmd);
+
+        // 7. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            Buffers::PrefixSumView stageView{stage.prefixSum, testCase.N};
+            const auto prefixSum = stageView.download<float, host::pmr_alloc<float>>(resource);
+            const auto reference = host::reference::pmr::segmented_prefix_sum<float>(
+                elements, segmentOffsets, resource);
+
+            std::size_t errorCount = 0;
+            for (std::size_t i = 0; i < testCase.N; ++i) {
+                const float tolerance = 1e-4f * std::max(1.0f, std::abs(reference[i]));
+                if (std::abs(prefixSum[i] - reference[i]) > tolerance) {
+                    if (errorCount < 10) {
+                        SPDLOG_ERROR("prefixSum[{}] = {}, expected {}", i, prefixSum[i],
+                                     reference[i]);
+                    }
+                    errorCount++;
+                }
+            }
+            if (errorCount != 0) {
+                SPDLOG_ERROR("{} out of {} elements are invalid", errorCount, testCase.N);
+                failed = true;
+            }
+        }
+        context.profiler->collect(true, true);
+    }
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing segmented prefix sum algorithm");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    SPDLOG_DEBUG("Allocating buffers");
+    auto [buffers, stage] = allocateBuffers(testContext);
+
+    host::memory::StackResource stackResource{4096 * 2048};
+    host::memory::FallbackResource fallbackResource{&stackResource};
+    host::memory::SafeResource safeResource{&fallbackResource};
+
+    std::pmr::memory_resource* resource = &safeResource;
+
+    uint32_t failCount = 0;
+    for (const auto& testCase : TEST_CASES) {
+        if (runTestCase(testContext, testCase, buffers, stage, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+
+    testContext.profiler->collect(true, true);
+    SPDLOG_INFO(fmt::format("Profiler results: \n{}",
+                            merian::Profiler::get_report_str(testContext.profiler->get_report())));
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
+                                 sizeof(TEST_CASES) / sizeof(TestCase)));
+    }
+}
+
+} // namespace device::test::segmented_prefix_sum
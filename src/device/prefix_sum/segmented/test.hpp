@@ -0,0 +1,8 @@
+#pragma once
+
+#include "merian/vk/context.hpp"
+namespace device::test::segmented_prefix_sum {
+
+void test(const merian::ContextHandle& context);
+
+}
@@ -64,6 +64,14 @@ static TestCase TEST_CASES[] = {
         .distribution = host::Distribution::UNIFORM,
         .iterations = 1,
     },
+    // 513 partitions in 9 chained dispatches (partitionOffset = 0, 64, ..., 512),
+    // the prefix of every dispatch after the first one is carried over by the look-back.
+    TestCase{
+        .config = DecoupledPrefixSumConfig(512, 8, BlockScanVariant::RANKED_STRIDED, 32, 64),
+        .N = static_cast<host::glsl::uint>((1024 * 2048 + 1)),
+        .distribution = host::Distribution::UNIFORM,
+        .iterations = 2,
+    },
 
     /* TestCase{ */
     /*     .config = DecoupledPrefixSumConfig( */
@@ -200,6 +208,7 @@ static bool runTestCase(const host::test::TestContext& context,
 
             if (err) {
                 SPDLOG_ERROR("Invalid prefix: \n{}", err.message());
+                failed = true;
             }
         }
         context.profiler->collect(true, true);
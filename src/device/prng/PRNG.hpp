@@ -2,11 +2,12 @@
 
 #include "merian/vk/memory/resource_allocations.hpp"
 #include "src/device/prng/philox/Philox.hpp"
+#include "src/device/prng/philox4x32/Philox4x32.hpp"
 #include <stdexcept>
 #include <variant>
 namespace device {
 
-using PRNGConfig = std::variant<PhiloxConfig>;
+using PRNGConfig = std::variant<PhiloxConfig, Philox4x32Config>;
 
 struct PRNGBuffers {
     merian::BufferHandle samples;
@@ -18,13 +19,16 @@ class PRNG {
     using Config = PRNGConfig;
 
   private:
-    using Method = std::variant<Philox>;
+    using Method = std::variant<Philox, Philox4x32>;
     static Method createMethod(const merian::ContextHandle& context,
                                const merian::ShaderCompilerHandle& shaderCompiler,
                                const Config& config) {
         if (std::holds_alternative<PhiloxConfig>(config)) {
             auto methodConfig = std::get<PhiloxConfig>(config);
             return Philox(context, shaderCompiler, methodConfig);
+        } else if (std::holds_alternative<Philox4x32Config>(config)) {
+            auto methodConfig = std::get<Philox4x32Config>(config);
+            return Philox4x32(context, shaderCompiler, methodConfig);
         } else {
             throw std::runtime_error("NOT-IMPLEMENTED");
         }
@@ -45,6 +49,11 @@ class PRNG {
             Philox::Buffers methodBuffers;
             methodBuffers.samples = buffers.samples;
             method.run(cmd, methodBuffers, S, seed);
+        } else if (std::holds_alternative<Philox4x32>(m_method)) {
+            const auto& method = std::get<Philox4x32>(m_method);
+            Philox4x32::Buffers methodBuffers;
+            methodBuffers.samples = buffers.samples;
+            method.run(cmd, methodBuffers, S, seed);
         } else {
             throw std::runtime_error("NOT-IMPLEMENTED");
         }
@@ -8,9 +8,11 @@
 #include "merian/vk/pipeline/specialization_info.hpp"
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
 #include <memory>
 #include <vulkan/vulkan_handles.hpp>
 
@@ -47,15 +49,18 @@ struct PhiloxBuffers {
 class PhiloxConfig {
   public:
     host::glsl::uint workgroupSize;
+    host::RNGAlgorithm rng;
 
-    constexpr PhiloxConfig() : workgroupSize(512) {}
-    explicit constexpr PhiloxConfig(host::glsl::uint workgroupSize)
-        : workgroupSize(workgroupSize) {}
+    constexpr PhiloxConfig() : workgroupSize(512), rng(host::RNGAlgorithm::PHILOX) {}
+    explicit constexpr PhiloxConfig(host::glsl::uint workgroupSize,
+                                    host::RNGAlgorithm rng = host::RNGAlgorithm::PHILOX)
+        : workgroupSize(workgroupSize), rng(rng) {}
 };
 
 class Philox {
     struct PushConstants {
         host::glsl::uint seed;
+        host::glsl::uint N;
     };
 
   public:
@@ -66,27 +71,15 @@ class Philox {
                     PhiloxConfig config = {})
         : m_workgroupSize(config.workgroupSize) {
 
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer()
-                .build_push_descriptor_layout(context);
-
         const std::string shaderPath = "src/device/prng/philox/shader.comp";
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(config.workgroupSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addIncludePath("src/device/common/")
+                         .addStorageBuffer()
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(host::rngSpecializationConstant(config.rng))
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd,
@@ -98,6 +91,7 @@ class Philox {
         cmd->push_descriptor_set(m_pipeline, buffers.samples);
         cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
                                                           .seed = seed,
+                                                          .N = sampleCount,
                                                       });
         const uint32_t workgroupCount = (sampleCount + m_workgroupSize - 1) / m_workgroupSize;
         cmd->dispatch(workgroupCount, 1, 1);
@@ -0,0 +1,98 @@
+#pragma once
+/**
+ * @filename    : Philox4x32.hpp
+ *
+ * Fills a float buffer with uniforms in [0,1) from Philox4x32-10.
+ * Every counter yields 4 floats, which are written with vec4 stores,
+ * every invocation writes `rows` vec4s, such that the kernel is bound by memory bandwidth.
+ */
+
+#include "merian/vk/pipeline/pipeline.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/device/prng/philox/Philox.hpp"
+#include "src/host/types/glsl.hpp"
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+class Philox4x32Config {
+  public:
+    host::glsl::uint workgroupSize;
+    host::glsl::uint rows; // vec4 per invocation
+    // counters (and counter offsets) above 2^32, otherwise the offset is truncated.
+    bool counter64;
+
+    constexpr Philox4x32Config() : workgroupSize(512), rows(4), counter64(false) {}
+    explicit constexpr Philox4x32Config(host::glsl::uint workgroupSize,
+                                        host::glsl::uint rows = 4,
+                                        bool counter64 = false)
+        : workgroupSize(workgroupSize), rows(rows), counter64(counter64) {}
+};
+
+class Philox4x32 {
+    struct PushConstants {
+        host::glsl::uint seed;
+        host::glsl::uint N;
+        host::glsl::uint counterOffsetLo;
+        host::glsl::uint counterOffsetHi;
+    };
+
+  public:
+    using Buffers = PhiloxBuffers;
+
+    explicit Philox4x32(const merian::ContextHandle& context,
+                        const merian::ShaderCompilerHandle& shaderCompiler,
+                        Philox4x32Config config = {})
+        : m_workgroupSize(config.workgroupSize), m_rows(config.rows),
+          m_counter64(config.counter64) {
+
+        const std::string shaderPath = "src/device/prng/philox4x32/shader.comp";
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addIncludePath("src/device/common/")
+                         .addStorageBuffer()
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(m_workgroupSize)
+                         .addSpecializationConstant(m_rows)
+                         .addSpecializationConstant(
+                             static_cast<host::glsl::uint>(m_counter64)) // VkBool32
+                         .build();
+    }
+
+    /// A counter offset of k continues a previous run of 4k floats, without repeating counters.
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint sampleCount,
+             host::glsl::uint seed = 12345u,
+             uint64_t counterOffset = 0) const {
+        if (!m_counter64 && (counterOffset >> 32) != 0) {
+            throw std::runtime_error("Philox4x32: counter offset requires 64-bit counters");
+        }
+
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.samples);
+        cmd->push_constant<PushConstants>(
+            m_pipeline, PushConstants{
+                            .seed = seed,
+                            .N = sampleCount,
+                            .counterOffsetLo = static_cast<host::glsl::uint>(counterOffset),
+                            .counterOffsetHi = static_cast<host::glsl::uint>(counterOffset >> 32),
+                        });
+        const host::glsl::uint vec4Count = sampleCount / 4 + 1; // + tail
+        const host::glsl::uint perWorkgroup = m_workgroupSize * m_rows;
+        const uint32_t workgroupCount = (vec4Count + perWorkgroup - 1) / perWorkgroup;
+        cmd->dispatch(workgroupCount, 1, 1);
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+    host::glsl::uint m_workgroupSize;
+    host::glsl::uint m_rows;
+    bool m_counter64;
+};
+
+} // namespace device
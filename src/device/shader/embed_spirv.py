@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""
+Generates a C++ translation unit which embeds precompiled SPIR-V modules.
+
+usage: embed_spirv.py <output.cpp> <source-dir> <key>... -- <spv>...
+
+Every key has the form "<path>|<define>,<define>,..." and belongs to the spv
+file at the same position. Defines are sorted by their name here, such that the
+runtime lookup (src/device/shader/load.cpp) can use the order of a
+std::map<name, value>. Sorting the whole "NAME=VALUE" strings differs from it,
+if a name is a prefix of another name (e.g. "A1" < "A=x" but "A" < "A1").
+"""
+
+import sys
+
+
+def canonical_key(key):
+    path, _, defines = key.partition("|")
+    defines = sorted((d for d in defines.split(",") if d),
+                     key=lambda d: d.partition("=")[0])
+    return path + "|" + ",".join(defines)
+
+
+def main(argv):
+    output, source_dir = argv[1], argv[2]
+    split = argv.index("--")
+    keys = [canonical_key(k) for k in argv[3:split]]
+    spvs = argv[split + 1:]
+    if len(keys) != len(spvs):
+        raise SystemExit("embed_spirv.py: key and spv count mismatch")
+
+    lines = [
+        "// Generated by embed_spirv.py, do not edit.",
+        '#include "src/device/shader/embedded_spirv.hpp"',
+        "",
+        "namespace device::shader::details {",
+        "",
+    ]
+    for i, spv in enumerate(spvs):
+        with open(spv, "rb") as f:
+            code = f.read()
+        words = [int.from_bytes(code[o:o + 4], "little") for o in range(0, len(code), 4)]
+        lines.append(f"static const std::uint32_t SPIRV_{i}[] = {{")
+        for o in range(0, len(words), 8):
+            lines.append("    " + ", ".join(f"0x{w:08x}u" for w in words[o:o + 8]) + ",")
+        lines.append("};")
+        lines.append("")
+
+    if spvs:
+        lines.append("static const EmbeddedSpirv TABLE[] = {")
+        for i, key in enumerate(keys):
+            lines.append(f'    {{"{key}", SPIRV_{i}, sizeof(SPIRV_{i}) / sizeof(std::uint32_t)}},')
+        lines.append("};")
+        lines.append("const std::span<const EmbeddedSpirv> EMBEDDED_SPIRV{TABLE};")
+    else:
+        lines.append("const std::span<const EmbeddedSpirv> EMBEDDED_SPIRV{};")
+    lines.append("")
+    lines.append(f'const std::string_view SHADER_SOURCE_DIR = "{source_dir}";')
+    lines.append("")
+    lines.append("} // namespace device::shader::details")
+    lines.append("")
+
+    with open(output, "w") as f:
+        f.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main(sys.argv)
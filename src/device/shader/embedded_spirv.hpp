@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace device::shader::details {
+
+struct EmbeddedSpirv {
+    // "<path>|<define>,<define>=<value>,..." with defines sorted by name.
+    std::string_view key;
+    const std::uint32_t* code;
+    std::size_t wordCount;
+};
+
+// Generated at build time by embed_spirv.py (see meson.build).
+extern const std::span<const EmbeddedSpirv> EMBEDDED_SPIRV;
+
+// Absolute path to the project source root, used to resolve shader
+// sources when falling back to runtime compilation.
+extern const std::string_view SHADER_SOURCE_DIR;
+
+} // namespace device::shader::details
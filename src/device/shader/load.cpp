@@ -0,0 +1,83 @@
+#include "./load.hpp"
+#include "src/device/shader/embedded_spirv.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+static std::string embeddedKey(const std::string& path,
+                               const std::map<std::string, std::string>& defines) {
+    std::string key = path + "|";
+    bool first = true;
+    for (const auto& [name, value] : defines) { // std::map is already sorted by name.
+        if (!first) {
+            key += ",";
+        }
+        first = false;
+        key += name;
+        if (!value.empty()) {
+            key += "=" + value;
+        }
+    }
+    return key;
+}
+
+static std::string resolveSourcePath(const std::string& path) {
+    if (std::filesystem::exists(path)) {
+        return path;
+    }
+    const std::filesystem::path resolved =
+        std::filesystem::path(device::shader::details::SHADER_SOURCE_DIR) / path;
+    if (std::filesystem::exists(resolved)) {
+        return resolved.string();
+    }
+    return path;
+}
+
+std::optional<std::span<const std::uint32_t>>
+device::shader::findEmbeddedSpirv(const std::string& path,
+                                  const std::map<std::string, std::string>& defines) {
+    const std::string key = embeddedKey(path, defines);
+    const auto it = std::ranges::find_if(details::EMBEDDED_SPIRV,
+                                         [&](const auto& entry) { return entry.key == key; });
+    if (it == details::EMBEDDED_SPIRV.end()) {
+        return std::nullopt;
+    }
+    return std::span<const std::uint32_t>(it->code, it->wordCount);
+}
+
+merian::ShaderModuleHandle
+device::shader::loadComputeShader(const merian::ContextHandle& context,
+                                  const merian::ShaderCompilerHandle& shaderCompiler,
+                                  const std::string& path,
+                                  const std::vector<std::string>& includePaths,
+                                  const std::map<std::string, std::string>& defines) {
+    const bool forceRuntime = std::getenv("WRS_RUNTIME_SHADERS") != nullptr;
+    if (!forceRuntime) {
+        const auto spirv = findEmbeddedSpirv(path, defines);
+        if (spirv.has_value()) {
+            return std::make_shared<merian::ShaderModule>(context, spirv->size_bytes(),
+                                                          spirv->data(),
+                                                          vk::ShaderStageFlagBits::eCompute);
+        }
+        SPDLOG_DEBUG("No embedded SPIR-V for {}, falling back to runtime compilation",
+                     embeddedKey(path, defines));
+    }
+
+    if (shaderCompiler == nullptr) {
+        throw std::runtime_error(fmt::format(
+            "Shader {} is not embedded and no runtime shader compiler is available",
+            embeddedKey(path, defines)));
+    }
+
+    std::vector<std::string> resolvedIncludePaths;
+    resolvedIncludePaths.reserve(includePaths.size());
+    for (const auto& includePath : includePaths) {
+        resolvedIncludePaths.push_back(resolveSourcePath(includePath));
+    }
+    return shaderCompiler->find_compile_glsl_to_shadermodule(
+        context, resolveSourcePath(path), vk::ShaderStageFlagBits::eCompute, resolvedIncludePaths,
+        defines);
+}
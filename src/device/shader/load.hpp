@@ -0,0 +1,35 @@
+#pragma once
+/**
+ * Loads the compute shader modules of all kernels.
+ * Every permutation registered in a meson.build (see src/device/shader/meson.build)
+ * is compiled to SPIR-V at build time and embedded into the binary.
+ * Permutations which are not embedded are compiled at runtime with the given
+ * shader compiler, this also works if the binary is not executed from the repository root.
+ *
+ * Setting the environment variable WRS_RUNTIME_SHADERS forces runtime compilation,
+ * which is useful while iterating on shader sources.
+ */
+
+#include "merian/vk/context.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "merian/vk/shader/shader_module.hpp"
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace device::shader {
+
+std::optional<std::span<const std::uint32_t>>
+findEmbeddedSpirv(const std::string& path, const std::map<std::string, std::string>& defines);
+
+merian::ShaderModuleHandle
+loadComputeShader(const merian::ContextHandle& context,
+                  const merian::ShaderCompilerHandle& shaderCompiler,
+                  const std::string& path,
+                  const std::vector<std::string>& includePaths = {},
+                  const std::map<std::string, std::string>& defines = {});
+
+} // namespace device::shader
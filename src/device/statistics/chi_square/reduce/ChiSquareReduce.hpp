@@ -1,5 +1,6 @@
 #pragma once
 
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/device/statistics/chi_square/reduce/ChiSquareReduceAllocFlags.hpp"
 #pragma once
 
@@ -119,32 +120,21 @@ class ChiSquareReduce {
                              ChiSquareReduceConfig config = {})
         : m_blockSize(config.blockSize()) {
 
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // elements
-                .add_binding_storage_buffer() // reductions
-                .add_binding_storage_buffer() // prefix sum
-                .build_push_descriptor_layout(context);
-
         const std::string shaderPath = "src/device/statistics/chi_square/reduce/shader.comp";
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute, {"src/device/common/"});
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(config.workgroupSize);
-        specInfoBuilder.add_entry(config.rows);
-        specInfoBuilder.add_entry(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addIncludePath("src/device/common/")
+                         .addStorageBuffer() // elements
+                         .addStorageBuffer() // reductions
+                         .addStorageBuffer() // prefix sum
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(config.rows)
+                         .addSpecializationConstant(subgroupSize)
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd,
@@ -16,6 +16,7 @@
 #include "merian/vk/pipeline/specialization_info.hpp"
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/device/statistics/chi_square/reduce/ChiSquareReduceAllocFlags.hpp"
 #include "src/device/statistics/histogram/HistogramAllocFlags.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
@@ -99,28 +100,14 @@ class AtomicHistogram {
         assert(context != nullptr);
         assert(shaderCompiler != nullptr);
 
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // samples
-                .add_binding_storage_buffer() // histogram
-                .build_push_descriptor_layout(context);
-
         const std::string shaderPath = "src/device/statistics/histogram/atomic/shader.comp";
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(m_workgroupSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addStorageBuffer() // samples
+                         .addStorageBuffer() // histogram
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(m_workgroupSize)
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd,
@@ -7,6 +7,7 @@
 #include "merian/vk/pipeline/specialization_info.hpp"
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/types/glsl.hpp"
@@ -63,32 +64,20 @@ class MeanSquaredError {
                               host::glsl::uint rows = 8)
         : m_partitionSize(workgroupSize * rows) {
 
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // histogram
-                .add_binding_storage_buffer() // weights
-                .add_binding_storage_buffer() // rme
-                .build_push_descriptor_layout(context);
+        const std::string shaderPath = "src/device/statistics/rmse/mse/shader.comp";
 
-        const std::string shaderPath = "src/wrs/algorithm/rmse/mse/shader.comp";
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(workgroupSize);
-        specInfoBuilder.add_entry(rows);
-        specInfoBuilder.add_entry(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addStorageBuffer() // histogram
+                         .addStorageBuffer() // weights
+                         .addStorageBuffer() // rme
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(workgroupSize)
+                         .addSpecializationConstant(rows)
+                         .addSpecializationConstant(subgroupSize)
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd,
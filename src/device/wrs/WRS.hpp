@@ -5,18 +5,32 @@
 #include "merian/vk/shader/shader_compiler.hpp"
 #include "src/device/wrs/alias/AliasTable.hpp"
 #include "src/device/wrs/cutpoint/Cutpoint.hpp"
+#include "src/device/wrs/glsl/WRSInline.hpp"
+#include "src/device/wrs/hst/HST.hpp"
 #include "src/device/wrs/its/ITS.hpp"
 #include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
+#include <span>
 #include <stdexcept>
 #include <variant>
+#include <vector>
 namespace device {
 
-using WRSConfig = std::variant<ITS::Config, AliasTable::Config, Cutpoint::Config>;
+using WRSConfig = std::variant<ITS::Config, AliasTable::Config, Cutpoint::Config, HST::Config>;
 
 [[maybe_unused]]
 static std::string wrsConfigName(WRSConfig config) {
     if (std::holds_alternative<ITS::Config>(config)) {
         auto methodConfig = std::get<ITS::Config>(config);
+        if (methodConfig.incrementalConfig.has_value()) {
+            methodConfig.incrementalConfig = std::nullopt;
+            return wrsConfigName(methodConfig) + "-Incremental";
+        }
+        if (methodConfig.compressedConfig.has_value()) {
+            const host::glsl::uint blockSize = methodConfig.compressedConfig->blockSize;
+            methodConfig.compressedConfig = std::nullopt;
+            return wrsConfigName(methodConfig) + fmt::format("-Compressed-{}", blockSize);
+        }
         if (methodConfig.samplingConfig.cooperativeSamplingSize == 0) {
             return fmt::format("ITS-{}", methodConfig.samplingConfig.workgroupSize);
         } else {
@@ -36,6 +50,9 @@ static std::string wrsConfigName(WRSConfig config) {
     } else if (std::holds_alternative<Cutpoint::Config>(config)) {
         auto methodConfig = std::get<Cutpoint::Config>(config);
         return methodConfig.name();
+    } else if (std::holds_alternative<HST::Config>(config)) {
+        auto methodConfig = std::get<HST::Config>(config);
+        return methodConfig.name();
     } else {
         throw std::runtime_error("NOT-IMPLEMENTED");
     }
@@ -54,7 +71,15 @@ struct WRSBuffers {
     using SamplesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
     using SamplesView = host::layout::BufferView<SamplesLayout>;
 
-    std::variant<device::ITS::Buffers, device::AliasTable::Buffers, device::Cutpoint::Buffers>
+    // only methods with a multinomial config (see WRS::sampleCounts).
+    merian::BufferHandle counts;
+    using CountsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using CountsView = host::layout::BufferView<CountsLayout>;
+
+    std::variant<device::ITS::Buffers,
+                 device::AliasTable::Buffers,
+                 device::Cutpoint::Buffers,
+                 device::HST::Buffers>
         m_internals;
 
     static Self allocate(const merian::ResourceAllocatorHandle& alloc,
@@ -65,7 +90,7 @@ struct WRSBuffers {
         Self buffers;
         if (std::holds_alternative<ITS::Config>(config)) {
             ITS::Buffers methodBuffers = ITS::Buffers::allocate(
-                alloc, memoryMapping, N, S, std::get<ITS::Config>(config).prefixSumConfig);
+                alloc, memoryMapping, N, S, std::get<ITS::Config>(config));
             buffers.weights = methodBuffers.weights;
             buffers.samples = methodBuffers.samples;
             buffers.m_internals = methodBuffers;
@@ -81,6 +106,13 @@ struct WRSBuffers {
             buffers.weights = methodBuffers.weights;
             buffers.samples = methodBuffers.samples;
             buffers.m_internals = methodBuffers;
+        } else if (std::holds_alternative<HST::Config>(config)) {
+            HST::Buffers methodBuffers =
+                HST::Buffers::allocate(alloc, memoryMapping, N, S, std::get<HST::Config>(config));
+            buffers.weights = methodBuffers.weights;
+            buffers.samples = methodBuffers.samples;
+            buffers.counts = methodBuffers.counts;
+            buffers.m_internals = methodBuffers;
         } else {
             throw std::runtime_error("NOT-IMPLEMENTED");
         }
@@ -92,31 +124,39 @@ class WRS {
   public:
     using Buffers = WRSBuffers;
     using Config = WRSConfig;
-    using Method = std::variant<ITS, AliasTable, Cutpoint>;
+    using Method = std::variant<ITS, AliasTable, Cutpoint, HST>;
 
   private:
     static Method createMethod(const merian::ContextHandle& context,
                                const merian::ShaderCompilerHandle& shaderCompiler,
-                               const Config& config) {
+                               const Config& config,
+                               bool sampleParametersBuffer) {
         if (std::holds_alternative<ITSConfig>(config)) {
             const auto& methodConfig = std::get<ITSConfig>(config);
-            return ITS(context, shaderCompiler, methodConfig);
+            return ITS(context, shaderCompiler, methodConfig, sampleParametersBuffer);
         } else if (std::holds_alternative<AliasTable::Config>(config)) {
             const auto& methodConfig = std::get<AliasTable::Config>(config);
-            return AliasTable(context, shaderCompiler, methodConfig);
+            return AliasTable(context, shaderCompiler, methodConfig, sampleParametersBuffer);
         } else if (std::holds_alternative<Cutpoint::Config>(config)) {
             const auto& methodConfig = std::get<Cutpoint::Config>(config);
-            return Cutpoint(context, shaderCompiler, methodConfig);
+            return Cutpoint(context, shaderCompiler, methodConfig, sampleParametersBuffer);
+        } else if (std::holds_alternative<HST::Config>(config)) {
+            const auto& methodConfig = std::get<HST::Config>(config);
+            return HST(context, shaderCompiler, methodConfig, sampleParametersBuffer);
         } else {
             throw std::runtime_error("NOT-IMPLEMENTED");
         }
     }
 
   public:
+    /// With sampleParametersBuffer, S and the seed of the samples are read from a buffer,
+    /// such that they can change between submits of recorded commands
+    /// (see the sample overload with parameters and ReplayableWRS).
     explicit WRS(const merian::ContextHandle& context,
                  const merian::ShaderCompilerHandle& shaderCompiler,
-                 Config config)
-        : m_method(createMethod(context, shaderCompiler, config)) {}
+                 Config config,
+                 bool sampleParametersBuffer = false)
+        : m_method(createMethod(context, shaderCompiler, config, sampleParametersBuffer)) {}
 
     void build(const merian::CommandBufferHandle& cmd,
                const WRSBuffers& buffers,
@@ -137,36 +177,238 @@ class WRS {
             Cutpoint::Buffers internals = std::get<Cutpoint::Buffers>(buffers.m_internals);
             internals.weights = buffers.weights;
             cutpoint.build(cmd, internals, N, profiler);
+        } else if (std::holds_alternative<HST>(m_method)) {
+            const auto& hst = std::get<HST>(m_method);
+            HST::Buffers internals = std::get<HST::Buffers>(buffers.m_internals);
+            internals.weights = buffers.weights;
+            hst.build(cmd, internals, N, profiler);
         } else {
             throw std::runtime_error("NOT-IMPLEMENTED");
         }
     }
 
+    /// The sequence selects the points of a low-discrepancy RNGAlgorithm.
     void sample(const merian::CommandBufferHandle& cmd,
                 const WRSBuffers& buffers,
                 host::glsl::uint N,
                 host::glsl::uint S,
-                host::glsl::uint seed = 12345u) const {
+                host::glsl::uint seed = 12345u,
+                const host::SampleSequence& sequence = {},
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (std::holds_alternative<ITS>(m_method)) {
+            const ITS& method = std::get<ITS>(m_method);
+            ITS::Buffers itsBuffers = std::get<ITS::Buffers>(buffers.m_internals);
+            itsBuffers.samples = buffers.samples;
+            method.sample(cmd, itsBuffers, N, S, seed, sequence, profiler);
+        } else if (std::holds_alternative<AliasTable>(m_method)) {
+            const AliasTable& method = std::get<AliasTable>(m_method);
+            AliasTable::Buffers aliasBuffers = std::get<AliasTable::Buffers>(buffers.m_internals);
+            aliasBuffers.samples = buffers.samples;
+            method.sample(cmd, aliasBuffers, N, S, seed, sequence, profiler);
+        } else if (std::holds_alternative<Cutpoint>(m_method)) {
+            const auto& cutpoint = std::get<Cutpoint>(m_method);
+            Cutpoint::Buffers internals = std::get<Cutpoint::Buffers>(buffers.m_internals);
+            internals.samples = buffers.samples;
+            cutpoint.sample(cmd, internals, N, S, seed, sequence, profiler);
+        } else if (std::holds_alternative<HST>(m_method)) {
+            const auto& hst = std::get<HST>(m_method);
+            HST::Buffers internals = std::get<HST::Buffers>(buffers.m_internals);
+            internals.samples = buffers.samples;
+            hst.sample(cmd, internals, N, S, seed, sequence, profiler);
+        } else {
+            throw std::runtime_error("NOT-IMPLEMENTED");
+        }
+    }
+
+    /**
+     * Reads S and the seed from parameters (two uints, see sample_parameters.comp) and is
+     * dispatched for maxS samples, every sample at or above S is skipped.
+     * Requires a WRS created with sampleParametersBuffer.
+     */
+    void sample(const merian::CommandBufferHandle& cmd,
+                const WRSBuffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint maxS,
+                const merian::BufferHandle& parameters,
+                const host::SampleSequence& sequence = {},
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
         if (std::holds_alternative<ITS>(m_method)) {
             const ITS& method = std::get<ITS>(m_method);
             ITS::Buffers itsBuffers = std::get<ITS::Buffers>(buffers.m_internals);
             itsBuffers.samples = buffers.samples;
-            method.sample(cmd, itsBuffers, N, S, seed);
+            method.sample(cmd, itsBuffers, N, maxS, parameters, sequence, profiler);
         } else if (std::holds_alternative<AliasTable>(m_method)) {
             const AliasTable& method = std::get<AliasTable>(m_method);
             AliasTable::Buffers aliasBuffers = std::get<AliasTable::Buffers>(buffers.m_internals);
             aliasBuffers.samples = buffers.samples;
-            method.sample(cmd, aliasBuffers, N, S, seed);
+            method.sample(cmd, aliasBuffers, N, maxS, parameters, sequence, profiler);
         } else if (std::holds_alternative<Cutpoint>(m_method)) {
             const auto& cutpoint = std::get<Cutpoint>(m_method);
             Cutpoint::Buffers internals = std::get<Cutpoint::Buffers>(buffers.m_internals);
             internals.samples = buffers.samples;
-            cutpoint.sample(cmd, internals, N, S, seed);
+            cutpoint.sample(cmd, internals, N, maxS, parameters, sequence, profiler);
+        } else if (std::holds_alternative<HST>(m_method)) {
+            const auto& hst = std::get<HST>(m_method);
+            HST::Buffers internals = std::get<HST::Buffers>(buffers.m_internals);
+            internals.samples = buffers.samples;
+            hst.sample(cmd, internals, N, maxS, parameters, sequence, profiler);
+        } else {
+            throw std::runtime_error("NOT-IMPLEMENTED");
+        }
+    }
+
+    /// Bindings to sample inline in user shaders instead of sample() (see glsl/WRSInline.hpp).
+    /// Not supported by HST and methods with incremental or compressed CMFs.
+    WRSInlineBindings inlineBindings(const WRSBuffers& buffers, host::glsl::uint N) const {
+        if (std::holds_alternative<ITS>(m_method)) {
+            const ITS& method = std::get<ITS>(m_method);
+            return method.inlineBindings(std::get<ITS::Buffers>(buffers.m_internals), N);
+        } else if (std::holds_alternative<AliasTable>(m_method)) {
+            const AliasTable& method = std::get<AliasTable>(m_method);
+            return method.inlineBindings(std::get<AliasTable::Buffers>(buffers.m_internals), N);
+        } else if (std::holds_alternative<Cutpoint>(m_method)) {
+            const auto& cutpoint = std::get<Cutpoint>(m_method);
+            return cutpoint.inlineBindings(std::get<Cutpoint::Buffers>(buffers.m_internals), N);
+        } else {
+            throw std::runtime_error("NOT-IMPLEMENTED");
+        }
+    }
+
+    /// Output sensitive sampling, writes how many of the S samples drew every weight
+    /// into the counts. Only supported by HST with a multinomial config.
+    void sampleCounts(const merian::CommandBufferHandle& cmd,
+                      const WRSBuffers& buffers,
+                      host::glsl::uint N,
+                      host::glsl::uint S,
+                      host::glsl::uint seed = 12345u,
+                      std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (std::holds_alternative<HST>(m_method)) {
+            const auto& hst = std::get<HST>(m_method);
+            HST::Buffers internals = std::get<HST::Buffers>(buffers.m_internals);
+            internals.counts = buffers.counts;
+            hst.sampleCounts(cmd, internals, N, S, seed, profiler);
+        } else {
+            throw std::runtime_error("NOT-IMPLEMENTED");
+        }
+    }
+
+    /// Updates the method after the weights in [dirtyBegin, dirtyEnd) changed,
+    /// instead of a full build. Only supported by HST and methods with an incremental config.
+    /// AliasTable needs the new weights on the host, see the overload with a tracker.
+    void update(const merian::CommandBufferHandle& cmd,
+                const WRSBuffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint dirtyBegin,
+                host::glsl::uint dirtyEnd,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (std::holds_alternative<ITS>(m_method)) {
+            const ITS& method = std::get<ITS>(m_method);
+            ITS::Buffers itsBuffers = std::get<ITS::Buffers>(buffers.m_internals);
+            itsBuffers.weights = buffers.weights;
+            method.update(cmd, itsBuffers, N, dirtyBegin, dirtyEnd, profiler);
+        } else if (std::holds_alternative<Cutpoint>(m_method)) {
+            const auto& cutpoint = std::get<Cutpoint>(m_method);
+            Cutpoint::Buffers internals = std::get<Cutpoint::Buffers>(buffers.m_internals);
+            internals.weights = buffers.weights;
+            cutpoint.update(cmd, internals, N, dirtyBegin, dirtyEnd, profiler);
+        } else if (std::holds_alternative<HST>(m_method)) {
+            const auto& hst = std::get<HST>(m_method);
+            HST::Buffers internals = std::get<HST::Buffers>(buffers.m_internals);
+            internals.weights = buffers.weights;
+            hst.update(cmd, internals, N, dirtyBegin, dirtyEnd, profiler);
+        } else if (std::holds_alternative<AliasTable>(m_method)) {
+            throw std::runtime_error(
+                "AliasTable updates require the new weights and an AliasTableUpdateTracker");
+        } else {
+            throw std::runtime_error("NOT-IMPLEMENTED");
+        }
+    }
+
+    /// Batched point updates after the weights at the given indices changed.
+    /// Supported by the same methods as the range update.
+    void update(const merian::CommandBufferHandle& cmd,
+                const WRSBuffers& buffers,
+                host::glsl::uint N,
+                std::span<const host::glsl::uint> changedIndices,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (std::holds_alternative<ITS>(m_method)) {
+            const ITS& method = std::get<ITS>(m_method);
+            ITS::Buffers itsBuffers = std::get<ITS::Buffers>(buffers.m_internals);
+            itsBuffers.weights = buffers.weights;
+            method.update(cmd, itsBuffers, N, changedIndices, profiler);
+        } else if (std::holds_alternative<Cutpoint>(m_method)) {
+            const auto& cutpoint = std::get<Cutpoint>(m_method);
+            Cutpoint::Buffers internals = std::get<Cutpoint::Buffers>(buffers.m_internals);
+            internals.weights = buffers.weights;
+            cutpoint.update(cmd, internals, N, changedIndices, profiler);
+        } else if (std::holds_alternative<HST>(m_method)) {
+            const auto& hst = std::get<HST>(m_method);
+            HST::Buffers internals = std::get<HST::Buffers>(buffers.m_internals);
+            internals.weights = buffers.weights;
+            hst.update(cmd, internals, N, changedIndices, profiler);
+        } else if (std::holds_alternative<AliasTable>(m_method)) {
+            throw std::runtime_error(
+                "AliasTable updates require the new weights and an AliasTableUpdateTracker");
         } else {
             throw std::runtime_error("NOT-IMPLEMENTED");
         }
     }
 
+    /**
+     * Point updates with the new weights, which also have to be written to the weights buffer.
+     * Supports every method, which supports update() and AliasTable with an update config.
+     * The tracker has to be constructed from the weights of the last full build, it is only
+     * used by AliasTable to decide between repacking splits and a full build.
+     * Returns true if a full build was recorded.
+     */
+    bool update(const merian::CommandBufferHandle& cmd,
+                const WRSBuffers& buffers,
+                host::glsl::uint N,
+                std::span<const AliasTableWeightChange> changes,
+                AliasTableUpdateTracker& tracker,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (std::holds_alternative<AliasTable>(m_method)) {
+            const auto& alias = std::get<AliasTable>(m_method);
+            AliasTable::Buffers aliasBuffers = std::get<AliasTable::Buffers>(buffers.m_internals);
+            aliasBuffers.weights = buffers.weights;
+            return alias.update(cmd, aliasBuffers, N, changes, tracker, profiler);
+        }
+        std::vector<host::glsl::uint> changedIndices(changes.size());
+        for (std::size_t i = 0; i < changes.size(); ++i) {
+            changedIndices[i] = changes[i].index;
+        }
+        update(cmd, buffers, N, changedIndices, profiler);
+        return false;
+    }
+
+    /// Range update with the new weights of [dirtyBegin, dirtyBegin + dirtyWeights.size()),
+    /// see the point update overload with a tracker.
+    bool update(const merian::CommandBufferHandle& cmd,
+                const WRSBuffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint dirtyBegin,
+                std::span<const float> dirtyWeights,
+                AliasTableUpdateTracker& tracker,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (dirtyWeights.empty()) {
+            return false;
+        }
+        if (std::holds_alternative<AliasTable>(m_method)) {
+            std::vector<AliasTableWeightChange> changes(dirtyWeights.size());
+            for (std::size_t i = 0; i < dirtyWeights.size(); ++i) {
+                changes[i] = AliasTableWeightChange{
+                    .index = dirtyBegin + static_cast<host::glsl::uint>(i),
+                    .weight = dirtyWeights[i],
+                };
+            }
+            return update(cmd, buffers, N, changes, tracker, profiler);
+        }
+        const host::glsl::uint dirtyEnd =
+            dirtyBegin + static_cast<host::glsl::uint>(dirtyWeights.size());
+        update(cmd, buffers, N, dirtyBegin, dirtyEnd, profiler);
+        return false;
+    }
+
   private:
     Method m_method;
 };
@@ -1,24 +1,159 @@
 #pragma once
 
 #include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ThreadPool.hpp"
 #include "src/device/wrs/alias/psa/PSA.hpp"
+#include "src/device/wrs/alias/psa/repack/SplitRepack.hpp"
+#include "src/device/wrs/alias/quantize/AliasTableQuantize.hpp"
 #include "src/device/wrs/alias/sampling/AliasTableSampling.hpp"
+#include "src/device/wrs/glsl/WRSInline.hpp"
+#include <algorithm>
+#include <cmath>
 #include <fmt/base.h>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <vector>
 
 namespace device {
 
+struct AliasTableUpdateConfig {
+    const SplitRepackConfig repackConfig;
+    // maximum accumulated |weight change| since the last full build relative to its total weight.
+    // Bounds the total variation distance between the sampled and the exact distribution.
+    const float maxDrift;
+    // a changed weight may cross the mean of the last full build by this fraction of the mean.
+    const float flipTolerance;
+
+    constexpr AliasTableUpdateConfig() : repackConfig{}, maxDrift(0.01f), flipTolerance(0.0f) {}
+    constexpr explicit AliasTableUpdateConfig(SplitRepackConfig repackConfig,
+                                              float maxDrift,
+                                              float flipTolerance)
+        : repackConfig(repackConfig), maxDrift(maxDrift), flipTolerance(flipTolerance) {}
+};
+
 struct AliasTableConfig {
     const PSA::Config psaConfig;
     const SampleAliasTable::Config samplingConfig;
+    // enables update() after partial weight changes.
+    const std::optional<AliasTableUpdateConfig> updateConfig;
+    // samples from a quantized 4 byte per entry table.
+    const std::optional<AliasTableQuantizeConfig> quantizeConfig;
 
     constexpr explicit AliasTableConfig(PSA::Config psaConfig,
-                                        SampleAliasTableConfig samplingConfig)
-        : psaConfig(psaConfig), samplingConfig(samplingConfig) {}
+                                        SampleAliasTableConfig samplingConfig,
+                                        std::optional<AliasTableUpdateConfig> updateConfig =
+                                            std::nullopt,
+                                        std::optional<AliasTableQuantizeConfig> quantizeConfig =
+                                            std::nullopt)
+        : psaConfig(psaConfig), samplingConfig(samplingConfig), updateConfig(updateConfig),
+          quantizeConfig(quantizeConfig) {}
 
     inline std::string name() const {
-        return fmt::format("AliasTable-{}-Sampling-{}", psaConfig.name(),
-                           samplingConfig.workgroupSize);
+        std::string name = fmt::format("AliasTable-{}-Sampling-{}", psaConfig.name(),
+                                       samplingConfig.workgroupSize);
+        if (quantizeConfig.has_value()) {
+            name += "-Quantized";
+        }
+        if (updateConfig.has_value()) {
+            name += "-Incremental";
+        }
+        if (samplingConfig.sampleIndexWidth != host::SampleIndexWidth::U32) {
+            name += "-" + host::sampleIndexWidthName(samplingConfig.sampleIndexWidth);
+        }
+        if (samplingConfig.rng != host::RNGAlgorithm::PHILOX) {
+            name += "-" + host::rngAlgorithmName(samplingConfig.rng);
+        }
+        return name;
+    }
+};
+
+struct AliasTableWeightChange {
+    host::glsl::uint index;
+    float weight;
+};
+
+/**
+ * Host side bookkeeping of the weight changes since the last full build.
+ *
+ * Repacking splits keeps the mean and the heavy/light classification of the last build,
+ * every split absorbs its weight change in a single heavy element and the total weight drifts.
+ * The tracker bounds this error and decides when an update requires a full build.
+ *
+ * Keeps a copy of the weights and the heavy/light class of every element at the last build,
+ * a change flips an element if it crosses the build mean in the opposite direction of its
+ * class, regardless of how many updates it took to get there.
+ */
+class AliasTableUpdateTracker {
+  public:
+    /// Expects the weights of the last full build.
+    explicit AliasTableUpdateTracker(std::span<const float> weights)
+        : m_weights(weights.begin(), weights.end()), m_heavy(weights.size()) {
+        for (const float w : weights) {
+            m_total += w;
+        }
+        rebuilt();
+    }
+
+    /// Records the changes and returns true if they can be applied by repacking splits.
+    /// Otherwise the caller has to record a full build, the tracker already assumes it.
+    bool accept(std::span<const AliasTableWeightChange> changes,
+                const AliasTableUpdateConfig& config,
+                host::glsl::uint splitSize) {
+        const double flipMargin = m_buildMean * config.flipTolerance;
+        bool flip = false;
+        for (const auto& change : changes) {
+            if (change.index >= m_weights.size()) {
+                throw std::runtime_error("AliasTableUpdateTracker: index out of range");
+            }
+            const double delta = static_cast<double>(change.weight) - m_weights[change.index];
+            m_weights[change.index] = change.weight;
+            m_total += delta;
+            m_drift += std::abs(delta);
+            if (m_heavy[change.index]) {
+                flip |= change.weight < m_buildMean - flipMargin;
+            } else {
+                flip |= change.weight > m_buildMean + flipMargin;
+            }
+        }
+        const bool accepted = !flip && changes.size() <= config.repackConfig.maxChangedCount &&
+                              m_weights.size() / splitSize > 0 &&
+                              m_drift <= config.maxDrift * m_buildTotal;
+        if (!accepted) {
+            rebuilt();
+        }
+        return accepted;
+    }
+
+    /// Has to be called after every full build, which is not requested by accept.
+    void rebuilt() {
+        m_buildTotal = m_total;
+        m_drift = 0;
+        // same comparison as the partition of the PSA (w > mean).
+        const float mean = static_cast<float>(m_total / static_cast<double>(m_weights.size()));
+        m_buildMean = mean;
+        for (std::size_t i = 0; i < m_weights.size(); ++i) {
+            m_heavy[i] = m_weights[i] > mean;
+        }
+    }
+
+    double drift() const {
+        return m_drift / m_buildTotal;
+    }
+
+    /// Weights after all accepted or rejected changes.
+    std::span<const float> weights() const {
+        return m_weights;
     }
+
+  private:
+    std::vector<float> m_weights;
+    std::vector<bool> m_heavy; // class at the last full build.
+    double m_buildMean = 0;
+    double m_total = 0;
+    double m_buildTotal = 0;
+    double m_drift = 0;
 };
 
 struct AliasTableBuffers {
@@ -30,7 +165,7 @@ struct AliasTableBuffers {
     using WeightsLayout = host::layout::ArrayLayout<weight_type, storageQualifier>;
     using WeightsView = host::layout::BufferView<WeightsLayout>;
 
-    merian::BufferHandle samples;
+    merian::BufferHandle samples; // packed for narrow sample indices (see sample_index.hpp)
     using SamplesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
     using SamplesView = host::layout::BufferView<SamplesLayout>;
 
@@ -40,12 +175,18 @@ struct AliasTableBuffers {
 
     PSA::Buffers m_psaBuffers;
 
+    SplitRepack::Buffers m_repackBuffers;
+
+    AliasTableQuantize::Buffers m_quantizeBuffers;
+
     static Self allocate(const merian::ResourceAllocatorHandle& alloc,
                          merian::MemoryMappingType memoryMapping,
                          const AliasTableConfig config,
                          host::glsl::uint N,
                          host::glsl::uint S) {
         Self buffers;
+        const std::size_t sampleWordCount =
+            host::sampleWordCount(S, config.samplingConfig.sampleIndexWidth);
 
         if (memoryMapping == merian::MemoryMappingType::NONE) {
             buffers.m_psaBuffers =
@@ -54,17 +195,30 @@ struct AliasTableBuffers {
             buffers.m_aliasTable = buffers.m_psaBuffers.aliasTable;
             buffers.weights = buffers.m_psaBuffers.weights;
 
-            buffers.samples = alloc->createBuffer(SamplesLayout::size(S),
+            buffers.samples = alloc->createBuffer(SamplesLayout::size(sampleWordCount),
                                                   vk::BufferUsageFlagBits::eStorageBuffer |
                                                       vk::BufferUsageFlagBits::eTransferSrc,
                                                   memoryMapping, "samples");
+
+            if (config.updateConfig.has_value()) {
+                const host::glsl::uint K = N / config.psaConfig.splitSize();
+                // the touched entries are only read by the quantize.
+                buffers.m_repackBuffers = SplitRepack::Buffers::allocate(
+                    alloc, memoryMapping, config.updateConfig->repackConfig, K,
+                    config.quantizeConfig.has_value() ? config.psaConfig.splitSize() : 0);
+            }
+            if (config.quantizeConfig.has_value()) {
+                buffers.m_quantizeBuffers = AliasTableQuantize::Buffers::allocate(
+                    alloc, memoryMapping, *config.quantizeConfig, N);
+                buffers.m_quantizeBuffers.aliasTable = buffers.m_aliasTable;
+            }
         } else {
             buffers.weights =
                 alloc->createBuffer(WeightsLayout::size(N), vk::BufferUsageFlagBits::eTransferSrc,
                                     memoryMapping, "psa-weights");
-            buffers.samples =
-                alloc->createBuffer(SamplesLayout::size(S), vk::BufferUsageFlagBits::eTransferDst,
-                                    memoryMapping, "samples");
+            buffers.samples = alloc->createBuffer(SamplesLayout::size(sampleWordCount),
+                                                  vk::BufferUsageFlagBits::eTransferDst,
+                                                  memoryMapping, "samples");
             buffers.m_aliasTable = nullptr;
         }
 
@@ -77,11 +231,38 @@ class AliasTable {
     using Buffers = AliasTableBuffers;
     using Config = AliasTableConfig;
 
+    /// With sampleParametersBuffer, S and the seed of the samples are read from a buffer
+    /// (see the sample overload with parameters).
     AliasTable(const merian::ContextHandle& context,
                const merian::ShaderCompilerHandle& shaderCompiler,
-               const AliasTableConfig& config)
-        : m_psa(context, shaderCompiler, config.psaConfig),
-          m_sampling(context, shaderCompiler, config.samplingConfig) {}
+               const AliasTableConfig& config,
+               bool sampleParametersBuffer = false)
+        : AliasTable(pipeline::parallel(
+                         [&]() { return PSA(context, shaderCompiler, config.psaConfig); },
+                         [&]() {
+                             return SampleAliasTable(context, shaderCompiler,
+                                                     config.samplingConfig,
+                                                     config.quantizeConfig.has_value(),
+                                                     sampleParametersBuffer);
+                         },
+                         [&]() -> std::optional<SplitRepack> {
+                             if (config.updateConfig.has_value()) {
+                                 return SplitRepack(context, shaderCompiler,
+                                                    config.updateConfig->repackConfig,
+                                                    config.psaConfig.splitSize(),
+                                                    config.quantizeConfig.has_value());
+                             }
+                             return std::nullopt;
+                         },
+                         [&]() -> std::optional<AliasTableQuantize> {
+                             if (config.quantizeConfig.has_value()) {
+                                 return AliasTableQuantize(context, shaderCompiler,
+                                                           *config.quantizeConfig,
+                                                           config.updateConfig.has_value());
+                             }
+                             return std::nullopt;
+                         }),
+                     config.updateConfig) {}
 
     void build(const merian::CommandBufferHandle& cmd,
                const Buffers& buffers,
@@ -93,22 +274,222 @@ class AliasTable {
                      vk::PipelineStageFlagBits::eComputeShader,
                      buffers.m_aliasTable->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
                                                           vk::AccessFlagBits::eShaderRead));
+        quantize(cmd, buffers, N, profiler);
+    }
+
+    /**
+     * Applies partial weight changes, the new weights have to be written to the weights buffer
+     * and be visible to compute shaders.
+     * Repacks only the splits which contain changed weights, unless the tracker
+     * requires a full build (drift, heavy/light flips or too many changes).
+     * A quantized table is only converted at the entries of the repacked splits.
+     * The changed indices are recorded into cmd, therefore several updates can be recorded
+     * into one command buffer and resubmitted without waiting for the previous submit.
+     * Returns true if a full build was recorded.
+     */
+    bool update(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                std::span<const AliasTableWeightChange> changes,
+                AliasTableUpdateTracker& tracker,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (!m_repack.has_value()) {
+            throw std::runtime_error("AliasTable was not configured for incremental updates");
+        }
+        if (changes.empty()) {
+            return false;
+        }
+        if (!tracker.accept(changes, *m_updateConfig, m_repack->splitSize())) {
+            build(cmd, buffers, N, profiler);
+            return true;
+        }
+
+        std::vector<host::glsl::uint> changedIndices(changes.size());
+        for (std::size_t i = 0; i < changes.size(); ++i) {
+            changedIndices[i] = changes[i].index;
+        }
+        // a previous update in the same command buffer might still access the indices and
+        // the repack state, which is reset by transfers.
+        std::vector<vk::BufferMemoryBarrier> repackBarriers;
+        repackBarriers.push_back(buffers.m_repackBuffers.changedIndices->buffer_barrier(
+            vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eTransferWrite));
+        repackBarriers.push_back(buffers.m_repackBuffers.splitFlags->buffer_barrier(
+            vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+            vk::AccessFlagBits::eTransferWrite));
+        if (m_repack->tracksEntries()) {
+            repackBarriers.push_back(buffers.m_repackBuffers.touchedEntries->buffer_barrier(
+                vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+                vk::AccessFlagBits::eTransferWrite));
+        }
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eTransfer, repackBarriers);
+
+        SplitRepack::Buffers::ChangedIndicesView localView{
+            buffers.m_repackBuffers.changedIndices, changedIndices.size()};
+        localView.update<host::glsl::uint>(cmd, changedIndices);
+        localView.expectComputeRead(cmd);
+
+        SplitRepack::Buffers repackBuffers = buffers.m_repackBuffers;
+        repackBuffers.weights = buffers.weights;
+        repackBuffers.partitionIndices = buffers.m_psaBuffers.m_partitionIndices;
+        repackBuffers.partitionPrefix = buffers.m_psaBuffers.m_partitionPrefix;
+        repackBuffers.heavyCount = buffers.m_psaBuffers.m_heavyCount;
+        repackBuffers.mean = buffers.m_psaBuffers.m_mean;
+        repackBuffers.aliasTable = buffers.m_aliasTable;
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "Split-Repack");
+            m_repack->run(cmd, repackBuffers, N, static_cast<host::glsl::uint>(changes.size()));
+        }
+
+        if (!m_quantize.has_value()) {
+            cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                         vk::PipelineStageFlagBits::eComputeShader,
+                         buffers.m_aliasTable->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                              vk::AccessFlagBits::eShaderRead));
+            return false;
+        }
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     {buffers.m_aliasTable->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                           vk::AccessFlagBits::eShaderRead),
+                      repackBuffers.touchedEntries->buffer_barrier(
+                          vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead)});
+        const host::glsl::uint K = N / m_repack->splitSize();
+        quantize(cmd, buffers, N, profiler,
+                 SplitRepack::Buffers::touchedEntryCapacity(
+                     m_updateConfig->repackConfig, m_repack->splitSize(),
+                     std::min(static_cast<host::glsl::uint>(changes.size()), K)));
+        return false;
+    }
+
+    void sample(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint S,
+                host::glsl::uint seed,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        sample(cmd, buffers, N, S, seed, host::SampleSequence{}, profiler);
     }
 
+    /// Samples from the points [offset, offset + S) of a low-discrepancy sequence, if the
+    /// sampling kernel uses one (see host::RNGAlgorithm).
     void sample(const merian::CommandBufferHandle& cmd,
                 const Buffers& buffers,
                 host::glsl::uint N,
                 host::glsl::uint S,
-                host::glsl::uint seed) const {
+                host::glsl::uint seed,
+                const host::SampleSequence& sequence,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        SampleAliasTable::Buffers samplingBuffers;
+        samplingBuffers.aliasTable = buffers.m_aliasTable;
+        samplingBuffers.samples = buffers.samples;
+        WRS_PROFILE_SCOPE(profiler, cmd, "Sampling");
+        if (m_quantize.has_value()) {
+            samplingBuffers.quantizedTable = buffers.m_quantizeBuffers.quantizedTable;
+            samplingBuffers.probabilities = buffers.m_quantizeBuffers.probabilities;
+            m_sampling.run(cmd, samplingBuffers, N, S, seed, m_quantize->quantization(N),
+                           sequence);
+        } else {
+            m_sampling.run(cmd, samplingBuffers, N, S, seed, sequence);
+        }
+    }
+
+    /// Reads S and the seed from parameters and is dispatched for maxS samples,
+    /// requires an AliasTable created with sampleParametersBuffer.
+    void sample(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint maxS,
+                const merian::BufferHandle& parameters,
+                const host::SampleSequence& sequence = {},
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
         SampleAliasTable::Buffers samplingBuffers;
         samplingBuffers.aliasTable = buffers.m_aliasTable;
         samplingBuffers.samples = buffers.samples;
-        m_sampling.run(cmd, samplingBuffers, N, S, seed);
+        std::optional<host::AliasTableQuantization> quantization;
+        if (m_quantize.has_value()) {
+            samplingBuffers.quantizedTable = buffers.m_quantizeBuffers.quantizedTable;
+            samplingBuffers.probabilities = buffers.m_quantizeBuffers.probabilities;
+            quantization = m_quantize->quantization(N);
+        }
+        WRS_PROFILE_SCOPE(profiler, cmd, "Sampling");
+        m_sampling.run(cmd, samplingBuffers, N, maxS, parameters, quantization, sequence);
+    }
+
+    /// Bindings to sample from the built table inline in user shaders (see glsl/wrs.glsl).
+    WRSInlineBindings inlineBindings(const Buffers& buffers, host::glsl::uint N) const {
+        WRSInlineBindings bindings;
+        bindings.defines["WRS_ALIAS"];
+        bindings.parameters.N = N;
+        if (!m_quantize.has_value()) {
+            bindings.buffers = {buffers.m_aliasTable};
+            return bindings;
+        }
+        const host::AliasTableQuantization quantization = m_quantize->quantization(N);
+        if (quantization.format == host::AliasTableFormat::PACKED) {
+            bindings.defines["WRS_ALIAS_PACKED"];
+            bindings.buffers = {buffers.m_quantizeBuffers.quantizedTable};
+            bindings.parameters.aliasBits = quantization.aliasBits;
+            bindings.parameters.probabilityBits = quantization.probabilityBits;
+        } else {
+            bindings.defines["WRS_ALIAS_SPLIT16"];
+            bindings.buffers = {buffers.m_quantizeBuffers.probabilities,
+                                buffers.m_quantizeBuffers.quantizedTable};
+        }
+        return bindings;
     }
 
   private:
+    using Kernels = std::tuple<PSA,
+                               SampleAliasTable,
+                               std::optional<SplitRepack>,
+                               std::optional<AliasTableQuantize>>;
+
+    explicit AliasTable(Kernels&& kernels, std::optional<AliasTableUpdateConfig> updateConfig)
+        : m_psa(std::move(std::get<0>(kernels))), m_sampling(std::move(std::get<1>(kernels))),
+          m_repack(std::move(std::get<2>(kernels))), m_quantize(std::move(std::get<3>(kernels))),
+          m_updateConfig(updateConfig) {}
+
+    /// Converts the whole table, or only the at most maxTouchedCount entries,
+    /// which were touched by the last split repack.
+    void quantize(const merian::CommandBufferHandle& cmd,
+                  const Buffers& buffers,
+                  host::glsl::uint N,
+                  std::optional<merian::ProfilerHandle> profiler,
+                  std::optional<host::glsl::uint> maxTouchedCount = std::nullopt) const {
+        if (!m_quantize.has_value()) {
+            return;
+        }
+        AliasTableQuantize::Buffers quantizeBuffers = buffers.m_quantizeBuffers;
+        quantizeBuffers.aliasTable = buffers.m_aliasTable;
+        if (maxTouchedCount.has_value()) {
+            WRS_PROFILE_SCOPE(profiler, cmd, "Quantize-Touched");
+            m_quantize->runTouched(cmd, quantizeBuffers, buffers.m_repackBuffers.touchedEntries,
+                                   N, *maxTouchedCount);
+        } else {
+            WRS_PROFILE_SCOPE(profiler, cmd, "Quantize");
+            m_quantize->run(cmd, quantizeBuffers, N);
+        }
+        if (quantizeBuffers.probabilities != nullptr) {
+            cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                         vk::PipelineStageFlagBits::eComputeShader,
+                         {quantizeBuffers.quantizedTable->buffer_barrier(
+                              vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead),
+                          quantizeBuffers.probabilities->buffer_barrier(
+                              vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead)});
+        } else {
+            cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                         vk::PipelineStageFlagBits::eComputeShader,
+                         quantizeBuffers.quantizedTable->buffer_barrier(
+                             vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead));
+        }
+    }
+
     PSA m_psa;
     SampleAliasTable m_sampling;
+    std::optional<SplitRepack> m_repack;
+    std::optional<AliasTableQuantize> m_quantize;
+    std::optional<AliasTableUpdateConfig> m_updateConfig;
 };
 
 } // namespace device
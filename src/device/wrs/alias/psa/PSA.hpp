@@ -3,6 +3,7 @@
 #include "merian/vk/memory/memory_allocator.hpp"
 #include "src/device/mean/Mean.hpp"
 #include "src/device/mean/MeanAllocFlags.hpp"
+#include "src/device/pipeline/ThreadPool.hpp"
 #include "src/device/prefix_partition/PrefixPartition.hpp"
 #include "src/device/prefix_partition/PrefixPartitionAllocFlags.hpp"
 #include "src/device/wrs/alias/psa/layout/alias_table.hpp"
@@ -161,11 +162,18 @@ class PSA {
     explicit PSA(const merian::ContextHandle& context,
                  const merian::ShaderCompilerHandle& shaderCompiler,
                  const Config& config)
-        : m_mean(context, shaderCompiler, config.meanConfig),
-          m_prefixPartition(
-              context, shaderCompiler, config.prefixPartitionConfig, config.usePartitionElements),
-          m_splitPack(context, shaderCompiler, config.splitPackConfig, config.usePartitionElements),
-          m_usePartitionElements(config.usePartitionElements) {}
+        : PSA(pipeline::parallel(
+                  [&]() { return Mean<weight_type>(context, shaderCompiler, config.meanConfig); },
+                  [&]() {
+                      return PrefixPartition<weight_type>(context, shaderCompiler,
+                                                          config.prefixPartitionConfig,
+                                                          config.usePartitionElements);
+                  },
+                  [&]() {
+                      return SplitPack(context, shaderCompiler, config.splitPackConfig,
+                                       config.usePartitionElements);
+                  }),
+              config.usePartitionElements) {}
 
     void run(const merian::CommandBufferHandle& cmd,
              const Buffers& buffers,
@@ -237,6 +245,14 @@ class PSA {
     }
 
   private:
+    using Kernels = std::tuple<Mean<weight_type>, PrefixPartition<weight_type>, SplitPack>;
+
+    PSA(Kernels&& kernels, bool usePartitionElements)
+        : m_mean(std::move(std::get<0>(kernels))),
+          m_prefixPartition(std::move(std::get<1>(kernels))),
+          m_splitPack(std::move(std::get<2>(kernels))),
+          m_usePartitionElements(usePartitionElements) {}
+
     Mean<weight_type> m_mean;
     PrefixPartition<weight_type> m_prefixPartition;
     SplitPack m_splitPack;
@@ -25,3 +25,10 @@ device::details::downloadAliasTableFromBuffer(const merian::BufferHandle& buffer
          host::glsl::uint>>>(resource); 
 }
 
+void device::details::uploadAliasTableToBuffer(
+    const merian::BufferHandle& buffer,
+    std::span<const host::AliasTableEntry<host::glsl::f32, host::glsl::uint>> aliasTable) {
+  using View = host::layout::BufferView<AliasTableLayout>;
+  View view{buffer, aliasTable.size()};
+  view.template upload<host::AliasTableEntry<host::glsl::f32, host::glsl::uint>>(aliasTable);
+}
@@ -7,6 +7,7 @@
 #include "src/host/layout/StructLayout.hpp"
 #include "src/host/types/glsl.hpp"
 #include <memory_resource>
+#include <span>
 namespace device::details {
 namespace internals {
 
@@ -29,4 +30,9 @@ downloadAliasTableFromBuffer(
     host::glsl::uint N,
     std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
+/// Writes the alias table into a host visible buffer.
+void uploadAliasTableToBuffer(
+    const merian::BufferHandle& buffer,
+    std::span<const host::AliasTableEntry<host::glsl::f32, host::glsl::uint>> aliasTable);
+
 } // namespace device::details
@@ -8,6 +8,8 @@
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/host/layout/Attribute.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/layout/StructLayout.hpp"
@@ -99,21 +101,6 @@ class ScalarPack {
         : m_workgroupSize(config.workgroupSize), m_splitSize(config.splitSize),
           m_usePartitionElements(usePartitionElements) {
 
-        auto setBuilder = merian::DescriptorSetLayoutBuilder()
-                              .add_binding_storage_buffer()  // partition indices
-                              .add_binding_storage_buffer()  // heavy count
-                              .add_binding_storage_buffer()  // weights
-                              .add_binding_storage_buffer()  // mean
-                              .add_binding_storage_buffer()  // splits
-                              .add_binding_storage_buffer(); // alias table
-
-        if (m_usePartitionElements) {
-            setBuilder.add_binding_storage_buffer(); // partition elements
-        }
-
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            setBuilder.build_push_descriptor_layout(context);
-
         std::string shaderPath = "src/device/wrs/alias/psa/pack/scalar/float.comp";
 
         std::map<std::string, std::string> defines;
@@ -121,22 +108,25 @@ class ScalarPack {
             defines["USE_PARTITION_ELEMENTS"];
         }
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute, {}, defines);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstant>()
-                .build_pipeline_layout();
+        pipeline::ComputePipelineBuilder pipelineBuilder(context, shaderCompiler, shaderPath);
+        pipelineBuilder.setDefines(defines)
+            .addStorageBuffer()  // partition indices
+            .addStorageBuffer()  // heavy count
+            .addStorageBuffer()  // weights
+            .addStorageBuffer()  // mean
+            .addStorageBuffer()  // splits
+            .addStorageBuffer(); // alias table
 
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry<host::glsl::uint>(config.workgroupSize);
-        specInfoBuilder.add_entry<host::glsl::uint>(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
+        if (m_usePartitionElements) {
+            pipelineBuilder.addStorageBuffer(); // partition elements
+        }
 
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        m_pipeline = pipelineBuilder.addPushConstant<PushConstant>()
+                         .addSpecializationConstant<host::glsl::uint>(config.workgroupSize)
+                         .addSpecializationConstant<host::glsl::uint>(
+                             context->physical_device.physical_device_subgroup_properties
+                                 .subgroupSize)
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd,
@@ -144,12 +134,7 @@ class ScalarPack {
              const host::glsl::uint N,
              std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
 
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->start("ScalarPack");
-            profiler.value()->cmd_start(cmd, "ScalarPack");
-        }
-#endif
+        WRS_PROFILE_SCOPE(profiler, cmd, "ScalarPack");
 
         const host::glsl::uint K = (N + m_splitSize - 1) / m_splitSize;
 
@@ -178,13 +163,6 @@ class ScalarPack {
         cmd->push_constant<PushConstant>(m_pipeline, PushConstant{.N = N, .K = K});
         const uint32_t workgroupCount = (K + m_workgroupSize - 1) / m_workgroupSize;
         cmd->dispatch(workgroupCount, 1, 1);
-
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
-        }
-#endif
     }
 
     inline host::glsl::uint splitSize() const {
@@ -8,6 +8,8 @@
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/host/layout/Attribute.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/layout/StructLayout.hpp"
@@ -102,20 +104,6 @@ class SubgroupPack {
                           bool usePartitionElements)
         : m_splitSize(config.splitSize), m_usePartitionElements(usePartitionElements) {
 
-        auto setBuilder = merian::DescriptorSetLayoutBuilder()
-                              .add_binding_storage_buffer()  // partition indices
-                              .add_binding_storage_buffer()  // heavy count
-                              .add_binding_storage_buffer()  // weights
-                              .add_binding_storage_buffer()  // mean
-                              .add_binding_storage_buffer()  // splits
-                              .add_binding_storage_buffer(); // alias table
-        if (m_usePartitionElements) {
-            setBuilder.add_binding_storage_buffer(); // partition elements
-        }
-
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            setBuilder.build_push_descriptor_layout(context);
-
         const std::string shaderPath = "src/device/wrs/alias/psa/pack/subgroup/shader.comp";
 
         std::map<std::string, std::string> defines;
@@ -123,49 +111,45 @@ class SubgroupPack {
             defines["USE_PARTITION_ELEMENTS"];
         }
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute, {}, defines);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
+        pipeline::ComputePipelineBuilder pipelineBuilder(context, shaderCompiler, shaderPath);
+        pipelineBuilder.setDefines(defines)
+            .addStorageBuffer()  // partition indices
+            .addStorageBuffer()  // heavy count
+            .addStorageBuffer()  // weights
+            .addStorageBuffer()  // mean
+            .addStorageBuffer()  // splits
+            .addStorageBuffer(); // alias table
+        if (m_usePartitionElements) {
+            pipelineBuilder.addStorageBuffer(); // partition elements
+        }
+        pipelineBuilder.addPushConstant<PushConstants>();
 
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(config.workgroupSize); // 0
+        pipelineBuilder.addSpecializationConstant(config.workgroupSize); // 0
         host::glsl::uint subgroupSize =
             context->physical_device.physical_device_subgroup_properties.subgroupSize;
         assert(config.workgroupSize % subgroupSize == 0);
-        specInfoBuilder.add_entry(subgroupSize); // 1
+        pipelineBuilder.addSpecializationConstant(subgroupSize); // 1
         /* glsl::uint log2SubgroupSize = std::bit_width(subgroupSize) - 1; // floor(log2( . )) */
-        /* specInfoBuilder.add_entry(log2SubgroupSize); */
+        /* pipelineBuilder.addSpecializationConstant(log2SubgroupSize); */
 
         host::glsl::uint threadsPerSubproblem = subgroupSize / config.subgroupSplit;
-        specInfoBuilder.add_entry(threadsPerSubproblem); // 2
+        pipelineBuilder.addSpecializationConstant(threadsPerSubproblem); // 2
         host::glsl::uint log2ThreadsPerSubgroup = std::bit_width(threadsPerSubproblem) - 1;
-        specInfoBuilder.add_entry(log2ThreadsPerSubgroup); // 3
+        pipelineBuilder.addSpecializationConstant(log2ThreadsPerSubgroup); // 3
 
-        specInfoBuilder.add_entry(config.splitSize); // 4
+        pipelineBuilder.addSpecializationConstant(config.splitSize); // 4
 
         host::glsl::uint subgroupCount = (config.workgroupSize + subgroupSize - 1) / subgroupSize;
         m_subproblemsPerWorkgroup = subgroupCount * config.subgroupSplit;
 
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        m_pipeline = pipelineBuilder.build();
     }
 
     void run(const merian::CommandBufferHandle& cmd,
              const Buffers& buffers,
              host::glsl::uint N,
              std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->start("SubgroupPack");
-            profiler.value()->cmd_start(cmd, "SubgroupPack");
-        }
-#endif
+        WRS_PROFILE_SCOPE(profiler, cmd, "SubgroupPack");
 
         cmd->bind(m_pipeline);
         if (m_usePartitionElements) {
@@ -187,13 +171,6 @@ class SubgroupPack {
         const uint32_t workgroupCount =
             (K + m_subproblemsPerWorkgroup - 1) / m_subproblemsPerWorkgroup;
         cmd->dispatch(workgroupCount, 1, 1);
-
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
-        }
-#endif
     }
 
     inline host::glsl::uint splitSize() const {
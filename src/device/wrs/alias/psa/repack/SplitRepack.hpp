@@ -0,0 +1,222 @@
+#pragma once
+/**
+ * @filename    : SplitRepack.hpp
+ *
+ * Repacks only the PSA splits, which contain changed weights.
+ *
+ * The partition, prefix sums and mean of the last full build are reused,
+ * therefore the split boundaries stay the same and every split can be
+ * repacked independently with the new weights.
+ * The weight change of a split is absorbed by the heavy element at its end,
+ * which is why the caller has to bound the accumulated change (see AliasTable::update).
+ *
+ * With trackEntries every written table entry is appended to the touched entries,
+ * such that a quantized table can be converted only where it changed.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+class SplitRepackConfig {
+  public:
+    host::glsl::uint workgroupSize;
+    // maximum amount of changed weights per update, more changes require a full build.
+    host::glsl::uint maxChangedCount;
+
+    constexpr SplitRepackConfig() : workgroupSize(256), maxChangedCount(4096) {}
+    explicit constexpr SplitRepackConfig(host::glsl::uint workgroupSize,
+                                         host::glsl::uint maxChangedCount)
+        : workgroupSize(workgroupSize), maxChangedCount(maxChangedCount) {}
+};
+
+struct SplitRepackBuffers {
+    using Self = SplitRepackBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle weights;
+    merian::BufferHandle partitionIndices;
+    merian::BufferHandle partitionPrefix;
+    merian::BufferHandle heavyCount;
+    merian::BufferHandle mean;
+    merian::BufferHandle aliasTable;
+
+    merian::BufferHandle changedIndices;
+    using ChangedIndicesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using ChangedIndicesView = host::layout::BufferView<ChangedIndicesLayout>;
+
+    merian::BufferHandle splitFlags;
+    using SplitFlagsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+
+    // only with trackEntries, a counter followed by the indices of the written table entries.
+    merian::BufferHandle touchedEntries;
+    using TouchedEntriesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+
+    /// Every split writes less than 2 * splitSize + 1 entries (the last split also covers
+    /// the remainder of N), at most min(maxChangedCount, K) splits are repacked.
+    static constexpr host::glsl::uint touchedEntryCapacity(SplitRepackConfig config,
+                                                           host::glsl::uint splitSize,
+                                                           host::glsl::uint K) {
+        return std::min(config.maxChangedCount, K) * (2 * splitSize + 1);
+    }
+
+    /// Allocates the changed indices and split flags, all other buffers belong to the PSA.
+    /// The touched entries are only allocated for a splitSize > 0.
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         merian::MemoryMappingType memoryMapping,
+                         SplitRepackConfig config,
+                         host::glsl::uint K,
+                         host::glsl::uint splitSize = 0) {
+        Self buffers;
+        if (memoryMapping == merian::MemoryMappingType::NONE) {
+            buffers.changedIndices = alloc->createBuffer(
+                ChangedIndicesLayout::size(config.maxChangedCount),
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                memoryMapping, "repack-changed-indices");
+            buffers.splitFlags = alloc->createBuffer(
+                SplitFlagsLayout::size(K + 1),
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                memoryMapping, "repack-split-flags");
+            if (splitSize > 0) {
+                buffers.touchedEntries = alloc->createBuffer(
+                    TouchedEntriesLayout::size(1 + touchedEntryCapacity(config, splitSize, K)),
+                    vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                    memoryMapping, "repack-touched-entries");
+            }
+        } else {
+            buffers.changedIndices = alloc->createBuffer(
+                ChangedIndicesLayout::size(config.maxChangedCount),
+                vk::BufferUsageFlagBits::eTransferSrc, memoryMapping, "repack-changed-indices");
+            buffers.splitFlags = nullptr;
+        }
+        return buffers;
+    }
+};
+
+class SplitRepack {
+    struct PushConstants {
+        host::glsl::uint K;
+        host::glsl::uint N;
+        host::glsl::uint changedCount;
+    };
+
+  public:
+    using Buffers = SplitRepackBuffers;
+    using Config = SplitRepackConfig;
+
+    explicit SplitRepack(const merian::ContextHandle& context,
+                         const merian::ShaderCompilerHandle& shaderCompiler,
+                         Config config,
+                         host::glsl::uint splitSize,
+                         bool trackEntries = false)
+        : m_workgroupSize(config.workgroupSize), m_splitSize(splitSize),
+          m_trackEntries(trackEntries) {
+        const std::string shaderPath = "src/device/wrs/alias/psa/repack/shader.comp";
+
+        std::map<std::string, std::string> defines;
+        if (m_trackEntries) {
+            defines["TRACK_ENTRIES"];
+        }
+        pipeline::ComputePipelineBuilder builder(context, shaderCompiler, shaderPath);
+        builder.setDefines(defines)
+            .addStorageBuffer() // weights
+            .addStorageBuffer() // partition indices
+            .addStorageBuffer() // partition prefix
+            .addStorageBuffer() // heavy count
+            .addStorageBuffer() // mean
+            .addStorageBuffer() // alias table
+            .addStorageBuffer() // changed indices
+            .addStorageBuffer(); // split flags
+        if (m_trackEntries) {
+            builder.addStorageBuffer(); // touched entries
+        }
+        m_pipeline = builder.addPushConstant<PushConstants>()
+                         .addSpecializationConstant(m_workgroupSize)
+                         .addSpecializationConstant(m_splitSize)
+                         .build();
+    }
+
+    /// Expects that the changed indices are visible to compute shaders.
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint changedCount) const {
+        cmd->fill(buffers.splitFlags, 0);
+        if (m_trackEntries) {
+            // only the counter has to be reset.
+            cmd->fill(buffers.touchedEntries, 0, 0, sizeof(host::glsl::uint));
+            cmd->barrier(vk::PipelineStageFlagBits::eTransfer,
+                         vk::PipelineStageFlagBits::eComputeShader,
+                         {buffers.splitFlags->buffer_barrier(vk::AccessFlagBits::eTransferWrite,
+                                                             vk::AccessFlagBits::eShaderRead |
+                                                                 vk::AccessFlagBits::eShaderWrite),
+                          buffers.touchedEntries->buffer_barrier(
+                              vk::AccessFlagBits::eTransferWrite,
+                              vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)});
+        } else {
+            cmd->barrier(vk::PipelineStageFlagBits::eTransfer,
+                         vk::PipelineStageFlagBits::eComputeShader,
+                         buffers.splitFlags->buffer_barrier(vk::AccessFlagBits::eTransferWrite,
+                                                            vk::AccessFlagBits::eShaderRead |
+                                                                vk::AccessFlagBits::eShaderWrite));
+        }
+
+        cmd->bind(m_pipeline);
+        if (m_trackEntries) {
+            cmd->push_descriptor_set(m_pipeline,               //
+                                     buffers.weights,          //
+                                     buffers.partitionIndices, //
+                                     buffers.partitionPrefix,  //
+                                     buffers.heavyCount,       //
+                                     buffers.mean,             //
+                                     buffers.aliasTable,       //
+                                     buffers.changedIndices,   //
+                                     buffers.splitFlags,       //
+                                     buffers.touchedEntries);
+        } else {
+            cmd->push_descriptor_set(m_pipeline,               //
+                                     buffers.weights,          //
+                                     buffers.partitionIndices, //
+                                     buffers.partitionPrefix,  //
+                                     buffers.heavyCount,       //
+                                     buffers.mean,             //
+                                     buffers.aliasTable,       //
+                                     buffers.changedIndices,   //
+                                     buffers.splitFlags);
+        }
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
+                                                          .K = N / m_splitSize,
+                                                          .N = N,
+                                                          .changedCount = changedCount,
+                                                      });
+        const host::glsl::uint workgroupCount =
+            (changedCount + m_workgroupSize - 1) / m_workgroupSize;
+        cmd->dispatch(workgroupCount, 1, 1);
+    }
+
+    host::glsl::uint splitSize() const {
+        return m_splitSize;
+    }
+
+    bool tracksEntries() const {
+        return m_trackEntries;
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+    host::glsl::uint m_workgroupSize;
+    host::glsl::uint m_splitSize;
+    bool m_trackEntries;
+};
+
+} // namespace device
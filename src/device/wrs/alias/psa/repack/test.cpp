@@ -0,0 +1,323 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/wrs/WRS.hpp"
+#include "src/device/wrs/alias/psa/layout/alias_table.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include "src/host/memory/FallbackResource.hpp"
+#include "src/host/memory/SafeResource.hpp"
+#include "src/host/memory/StackResource.hpp"
+#include "src/host/types/quantized_alias_table.hpp"
+#include <cmath>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <random>
+#include <span>
+#include <spdlog/spdlog.h>
+
+namespace device::test::split_repack {
+
+using Buffers = WRS::Buffers;
+using Config = WRS::Config;
+using Entry = host::AliasTableEntry<host::glsl::f32, host::glsl::uint>;
+
+struct TestCase {
+    Config config;
+    host::glsl::uint N;
+    host::Distribution distribution;
+    // weight changes per update, the updates accumulate until the tracker requests a build.
+    host::glsl::uint changedCount;
+    uint32_t iterations;
+};
+
+static constexpr AliasTableUpdateConfig UPDATE_CONFIG{};
+
+static constexpr TestCase TEST_CASES[] = {
+    TestCase{
+        .config = AliasTableConfig(PSAConfig(AtomicMeanConfig(),
+                                             DecoupledPrefixPartitionConfig(),
+                                             InlineSplitPackConfig(32),
+                                             false),
+                                   SampleAliasTableConfig(128),
+                                   UPDATE_CONFIG),
+        .N = static_cast<host::glsl::uint>(1e5),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .changedCount = 64,
+        .iterations = 16,
+    },
+    TestCase{
+        .config = AliasTableConfig(PSAConfig(AtomicMeanConfig(),
+                                             DecoupledPrefixPartitionConfig(),
+                                             InlineSplitPackConfig(32),
+                                             false),
+                                   SampleAliasTableConfig(128),
+                                   UPDATE_CONFIG,
+                                   AliasTableQuantizeConfig()),
+        .N = static_cast<host::glsl::uint>(1e5) + 17,
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .changedCount = 512,
+        .iterations = 16,
+    },
+};
+
+static double mean(std::span<const float> weights) {
+    double total = 0;
+    for (const float w : weights) {
+        total += w;
+    }
+    return total / static_cast<double>(weights.size());
+}
+
+/// Total variation distance between the distributions sampled from two alias tables.
+static double totalVariation(std::span<const Entry> a, std::span<const Entry> b) {
+    const std::vector<double> p = host::aliasTableDistribution(a);
+    const std::vector<double> q = host::aliasTableDistribution(b);
+    double distance = 0;
+    for (std::size_t i = 0; i < p.size(); ++i) {
+        distance += 0.5 * std::abs(p[i] - q[i]);
+    }
+    return distance;
+}
+
+static void downloadToStage(const merian::CommandBufferHandle& cmd,
+                            const Buffers& buffers,
+                            const merian::BufferHandle& aliasTableStage,
+                            const merian::BufferHandle& quantizedStage,
+                            host::glsl::uint N) {
+    const auto& internals = std::get<AliasTable::Buffers>(buffers.m_internals);
+    AliasTable::Buffers::AliasTableView localView{internals.m_aliasTable, N};
+    AliasTable::Buffers::AliasTableView stageView{aliasTableStage, N};
+    localView.expectComputeWrite();
+    localView.copyTo(cmd, stageView);
+    stageView.expectHostRead(cmd);
+    if (quantizedStage != nullptr) {
+        AliasTableQuantize::Buffers::QuantizedTableView localQuantizedView{
+            internals.m_quantizeBuffers.quantizedTable, N};
+        AliasTableQuantize::Buffers::QuantizedTableView stageQuantizedView{quantizedStage, N};
+        localQuantizedView.expectComputeWrite();
+        localQuantizedView.copyTo(cmd, stageQuantizedView);
+        stageQuantizedView.expectHostRead(cmd);
+    }
+}
+
+static bool runTestCase(const host::test::TestContext& context,
+                        const TestCase& testCase,
+                        std::pmr::memory_resource* resource) {
+    const host::glsl::uint N = testCase.N;
+    const auto& aliasConfig = std::get<AliasTable::Config>(testCase.config);
+    const bool quantized = aliasConfig.quantizeConfig.has_value();
+    std::string testName = fmt::format("{{{},N={},changed={}}}", wrsConfigName(testCase.config), N,
+                                       testCase.changedCount);
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    // updated incrementally and rebuilt from scratch with the same weights.
+    Buffers buffers =
+        Buffers::allocate(context.alloc, merian::MemoryMappingType::NONE, N, 1, testCase.config);
+    Buffers reference =
+        Buffers::allocate(context.alloc, merian::MemoryMappingType::NONE, N, 1, testCase.config);
+    Buffers stage = Buffers::allocate(context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+                                      N, 1, testCase.config);
+    const merian::BufferHandle aliasTableStage = details::allocateAliasTableBuffer(
+        context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+        vk::BufferUsageFlagBits::eTransferDst, N);
+    const merian::BufferHandle referenceStage = details::allocateAliasTableBuffer(
+        context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+        vk::BufferUsageFlagBits::eTransferDst, N);
+    const merian::BufferHandle quantizedStage =
+        quantized ? context.alloc->createBuffer(
+                        AliasTableQuantize::Buffers::QuantizedTableLayout::size(N),
+                        vk::BufferUsageFlagBits::eTransferDst,
+                        merian::MemoryMappingType::HOST_ACCESS_RANDOM)
+                  : nullptr;
+
+    WRS wrs{context.context, context.shaderCompiler, testCase.config};
+
+    std::mt19937 rng{std::random_device{}()};
+    std::uniform_int_distribution<host::glsl::uint> indexDist{0, N - 1};
+
+    // 1. Initial full build
+    auto weights = host::pmr::generate_weights<float>(testCase.distribution, N, resource);
+    {
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        Buffers::WeightsView stageView{stage.weights, N};
+        Buffers::WeightsView localView{buffers.weights, N};
+        stageView.upload<float>(weights);
+        stageView.copyTo(cmd, localView);
+        localView.expectComputeRead(cmd);
+        wrs.build(cmd, buffers, N, context.profiler);
+        cmd->end();
+        context.queue->submit_wait(cmd);
+    }
+    AliasTableUpdateTracker tracker{weights};
+    double buildMean = mean(weights);
+
+    bool failed = false;
+    uint32_t repackCount = 0;
+    for (size_t it = 0; it < testCase.iterations; ++it) {
+        MERIAN_PROFILE_SCOPE(context.profiler, testName);
+        context.queue->wait_idle();
+
+        // 2. Generate changes, which keep the heavy/light class of the last build,
+        // such that only the drift bound decides about a full build.
+        context.profiler->start("Generate test input");
+        std::uniform_real_distribution<double> heavyDist{buildMean * 1.01, buildMean * 2.0};
+        std::uniform_real_distribution<double> lightDist{0.0, buildMean * 0.99};
+        std::vector<AliasTableWeightChange> changes(testCase.changedCount);
+        for (auto& change : changes) {
+            change.index = indexDist(rng);
+            const bool heavy = tracker.weights()[change.index] > buildMean;
+            change.weight = static_cast<float>(heavy ? heavyDist(rng) : lightDist(rng));
+            weights[change.index] = change.weight;
+        }
+        context.profiler->end();
+
+        // 3. Begin recoding
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        std::string recordingLabel = fmt::format("Recording : {}", testName);
+        context.profiler->start(recordingLabel);
+        context.profiler->cmd_start(cmd, recordingLabel);
+
+        // 4. Upload the new weights into both
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Upload test case");
+            Buffers::WeightsView stageView{stage.weights, N};
+            stageView.upload<float>(weights);
+            for (const Buffers* target : {&buffers, &reference}) {
+                Buffers::WeightsView localView{target->weights, N};
+                stageView.copyTo(cmd, localView);
+                localView.expectComputeRead(cmd);
+            }
+        }
+
+        // 5. Update and rebuild
+        bool rebuilt;
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Update");
+            // two batches in one command buffer, the second must not overwrite the indices
+            // of the first. Only the last one decides about the bound, the drift accumulates
+            // since the last full build.
+            const std::span<const AliasTableWeightChange> batches = changes;
+            const std::size_t firstBatch = batches.size() / 2;
+            wrs.update(cmd, buffers, N, batches.first(firstBatch), tracker, context.profiler);
+            rebuilt = wrs.update(cmd, buffers, N, batches.subspan(firstBatch), tracker,
+                                 context.profiler);
+        }
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Reference build");
+            wrs.build(cmd, reference, N, context.profiler);
+        }
+
+        // 6. Download results to stage
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Download results to stage");
+            downloadToStage(cmd, buffers, aliasTableStage, quantizedStage, N);
+            downloadToStage(cmd, reference, referenceStage, nullptr, N);
+        }
+
+        // 7. Submit to device
+        context.profiler->end();
+        context.profiler->cmd_end(cmd);
+        cmd->end();
+        context.queue->submit_wait(cmd);
+
+        // 8. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            const auto table = details::downloadAliasTableFromBuffer(aliasTableStage, N, resource);
+            const auto referenceTable =
+                details::downloadAliasTableFromBuffer(referenceStage, N, resource);
+
+            // a repack deviates by at most the drift (see AliasTableUpdateConfig::maxDrift),
+            // a full build only by float rounding.
+            const double bound = (rebuilt ? 0.0 : tracker.drift()) + 1e-4;
+            const double distance = totalVariation(table, referenceTable);
+            SPDLOG_DEBUG("rebuilt={}, drift={}, total variation={}", rebuilt, tracker.drift(),
+                         distance);
+            if (!rebuilt && tracker.drift() > UPDATE_CONFIG.maxDrift) {
+                SPDLOG_ERROR("Accepted a drift of {}, which exceeds the bound {}",
+                             tracker.drift(), UPDATE_CONFIG.maxDrift);
+                failed = true;
+            }
+            if (distance > bound) {
+                SPDLOG_ERROR("Updated table differs from a full build by {} (bound {})", distance,
+                             bound);
+                failed = true;
+            }
+
+            // the touched entries have to be quantized again, all others are unchanged.
+            if (quantized) {
+                const host::AliasTableQuantization quantization =
+                    host::AliasTableQuantization::select(N,
+                                                         aliasConfig.quantizeConfig
+                                                             ->minProbabilityBits);
+                const auto packed =
+                    AliasTableQuantize::Buffers::QuantizedTableView{quantizedStage, N}
+                        .download<host::glsl::uint, host::pmr_alloc<host::glsl::uint>>(
+                            resource);
+                const std::vector<host::glsl::uint> expected =
+                    host::packAliasTable(table, quantization);
+                const host::glsl::uint aliasMask = (1u << quantization.aliasBits) - 1;
+                std::size_t mismatches = 0;
+                for (host::glsl::uint i = 0; i < N; ++i) {
+                    const host::glsl::uint q = packed[i] >> quantization.aliasBits;
+                    const host::glsl::uint e = expected[i] >> quantization.aliasBits;
+                    // float rounding on the device may differ by one step from the host.
+                    mismatches += (packed[i] & aliasMask) != (expected[i] & aliasMask) ||
+                                  (q > e ? q - e : e - q) > 1;
+                }
+                if (mismatches != 0) {
+                    SPDLOG_ERROR("Quantized table is stale in {} entries", mismatches);
+                    failed = true;
+                }
+            }
+        }
+
+        if (rebuilt) {
+            buildMean = mean(weights);
+        } else {
+            repackCount++;
+        }
+        context.profiler->collect(true, true);
+    }
+    SPDLOG_INFO("Repacked {} out of {} updates", repackCount, testCase.iterations);
+    if (repackCount == 0) {
+        SPDLOG_ERROR("{} never repacked splits", testName);
+        failed = true;
+    }
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing split repack of alias tables");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    host::memory::StackResource stackResource{4096 * 2048};
+    host::memory::FallbackResource fallbackResource{&stackResource};
+    host::memory::SafeResource safeResource{&fallbackResource};
+
+    std::pmr::memory_resource* resource = &safeResource;
+
+    uint32_t failCount = 0;
+    for (const auto& testCase : TEST_CASES) {
+        if (runTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+
+    testContext.profiler->collect(true, true);
+    SPDLOG_INFO(fmt::format("Profiler results: \n{}",
+                            merian::Profiler::get_report_str(testContext.profiler->get_report())));
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
+                                 sizeof(TEST_CASES) / sizeof(TestCase)));
+    }
+}
+
+} // namespace device::test::split_repack
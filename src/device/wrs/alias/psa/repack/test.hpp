@@ -0,0 +1,9 @@
+#pragma once
+
+#include "merian/vk/context.hpp"
+
+namespace device::test::split_repack {
+
+void test(const merian::ContextHandle& context);
+
+}
@@ -9,6 +9,7 @@
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/types/glsl.hpp"
+#include "src/host/types/kernel_cost.hpp"
 #include "vulkan/vulkan_enums.hpp"
 #include <fmt/format.h>
 #include <stdexcept>
@@ -163,6 +164,14 @@ class Split {
         }
     }
 
+    host::KernelCost cost(host::glsl::uint N) const {
+        if (std::holds_alternative<ScalarSplit>(m_method)) {
+            return std::get<ScalarSplit>(m_method).cost(N);
+        } else {
+            throw std::runtime_error("NOT-IMPLEMENTED");
+        }
+    }
+
   private:
     Method m_method;
 };
@@ -11,12 +11,16 @@
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/device/wrs/alias/psa/layout/split.hpp"
 #include "src/device/wrs/alias/psa/split/SplitAllocFlags.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/types/glsl.hpp"
+#include "src/host/types/kernel_cost.hpp"
 #include "vulkan/vulkan_enums.hpp"
+#include <bit>
 #include <fmt/base.h>
 #include <memory>
 #include <stdexcept>
@@ -105,42 +109,23 @@ class ScalarSplit {
                 const merian::ShaderCompilerHandle& shaderCompiler,
                 Config config)
         : m_workgroupSize(config.workgroupSize), m_splitSize(config.splitSize) {
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // partition prefix sums
-                .add_binding_storage_buffer() // partition heavy
-                .add_binding_storage_buffer() // mean
-                .add_binding_storage_buffer() // splits
-                .build_push_descriptor_layout(context);
-
         std::string shaderPath = "src/device/wrs/alias/psa/split/scalar/shader.comp";
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<std::tuple<uint32_t, uint32_t>>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(m_workgroupSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addStorageBuffer() // partition prefix sums
+                         .addStorageBuffer() // partition heavy
+                         .addStorageBuffer() // mean
+                         .addStorageBuffer() // splits
+                         .addPushConstant<std::tuple<uint32_t, uint32_t>>()
+                         .addSpecializationConstant(m_workgroupSize)
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd,
              const ScalarSplitBuffers& buffers,
              uint32_t N,
              std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->start("ScalarSplit");
-            profiler.value()->cmd_start(cmd, "ScalarSplit");
-        }
-#endif
+        WRS_PROFILE_SCOPE(profiler, cmd, "ScalarSplit");
 
         const host::glsl::uint K = (N + m_splitSize - 1) / m_splitSize;
         cmd->bind(m_pipeline);
@@ -156,19 +141,25 @@ class ScalarSplit {
                                                       });
         const host::glsl::uint workgroupCount = (K - 1 + m_workgroupSize - 1) / m_workgroupSize;
         cmd->dispatch(workgroupCount, 1, 1);
-
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
-        }
-#endif
     }
 
     inline host::glsl::uint splitSize() const {
         return m_splitSize;
     }
 
+    /// K - 1 binary searches over the partition prefix, two reads per step.
+    host::KernelCost cost(host::glsl::uint N) const {
+        using Buffers = ScalarSplitBuffers;
+        const std::size_t K = (N + m_splitSize - 1) / m_splitSize;
+        const std::size_t steps = std::bit_width(N);
+        return host::KernelCost{
+            .bytesRead = (K - 1) * (2 * steps + 2) * sizeof(Buffers::weight_type) +
+                         Buffers::HeavyCountLayout::size() + Buffers::MeanLayout::size(),
+            .bytesWritten = Buffers::SplitsLayout::size(K),
+            .operations = (K - 1) * steps,
+        };
+    }
+
   private:
     merian::PipelineHandle m_pipeline;
     std::vector<vk::WriteDescriptorSet> m_writes;
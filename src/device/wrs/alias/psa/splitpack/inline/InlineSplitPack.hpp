@@ -9,6 +9,8 @@
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/host/types/glsl.hpp"
 #include <fmt/base.h>
 #include <fmt/format.h>
@@ -61,20 +63,6 @@ class InlineSplitPack {
         : m_workgroupSize(config.workgroupSize), m_splitSize(config.splitSize),
           m_usePartitionElements(usePartitionElements) {
 
-        auto setBuilder = merian::DescriptorSetLayoutBuilder()
-                              .add_binding_storage_buffer()  // weights
-                              .add_binding_storage_buffer()  // partition indices
-                              .add_binding_storage_buffer()  // partition prefix
-                              .add_binding_storage_buffer()  // heavy count
-                              .add_binding_storage_buffer()  // mean
-                              .add_binding_storage_buffer(); // alias table
-
-        if (m_usePartitionElements) {
-            setBuilder.add_binding_storage_buffer(); // partition elements
-        }
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            setBuilder.build_push_descriptor_layout(context);
-
         const std::string shaderPath =
             "src/device/wrs/alias/psa/splitpack/inline/shader.comp";
 
@@ -83,35 +71,32 @@ class InlineSplitPack {
             defines["USE_PARTITION_ELEMENTS"];
         }
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute, {}, defines);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(m_workgroupSize);
-        specInfoBuilder.add_entry(
-            context->physical_device.physical_device_subgroup_properties.subgroupSize);
-        specInfoBuilder.add_entry(m_splitSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+
+        pipeline::ComputePipelineBuilder pipelineBuilder(context, shaderCompiler, shaderPath);
+        pipelineBuilder.setDefines(defines)
+            .addStorageBuffer()  // weights
+            .addStorageBuffer()  // partition indices
+            .addStorageBuffer()  // partition prefix
+            .addStorageBuffer()  // heavy count
+            .addStorageBuffer()  // mean
+            .addStorageBuffer(); // alias table
+        if (m_usePartitionElements) {
+            pipelineBuilder.addStorageBuffer(); // partition elements
+        }
+        m_pipeline = pipelineBuilder.addPushConstant<PushConstants>()
+                         .addSpecializationConstant(m_workgroupSize)
+                         .addSpecializationConstant(subgroupSize)
+                         .addSpecializationConstant(m_splitSize)
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle cmd,
              const Buffers& buffers,
              host::glsl::uint N,
              std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->start("Inline-SplitPack");
-            profiler.value()->cmd_start(cmd, "Inline-SplitPack");
-        }
-#endif
+        WRS_PROFILE_SCOPE(profiler, cmd, "Inline-SplitPack");
 
         host::glsl::uint K = N / m_splitSize;
 
@@ -141,13 +126,6 @@ class InlineSplitPack {
         const host::glsl::uint splitsPerDispatch = m_workgroupSize - 1;
         const host::glsl::uint workgroupCount = (K + splitsPerDispatch - 1) / splitsPerDispatch;
         cmd->dispatch(workgroupCount, 1, 1);
-
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
-        }
-#endif
     }
 
   private:
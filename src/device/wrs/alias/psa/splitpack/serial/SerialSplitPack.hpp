@@ -3,6 +3,7 @@
 #include "merian/vk/command/command_buffer.hpp"
 #include "merian/vk/memory/resource_allocations.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
 #include "src/device/wrs/alias/psa/pack/Pack.hpp"
 #include "src/device/wrs/alias/psa/split/Split.hpp"
 #include "vulkan/vulkan_enums.hpp"
@@ -53,12 +54,7 @@ class SerialSplitPack {
              const Buffers& buffers,
              host::glsl::uint N,
              std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->start("Serial-SplitPack");
-            profiler.value()->cmd_start(cmd, "Serial-SplitPack");
-        }
-#endif
+        WRS_PROFILE_SCOPE(profiler, cmd, "Serial-SplitPack");
 
         Split::Buffers splitBuffers;
         splitBuffers.partitionPrefix = buffers.partitionPrefix;
@@ -81,13 +77,6 @@ class SerialSplitPack {
         packBuffers.aliasTable = buffers.aliasTable;
         packBuffers.weights = buffers.weights;
         m_pack.run(cmd, packBuffers, N, profiler);
-
-#ifdef MERIAN_PROFILER_ENABLE
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
-        }
-#endif
     }
 
   private:
@@ -0,0 +1,200 @@
+#pragma once
+/**
+ * @filename    : AliasTableQuantize.hpp
+ *
+ * Converts the float alias table written by the PSA into one of the
+ * quantized formats of host::AliasTableQuantization (4 instead of 8 bytes per entry).
+ * Runs as a separate pass after packing, such that all pack variants stay untouched.
+ * After a split repack only the touched entries are converted (see runTouched).
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include "src/host/types/quantized_alias_table.hpp"
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+struct AliasTableQuantizeConfig {
+    const host::glsl::uint workgroupSize;
+    // fewer remaining bits for the probability select the SPLIT16 format.
+    const host::glsl::uint minProbabilityBits;
+
+    constexpr AliasTableQuantizeConfig() : workgroupSize(512), minProbabilityBits(8) {}
+    constexpr explicit AliasTableQuantizeConfig(host::glsl::uint workgroupSize,
+                                                host::glsl::uint minProbabilityBits)
+        : workgroupSize(workgroupSize), minProbabilityBits(minProbabilityBits) {}
+};
+
+struct AliasTableQuantizeBuffers {
+    using Self = AliasTableQuantizeBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle aliasTable;
+
+    // PACKED entries or the aliases of SPLIT16.
+    merian::BufferHandle quantizedTable;
+    using QuantizedTableLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using QuantizedTableView = host::layout::BufferView<QuantizedTableLayout>;
+
+    // only SPLIT16, two unorm16 per uint.
+    merian::BufferHandle probabilities;
+    using ProbabilitiesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using ProbabilitiesView = host::layout::BufferView<ProbabilitiesLayout>;
+
+    /// Allocates the quantized buffers for at most N entries, the alias table belongs to the PSA.
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         merian::MemoryMappingType memoryMapping,
+                         AliasTableQuantizeConfig config,
+                         host::glsl::uint N) {
+        Self buffers;
+        const vk::BufferUsageFlags usage =
+            memoryMapping == merian::MemoryMappingType::NONE
+                ? vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc
+                : vk::BufferUsageFlags{vk::BufferUsageFlagBits::eTransferDst};
+        buffers.quantizedTable = alloc->createBuffer(QuantizedTableLayout::size(N), usage,
+                                                     memoryMapping, "quantized-alias-table");
+        if (host::AliasTableQuantization::select(N, config.minProbabilityBits).format ==
+            host::AliasTableFormat::SPLIT16) {
+            buffers.probabilities = alloc->createBuffer(ProbabilitiesLayout::size((N + 1) / 2),
+                                                        usage, memoryMapping,
+                                                        "quantized-alias-probabilities");
+        }
+        return buffers;
+    }
+};
+
+class AliasTableQuantize {
+    struct PushConstants {
+        host::glsl::uint N;
+        host::glsl::uint aliasBits;
+        host::glsl::uint probabilityBits;
+    };
+
+  public:
+    using Buffers = AliasTableQuantizeBuffers;
+    using Config = AliasTableQuantizeConfig;
+
+    explicit AliasTableQuantize(const merian::ContextHandle& context,
+                                const merian::ShaderCompilerHandle& shaderCompiler,
+                                Config config = {},
+                                bool touched = false)
+        : m_workgroupSize(config.workgroupSize), m_minProbabilityBits(config.minProbabilityBits) {
+        m_packedPipeline = createPipeline(context, shaderCompiler, false, false);
+        m_splitPipeline = createPipeline(context, shaderCompiler, true, false);
+        if (touched) {
+            m_touchedPackedPipeline = createPipeline(context, shaderCompiler, false, true);
+            m_touchedSplitPipeline = createPipeline(context, shaderCompiler, true, true);
+        }
+    }
+
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N) const {
+        const host::AliasTableQuantization quantization = this->quantization(N);
+        const merian::PipelineHandle& pipeline =
+            quantization.format == host::AliasTableFormat::PACKED ? m_packedPipeline
+                                                                  : m_splitPipeline;
+        cmd->bind(pipeline);
+        if (quantization.format == host::AliasTableFormat::PACKED) {
+            cmd->push_descriptor_set(pipeline, buffers.aliasTable, buffers.quantizedTable);
+        } else {
+            cmd->push_descriptor_set(pipeline, buffers.aliasTable, buffers.probabilities,
+                                     buffers.quantizedTable);
+        }
+        cmd->push_constant<PushConstants>(
+            pipeline, PushConstants{
+                          .N = N,
+                          .aliasBits = quantization.aliasBits,
+                          .probabilityBits = quantization.probabilityBits,
+                      });
+        // every invocation converts two entries.
+        const host::glsl::uint pairCount = (N + 1) / 2;
+        cmd->dispatch((pairCount + m_workgroupSize - 1) / m_workgroupSize, 1, 1);
+    }
+
+    /**
+     * Converts only the entries listed in touchedEntries (see SplitRepack::Buffers), which
+     * must be visible to compute shaders. maxTouchedCount bounds the listed entries,
+     * the dispatch is sized for it instead of N.
+     * Requires that the quantize was constructed with touched = true.
+     */
+    void runTouched(const merian::CommandBufferHandle& cmd,
+                    const Buffers& buffers,
+                    const merian::BufferHandle& touchedEntries,
+                    host::glsl::uint N,
+                    host::glsl::uint maxTouchedCount) const {
+        if (m_touchedPackedPipeline == nullptr) {
+            throw std::runtime_error("AliasTableQuantize was not constructed for touched entries");
+        }
+        const host::AliasTableQuantization quantization = this->quantization(N);
+        const merian::PipelineHandle& pipeline =
+            quantization.format == host::AliasTableFormat::PACKED ? m_touchedPackedPipeline
+                                                                  : m_touchedSplitPipeline;
+        cmd->bind(pipeline);
+        if (quantization.format == host::AliasTableFormat::PACKED) {
+            cmd->push_descriptor_set(pipeline, buffers.aliasTable, buffers.quantizedTable,
+                                     touchedEntries);
+        } else {
+            cmd->push_descriptor_set(pipeline, buffers.aliasTable, buffers.probabilities,
+                                     buffers.quantizedTable, touchedEntries);
+        }
+        cmd->push_constant<PushConstants>(
+            pipeline, PushConstants{
+                          .N = N,
+                          .aliasBits = quantization.aliasBits,
+                          .probabilityBits = quantization.probabilityBits,
+                      });
+        cmd->dispatch((maxTouchedCount + m_workgroupSize - 1) / m_workgroupSize, 1, 1);
+    }
+
+    host::AliasTableQuantization quantization(host::glsl::uint N) const {
+        return host::AliasTableQuantization::select(N, m_minProbabilityBits);
+    }
+
+  private:
+    merian::PipelineHandle createPipeline(const merian::ContextHandle& context,
+                                          const merian::ShaderCompilerHandle& shaderCompiler,
+                                          bool split16,
+                                          bool touched) const {
+        const std::string shaderPath = "src/device/wrs/alias/quantize/shader.comp";
+        std::map<std::string, std::string> defines;
+        if (split16) {
+            defines["SPLIT16"];
+        }
+        if (touched) {
+            defines["TOUCHED"];
+        }
+        pipeline::ComputePipelineBuilder builder(context, shaderCompiler, shaderPath);
+        builder.setDefines(defines).addStorageBuffer(); // alias table
+        if (split16) {
+            builder.addStorageBuffer()  // probabilities
+                .addStorageBuffer();    // aliases
+        } else {
+            builder.addStorageBuffer(); // packed table
+        }
+        if (touched) {
+            builder.addStorageBuffer(); // touched entries
+        }
+        return builder.addPushConstant<PushConstants>()
+            .addSpecializationConstant(m_workgroupSize)
+            .build();
+    }
+
+    merian::PipelineHandle m_packedPipeline;
+    merian::PipelineHandle m_splitPipeline;
+    merian::PipelineHandle m_touchedPackedPipeline;
+    merian::PipelineHandle m_touchedSplitPipeline;
+    host::glsl::uint m_workgroupSize;
+    host::glsl::uint m_minProbabilityBits;
+};
+
+} // namespace device
@@ -8,8 +8,16 @@
 #include "merian/vk/pipeline/specialization_info.hpp"
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/host/types/glsl.hpp"
+#include "src/host/types/quantized_alias_table.hpp"
+#include "src/host/types/rng.hpp"
+#include "src/host/types/sample_index.hpp"
+#include <fmt/format.h>
+#include <map>
 #include <memory>
+#include <optional>
+#include <stdexcept>
 #include <vulkan/vulkan_handles.hpp>
 
 #include "merian/vk/memory/resource_allocations.hpp"
@@ -20,16 +28,26 @@ struct SampleAliasTableBuffers {
     using Self = SampleAliasTableBuffers;
 
     merian::BufferHandle aliasTable;
-    merian::BufferHandle samples;
+    merian::BufferHandle samples; // packed for narrow sample indices (see sample_index.hpp)
+
+    // only bound for quantized tables (see AliasTableQuantize.hpp).
+    merian::BufferHandle quantizedTable = nullptr;
+    merian::BufferHandle probabilities = nullptr;
 };
 
 struct SampleAliasTableConfig {
     const host::glsl::uint cooperativeSampleSize;
     const host::glsl::uint workgroupSize;
-
-    constexpr explicit SampleAliasTableConfig(host::glsl::uint cooperativeSampleSize,
-                                              host::glsl::uint workgroupSize = 512)
-        : cooperativeSampleSize(cooperativeSampleSize), workgroupSize(workgroupSize) {}
+    const host::SampleIndexWidth sampleIndexWidth;
+    const host::RNGAlgorithm rng;
+
+    constexpr explicit SampleAliasTableConfig(
+        host::glsl::uint cooperativeSampleSize,
+        host::glsl::uint workgroupSize = 512,
+        host::SampleIndexWidth sampleIndexWidth = host::SampleIndexWidth::U32,
+        host::RNGAlgorithm rng = host::RNGAlgorithm::PHILOX)
+        : cooperativeSampleSize(cooperativeSampleSize), workgroupSize(workgroupSize),
+          sampleIndexWidth(sampleIndexWidth), rng(rng) {}
 };
 
 class SampleAliasTable {
@@ -37,56 +55,193 @@ class SampleAliasTable {
         host::glsl::uint N;
         host::glsl::uint S;
         host::glsl::uint seed;
+        host::glsl::uint aliasBits;
+        host::glsl::uint probabilityBits;
+        host::glsl::uint dimension;
+        host::glsl::uint sequenceOffset;
     };
 
   public:
     using Buffers = SampleAliasTableBuffers;
     using Config = SampleAliasTableConfig;
 
+    /// With sampleParametersBuffer, S and the seed are read from a buffer
+    /// (see the run overloads with parameters).
     explicit SampleAliasTable(const merian::ContextHandle& context,
                               const merian::ShaderCompilerHandle& shaderCompiler,
-                              const SampleAliasTableConfig& config)
-        : m_workgroupSize(config.workgroupSize) {
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // alias table
-                .add_binding_storage_buffer() // samples
-                .build_push_descriptor_layout(context);
+                              const SampleAliasTableConfig& config,
+                              bool quantized = false,
+                              bool sampleParametersBuffer = false)
+        : m_workgroupSize(config.workgroupSize), m_sampleIndexWidth(config.sampleIndexWidth),
+          m_sampleParametersBuffer(sampleParametersBuffer) {
 
         const std::string shaderPath = "src/device/wrs/alias/sampling/shader.comp";
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(m_workgroupSize);
-        specInfoBuilder.add_entry(config.cooperativeSampleSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
+        std::map<std::string, std::string> defines;
+        if (const auto define = host::sampleIndexDefine(m_sampleIndexWidth)) {
+            defines[*define];
+        }
+        if (m_sampleParametersBuffer) {
+            defines["SAMPLE_PARAMETERS_BUFFER"];
+        }
+        const host::glsl::uint rng = host::rngSpecializationConstant(config.rng);
+
+        // the sample parameters are bound after all other buffers.
+        const auto build = [&](pipeline::ComputePipelineBuilder& builder) {
+            if (m_sampleParametersBuffer) {
+                builder.addStorageBuffer(); // sample parameters
+            }
+            return builder.addPushConstant<PushConstants>()
+                .addSpecializationConstant(m_workgroupSize)
+                .addSpecializationConstant(config.cooperativeSampleSize)
+                .addSpecializationConstant(rng)
+                .build();
+        };
+
+        if (!quantized) {
+            pipeline::ComputePipelineBuilder builder(context, shaderCompiler, shaderPath);
+            builder.addIncludePath("src/device/common/")
+                .setDefines(defines)
+                .addStorageBuffer()  // alias table
+                .addStorageBuffer(); // samples
+            m_pipeline = build(builder);
+            return;
+        }
+
+        std::map<std::string, std::string> packedDefines = defines;
+        packedDefines["PACKED"];
+        pipeline::ComputePipelineBuilder packedBuilder(context, shaderCompiler, shaderPath);
+        packedBuilder.addIncludePath("src/device/common/")
+            .setDefines(packedDefines)
+            .addStorageBuffer()  // packed table
+            .addStorageBuffer(); // samples
+        m_packedPipeline = build(packedBuilder);
+
+        std::map<std::string, std::string> splitDefines = defines;
+        splitDefines["SPLIT16"];
+        pipeline::ComputePipelineBuilder splitBuilder(context, shaderCompiler, shaderPath);
+        splitBuilder.addIncludePath("src/device/common/")
+            .setDefines(splitDefines)
+            .addStorageBuffer()  // probabilities
+            .addStorageBuffer()  // samples
+            .addStorageBuffer(); // aliases
+        m_splitPipeline = build(splitBuilder);
+    }
 
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint S,
+             host::glsl::uint seed = 12345u,
+             const host::SampleSequence& sequence = {}) const {
+        checkParameterSource(false);
+        record(cmd, buffers, N, S, seed, std::nullopt, sequence, nullptr);
     }
 
+    /// Samples from the quantized table, requires a kernel created with quantized = true.
     void run(const merian::CommandBufferHandle& cmd,
              const Buffers& buffers,
              host::glsl::uint N,
              host::glsl::uint S,
-             host::glsl::uint seed = 12345u) const {
-        cmd->bind(m_pipeline);
-        cmd->push_descriptor_set(m_pipeline, buffers.aliasTable, buffers.samples);
-        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{.N = N, .S = S, .seed = seed});
+             host::glsl::uint seed,
+             const host::AliasTableQuantization& quantization,
+             const host::SampleSequence& sequence = {}) const {
+        checkParameterSource(false);
+        record(cmd, buffers, N, S, seed, quantization, sequence, nullptr);
+    }
+
+    /**
+     * Reads the sample count and the seed from parameters (see sample_parameters.comp),
+     * such that they can change between submits of the recorded commands.
+     * Dispatched for maxS samples, requires a kernel created with sampleParametersBuffer.
+     */
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint maxS,
+             const merian::BufferHandle& parameters,
+             const std::optional<host::AliasTableQuantization>& quantization = std::nullopt,
+             const host::SampleSequence& sequence = {}) const {
+        checkParameterSource(true);
+        record(cmd, buffers, N, maxS, 0, quantization, sequence, parameters);
+    }
+
+  private:
+    void checkParameterSource(bool fromBuffer) const {
+        if (fromBuffer != m_sampleParametersBuffer) {
+            throw std::runtime_error(
+                m_sampleParametersBuffer
+                    ? "SampleAliasTable: the kernel reads S and seed from a buffer"
+                    : "SampleAliasTable: the kernel reads S and seed from push constants");
+        }
+    }
+
+    // S is the dispatched sample count, S and seed are ignored if the kernel reads them
+    // from the parameters.
+    void record(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint S,
+                host::glsl::uint seed,
+                const std::optional<host::AliasTableQuantization>& quantization,
+                const host::SampleSequence& sequence,
+                const merian::BufferHandle& parameters) const {
+        if (!host::sampleIndexWidthFits(N, m_sampleIndexWidth)) {
+            throw std::runtime_error(
+                fmt::format("SampleAliasTable: N = {} exceeds the {} sample indices", N,
+                            host::sampleIndexWidthName(m_sampleIndexWidth)));
+        }
+
+        const merian::PipelineHandle* pipeline = &m_pipeline;
+        if (quantization.has_value()) {
+            pipeline = quantization->format == host::AliasTableFormat::PACKED ? &m_packedPipeline
+                                                                              : &m_splitPipeline;
+        }
+        cmd->bind(*pipeline);
+        if (!quantization.has_value()) {
+            if (m_sampleParametersBuffer) {
+                cmd->push_descriptor_set(*pipeline, buffers.aliasTable, buffers.samples,
+                                         parameters);
+            } else {
+                cmd->push_descriptor_set(*pipeline, buffers.aliasTable, buffers.samples);
+            }
+        } else if (quantization->format == host::AliasTableFormat::PACKED) {
+            if (m_sampleParametersBuffer) {
+                cmd->push_descriptor_set(*pipeline, buffers.quantizedTable, buffers.samples,
+                                         parameters);
+            } else {
+                cmd->push_descriptor_set(*pipeline, buffers.quantizedTable, buffers.samples);
+            }
+        } else {
+            if (m_sampleParametersBuffer) {
+                cmd->push_descriptor_set(*pipeline, buffers.probabilities, buffers.samples,
+                                         buffers.quantizedTable, parameters);
+            } else {
+                cmd->push_descriptor_set(*pipeline, buffers.probabilities, buffers.samples,
+                                         buffers.quantizedTable);
+            }
+        }
+        cmd->push_constant<PushConstants>(
+            *pipeline, PushConstants{
+                           .N = N,
+                           .S = S,
+                           .seed = seed,
+                           .aliasBits = quantization.has_value() ? quantization->aliasBits : 0,
+                           .probabilityBits =
+                               quantization.has_value() ? quantization->probabilityBits : 0,
+                           .dimension = sequence.dimension,
+                           .sequenceOffset = sequence.offset,
+                       });
         const uint32_t workgroupCount = (S + m_workgroupSize - 1) / m_workgroupSize;
         cmd->dispatch(workgroupCount, 1, 1);
     }
 
-  private:
     merian::PipelineHandle m_pipeline;
+    merian::PipelineHandle m_packedPipeline;
+    merian::PipelineHandle m_splitPipeline;
     host::glsl::uint m_workgroupSize;
+    host::SampleIndexWidth m_sampleIndexWidth;
+    bool m_sampleParametersBuffer;
 };
 
 } // namespace device
@@ -0,0 +1,209 @@
+#pragma once
+/**
+ * @filename    : BatchedITS.hpp
+ *
+ * Batched Inverse Transform Sampling over many independent distributions.
+ *
+ * The weights of all B distributions are concatenated into a single buffer,
+ * distribution (segment) b spans [segmentOffsets[b], segmentOffsets[b+1]).
+ * build() computes the CMFs of all segments with a single segmented scan and
+ * sample() serves R requests of the form (segment, count) with two dispatches,
+ * instead of one build and one sample dispatch per distribution.
+ *
+ * The samples of request r are written to
+ * [requestOffsets[r] - requestCounts[r], requestOffsets[r]) and
+ * are relative to the begin of the requested segment.
+ *
+ * Out of scope: only the CMF (ITS) method is batched. A batched alias table requires a
+ * segmented mean, partition and split for PSA, the build of a single alias table over
+ * a segment can be done with WRS on a sub range of the weights in the meantime.
+ */
+
+#include "merian/vk/memory/memory_allocator.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ThreadPool.hpp"
+#include "src/device/wrs/batched/request_offsets/RequestOffsets.hpp"
+#include "src/device/wrs/batched/sampling/BatchedSampling.hpp"
+#include "src/device/wrs/batched/segmented_cmf/SegmentedCMF.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
+#include <fmt/format.h>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vulkan/vulkan_handles.hpp>
+
+#include "merian/vk/memory/resource_allocator.hpp"
+
+namespace device {
+
+class BatchedITSConfig {
+  public:
+    SegmentedCMFConfig cmfConfig;
+    RequestOffsetsConfig requestOffsetsConfig;
+    BatchedSamplingConfig samplingConfig;
+
+    constexpr BatchedITSConfig() : cmfConfig{}, requestOffsetsConfig{}, samplingConfig{} {}
+    explicit constexpr BatchedITSConfig(SegmentedCMFConfig cmfConfig,
+                                        BatchedSamplingConfig samplingConfig)
+        : cmfConfig(cmfConfig), requestOffsetsConfig{}, samplingConfig(samplingConfig) {}
+
+    std::string name() const {
+        return fmt::format("BatchedITS-{}-{}-{}-{}", cmfConfig.prefixSumConfig.workgroupSize,
+                           cmfConfig.prefixSumConfig.rows, samplingConfig.workgroupSize,
+                           host::rngAlgorithmName(samplingConfig.rng));
+    }
+};
+
+struct BatchedITSBuffers {
+    using Self = BatchedITSBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle segmentOffsets; // B + 1 entries
+    using SegmentOffsetsLayout = SegmentedCMFBuffers::SegmentOffsetsLayout;
+    using SegmentOffsetsView = SegmentedCMFBuffers::SegmentOffsetsView;
+
+    merian::BufferHandle weights;
+    using WeightsLayout = SegmentedCMFBuffers::WeightsLayout;
+    using WeightsView = SegmentedCMFBuffers::WeightsView;
+
+    merian::BufferHandle requestSegments;
+    using RequestSegmentsLayout = BatchedSamplingBuffers::RequestSegmentsLayout;
+    using RequestSegmentsView = BatchedSamplingBuffers::RequestSegmentsView;
+
+    merian::BufferHandle requestCounts;
+    using RequestCountsLayout = RequestOffsetsBuffers::RequestCountsLayout;
+    using RequestCountsView = RequestOffsetsBuffers::RequestCountsView;
+
+    merian::BufferHandle samples;
+    using SamplesLayout = BatchedSamplingBuffers::SamplesLayout;
+    using SamplesView = BatchedSamplingBuffers::SamplesView;
+
+    SegmentedCMFBuffers m_cmfBuffers;
+    RequestOffsetsBuffers m_requestOffsetsBuffers;
+    BatchedSamplingBuffers m_samplingBuffers;
+
+    /// N: total weight count, B: segment count, R: request count, S: total sample count.
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         merian::MemoryMappingType memoryMapping,
+                         std::size_t N,
+                         std::size_t B,
+                         std::size_t R,
+                         std::size_t S,
+                         const BatchedITSConfig& config = {}) {
+        Self buffers;
+        buffers.m_cmfBuffers = SegmentedCMFBuffers::allocate(alloc, memoryMapping, N, B,
+                                                             config.cmfConfig.partitionSize());
+        buffers.m_requestOffsetsBuffers =
+            RequestOffsetsBuffers::allocate(alloc, memoryMapping, R);
+        if (memoryMapping == merian::MemoryMappingType::NONE) {
+            buffers.requestSegments = alloc->createBuffer(RequestSegmentsLayout::size(R),
+                                                          vk::BufferUsageFlagBits::eStorageBuffer |
+                                                              vk::BufferUsageFlagBits::eTransferDst,
+                                                          memoryMapping);
+            buffers.samples = alloc->createBuffer(SamplesLayout::size(S),
+                                                  vk::BufferUsageFlagBits::eStorageBuffer |
+                                                      vk::BufferUsageFlagBits::eTransferSrc,
+                                                  memoryMapping);
+        } else {
+            buffers.requestSegments =
+                alloc->createBuffer(RequestSegmentsLayout::size(R),
+                                    vk::BufferUsageFlagBits::eTransferSrc, memoryMapping);
+            buffers.samples = alloc->createBuffer(
+                SamplesLayout::size(S), vk::BufferUsageFlagBits::eTransferDst, memoryMapping);
+        }
+
+        buffers.segmentOffsets = buffers.m_cmfBuffers.segmentOffsets;
+        buffers.weights = buffers.m_cmfBuffers.weights;
+        buffers.requestCounts = buffers.m_requestOffsetsBuffers.requestCounts;
+
+        buffers.m_samplingBuffers.segmentOffsets = buffers.segmentOffsets;
+        buffers.m_samplingBuffers.cmf = buffers.m_cmfBuffers.cmf;
+        buffers.m_samplingBuffers.requestSegments = buffers.requestSegments;
+        buffers.m_samplingBuffers.requestOffsets = buffers.m_requestOffsetsBuffers.requestOffsets;
+        buffers.m_samplingBuffers.samples = buffers.samples;
+        return buffers;
+    }
+};
+
+class BatchedITS {
+  public:
+    using Buffers = BatchedITSBuffers;
+    using Config = BatchedITSConfig;
+
+    explicit BatchedITS(const merian::ContextHandle& context,
+                        const merian::ShaderCompilerHandle& shaderCompiler,
+                        BatchedITSConfig config = {})
+        : BatchedITS(pipeline::parallel(
+              [&]() { return SegmentedCMF(context, shaderCompiler, config.cmfConfig); },
+              [&]() {
+                  return RequestOffsets(context, shaderCompiler, config.requestOffsetsConfig);
+              },
+              [&]() { return BatchedSampling(context, shaderCompiler, config.samplingConfig); })) {
+    }
+
+    /// N: total weight count (segmentOffsets[B]), B: segment count.
+    void build(const merian::CommandBufferHandle& cmd,
+               const Buffers& buffers,
+               host::glsl::uint N,
+               host::glsl::uint B,
+               std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        SegmentedCMFBuffers cmfBuffers = buffers.m_cmfBuffers;
+        cmfBuffers.segmentOffsets = buffers.segmentOffsets;
+        cmfBuffers.weights = buffers.weights;
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "Segmented CMF");
+            m_cmfKernel.run(cmd, cmfBuffers, N, B);
+        }
+
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     cmfBuffers.cmf->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                    vk::AccessFlagBits::eShaderRead));
+    }
+
+    /// S has to be the sum of all request counts (or an upper bound of it).
+    void sample(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint R,
+                host::glsl::uint S,
+                host::glsl::uint seed = 12345u,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        RequestOffsetsBuffers requestOffsetsBuffers = buffers.m_requestOffsetsBuffers;
+        requestOffsetsBuffers.requestCounts = buffers.requestCounts;
+        BatchedSamplingBuffers samplingBuffers = buffers.m_samplingBuffers;
+        samplingBuffers.segmentOffsets = buffers.segmentOffsets;
+        samplingBuffers.requestSegments = buffers.requestSegments;
+        samplingBuffers.samples = buffers.samples;
+
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "Request offsets");
+            m_requestOffsetsKernel.run(cmd, requestOffsetsBuffers, R);
+        }
+
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     requestOffsetsBuffers.requestOffsets->buffer_barrier(
+                         vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead));
+
+        WRS_PROFILE_SCOPE(profiler, cmd, "Sampling");
+        m_samplingKernel.run(cmd, samplingBuffers, R, S, seed);
+    }
+
+  private:
+    using Kernels = std::tuple<SegmentedCMF, RequestOffsets, BatchedSampling>;
+
+    explicit BatchedITS(Kernels&& kernels)
+        : m_cmfKernel(std::move(std::get<0>(kernels))),
+          m_requestOffsetsKernel(std::move(std::get<1>(kernels))),
+          m_samplingKernel(std::move(std::get<2>(kernels))) {}
+
+    SegmentedCMF m_cmfKernel;
+    RequestOffsets m_requestOffsetsKernel;
+    BatchedSampling m_samplingKernel;
+};
+
+} // namespace device
@@ -0,0 +1,82 @@
+#pragma once
+/**
+ * @filename    : HeadFlags.hpp
+ *
+ * Converts the segment offsets of a batched WRS into the packed head flags
+ * of the SegmentedPrefixSum, bit (i % 32) of headFlags[i / 32] marks weight i
+ * as the first weight of a segment.
+ */
+
+#include "merian/vk/pipeline/pipeline.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/host/types/glsl.hpp"
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+struct HeadFlagsBuffers {
+    merian::BufferHandle segmentOffsets; // B + 1 entries
+    merian::BufferHandle headFlags;      // (N + 31) / 32 words
+};
+
+class HeadFlagsConfig {
+  public:
+    host::glsl::uint workgroupSize;
+
+    constexpr HeadFlagsConfig() : workgroupSize(512) {}
+    explicit constexpr HeadFlagsConfig(host::glsl::uint workgroupSize)
+        : workgroupSize(workgroupSize) {}
+};
+
+class HeadFlags {
+    struct PushConstants {
+        host::glsl::uint N; // weight count
+        host::glsl::uint B; // segment count
+    };
+
+  public:
+    using Buffers = HeadFlagsBuffers;
+    using Config = HeadFlagsConfig;
+
+    explicit HeadFlags(const merian::ContextHandle& context,
+                       const merian::ShaderCompilerHandle& shaderCompiler,
+                       HeadFlagsConfig config = {})
+        : m_workgroupSize(config.workgroupSize) {
+        const std::string shaderPath = "src/device/wrs/batched/head_flags/shader.comp";
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addStorageBuffer() // segmentOffsets
+                         .addStorageBuffer() // headFlags
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(m_workgroupSize)
+                         .build();
+    }
+
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint B) const {
+        cmd->fill(buffers.headFlags, 0);
+        cmd->barrier(vk::PipelineStageFlagBits::eTransfer,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     buffers.headFlags->buffer_barrier(vk::AccessFlagBits::eTransferWrite,
+                                                       vk::AccessFlagBits::eShaderRead |
+                                                           vk::AccessFlagBits::eShaderWrite));
+        if (B == 0) {
+            return;
+        }
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.segmentOffsets, buffers.headFlags);
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{.N = N, .B = B});
+        const uint32_t workgroupCount = (B + m_workgroupSize - 1) / m_workgroupSize;
+        cmd->dispatch(workgroupCount, 1, 1);
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+    host::glsl::uint m_workgroupSize;
+};
+
+} // namespace device
@@ -0,0 +1,108 @@
+#pragma once
+/**
+ * @filename    : RequestOffsets.hpp
+ *
+ * Inclusive scan over the sample counts of all sampling requests
+ * of a batched WRS, which assigns every request its range in the sample buffer.
+ * Runs as a single workgroup, the request count is expected to be small.
+ */
+
+#include "merian/vk/memory/memory_allocator.hpp"
+#include "merian/vk/pipeline/pipeline.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+#include "merian/vk/memory/resource_allocator.hpp"
+
+namespace device {
+
+struct RequestOffsetsBuffers {
+    using Self = RequestOffsetsBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle requestCounts;
+    using RequestCountsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using RequestCountsView = host::layout::BufferView<RequestCountsLayout>;
+
+    merian::BufferHandle requestOffsets;
+    using RequestOffsetsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using RequestOffsetsView = host::layout::BufferView<RequestOffsetsLayout>;
+
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         merian::MemoryMappingType memoryMapping,
+                         std::size_t R) {
+        Self buffers;
+        if (memoryMapping == merian::MemoryMappingType::NONE) {
+            buffers.requestCounts = alloc->createBuffer(RequestCountsLayout::size(R),
+                                                        vk::BufferUsageFlagBits::eStorageBuffer |
+                                                            vk::BufferUsageFlagBits::eTransferDst,
+                                                        memoryMapping);
+            buffers.requestOffsets = alloc->createBuffer(RequestOffsetsLayout::size(R),
+                                                         vk::BufferUsageFlagBits::eStorageBuffer |
+                                                             vk::BufferUsageFlagBits::eTransferSrc,
+                                                         memoryMapping);
+        } else {
+            buffers.requestCounts = alloc->createBuffer(
+                RequestCountsLayout::size(R), vk::BufferUsageFlagBits::eTransferSrc, memoryMapping);
+            buffers.requestOffsets =
+                alloc->createBuffer(RequestOffsetsLayout::size(R),
+                                    vk::BufferUsageFlagBits::eTransferDst, memoryMapping);
+        }
+        return buffers;
+    }
+};
+
+class RequestOffsetsConfig {
+  public:
+    host::glsl::uint workgroupSize;
+
+    constexpr RequestOffsetsConfig() : workgroupSize(512) {}
+    explicit constexpr RequestOffsetsConfig(host::glsl::uint workgroupSize)
+        : workgroupSize(workgroupSize) {}
+};
+
+class RequestOffsets {
+    struct PushConstants {
+        host::glsl::uint R; // request count
+    };
+
+  public:
+    using Buffers = RequestOffsetsBuffers;
+    using Config = RequestOffsetsConfig;
+
+    explicit RequestOffsets(const merian::ContextHandle& context,
+                            const merian::ShaderCompilerHandle& shaderCompiler,
+                            RequestOffsetsConfig config = {}) {
+        const std::string shaderPath = "src/device/wrs/batched/request_offsets/shader.comp";
+
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addStorageBuffer() // requestCounts
+                         .addStorageBuffer() // requestOffsets
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(subgroupSize)
+                         .build();
+    }
+
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint R) const {
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.requestCounts, buffers.requestOffsets);
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{.R = R});
+        cmd->dispatch(1, 1, 1);
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+};
+
+} // namespace device
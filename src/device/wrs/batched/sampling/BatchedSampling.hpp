@@ -0,0 +1,155 @@
+#pragma once
+/**
+ * @filename    : BatchedSampling.hpp
+ *
+ * Sampling step of the batched ITS method.
+ * Every invocation generates one sample, it first locates its request
+ * with a binary search over the request offsets and then performs the
+ * inverse transform within the CMF of the requested segment.
+ *
+ * Samples are written as indices relative to the begin of their segment,
+ * requests of empty segments produce 0xFFFFFFFF.
+ * The uniforms come from the shared generators of rng.comp (see BatchedSamplingConfig::rng),
+ * low-discrepancy sources are stratified per request.
+ */
+
+#include "merian/vk/memory/memory_allocator.hpp"
+#include "merian/vk/pipeline/pipeline.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+#include "merian/vk/memory/resource_allocator.hpp"
+
+namespace device {
+
+struct BatchedSamplingBuffers {
+    using Self = BatchedSamplingBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle segmentOffsets; // B + 1 entries
+    using SegmentOffsetsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using SegmentOffsetsView = host::layout::BufferView<SegmentOffsetsLayout>;
+
+    merian::BufferHandle cmf;
+    using CMFLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using CMFView = host::layout::BufferView<CMFLayout>;
+
+    merian::BufferHandle requestSegments;
+    using RequestSegmentsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using RequestSegmentsView = host::layout::BufferView<RequestSegmentsLayout>;
+
+    merian::BufferHandle requestOffsets; // inclusive scan of the request counts
+    using RequestOffsetsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using RequestOffsetsView = host::layout::BufferView<RequestOffsetsLayout>;
+
+    merian::BufferHandle samples;
+    using SamplesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using SamplesView = host::layout::BufferView<SamplesLayout>;
+
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         merian::MemoryMappingType memoryMapping,
+                         std::size_t N,
+                         std::size_t B,
+                         std::size_t R,
+                         std::size_t S) {
+        Self buffers;
+        if (memoryMapping == merian::MemoryMappingType::NONE) {
+            const vk::BufferUsageFlags inputUsage =
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+            buffers.segmentOffsets =
+                alloc->createBuffer(SegmentOffsetsLayout::size(B + 1), inputUsage, memoryMapping);
+            buffers.cmf = alloc->createBuffer(CMFLayout::size(N), inputUsage, memoryMapping);
+            buffers.requestSegments =
+                alloc->createBuffer(RequestSegmentsLayout::size(R), inputUsage, memoryMapping);
+            buffers.requestOffsets =
+                alloc->createBuffer(RequestOffsetsLayout::size(R), inputUsage, memoryMapping);
+            buffers.samples = alloc->createBuffer(SamplesLayout::size(S),
+                                                  vk::BufferUsageFlagBits::eStorageBuffer |
+                                                      vk::BufferUsageFlagBits::eTransferSrc,
+                                                  memoryMapping);
+        } else {
+            const vk::BufferUsageFlags inputUsage = vk::BufferUsageFlagBits::eTransferSrc;
+            buffers.segmentOffsets =
+                alloc->createBuffer(SegmentOffsetsLayout::size(B + 1), inputUsage, memoryMapping);
+            buffers.cmf = alloc->createBuffer(CMFLayout::size(N), inputUsage, memoryMapping);
+            buffers.requestSegments =
+                alloc->createBuffer(RequestSegmentsLayout::size(R), inputUsage, memoryMapping);
+            buffers.requestOffsets =
+                alloc->createBuffer(RequestOffsetsLayout::size(R), inputUsage, memoryMapping);
+            buffers.samples = alloc->createBuffer(
+                SamplesLayout::size(S), vk::BufferUsageFlagBits::eTransferDst, memoryMapping);
+        }
+        return buffers;
+    }
+};
+
+class BatchedSamplingConfig {
+  public:
+    host::glsl::uint workgroupSize;
+    host::RNGAlgorithm rng;
+
+    constexpr BatchedSamplingConfig() : workgroupSize(512), rng(host::RNGAlgorithm::HASH) {}
+    explicit constexpr BatchedSamplingConfig(host::glsl::uint workgroupSize,
+                                             host::RNGAlgorithm rng = host::RNGAlgorithm::HASH)
+        : workgroupSize(workgroupSize), rng(rng) {}
+};
+
+class BatchedSampling {
+    struct PushConstants {
+        host::glsl::uint R; // request count
+        host::glsl::uint S; // total sample count
+        host::glsl::uint seed;
+    };
+
+  public:
+    using Buffers = BatchedSamplingBuffers;
+    using Config = BatchedSamplingConfig;
+
+    explicit BatchedSampling(const merian::ContextHandle& context,
+                             const merian::ShaderCompilerHandle& shaderCompiler,
+                             BatchedSamplingConfig config = {})
+        : m_workgroupSize(config.workgroupSize) {
+        const std::string shaderPath = "src/device/wrs/batched/sampling/shader.comp";
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addIncludePath("src/device/common/")
+                         .addStorageBuffer() // segmentOffsets
+                         .addStorageBuffer() // cmf
+                         .addStorageBuffer() // requestSegments
+                         .addStorageBuffer() // requestOffsets
+                         .addStorageBuffer() // samples
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(m_workgroupSize)
+                         .addSpecializationConstant(host::rngSpecializationConstant(config.rng))
+                         .build();
+    }
+
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint R,
+             host::glsl::uint S,
+             host::glsl::uint seed = 12345u) const {
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.segmentOffsets, buffers.cmf,
+                                 buffers.requestSegments, buffers.requestOffsets, buffers.samples);
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
+                                                          .R = R,
+                                                          .S = S,
+                                                          .seed = seed,
+                                                      });
+        const uint32_t workgroupCount = (S + m_workgroupSize - 1) / m_workgroupSize;
+        cmd->dispatch(workgroupCount, 1, 1);
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+    host::glsl::uint m_workgroupSize;
+};
+
+} // namespace device
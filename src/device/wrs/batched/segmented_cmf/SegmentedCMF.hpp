@@ -0,0 +1,141 @@
+#pragma once
+/**
+ * @filename    : SegmentedCMF.hpp
+ *
+ * Computes the (not normalized) cummulative mass functions of many
+ * independent distributions, which are stored back to back in a single weight buffer.
+ * Segment b spans the weights [segmentOffsets[b], segmentOffsets[b+1]).
+ *
+ * The segment offsets are converted into head flags (see HeadFlags.hpp), afterwards
+ * a single SegmentedPrefixSum scans all segments at once. Segments of any length are
+ * spread over all workgroups, therefore a few large segments do not serialize the
+ * build, while many small segments are a lot cheaper than one prefix sum per distribution.
+ */
+
+#include "merian/vk/memory/memory_allocator.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/prefix_sum/segmented/SegmentedPrefixSum.hpp"
+#include "src/device/wrs/batched/head_flags/HeadFlags.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+#include "merian/vk/memory/resource_allocator.hpp"
+
+namespace device {
+
+struct SegmentedCMFBuffers {
+    using Self = SegmentedCMFBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle segmentOffsets; // B + 1 entries
+    using SegmentOffsetsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using SegmentOffsetsView = host::layout::BufferView<SegmentOffsetsLayout>;
+
+    merian::BufferHandle weights;
+    using WeightsLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using WeightsView = host::layout::BufferView<WeightsLayout>;
+
+    merian::BufferHandle cmf;
+    using CMFLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using CMFView = host::layout::BufferView<CMFLayout>;
+
+    SegmentedPrefixSumBuffers m_prefixSumBuffers; // headFlags + decoupledStates
+
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         merian::MemoryMappingType memoryMapping,
+                         std::size_t N,
+                         std::size_t B,
+                         std::size_t partitionSize) {
+        Self buffers;
+        buffers.m_prefixSumBuffers = SegmentedPrefixSumBuffers::allocate(
+            alloc, memoryMapping, N, partitionSize, PrefixSumAllocFlags::ALLOC_NONE);
+        if (memoryMapping == merian::MemoryMappingType::NONE) {
+            buffers.segmentOffsets = alloc->createBuffer(SegmentOffsetsLayout::size(B + 1),
+                                                         vk::BufferUsageFlagBits::eStorageBuffer |
+                                                             vk::BufferUsageFlagBits::eTransferDst,
+                                                         memoryMapping);
+            buffers.weights = alloc->createBuffer(WeightsLayout::size(N),
+                                                  vk::BufferUsageFlagBits::eStorageBuffer |
+                                                      vk::BufferUsageFlagBits::eTransferDst,
+                                                  memoryMapping);
+            buffers.cmf = alloc->createBuffer(CMFLayout::size(N),
+                                              vk::BufferUsageFlagBits::eStorageBuffer |
+                                                  vk::BufferUsageFlagBits::eTransferSrc,
+                                              memoryMapping);
+        } else {
+            buffers.segmentOffsets =
+                alloc->createBuffer(SegmentOffsetsLayout::size(B + 1),
+                                    vk::BufferUsageFlagBits::eTransferSrc, memoryMapping);
+            buffers.weights = alloc->createBuffer(
+                WeightsLayout::size(N), vk::BufferUsageFlagBits::eTransferSrc, memoryMapping);
+            buffers.cmf = alloc->createBuffer(CMFLayout::size(N),
+                                              vk::BufferUsageFlagBits::eTransferDst, memoryMapping);
+        }
+        return buffers;
+    }
+};
+
+class SegmentedCMFConfig {
+  public:
+    HeadFlagsConfig headFlagsConfig;
+    DecoupledPrefixSumConfig prefixSumConfig;
+
+    constexpr SegmentedCMFConfig() : headFlagsConfig{}, prefixSumConfig{} {}
+    explicit constexpr SegmentedCMFConfig(DecoupledPrefixSumConfig prefixSumConfig)
+        : headFlagsConfig{}, prefixSumConfig(prefixSumConfig) {}
+    explicit constexpr SegmentedCMFConfig(host::glsl::uint workgroupSize, host::glsl::uint rows)
+        : headFlagsConfig{}, prefixSumConfig(workgroupSize, rows) {}
+
+    inline constexpr host::glsl::uint partitionSize() const {
+        return prefixSumConfig.partitionSize();
+    }
+};
+
+class SegmentedCMF {
+  public:
+    using Buffers = SegmentedCMFBuffers;
+    using Config = SegmentedCMFConfig;
+
+    explicit SegmentedCMF(const merian::ContextHandle& context,
+                          const merian::ShaderCompilerHandle& shaderCompiler,
+                          SegmentedCMFConfig config = {})
+        : m_headFlags(context, shaderCompiler, config.headFlagsConfig),
+          m_prefixSum(context, shaderCompiler, config.prefixSumConfig) {}
+
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint B) const {
+        if (N == 0) {
+            return;
+        }
+        const HeadFlags::Buffers headFlagsBuffers{
+            .segmentOffsets = buffers.segmentOffsets,
+            .headFlags = buffers.m_prefixSumBuffers.headFlags,
+        };
+        m_headFlags.run(cmd, headFlagsBuffers, N, B);
+
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     headFlagsBuffers.headFlags->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                                vk::AccessFlagBits::eShaderRead));
+
+        SegmentedPrefixSum::Buffers prefixSumBuffers = buffers.m_prefixSumBuffers;
+        prefixSumBuffers.elements = buffers.weights;
+        prefixSumBuffers.prefixSum = buffers.cmf;
+        m_prefixSum.run(cmd, prefixSumBuffers, N);
+    }
+
+    inline host::glsl::uint getPartitionSize() const {
+        return m_prefixSum.getPartitionSize();
+    }
+
+  private:
+    HeadFlags m_headFlags;
+    SegmentedPrefixSum m_prefixSum;
+};
+
+} // namespace device
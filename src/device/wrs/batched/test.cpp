@@ -0,0 +1,274 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/prefix_sum/block_scan/BlockScanVariant.hpp"
+#include "src/device/wrs/batched/BatchedITS.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include "src/host/memory/FallbackResource.hpp"
+#include "src/host/memory/SafeResource.hpp"
+#include "src/host/memory/StackResource.hpp"
+#include "src/host/statistics/js_divergence.hpp"
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <random>
+#include <spdlog/spdlog.h>
+
+namespace device::test::batched_wrs {
+
+using Algorithm = BatchedITS;
+using Buffers = Algorithm::Buffers;
+using Config = Algorithm::Config;
+
+struct TestCase {
+    Config config;
+    host::glsl::uint B;           // segment count
+    host::glsl::uint maxSegmentSize;
+    host::Distribution distribution;
+    host::glsl::uint R;           // request count
+    host::glsl::uint maxRequestSize;
+    uint32_t iterations;
+};
+
+static constexpr TestCase TEST_CASES[] = {
+    TestCase{
+        .config = {},
+        .B = 1024,
+        .maxSegmentSize = 4096,
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .R = 4096,
+        .maxRequestSize = 2048,
+        .iterations = 2,
+    },
+    TestCase{
+        .config = BatchedITSConfig(SegmentedCMFConfig(512, 8),
+                                   BatchedSamplingConfig(256, host::RNGAlgorithm::PHILOX)),
+        .B = 16,
+        .maxSegmentSize = static_cast<host::glsl::uint>(1e6),
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .R = 16,
+        .maxRequestSize = static_cast<host::glsl::uint>(1e6),
+        .iterations = 2,
+    },
+    // few segments, which are a lot larger than a partition, next to tiny ones.
+    TestCase{
+        .config = BatchedITSConfig(
+            SegmentedCMFConfig(DecoupledPrefixSumConfig(256, 4, BlockScanVariant::RAKING)),
+            BatchedSamplingConfig(512, host::RNGAlgorithm::SOBOL)),
+        .B = 8,
+        .maxSegmentSize = static_cast<host::glsl::uint>(4e6),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .R = 64,
+        .maxRequestSize = 4096,
+        .iterations = 2,
+    },
+};
+
+struct Batch {
+    std::pmr::vector<host::glsl::uint> segmentOffsets;
+    std::pmr::vector<float> weights;
+    std::pmr::vector<host::glsl::uint> requestSegments;
+    std::pmr::vector<host::glsl::uint> requestCounts;
+    host::glsl::uint S;
+};
+
+static Batch generateBatch(const TestCase& testCase, std::pmr::memory_resource* resource) {
+    std::mt19937 rng{std::random_device{}()};
+    Batch batch{
+        .segmentOffsets = std::pmr::vector<host::glsl::uint>{resource},
+        .weights = std::pmr::vector<float>{resource},
+        .requestSegments = std::pmr::vector<host::glsl::uint>{resource},
+        .requestCounts = std::pmr::vector<host::glsl::uint>{resource},
+        .S = 0,
+    };
+
+    // segment 0 is always empty to cover the edge case.
+    std::uniform_int_distribution<host::glsl::uint> segmentSizeDist{1, testCase.maxSegmentSize};
+    batch.segmentOffsets.push_back(0);
+    batch.segmentOffsets.push_back(0);
+    for (host::glsl::uint b = 1; b < testCase.B; ++b) {
+        const host::glsl::uint size = segmentSizeDist(rng);
+        const auto weights = host::generate_weights<float>(testCase.distribution, size);
+        batch.weights.insert(batch.weights.end(), weights.begin(), weights.end());
+        batch.segmentOffsets.push_back(batch.weights.size());
+    }
+
+    std::uniform_int_distribution<host::glsl::uint> segmentDist{1, testCase.B - 1};
+    std::uniform_int_distribution<host::glsl::uint> requestSizeDist{0, testCase.maxRequestSize};
+    for (host::glsl::uint r = 0; r < testCase.R; ++r) {
+        batch.requestSegments.push_back(segmentDist(rng));
+        batch.requestCounts.push_back(requestSizeDist(rng));
+        batch.S += batch.requestCounts.back();
+    }
+    return batch;
+}
+
+template <typename View, typename T>
+static void uploadArray(const merian::CommandBufferHandle& cmd,
+                        const merian::BufferHandle& local,
+                        const merian::BufferHandle& stage,
+                        std::span<const T> elements) {
+    View stageView{stage, elements.size()};
+    View localView{local, elements.size()};
+    stageView.template upload<T>(elements);
+    stageView.copyTo(cmd, localView);
+    localView.expectComputeRead(cmd);
+}
+
+static void uploadTestCase(const merian::CommandBufferHandle& cmd,
+                           const Buffers& buffers,
+                           const Buffers& stage,
+                           const Batch& batch) {
+    uploadArray<Buffers::SegmentOffsetsView, host::glsl::uint>(
+        cmd, buffers.segmentOffsets, stage.segmentOffsets, batch.segmentOffsets);
+    uploadArray<Buffers::WeightsView, float>(cmd, buffers.weights, stage.weights, batch.weights);
+    uploadArray<Buffers::RequestSegmentsView, host::glsl::uint>(
+        cmd, buffers.requestSegments, stage.requestSegments, batch.requestSegments);
+    uploadArray<Buffers::RequestCountsView, host::glsl::uint>(
+        cmd, buffers.requestCounts, stage.requestCounts, batch.requestCounts);
+}
+
+static bool runTestCase(const host::test::TestContext& context,
+                        const TestCase& testCase,
+                        std::pmr::memory_resource* resource) {
+    std::string testName = fmt::format("{{{},B={},R={}}}", testCase.config.name(), testCase.B,
+                                       testCase.R);
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    Algorithm kernel{context.context, context.shaderCompiler, testCase.config};
+
+    bool failed = false;
+    for (size_t it = 0; it < testCase.iterations; ++it) {
+        MERIAN_PROFILE_SCOPE(context.profiler, testName);
+        context.queue->wait_idle();
+
+        // 1. Generate input
+        context.profiler->start("Generate test input");
+        const Batch batch = generateBatch(testCase, resource);
+        const std::size_t N = batch.weights.size();
+        context.profiler->end();
+
+        Buffers buffers = Buffers::allocate(context.alloc, merian::MemoryMappingType::NONE, N,
+                                            testCase.B, testCase.R, batch.S, testCase.config);
+        Buffers stage =
+            Buffers::allocate(context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM, N,
+                              testCase.B, testCase.R, batch.S, testCase.config);
+
+        // 2. Begin recoding
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        std::string recordingLabel = fmt::format("Recording : {}", testName);
+        context.profiler->start(recordingLabel);
+        context.profiler->cmd_start(cmd, recordingLabel);
+
+        // 3. Upload test case
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Upload test case");
+            uploadTestCase(cmd, buffers, stage, batch);
+        }
+
+        // 4. Run test case
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Build batched ITS");
+            kernel.build(cmd, buffers, N, testCase.B, context.profiler);
+        }
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Sample batched ITS");
+            std::uniform_int_distribution<host::glsl::uint> dist{};
+            std::random_device rng;
+            kernel.sample(cmd, buffers, testCase.R, batch.S, dist(rng), context.profiler);
+        }
+
+        // 5. Download results to stage
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Download results to stage");
+            Buffers::SamplesView localView{buffers.samples, batch.S};
+            Buffers::SamplesView stageView{stage.samples, batch.S};
+            localView.expectComputeWrite();
+            localView.copyTo(cmd, stageView);
+            stageView.expectHostRead(cmd);
+        }
+
+        // 6. Submit to device
+        context.profiler->end();
+        context.profiler->cmd_end(cmd);
+        cmd->end();
+        context.queue->submit_wait(cmd);
+
+        // 7. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            const auto samples =
+                Buffers::SamplesView{stage.samples, batch.S}
+                    .download<host::glsl::uint, host::pmr_alloc<host::glsl::uint>>(resource);
+
+            float averageJSDivergence = 0;
+            host::glsl::uint requestBegin = 0;
+            for (host::glsl::uint r = 0; r < testCase.R; ++r) {
+                const host::glsl::uint b = batch.requestSegments[r];
+                const host::glsl::uint count = batch.requestCounts[r];
+                const std::span<const float> segmentWeights{
+                    batch.weights.begin() + batch.segmentOffsets[b],
+                    batch.weights.begin() + batch.segmentOffsets[b + 1]};
+                const std::span<const host::glsl::uint> requestSamples{
+                    samples.begin() + requestBegin, samples.begin() + requestBegin + count};
+                requestBegin += count;
+
+                for (host::glsl::uint s : requestSamples) {
+                    if (s >= segmentWeights.size()) {
+                        SPDLOG_ERROR("Request {} sampled {}, which is out of bounds of segment "
+                                     "{} with size {}",
+                                     r, s, b, segmentWeights.size());
+                        failed = true;
+                        break;
+                    }
+                }
+                if (count != 0 && !failed) {
+                    averageJSDivergence +=
+                        host::js_divergence<host::glsl::uint, float>(requestSamples,
+                                                                     segmentWeights);
+                }
+            }
+            averageJSDivergence /= testCase.R;
+            SPDLOG_INFO("Average JS-Divergence: {}", averageJSDivergence);
+            if (averageJSDivergence > 0.05) {
+                SPDLOG_ERROR("{} displays a significant bias", testCase.config.name());
+                failed = true;
+            }
+        }
+        context.profiler->collect(true, true);
+    }
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing batched WRS");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    host::memory::StackResource stackResource{4096 * 2048};
+    host::memory::FallbackResource fallbackResource{&stackResource};
+    host::memory::SafeResource safeResource{&fallbackResource};
+
+    std::pmr::memory_resource* resource = &safeResource;
+
+    uint32_t failCount = 0;
+    for (const auto& testCase : TEST_CASES) {
+        if (runTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+
+    testContext.profiler->collect(true, true);
+    SPDLOG_INFO(fmt::format("Profiler results: \n{}",
+                            merian::Profiler::get_report_str(testContext.profiler->get_report())));
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
+                                 sizeof(TEST_CASES) / sizeof(TestCase)));
+    }
+}
+
+} // namespace device::test::batched_wrs
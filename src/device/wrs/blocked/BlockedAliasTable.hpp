@@ -0,0 +1,264 @@
+#pragma once
+/**
+ * @filename    : BlockedAliasTable.hpp
+ *
+ * Two-level, cache-blocked alias table.
+ * The weights are split into blocks of blockSize elements, every block has its own
+ * alias table and a small top-level alias table (built with the PSA) selects the block.
+ *
+ * Sampling a flat alias table reads one random entry of the whole table per sample,
+ * which is bound by the latency of uncached global memory for large N.
+ * Here the samples are distributed over the blocks first and afterwards every workgroup
+ * loads the table of one block into shared memory and draws all of its samples from it.
+ * The top-level table (N / blockSize entries) stays in the L2 cache and
+ * the per-block tables are only read linearly.
+ *
+ * The samples are grouped by block (the order of the blocks is unspecified).
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/memory/resource_allocator.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ThreadPool.hpp"
+#include "src/device/wrs/alias/psa/PSA.hpp"
+#include "src/device/wrs/alias/psa/layout/alias_table.hpp"
+#include "src/device/wrs/blocked/construction/BlockedAliasTableConstruction.hpp"
+#include "src/device/wrs/blocked/count/BlockSampleCount.hpp"
+#include "src/device/wrs/blocked/sampling/BlockedAliasTableSampling.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/layout/PrimitiveLayout.hpp"
+#include "src/host/types/glsl.hpp"
+#include <fmt/format.h>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+struct BlockedAliasTableConfig {
+    const PSA::Config topLevelConfig;
+    // elements per block, the table of a block has to fit into shared memory.
+    const host::glsl::uint blockSize;
+    const BlockedAliasTableConstructionConfig constructionConfig;
+    const BlockSampleCountConfig countConfig;
+    const BlockedAliasTableSamplingConfig samplingConfig;
+
+    constexpr explicit BlockedAliasTableConfig(
+        PSA::Config topLevelConfig,
+        host::glsl::uint blockSize = 1024,
+        BlockedAliasTableConstructionConfig constructionConfig = {},
+        BlockSampleCountConfig countConfig = {},
+        BlockedAliasTableSamplingConfig samplingConfig = {})
+        : topLevelConfig(topLevelConfig), blockSize(blockSize),
+          constructionConfig(constructionConfig), countConfig(countConfig),
+          samplingConfig(samplingConfig) {}
+
+    constexpr host::glsl::uint blockCount(host::glsl::uint N) const {
+        return (N + blockSize - 1) / blockSize;
+    }
+
+    inline std::string name() const {
+        std::string name =
+            fmt::format("BlockedAliasTable-{}-TopLevel-{}", blockSize, topLevelConfig.name());
+        if (countConfig.rng != host::RNGAlgorithm::PHILOX) {
+            name += "-Count-" + host::rngAlgorithmName(countConfig.rng);
+        }
+        if (samplingConfig.rng != host::RNGAlgorithm::PHILOX) {
+            name += "-Sampling-" + host::rngAlgorithmName(samplingConfig.rng);
+        }
+        return name;
+    }
+};
+
+struct BlockedAliasTableBuffers {
+    using Self = BlockedAliasTableBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle weights;
+    using WeightsLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using WeightsView = host::layout::BufferView<WeightsLayout>;
+
+    // per-block tables, the aliases are relative to the begin of their block.
+    merian::BufferHandle aliasTable;
+    using AliasTableLayout = device::details::AliasTableLayout;
+    using AliasTableView = host::layout::BufferView<AliasTableLayout>;
+
+    merian::BufferHandle samples;
+    using SamplesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using SamplesView = host::layout::BufferView<SamplesLayout>;
+
+    // the weights of the top-level table are the block totals.
+    PSA::Buffers m_topLevel;
+
+    merian::BufferHandle m_blockCounts;
+    using BlockCountsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using BlockCountsView = host::layout::BufferView<BlockCountsLayout>;
+
+    merian::BufferHandle m_cursor;
+    using CursorLayout = host::layout::PrimitiveLayout<host::glsl::uint, storageQualifier>;
+    using CursorView = host::layout::BufferView<CursorLayout>;
+
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         merian::MemoryMappingType memoryMapping,
+                         const BlockedAliasTableConfig& config,
+                         host::glsl::uint N,
+                         host::glsl::uint S) {
+        Self buffers;
+        if (memoryMapping == merian::MemoryMappingType::NONE) {
+            const host::glsl::uint blockCount = config.blockCount(N);
+            buffers.weights = alloc->createBuffer(WeightsLayout::size(N),
+                                                  vk::BufferUsageFlagBits::eStorageBuffer |
+                                                      vk::BufferUsageFlagBits::eTransferDst,
+                                                  memoryMapping, "blocked-weights");
+            buffers.aliasTable = device::details::allocateAliasTableBuffer(
+                alloc, memoryMapping,
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc, N);
+            buffers.samples = alloc->createBuffer(SamplesLayout::size(S),
+                                                  vk::BufferUsageFlagBits::eStorageBuffer |
+                                                      vk::BufferUsageFlagBits::eTransferSrc,
+                                                  memoryMapping, "samples");
+            buffers.m_topLevel =
+                PSA::Buffers::allocate(alloc, memoryMapping, config.topLevelConfig, blockCount);
+            buffers.m_blockCounts = alloc->createBuffer(
+                BlockCountsLayout::size(blockCount),
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                memoryMapping, "blocked-block-counts");
+            buffers.m_cursor = alloc->createBuffer(CursorLayout::size(),
+                                                   vk::BufferUsageFlagBits::eStorageBuffer |
+                                                       vk::BufferUsageFlagBits::eTransferDst,
+                                                   memoryMapping, "blocked-cursor");
+        } else {
+            buffers.weights =
+                alloc->createBuffer(WeightsLayout::size(N), vk::BufferUsageFlagBits::eTransferSrc,
+                                    memoryMapping, "blocked-weights");
+            buffers.aliasTable = device::details::allocateAliasTableBuffer(
+                alloc, memoryMapping, vk::BufferUsageFlagBits::eTransferDst, N);
+            buffers.samples =
+                alloc->createBuffer(SamplesLayout::size(S), vk::BufferUsageFlagBits::eTransferDst,
+                                    memoryMapping, "samples");
+        }
+        return buffers;
+    }
+};
+
+class BlockedAliasTable {
+  public:
+    using Buffers = BlockedAliasTableBuffers;
+    using Config = BlockedAliasTableConfig;
+
+    explicit BlockedAliasTable(const merian::ContextHandle& context,
+                               const merian::ShaderCompilerHandle& shaderCompiler,
+                               const Config& config)
+        : BlockedAliasTable(
+              pipeline::parallel(
+                  [&]() {
+                      return BlockedAliasTableConstruction(context, shaderCompiler,
+                                                           config.blockSize,
+                                                           config.constructionConfig);
+                  },
+                  [&]() { return PSA(context, shaderCompiler, config.topLevelConfig); },
+                  [&]() { return BlockSampleCount(context, shaderCompiler, config.countConfig); },
+                  [&]() {
+                      return BlockedAliasTableSampling(context, shaderCompiler, config.blockSize,
+                                                       config.samplingConfig);
+                  }),
+              config.blockSize) {
+        // the construction holds 4 words per element in shared memory.
+        const vk::PhysicalDeviceLimits limits =
+            context->physical_device.physical_device.getProperties().limits;
+        if (config.blockSize * 4 * sizeof(host::glsl::uint) > limits.maxComputeSharedMemorySize) {
+            throw std::runtime_error("BlockedAliasTable: blockSize exceeds the shared memory");
+        }
+    }
+
+    void build(const merian::CommandBufferHandle& cmd,
+               const Buffers& buffers,
+               host::glsl::uint N,
+               std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        WRS_PROFILE_SCOPE(profiler, cmd, "BlockedAliasTable-Construction");
+        BlockedAliasTableConstruction::Buffers constructionBuffers;
+        constructionBuffers.weights = buffers.weights;
+        constructionBuffers.aliasTable = buffers.aliasTable;
+        constructionBuffers.blockTotals = buffers.m_topLevel.weights;
+        m_construction.run(cmd, constructionBuffers, N);
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     buffers.m_topLevel.weights->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                                vk::AccessFlagBits::eShaderRead));
+
+        m_topLevel.run(cmd, buffers.m_topLevel, blockCount(N), profiler);
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     {
+                         buffers.aliasTable->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                            vk::AccessFlagBits::eShaderRead),
+                         buffers.m_topLevel.aliasTable->buffer_barrier(
+                             vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead),
+                     });
+    }
+
+    void sample(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint S,
+                host::glsl::uint seed = 12345u,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        WRS_PROFILE_SCOPE(profiler, cmd, "BlockedAliasTable-Sampling");
+        cmd->fill(buffers.m_blockCounts, 0);
+        cmd->fill(buffers.m_cursor, 0);
+        const vk::AccessFlags atomicAccess =
+            vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+        cmd->barrier(
+            vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+            {
+                buffers.m_blockCounts->buffer_barrier(vk::AccessFlagBits::eTransferWrite,
+                                                      atomicAccess),
+                buffers.m_cursor->buffer_barrier(vk::AccessFlagBits::eTransferWrite, atomicAccess),
+            });
+
+        BlockSampleCount::Buffers countBuffers;
+        countBuffers.topLevelTable = buffers.m_topLevel.aliasTable;
+        countBuffers.blockCounts = buffers.m_blockCounts;
+        m_count.run(cmd, countBuffers, blockCount(N), S, seed);
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     buffers.m_blockCounts->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                           vk::AccessFlagBits::eShaderRead));
+
+        BlockedAliasTableSampling::Buffers samplingBuffers;
+        samplingBuffers.aliasTable = buffers.aliasTable;
+        samplingBuffers.blockCounts = buffers.m_blockCounts;
+        samplingBuffers.cursor = buffers.m_cursor;
+        samplingBuffers.samples = buffers.samples;
+        m_sampling.run(cmd, samplingBuffers, N, seed);
+    }
+
+    host::glsl::uint blockSize() const {
+        return m_blockSize;
+    }
+
+    host::glsl::uint blockCount(host::glsl::uint N) const {
+        return (N + m_blockSize - 1) / m_blockSize;
+    }
+
+  private:
+    using Kernels =
+        std::tuple<BlockedAliasTableConstruction, PSA, BlockSampleCount, BlockedAliasTableSampling>;
+
+    explicit BlockedAliasTable(Kernels&& kernels, host::glsl::uint blockSize)
+        : m_construction(std::move(std::get<0>(kernels))),
+          m_topLevel(std::move(std::get<1>(kernels))), m_count(std::move(std::get<2>(kernels))),
+          m_sampling(std::move(std::get<3>(kernels))), m_blockSize(blockSize) {}
+
+    BlockedAliasTableConstruction m_construction;
+    PSA m_topLevel;
+    BlockSampleCount m_count;
+    BlockedAliasTableSampling m_sampling;
+    host::glsl::uint m_blockSize;
+};
+
+} // namespace device
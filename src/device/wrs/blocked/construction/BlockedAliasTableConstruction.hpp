@@ -0,0 +1,92 @@
+#pragma once
+/**
+ * @filename    : BlockedAliasTableConstruction.hpp
+ *
+ * Builds an independent alias table for every block of blockSize weights
+ * and writes the block totals, which are the weights of the top-level table.
+ * Every workgroup builds one block in shared memory, therefore the table of a block
+ * is normalized by the mean of the block and its aliases are relative to the block.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/device/wrs/alias/psa/layout/alias_table.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include <string>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+class BlockedAliasTableConstructionConfig {
+  public:
+    host::glsl::uint workgroupSize;
+
+    constexpr BlockedAliasTableConstructionConfig() : workgroupSize(256) {}
+    explicit constexpr BlockedAliasTableConstructionConfig(host::glsl::uint workgroupSize)
+        : workgroupSize(workgroupSize) {}
+};
+
+struct BlockedAliasTableConstructionBuffers {
+    using Self = BlockedAliasTableConstructionBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle weights;
+    using WeightsLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using WeightsView = host::layout::BufferView<WeightsLayout>;
+
+    merian::BufferHandle aliasTable;
+    using AliasTableLayout = device::details::AliasTableLayout;
+    using AliasTableView = host::layout::BufferView<AliasTableLayout>;
+
+    merian::BufferHandle blockTotals;
+    using BlockTotalsLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using BlockTotalsView = host::layout::BufferView<BlockTotalsLayout>;
+};
+
+class BlockedAliasTableConstruction {
+    struct PushConstants {
+        host::glsl::uint N;
+    };
+
+  public:
+    using Buffers = BlockedAliasTableConstructionBuffers;
+    using Config = BlockedAliasTableConstructionConfig;
+
+    explicit BlockedAliasTableConstruction(const merian::ContextHandle& context,
+                                           const merian::ShaderCompilerHandle& shaderCompiler,
+                                           host::glsl::uint blockSize,
+                                           Config config = {})
+        : m_blockSize(blockSize) {
+        const std::string shaderPath = "src/device/wrs/blocked/construction/shader.comp";
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addStorageBuffer() // weights
+                         .addStorageBuffer() // alias table
+                         .addStorageBuffer() // block totals
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(m_blockSize)
+                         .build();
+    }
+
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N) const {
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.weights, buffers.aliasTable,
+                                 buffers.blockTotals);
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{.N = N});
+        // one workgroup per block.
+        cmd->dispatch((N + m_blockSize - 1) / m_blockSize, 1, 1);
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+    host::glsl::uint m_blockSize;
+};
+
+} // namespace device
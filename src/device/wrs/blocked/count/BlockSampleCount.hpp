@@ -0,0 +1,101 @@
+#pragma once
+/**
+ * @filename    : BlockSampleCount.hpp
+ *
+ * First sampling stage of the blocked alias table.
+ * Distributes S samples over the blocks with the top-level table,
+ * the counts are accumulated with atomics and have to be cleared before.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/device/wrs/alias/psa/layout/alias_table.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
+#include <stdexcept>
+#include <string>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+class BlockSampleCountConfig {
+  public:
+    host::glsl::uint workgroupSize;
+    // low-discrepancy sequences are not supported.
+    host::RNGAlgorithm rng;
+
+    constexpr BlockSampleCountConfig() : workgroupSize(512), rng(host::RNGAlgorithm::PHILOX) {}
+    explicit constexpr BlockSampleCountConfig(host::glsl::uint workgroupSize,
+                                              host::RNGAlgorithm rng = host::RNGAlgorithm::PHILOX)
+        : workgroupSize(workgroupSize), rng(rng) {}
+};
+
+struct BlockSampleCountBuffers {
+    using Self = BlockSampleCountBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle topLevelTable;
+    using TopLevelTableLayout = device::details::AliasTableLayout;
+    using TopLevelTableView = host::layout::BufferView<TopLevelTableLayout>;
+
+    merian::BufferHandle blockCounts;
+    using BlockCountsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using BlockCountsView = host::layout::BufferView<BlockCountsLayout>;
+};
+
+class BlockSampleCount {
+    struct PushConstants {
+        host::glsl::uint blockCount;
+        host::glsl::uint S;
+        host::glsl::uint seed;
+    };
+
+  public:
+    using Buffers = BlockSampleCountBuffers;
+    using Config = BlockSampleCountConfig;
+
+    explicit BlockSampleCount(const merian::ContextHandle& context,
+                              const merian::ShaderCompilerHandle& shaderCompiler,
+                              Config config = {})
+        : m_workgroupSize(config.workgroupSize) {
+        if (host::rngIsSequence(config.rng)) {
+            throw std::runtime_error("BlockSampleCount: requires a stream RNG");
+        }
+        const std::string shaderPath = "src/device/wrs/blocked/count/shader.comp";
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addIncludePath("src/device/common/")
+                         .addStorageBuffer() // top-level table
+                         .addStorageBuffer() // block counts
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(m_workgroupSize)
+                         .addSpecializationConstant(host::rngSpecializationConstant(config.rng))
+                         .build();
+    }
+
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint blockCount,
+             host::glsl::uint S,
+             host::glsl::uint seed) const {
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.topLevelTable, buffers.blockCounts);
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
+                                                          .blockCount = blockCount,
+                                                          .S = S,
+                                                          .seed = seed,
+                                                      });
+        // every invocation draws the block of one sample.
+        cmd->dispatch((S + m_workgroupSize - 1) / m_workgroupSize, 1, 1);
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+    host::glsl::uint m_workgroupSize;
+};
+
+} // namespace device
@@ -0,0 +1,114 @@
+#pragma once
+/**
+ * @filename    : BlockedAliasTableSampling.hpp
+ *
+ * Second sampling stage of the blocked alias table.
+ * Every workgroup draws the samples of one block from its table in shared memory.
+ * The blocks allocate their output ranges with an atomic cursor, which has to be cleared before.
+ * Therefore the samples are grouped by block, but the order of the blocks is unspecified.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/device/wrs/alias/psa/layout/alias_table.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/layout/PrimitiveLayout.hpp"
+#include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
+#include <stdexcept>
+#include <string>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+class BlockedAliasTableSamplingConfig {
+  public:
+    host::glsl::uint workgroupSize;
+    // low-discrepancy sequences are not supported.
+    host::RNGAlgorithm rng;
+
+    constexpr BlockedAliasTableSamplingConfig()
+        : workgroupSize(256), rng(host::RNGAlgorithm::PHILOX) {}
+    explicit constexpr BlockedAliasTableSamplingConfig(
+        host::glsl::uint workgroupSize, host::RNGAlgorithm rng = host::RNGAlgorithm::PHILOX)
+        : workgroupSize(workgroupSize), rng(rng) {}
+};
+
+struct BlockedAliasTableSamplingBuffers {
+    using Self = BlockedAliasTableSamplingBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle aliasTable;
+    using AliasTableLayout = device::details::AliasTableLayout;
+    using AliasTableView = host::layout::BufferView<AliasTableLayout>;
+
+    merian::BufferHandle blockCounts;
+    using BlockCountsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using BlockCountsView = host::layout::BufferView<BlockCountsLayout>;
+
+    merian::BufferHandle cursor;
+    using CursorLayout = host::layout::PrimitiveLayout<host::glsl::uint, storageQualifier>;
+    using CursorView = host::layout::BufferView<CursorLayout>;
+
+    merian::BufferHandle samples;
+    using SamplesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using SamplesView = host::layout::BufferView<SamplesLayout>;
+};
+
+class BlockedAliasTableSampling {
+    struct PushConstants {
+        host::glsl::uint N;
+        host::glsl::uint seed;
+    };
+
+  public:
+    using Buffers = BlockedAliasTableSamplingBuffers;
+    using Config = BlockedAliasTableSamplingConfig;
+
+    explicit BlockedAliasTableSampling(const merian::ContextHandle& context,
+                                       const merian::ShaderCompilerHandle& shaderCompiler,
+                                       host::glsl::uint blockSize,
+                                       Config config = {})
+        : m_blockSize(blockSize) {
+        if (host::rngIsSequence(config.rng)) {
+            throw std::runtime_error("BlockedAliasTableSampling: requires a stream RNG");
+        }
+        const std::string shaderPath = "src/device/wrs/blocked/sampling/shader.comp";
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addIncludePath("src/device/common/")
+                         .addStorageBuffer() // alias table
+                         .addStorageBuffer() // block counts
+                         .addStorageBuffer() // cursor
+                         .addStorageBuffer() // samples
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(m_blockSize)
+                         .addSpecializationConstant(host::rngSpecializationConstant(config.rng))
+                         .build();
+    }
+
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint seed) const {
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.aliasTable, buffers.blockCounts,
+                                 buffers.cursor, buffers.samples);
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
+                                                          .N = N,
+                                                          .seed = seed,
+                                                      });
+        // one workgroup per block, blocks without samples exit immediately.
+        cmd->dispatch((N + m_blockSize - 1) / m_blockSize, 1, 1);
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+    host::glsl::uint m_blockSize;
+};
+
+} // namespace device
@@ -0,0 +1,235 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/wrs/blocked/BlockedAliasTable.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include "src/host/memory/FallbackResource.hpp"
+#include "src/host/memory/SafeResource.hpp"
+#include "src/host/memory/StackResource.hpp"
+#include "src/host/statistics/js_divergence.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+namespace device::test::blocked {
+
+using Algorithm = BlockedAliasTable;
+using Buffers = Algorithm::Buffers;
+using Config = Algorithm::Config;
+
+struct TestCase {
+    Config config;
+    host::glsl::uint N;
+    host::Distribution distribution;
+    host::glsl::uint S;
+    uint32_t iterations;
+};
+
+static constexpr PSAConfig TOP_LEVEL_CONFIG =
+    PSAConfig(AtomicMeanConfig(),
+              DecoupledPrefixPartitionConfig(),
+              InlineSplitPackConfig(2),
+              false);
+
+static const TestCase TEST_CASES[] = {
+    TestCase{
+        .config = BlockedAliasTableConfig(TOP_LEVEL_CONFIG),
+        .N = static_cast<host::glsl::uint>(1e6) + 17,
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = static_cast<host::glsl::uint>(4e6),
+        .iterations = 2,
+    },
+    TestCase{
+        .config = BlockedAliasTableConfig(TOP_LEVEL_CONFIG, 2048),
+        .N = static_cast<host::glsl::uint>(1e6),
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .S = static_cast<host::glsl::uint>(1e6),
+        .iterations = 2,
+    },
+    // less samples than blocks, most blocks read their table from global memory.
+    TestCase{
+        .config = BlockedAliasTableConfig(TOP_LEVEL_CONFIG, 256),
+        .N = static_cast<host::glsl::uint>(1e6),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = 1024,
+        .iterations = 2,
+    },
+};
+
+/// Maximum error of the probability of every element implied by the per-block tables,
+/// relative to its exact probability within the block.
+static double blockTableError(std::span<const float> weights,
+                              std::span<const host::AliasTableEntry<float, host::glsl::uint>> table,
+                              host::glsl::uint blockSize) {
+    const host::glsl::uint N = static_cast<host::glsl::uint>(weights.size());
+    double maxError = 0.0;
+    std::vector<double> implied(blockSize);
+    for (host::glsl::uint begin = 0; begin < N; begin += blockSize) {
+        const host::glsl::uint n = std::min(blockSize, N - begin);
+        double total = 0.0;
+        for (host::glsl::uint i = 0; i < n; ++i) {
+            total += weights[begin + i];
+        }
+        if (total == 0.0) {
+            continue;
+        }
+        std::fill(implied.begin(), implied.end(), 0.0);
+        for (host::glsl::uint i = 0; i < n; ++i) {
+            const auto& entry = table[begin + i];
+            if (entry.a >= n) {
+                return INFINITY;
+            }
+            implied[i] += entry.p / static_cast<double>(n);
+            implied[entry.a] += (1.0 - entry.p) / static_cast<double>(n);
+        }
+        for (host::glsl::uint i = 0; i < n; ++i) {
+            maxError = std::max(maxError, std::abs(implied[i] - weights[begin + i] / total));
+        }
+    }
+    return maxError;
+}
+
+static bool runTestCase(const host::test::TestContext& context,
+                        const TestCase& testCase,
+                        std::pmr::memory_resource* resource) {
+    const host::glsl::uint N = testCase.N;
+    const host::glsl::uint S = testCase.S;
+    std::string testName =
+        fmt::format("{{{},N={},distribution={},S={}}}", testCase.config.name(), N,
+                    host::distribution_to_pretty_string(testCase.distribution), S);
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    Algorithm kernel{context.context, context.shaderCompiler, testCase.config};
+    Buffers buffers =
+        Buffers::allocate(context.alloc, merian::MemoryMappingType::NONE, testCase.config, N, S);
+    Buffers stage = Buffers::allocate(context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+                                      testCase.config, N, S);
+
+    std::mt19937 rng{std::random_device{}()};
+    std::uniform_int_distribution<host::glsl::uint> seedDist;
+
+    bool failed = false;
+    for (size_t it = 0; it < testCase.iterations; ++it) {
+        MERIAN_PROFILE_SCOPE(context.profiler, testName);
+        context.queue->wait_idle();
+
+        // 1. Generate input
+        context.profiler->start("Generate test input");
+        std::pmr::vector<float> weights =
+            host::pmr::generate_weights<float>(testCase.distribution, N, resource);
+        context.profiler->end();
+
+        // 2. Begin recoding
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        std::string recordingLabel = fmt::format("Recording : {}", testName);
+        context.profiler->start(recordingLabel);
+        context.profiler->cmd_start(cmd, recordingLabel);
+
+        // 3. Upload weights, build and sample
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Upload test case");
+            Buffers::WeightsView stageWeights{stage.weights, N};
+            Buffers::WeightsView localWeights{buffers.weights, N};
+            stageWeights.upload<float>(weights);
+            stageWeights.copyTo(cmd, localWeights);
+            localWeights.expectComputeRead(cmd);
+        }
+        kernel.build(cmd, buffers, N, context.profiler);
+        kernel.sample(cmd, buffers, N, S, seedDist(rng), context.profiler);
+
+        // 4. Download results to stage
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Download results to stage");
+            Buffers::AliasTableView localTable{buffers.aliasTable, N};
+            Buffers::AliasTableView stageTable{stage.aliasTable, N};
+            localTable.expectComputeWrite();
+            localTable.copyTo(cmd, stageTable);
+            stageTable.expectHostRead(cmd);
+
+            Buffers::SamplesView localSamples{buffers.samples, S};
+            Buffers::SamplesView stageSamples{stage.samples, S};
+            localSamples.expectComputeWrite();
+            localSamples.copyTo(cmd, stageSamples);
+            stageSamples.expectHostRead(cmd);
+        }
+
+        // 5. Submit to device
+        context.profiler->end();
+        context.profiler->cmd_end(cmd);
+        cmd->end();
+        context.queue->submit_wait(cmd);
+
+        // 6. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            const auto table = device::details::downloadAliasTableFromBuffer(stage.aliasTable, N,
+                                                                              resource);
+            const double tableError = blockTableError(weights, table, kernel.blockSize());
+            if (tableError > 1e-4) {
+                SPDLOG_ERROR("Invalid block alias tables, max error: {}", tableError);
+                failed = true;
+            }
+
+            const auto samples = Buffers::SamplesView{stage.samples, S}
+                                     .download<host::glsl::uint, host::pmr_alloc<host::glsl::uint>>(
+                                         resource);
+            for (host::glsl::uint s = 0; s < S; ++s) {
+                if (samples[s] >= N || weights[samples[s]] == 0.0f) {
+                    SPDLOG_ERROR("Invalid sample {} at {}", samples[s], s);
+                    failed = true;
+                    break;
+                }
+            }
+            // the divergence of a few samples is dominated by the sample size.
+            if (S >= N) {
+                const float jsDivergence =
+                    host::js_divergence<host::glsl::uint, host::glsl::f32>(samples, weights);
+                SPDLOG_INFO("JS-Divergence: {}", jsDivergence);
+                if (jsDivergence > 0.15) {
+                    SPDLOG_ERROR("{} displays a significant bias", testCase.config.name());
+                    failed = true;
+                }
+            }
+        }
+        context.profiler->collect(true, true);
+    }
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing blocked alias table");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    host::memory::StackResource stackResource{4096 * 2048};
+    host::memory::FallbackResource fallbackResource{&stackResource};
+    host::memory::SafeResource safeResource{&fallbackResource};
+
+    std::pmr::memory_resource* resource = &safeResource;
+
+    uint32_t failCount = 0;
+    for (const auto& testCase : TEST_CASES) {
+        if (runTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+
+    testContext.profiler->collect(true, true);
+    SPDLOG_INFO(fmt::format("Profiler results: \n{}",
+                            merian::Profiler::get_report_str(testContext.profiler->get_report())));
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
+                                 sizeof(TEST_CASES) / sizeof(TestCase)));
+    }
+}
+
+} // namespace device::test::blocked
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "merian/vk/context.hpp"
+
+namespace device::test::blocked {
+
+void test(const merian::ContextHandle& context);
+
+}
@@ -0,0 +1,314 @@
+#pragma once
+/**
+ * @filename    : ChunkedAliasTable.hpp
+ *
+ * Out-of-core variant of the alias table method for weight sets,
+ * which don't fit into the device memory we can spare.
+ *
+ * The weights stay in host memory and are streamed to the device in chunks of chunkSize elements.
+ * Every chunk is build into its own alias table, which is downloaded and kept in host memory.
+ * A top-level alias table over the chunk totals is build on the host.
+ *
+ * Sampling is split into two stages:
+ * 1. The top-level table distributes the S samples over the chunks (on the host).
+ * 2. Every chunk with at least one sample is paged in and sampled on the device.
+ *
+ * The device only ever holds the buffers of a single chunk and one batch of samples,
+ * the chunk size is the largest power of two, which fits into the configured budget.
+ * The host visible staging buffers are not counted against the budget.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/command/command_pool.hpp"
+#include "merian/vk/command/queue.hpp"
+#include "merian/vk/memory/resource_allocator.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/wrs/alias/AliasTable.hpp"
+#include "src/device/wrs/alias/psa/layout/alias_table.hpp"
+#include "src/host/reference/sweeping_alias_table.hpp"
+#include "src/host/types/alias_table.hpp"
+#include "src/host/types/glsl.hpp"
+#include <algorithm>
+#include <bit>
+#include <fmt/format.h>
+#include <memory>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace device {
+
+struct ChunkedAliasTableConfig {
+    // used for every chunk, incremental updates, quantization and narrow sample indices
+    // (SampleIndexWidth U16/U8) are not supported.
+    const AliasTableConfig aliasTableConfig;
+    // upper bound of the device memory used by the buffers of a chunk and a sample batch in bytes.
+    const std::size_t deviceMemoryBudget;
+    // maximum amount of samples per dispatch of the second stage.
+    const host::glsl::uint sampleBatchSize;
+
+    constexpr explicit ChunkedAliasTableConfig(AliasTableConfig aliasTableConfig,
+                                               std::size_t deviceMemoryBudget,
+                                               host::glsl::uint sampleBatchSize = 1 << 22)
+        : aliasTableConfig(aliasTableConfig), deviceMemoryBudget(deviceMemoryBudget),
+          sampleBatchSize(sampleBatchSize) {}
+
+    inline std::string name() const {
+        return fmt::format("Chunked-{}-Budget-{}MiB", aliasTableConfig.name(),
+                           deviceMemoryBudget / (1 << 20));
+    }
+
+    /**
+     * Approximate device memory used by the buffers of a chunk:
+     * weights, alias table, partition indices, partition prefix and optional partition elements.
+     * The internal states of mean, prefix partition and split pack are in the order of
+     * chunkSize / partitionSize and accounted for by a slack of 1/16.
+     */
+    constexpr std::size_t deviceMemoryFootprint(std::size_t chunkSize) const {
+        const std::size_t bytesPerElement =
+            sizeof(float)                                    // weights
+            + sizeof(float) + sizeof(host::glsl::uint)       // alias table
+            + sizeof(host::glsl::uint)                       // partition indices
+            + sizeof(float)                                  // partition prefix
+            + (aliasTableConfig.psaConfig.usePartitionElements ? sizeof(float) : 0);
+        const std::size_t footprint =
+            chunkSize * bytesPerElement + sampleBatchSize * sizeof(host::glsl::uint);
+        return footprint + footprint / 16;
+    }
+
+    /// Largest power of two chunk size within the budget, which is not larger than required for N.
+    constexpr host::glsl::uint chunkSize(host::glsl::uint N) const {
+        host::glsl::uint chunkSize = std::bit_ceil(std::max<host::glsl::uint>(N, 2));
+        while (chunkSize > 1 && deviceMemoryFootprint(chunkSize) > deviceMemoryBudget) {
+            chunkSize /= 2;
+        }
+        return chunkSize;
+    }
+};
+
+/// Host resident state of a build.
+struct ChunkedAliasTableChunks {
+    host::glsl::uint N;
+    host::glsl::uint chunkSize;
+    std::vector<host::pmr::AliasTable<float, host::glsl::uint>> aliasTables;
+    std::vector<double> totals;
+    // distribution over the chunks.
+    host::AliasTable<double, host::glsl::uint> topLevel;
+
+    host::glsl::uint chunkCount() const {
+        return static_cast<host::glsl::uint>(aliasTables.size());
+    }
+
+    host::glsl::uint chunkBegin(host::glsl::uint chunk) const {
+        return chunk * chunkSize;
+    }
+
+    host::glsl::uint chunkLength(host::glsl::uint chunk) const {
+        return std::min(chunkSize, N - chunkBegin(chunk));
+    }
+};
+
+struct ChunkedAliasTableBuffers {
+    using Self = ChunkedAliasTableBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    // device buffers of a single chunk.
+    AliasTable::Buffers m_chunk;
+
+    merian::BufferHandle m_weightsStage;
+    merian::BufferHandle m_aliasTableStage;
+    merian::BufferHandle m_samplesStage;
+
+    host::glsl::uint m_chunkSize;
+    host::glsl::uint m_sampleBatchSize;
+
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         const ChunkedAliasTableConfig& config,
+                         host::glsl::uint N) {
+        Self buffers;
+        buffers.m_chunkSize = config.chunkSize(N);
+        buffers.m_sampleBatchSize = config.sampleBatchSize;
+        if (config.deviceMemoryFootprint(buffers.m_chunkSize) > config.deviceMemoryBudget ||
+            buffers.m_chunkSize < config.aliasTableConfig.psaConfig.splitSize()) {
+            throw std::runtime_error("ChunkedAliasTable: device memory budget is too small");
+        }
+        buffers.m_chunk =
+            AliasTable::Buffers::allocate(alloc, merian::MemoryMappingType::NONE,
+                                          config.aliasTableConfig, buffers.m_chunkSize,
+                                          config.sampleBatchSize);
+        buffers.m_weightsStage = alloc->createBuffer(
+            AliasTable::Buffers::WeightsLayout::size(buffers.m_chunkSize),
+            vk::BufferUsageFlagBits::eTransferSrc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+            "chunked-weights-stage");
+        buffers.m_aliasTableStage = device::details::allocateAliasTableBuffer(
+            alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+            vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+            buffers.m_chunkSize);
+        buffers.m_samplesStage = alloc->createBuffer(
+            AliasTable::Buffers::SamplesLayout::size(config.sampleBatchSize),
+            vk::BufferUsageFlagBits::eTransferDst, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+            "chunked-samples-stage");
+        return buffers;
+    }
+};
+
+class ChunkedAliasTable {
+  public:
+    using Buffers = ChunkedAliasTableBuffers;
+    using Config = ChunkedAliasTableConfig;
+    using Chunks = ChunkedAliasTableChunks;
+
+    ChunkedAliasTable(const merian::ContextHandle& context,
+                      const merian::ShaderCompilerHandle& shaderCompiler,
+                      const Config& config)
+        : m_aliasTable(context, shaderCompiler, validate(config).aliasTableConfig) {}
+
+    /**
+     * Streams the host resident weights chunk by chunk through the device and
+     * returns the per chunk alias tables and the top-level table.
+     * Records and submits its own command buffers and waits for every chunk.
+     */
+    Chunks build(const merian::QueueHandle& queue,
+                 const merian::CommandPoolHandle& cmdPool,
+                 const Buffers& buffers,
+                 std::span<const float> weights) const {
+        Chunks chunks;
+        chunks.N = static_cast<host::glsl::uint>(weights.size());
+        chunks.chunkSize = buffers.m_chunkSize;
+        const host::glsl::uint chunkCount = (chunks.N + chunks.chunkSize - 1) / chunks.chunkSize;
+        chunks.aliasTables.reserve(chunkCount);
+        chunks.totals.reserve(chunkCount);
+
+        for (host::glsl::uint chunk = 0; chunk < chunkCount; ++chunk) {
+            const host::glsl::uint begin = chunk * chunks.chunkSize;
+            const host::glsl::uint n = std::min(chunks.chunkSize, chunks.N - begin);
+            const std::span<const float> chunkWeights = weights.subspan(begin, n);
+
+            merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(cmdPool);
+            cmd->begin();
+            AliasTable::Buffers::WeightsView stageWeights{buffers.m_weightsStage, n};
+            AliasTable::Buffers::WeightsView localWeights{buffers.m_chunk.weights, n};
+            stageWeights.upload<float>(chunkWeights);
+            stageWeights.copyTo(cmd, localWeights);
+            localWeights.expectComputeRead(cmd);
+
+            m_aliasTable.build(cmd, buffers.m_chunk, n);
+
+            AliasTable::Buffers::AliasTableView localTable{buffers.m_chunk.m_aliasTable, n};
+            AliasTable::Buffers::AliasTableView stageTable{buffers.m_aliasTableStage, n};
+            localTable.expectComputeWrite();
+            localTable.copyTo(cmd, stageTable);
+            stageTable.expectHostRead(cmd);
+            cmd->end();
+            queue->submit_wait(cmd);
+
+            chunks.aliasTables.push_back(
+                device::details::downloadAliasTableFromBuffer(buffers.m_aliasTableStage, n));
+            double total = 0;
+            for (const float w : chunkWeights) {
+                total += w;
+            }
+            chunks.totals.push_back(total);
+        }
+
+        double total = 0;
+        for (const double t : chunks.totals) {
+            total += t;
+        }
+        chunks.topLevel =
+            host::reference::sweeping_alias_table<double, double, host::glsl::uint>(
+                std::span<double>(chunks.totals), total);
+        return chunks;
+    }
+
+    /**
+     * Writes samples.size() samples into the host resident samples.
+     * The samples are independent, but ordered by chunk.
+     */
+    void sample(const merian::QueueHandle& queue,
+                const merian::CommandPoolHandle& cmdPool,
+                const Buffers& buffers,
+                const Chunks& chunks,
+                std::span<host::glsl::uint> samples,
+                host::glsl::uint seed = 12345u) const {
+        // 1. Distribute the samples over the chunks with the top-level table.
+        std::vector<std::size_t> counts(chunks.chunkCount(), 0);
+        {
+            std::mt19937 rng{seed};
+            std::uniform_int_distribution<host::glsl::uint> u1Dist{0, chunks.chunkCount() - 1};
+            std::uniform_real_distribution<double> u2Dist{0.0, 1.0};
+            for (std::size_t s = 0; s < samples.size(); ++s) {
+                const host::glsl::uint u1 = u1Dist(rng);
+                const auto& entry = chunks.topLevel[u1];
+                counts[u2Dist(rng) < entry.p ? u1 : entry.a]++;
+            }
+        }
+
+        // 2. Page in every chunk with samples and sample it on the device.
+        std::size_t offset = 0;
+        host::glsl::uint dispatch = 0;
+        for (host::glsl::uint chunk = 0; chunk < chunks.chunkCount(); ++chunk) {
+            if (counts[chunk] == 0) {
+                continue;
+            }
+            const host::glsl::uint n = chunks.chunkLength(chunk);
+            bool pagedIn = false;
+            for (std::size_t done = 0; done < counts[chunk];) {
+                const host::glsl::uint S = static_cast<host::glsl::uint>(
+                    std::min<std::size_t>(counts[chunk] - done, buffers.m_sampleBatchSize));
+
+                merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(cmdPool);
+                cmd->begin();
+                if (!pagedIn) {
+                    device::details::uploadAliasTableToBuffer(buffers.m_aliasTableStage,
+                                                              chunks.aliasTables[chunk]);
+                    AliasTable::Buffers::AliasTableView stageTable{buffers.m_aliasTableStage, n};
+                    AliasTable::Buffers::AliasTableView localTable{buffers.m_chunk.m_aliasTable,
+                                                                   n};
+                    stageTable.expectHostWrite();
+                    stageTable.copyTo(cmd, localTable);
+                    localTable.expectComputeRead(cmd);
+                    pagedIn = true;
+                }
+                m_aliasTable.sample(cmd, buffers.m_chunk, n, S, seed ^ (0x9E3779B9u * ++dispatch));
+
+                AliasTable::Buffers::SamplesView localSamples{buffers.m_chunk.samples, S};
+                AliasTable::Buffers::SamplesView stageSamples{buffers.m_samplesStage, S};
+                localSamples.expectComputeWrite();
+                localSamples.copyTo(cmd, stageSamples);
+                stageSamples.expectHostRead(cmd);
+                cmd->end();
+                queue->submit_wait(cmd);
+
+                const std::vector<host::glsl::uint> batch =
+                    stageSamples.download<host::glsl::uint>();
+                const host::glsl::uint begin = chunks.chunkBegin(chunk);
+                std::ranges::transform(batch, samples.begin() + offset,
+                                       [begin](host::glsl::uint i) { return begin + i; });
+                offset += S;
+                done += S;
+            }
+        }
+    }
+
+  private:
+    static const Config& validate(const Config& config) {
+        if (config.aliasTableConfig.updateConfig.has_value() ||
+            config.aliasTableConfig.quantizeConfig.has_value()) {
+            throw std::runtime_error(
+                "ChunkedAliasTable: incremental updates and quantization are not supported");
+        }
+        // the batches are downloaded as uint chunk local indices and offset by the chunk.
+        if (config.aliasTableConfig.samplingConfig.sampleIndexWidth !=
+            host::SampleIndexWidth::U32) {
+            throw std::runtime_error("ChunkedAliasTable: only 32-bit sample indices are supported");
+        }
+        return config;
+    }
+
+    AliasTable m_aliasTable;
+};
+
+} // namespace device
@@ -0,0 +1,151 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/wrs/chunked/ChunkedAliasTable.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include "src/host/memory/FallbackResource.hpp"
+#include "src/host/memory/SafeResource.hpp"
+#include "src/host/memory/StackResource.hpp"
+#include "src/host/statistics/js_divergence.hpp"
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <random>
+#include <spdlog/spdlog.h>
+
+namespace device::test::chunked {
+
+using Algorithm = ChunkedAliasTable;
+using Buffers = Algorithm::Buffers;
+using Config = Algorithm::Config;
+
+struct TestCase {
+    Config config;
+    host::glsl::uint N;
+    host::Distribution distribution;
+    host::glsl::uint S;
+    uint32_t iterations;
+};
+
+static constexpr AliasTableConfig ALIAS_TABLE_CONFIG =
+    AliasTableConfig(PSAConfig(AtomicMeanConfig(),
+                               DecoupledPrefixPartitionConfig(),
+                               InlineSplitPackConfig(2),
+                               false),
+                     SampleAliasTableConfig(128));
+
+static const TestCase TEST_CASES[] = {
+    TestCase{
+        .config = ChunkedAliasTableConfig(ALIAS_TABLE_CONFIG, 2 << 20, 1 << 16),
+        .N = static_cast<host::glsl::uint>(1e6) + 17,
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = static_cast<host::glsl::uint>(1e6),
+        .iterations = 2,
+    },
+    TestCase{
+        .config = ChunkedAliasTableConfig(ALIAS_TABLE_CONFIG, 2 << 20, 1 << 16),
+        .N = static_cast<host::glsl::uint>(1e5),
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .S = static_cast<host::glsl::uint>(4e6),
+        .iterations = 2,
+    },
+};
+
+static bool runTestCase(const host::test::TestContext& context,
+                        const TestCase& testCase,
+                        std::pmr::memory_resource* resource) {
+    const host::glsl::uint N = testCase.N;
+    const host::glsl::uint S = testCase.S;
+    std::string testName =
+        fmt::format("{{{},N={},distribution={},S={}}}", testCase.config.name(), N,
+                    host::distribution_to_pretty_string(testCase.distribution), S);
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    Algorithm kernel{context.context, context.shaderCompiler, testCase.config};
+    Buffers buffers = Buffers::allocate(context.alloc, testCase.config, N);
+    SPDLOG_INFO("Chunk size: {}", buffers.m_chunkSize);
+
+    std::mt19937 rng{std::random_device{}()};
+    std::uniform_int_distribution<host::glsl::uint> seedDist;
+
+    bool failed = false;
+    for (size_t it = 0; it < testCase.iterations; ++it) {
+        MERIAN_PROFILE_SCOPE(context.profiler, testName);
+        context.queue->wait_idle();
+
+        // 1. Generate input
+        context.profiler->start("Generate test input");
+        std::pmr::vector<float> weights =
+            host::pmr::generate_weights<float>(testCase.distribution, N, resource);
+        context.profiler->end();
+
+        // 2. Build and sample
+        Algorithm::Chunks chunks;
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Build");
+            chunks = kernel.build(context.queue, context.cmdPool, buffers, weights);
+        }
+        std::pmr::vector<host::glsl::uint> samples(S, resource);
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Sample");
+            kernel.sample(context.queue, context.cmdPool, buffers, chunks, samples,
+                          seedDist(rng));
+        }
+
+        // 3. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            if (chunks.chunkCount() < 2) {
+                SPDLOG_WARN("The budget did not split the weights into multiple chunks");
+            }
+            for (host::glsl::uint s = 0; s < S; ++s) {
+                if (samples[s] >= N || weights[samples[s]] == 0.0f) {
+                    SPDLOG_ERROR("Invalid sample {} at {}", samples[s], s);
+                    failed = true;
+                    break;
+                }
+            }
+            const float jsDivergence =
+                host::js_divergence<host::glsl::uint, host::glsl::f32>(samples, weights);
+            SPDLOG_INFO("JS-Divergence: {}", jsDivergence);
+            if (jsDivergence > 0.15) {
+                SPDLOG_ERROR("{} displays a significant bias", testCase.config.name());
+                failed = true;
+            }
+        }
+        context.profiler->collect(true, true);
+    }
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing chunked alias table");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    host::memory::StackResource stackResource{4096 * 2048};
+    host::memory::FallbackResource fallbackResource{&stackResource};
+    host::memory::SafeResource safeResource{&fallbackResource};
+
+    std::pmr::memory_resource* resource = &safeResource;
+
+    uint32_t failCount = 0;
+    for (const auto& testCase : TEST_CASES) {
+        if (runTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+
+    testContext.profiler->collect(true, true);
+    SPDLOG_INFO(fmt::format("Profiler results: \n{}",
+                            merian::Profiler::get_report_str(testContext.profiler->get_report())));
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
+                                 sizeof(TEST_CASES) / sizeof(TestCase)));
+    }
+}
+
+} // namespace device::test::chunked
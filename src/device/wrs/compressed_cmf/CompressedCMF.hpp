@@ -0,0 +1,155 @@
+#pragma once
+/**
+ * @filename    : CompressedCMF.hpp
+ *
+ * Compresses a fp32 CMF into blocks of blockSize elements.
+ * Every block stores its fp32 base (the CMF in front of the block) and
+ * every element a unorm16 offset relative to the range [base(b), base(b + 1)] of its block.
+ *
+ * The sampling kernels search the block bases first and afterwards the deltas of a single block,
+ * which halves the working set of the searches (2 instead of 4 bytes per element).
+ * Elements with a weight below (base(b + 1) - base(b)) / 65535 may be under or over sampled,
+ * zero weights are never sampled.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/memory/resource_allocator.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+class CompressedCMFConfig {
+  public:
+    host::glsl::uint workgroupSize;
+    host::glsl::uint blockSize;
+
+    constexpr CompressedCMFConfig() : workgroupSize(512), blockSize(256) {}
+    explicit constexpr CompressedCMFConfig(host::glsl::uint workgroupSize,
+                                           host::glsl::uint blockSize)
+        : workgroupSize(workgroupSize), blockSize(blockSize) {}
+};
+
+struct CompressedCMFBuffers {
+    using Self = CompressedCMFBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle cmf;
+    using CMFLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using CMFView = host::layout::BufferView<CMFLayout>;
+
+    // two unorm16 deltas per uint, the even element in the low half.
+    merian::BufferHandle deltas;
+    using DeltasLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using DeltasView = host::layout::BufferView<DeltasLayout>;
+
+    // blockCount + 1 entries, the last one is the total weight.
+    merian::BufferHandle blockBases;
+    using BlockBasesLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using BlockBasesView = host::layout::BufferView<BlockBasesLayout>;
+
+    static constexpr std::size_t deltaCount(std::size_t N) {
+        return (N + 1) / 2;
+    }
+
+    static constexpr std::size_t blockBaseCount(std::size_t N, CompressedCMFConfig config) {
+        return (N + config.blockSize - 1) / config.blockSize + 1;
+    }
+
+    /// Allocates the compressed representation, the cmf belongs to the surrounding method.
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         merian::MemoryMappingType memoryMapping,
+                         std::size_t N,
+                         CompressedCMFConfig config) {
+        Self buffers;
+        if (memoryMapping == merian::MemoryMappingType::NONE) {
+            buffers.deltas = alloc->createBuffer(DeltasLayout::size(deltaCount(N)),
+                                                 vk::BufferUsageFlagBits::eStorageBuffer |
+                                                     vk::BufferUsageFlagBits::eTransferSrc,
+                                                 memoryMapping, "compressed-cmf-deltas");
+            buffers.blockBases = alloc->createBuffer(
+                BlockBasesLayout::size(blockBaseCount(N, config)),
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc,
+                memoryMapping, "compressed-cmf-block-bases");
+        } else {
+            buffers.deltas = alloc->createBuffer(DeltasLayout::size(deltaCount(N)),
+                                                 vk::BufferUsageFlagBits::eTransferDst,
+                                                 memoryMapping, "compressed-cmf-deltas");
+            buffers.blockBases = alloc->createBuffer(
+                BlockBasesLayout::size(blockBaseCount(N, config)),
+                vk::BufferUsageFlagBits::eTransferDst, memoryMapping, "compressed-cmf-block-bases");
+        }
+        return buffers;
+    }
+};
+
+class CompressedCMF {
+    struct PushConstants {
+        host::glsl::uint N;
+    };
+
+  public:
+    using Buffers = CompressedCMFBuffers;
+    using Config = CompressedCMFConfig;
+
+    explicit CompressedCMF(const merian::ContextHandle& context,
+                           const merian::ShaderCompilerHandle& shaderCompiler,
+                           Config config = {})
+        : m_workgroupSize(config.workgroupSize), m_blockSize(config.blockSize) {
+        if (m_blockSize < 2) {
+            throw std::runtime_error("CompressedCMF: the block size must be at least 2");
+        }
+        const std::string shaderPath = "src/device/wrs/compressed_cmf/shader.comp";
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addStorageBuffer() // cmf
+                         .addStorageBuffer() // deltas
+                         .addStorageBuffer() // block bases
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(m_workgroupSize)
+                         .addSpecializationConstant(m_blockSize)
+                         .build();
+    }
+
+    /// The cmf has to be visible to compute shaders.
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N) const {
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.deltas, buffers.blockBases);
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{.N = N});
+        // every invocation writes one pair of deltas and at most one block base.
+        const host::glsl::uint invocationCount =
+            std::max<host::glsl::uint>((N + 1) / 2, (N + m_blockSize - 1) / m_blockSize + 1);
+        cmd->dispatch((invocationCount + m_workgroupSize - 1) / m_workgroupSize, 1, 1);
+    }
+
+    /// Makes the deltas and block bases visible to the sampling kernels.
+    static void barrier(const merian::CommandBufferHandle& cmd, const Buffers& buffers) {
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     {buffers.deltas->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                     vk::AccessFlagBits::eShaderRead),
+                      buffers.blockBases->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                         vk::AccessFlagBits::eShaderRead)});
+    }
+
+    host::glsl::uint blockSize() const {
+        return m_blockSize;
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+    host::glsl::uint m_workgroupSize;
+    host::glsl::uint m_blockSize;
+};
+
+} // namespace device
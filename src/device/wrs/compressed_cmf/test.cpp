@@ -0,0 +1,217 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/wrs/compressed_cmf/CompressedCMF.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include "src/host/memory/FallbackResource.hpp"
+#include "src/host/memory/SafeResource.hpp"
+#include "src/host/memory/StackResource.hpp"
+#include "src/host/reference/prefix_sum.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+namespace device::test::compressed_cmf {
+
+using Algorithm = CompressedCMF;
+using Buffers = Algorithm::Buffers;
+using Config = Algorithm::Config;
+
+struct TestCase {
+    Config config;
+    host::glsl::uint N;
+    host::Distribution distribution;
+    uint32_t iterations;
+};
+
+static constexpr TestCase TEST_CASES[] = {
+    TestCase{
+        .config = {},
+        .N = static_cast<host::glsl::uint>(1e6),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .iterations = 4,
+    },
+    TestCase{
+        .config = CompressedCMFConfig(256, 1024),
+        .N = static_cast<host::glsl::uint>(1e6) + 17,
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .iterations = 4,
+    },
+    TestCase{
+        .config = CompressedCMFConfig(512, 2),
+        .N = 4096 + 3,
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .iterations = 4,
+    },
+};
+
+/// Decodes the compressed cmf, must match compressedCMF in the sampling shaders.
+static float decode(std::span<const host::glsl::uint> deltas,
+                    std::span<const float> blockBases,
+                    host::glsl::uint blockSize,
+                    host::glsl::uint i) {
+    const host::glsl::uint block = i / blockSize;
+    const float delta = static_cast<float>((deltas[i / 2] >> (16 * (i % 2))) & 0xFFFFu) / 65535.0f;
+    return blockBases[block] + (blockBases[block + 1] - blockBases[block]) * delta;
+}
+
+static bool runTestCase(const host::test::TestContext& context,
+                        const TestCase& testCase,
+                        std::pmr::memory_resource* resource) {
+    std::string testName = fmt::format("{{blockSize={},N={},distribution={}}}",
+                                       testCase.config.blockSize, testCase.N,
+                                       host::distribution_to_pretty_string(testCase.distribution));
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    Algorithm kernel{context.context, context.shaderCompiler, testCase.config};
+
+    const host::glsl::uint N = testCase.N;
+    const host::glsl::uint blockSize = testCase.config.blockSize;
+    const std::size_t deltaCount = Buffers::deltaCount(N);
+    const std::size_t blockBaseCount = Buffers::blockBaseCount(N, testCase.config);
+
+    Buffers buffers =
+        Buffers::allocate(context.alloc, merian::MemoryMappingType::NONE, N, testCase.config);
+    buffers.cmf = context.alloc->createBuffer(Buffers::CMFLayout::size(N),
+                                              vk::BufferUsageFlagBits::eStorageBuffer |
+                                                  vk::BufferUsageFlagBits::eTransferDst,
+                                              merian::MemoryMappingType::NONE);
+    Buffers stage = Buffers::allocate(context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+                                      N, testCase.config);
+    stage.cmf = context.alloc->createBuffer(Buffers::CMFLayout::size(N),
+                                            vk::BufferUsageFlagBits::eTransferSrc,
+                                            merian::MemoryMappingType::HOST_ACCESS_RANDOM);
+
+    bool failed = false;
+    for (size_t it = 0; it < testCase.iterations; ++it) {
+        MERIAN_PROFILE_SCOPE(context.profiler, testName);
+        context.queue->wait_idle();
+
+        // 1. Generate input
+        context.profiler->start("Generate test input");
+        std::pmr::vector<float> weights =
+            host::pmr::generate_weights<float>(testCase.distribution, N, resource);
+        std::pmr::vector<float> cmf = host::reference::pmr::prefix_sum<float>(weights, resource);
+        context.profiler->end();
+
+        // 2. Begin recoding
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        std::string recordingLabel = fmt::format("Recording : {}", testName);
+        context.profiler->start(recordingLabel);
+        context.profiler->cmd_start(cmd, recordingLabel);
+
+        // 3. Upload cmf
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Upload test case");
+            Buffers::CMFView stageView{stage.cmf, N};
+            Buffers::CMFView localView{buffers.cmf, N};
+            stageView.upload<float>(cmf);
+            stageView.copyTo(cmd, localView);
+            localView.expectComputeRead(cmd);
+        }
+
+        // 4. Run test
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Compress CMF");
+            kernel.run(cmd, buffers, N);
+        }
+
+        // 5. Download results to stage
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Download results to stage");
+            Buffers::DeltasView localDeltas{buffers.deltas, deltaCount};
+            Buffers::DeltasView stageDeltas{stage.deltas, deltaCount};
+            localDeltas.expectComputeWrite();
+            localDeltas.copyTo(cmd, stageDeltas);
+            stageDeltas.expectHostRead(cmd);
+
+            Buffers::BlockBasesView localBases{buffers.blockBases, blockBaseCount};
+            Buffers::BlockBasesView stageBases{stage.blockBases, blockBaseCount};
+            localBases.expectComputeWrite();
+            localBases.copyTo(cmd, stageBases);
+            stageBases.expectHostRead(cmd);
+        }
+
+        // 6. Submit to device
+        context.profiler->end();
+        context.profiler->cmd_end(cmd);
+        cmd->end();
+        context.queue->submit_wait(cmd);
+
+        // 7. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            const auto deltas =
+                Buffers::DeltasView{stage.deltas, deltaCount}
+                    .download<host::glsl::uint, host::pmr_alloc<host::glsl::uint>>(resource);
+            const auto blockBases =
+                Buffers::BlockBasesView{stage.blockBases, blockBaseCount}
+                    .download<float, host::pmr_alloc<float>>(resource);
+
+            for (std::size_t b = 0; b < blockBaseCount; ++b) {
+                const std::size_t end = std::min<std::size_t>(b * blockSize, N);
+                const float expected = end == 0 ? 0.0f : cmf[end - 1];
+                if (blockBases[b] != expected) {
+                    SPDLOG_ERROR("Invalid block base {}: expected {}, got {}", b, expected,
+                                 blockBases[b]);
+                    failed = true;
+                    break;
+                }
+            }
+
+            // every decoded value has to be within half a quantization step of its block.
+            for (host::glsl::uint i = 0; i < N && !failed; ++i) {
+                const host::glsl::uint block = i / blockSize;
+                const float range = blockBases[block + 1] - blockBases[block];
+                const float err = std::abs(decode(deltas, blockBases, blockSize, i) - cmf[i]);
+                if (err > range / 65535.0f + 1e-6f * cmf[N - 1]) {
+                    SPDLOG_ERROR("Invalid compressed cmf at {}: expected {}, got {}", i, cmf[i],
+                                 decode(deltas, blockBases, blockSize, i));
+                    failed = true;
+                }
+            }
+            if (deltas[(N - 1) / 2] >> (16 * ((N - 1) % 2)) != 0xFFFFu) {
+                SPDLOG_ERROR("The last element must decode to the total weight");
+                failed = true;
+            }
+        }
+        context.profiler->collect(true, true);
+    }
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing compressed CMF");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    host::memory::StackResource stackResource{4096 * 2048};
+    host::memory::FallbackResource fallbackResource{&stackResource};
+    host::memory::SafeResource safeResource{&fallbackResource};
+
+    std::pmr::memory_resource* resource = &safeResource;
+
+    uint32_t failCount = 0;
+    for (const auto& testCase : TEST_CASES) {
+        if (runTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+
+    testContext.profiler->collect(true, true);
+    SPDLOG_INFO(fmt::format("Profiler results: \n{}",
+                            merian::Profiler::get_report_str(testContext.profiler->get_report())));
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
+                                 sizeof(TEST_CASES) / sizeof(TestCase)));
+    }
+}
+
+} // namespace device::test::compressed_cmf
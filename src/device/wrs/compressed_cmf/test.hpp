@@ -0,0 +1,9 @@
+#pragma once
+
+#include "merian/vk/context.hpp"
+
+namespace device::test::compressed_cmf {
+
+void test(const merian::ContextHandle& context);
+
+}
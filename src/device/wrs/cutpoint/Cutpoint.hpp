@@ -11,12 +11,22 @@
 
 #include "merian/vk/memory/memory_allocator.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ThreadPool.hpp"
 #include "src/device/prefix_sum/PrefixSum.hpp"
+#include "src/device/wrs/compressed_cmf/CompressedCMF.hpp"
 #include "src/device/wrs/cutpoint/guiding_table/CutpointGuidingTable.hpp"
 #include "src/device/wrs/cutpoint/sampling/CutpointSampling.hpp"
+#include "src/device/wrs/glsl/WRSInline.hpp"
+#include "src/device/wrs/incremental/IncrementalCMF.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
+#include "src/host/types/sample_index.hpp"
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include <vulkan/vulkan_handles.hpp>
 
 #include "merian/vk/memory/resource_allocator.hpp"
@@ -28,13 +38,43 @@ class CutpointConfig {
   public:
     PrefixSumConfig prefixSumConfig;
     host::glsl::uint guidingEntrySize;
+    // enables update() after partial weight changes.
+    std::optional<IncrementalCMFConfig> incrementalConfig;
+    // samples from a compressed cmf, can't be combined with incremental updates.
+    std::optional<CompressedCMFConfig> compressedConfig;
+    // narrow sample indices, requires N <= 2^bits.
+    host::SampleIndexWidth sampleIndexWidth;
+    host::RNGAlgorithm rng;
 
     explicit constexpr CutpointConfig(PrefixSumConfig prefixSumConfig,
-                                      host::glsl::uint guidingEntrySize)
-        : prefixSumConfig(prefixSumConfig), guidingEntrySize(guidingEntrySize) {}
+                                      host::glsl::uint guidingEntrySize,
+                                      std::optional<IncrementalCMFConfig> incrementalConfig =
+                                          std::nullopt,
+                                      std::optional<CompressedCMFConfig> compressedConfig =
+                                          std::nullopt,
+                                      host::SampleIndexWidth sampleIndexWidth =
+                                          host::SampleIndexWidth::U32,
+                                      host::RNGAlgorithm rng = host::RNGAlgorithm::HASH)
+        : prefixSumConfig(prefixSumConfig), guidingEntrySize(guidingEntrySize),
+          incrementalConfig(incrementalConfig), compressedConfig(compressedConfig),
+          sampleIndexWidth(sampleIndexWidth), rng(rng) {}
 
     std::string name() const {
-        return fmt::format("Cutpoint-{}", guidingEntrySize);
+        std::string suffix =
+            sampleIndexWidth == host::SampleIndexWidth::U32
+                ? ""
+                : fmt::format("-{}", host::sampleIndexWidthName(sampleIndexWidth));
+        if (rng != host::RNGAlgorithm::HASH) {
+            suffix += "-" + host::rngAlgorithmName(rng);
+        }
+        if (incrementalConfig.has_value()) {
+            return fmt::format("Cutpoint-{}-Incremental{}", guidingEntrySize, suffix);
+        }
+        if (compressedConfig.has_value()) {
+            return fmt::format("Cutpoint-{}-Compressed-{}{}", guidingEntrySize,
+                               compressedConfig->blockSize, suffix);
+        }
+        return fmt::format("Cutpoint-{}{}", guidingEntrySize, suffix);
     }
 };
 
@@ -46,7 +86,7 @@ struct CutpointBuffers {
     using WeightsLayout = host::layout::ArrayLayout<float, storageQualifier>;
     using WeightsView = host::layout::BufferView<WeightsLayout>;
 
-    merian::BufferHandle samples;
+    merian::BufferHandle samples; // packed for narrow sample indices (see sample_index.hpp)
     using SamplesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
     using SamplesView = host::layout::BufferView<SamplesLayout>;
 
@@ -57,18 +97,23 @@ struct CutpointBuffers {
 
     merian::BufferHandle m_cmf;
 
+    merian::BufferHandle m_incrementalStates = nullptr;
+    merian::BufferHandle m_guidingRefreshRange = nullptr;
+    CompressedCMFBuffers m_compressedBuffers;
+
     static Self allocate(const merian::ResourceAllocatorHandle& alloc,
                          merian::MemoryMappingType memoryMapping,
                          std::size_t N,
                          std::size_t S,
                          CutpointConfig config) {
         Self buffers;
+        const std::size_t sampleWordCount = host::sampleWordCount(S, config.sampleIndexWidth);
         buffers.m_prefixSumBuffers =
             PrefixSumBuffers::allocate(alloc, memoryMapping, config.prefixSumConfig, N);
         buffers.weights = buffers.m_prefixSumBuffers.elements;
         buffers.m_cmf = buffers.m_prefixSumBuffers.prefixSum;
         if (memoryMapping == merian::MemoryMappingType::NONE) {
-            buffers.samples = alloc->createBuffer(SamplesLayout::size(S),
+            buffers.samples = alloc->createBuffer(SamplesLayout::size(sampleWordCount),
                                                   vk::BufferUsageFlagBits::eStorageBuffer |
                                                       vk::BufferUsageFlagBits::eTransferSrc,
                                                   memoryMapping);
@@ -76,9 +121,21 @@ struct CutpointBuffers {
                 (N + config.guidingEntrySize - 1) / config.guidingEntrySize;
             buffers.m_guidingTable = alloc->createBuffer(GuidingTableLayout::size(guidingTableSize),
                                                          vk::BufferUsageFlagBits::eStorageBuffer);
+            if (config.incrementalConfig.has_value()) {
+                buffers.m_incrementalStates =
+                    IncrementalCMFBuffers::allocateStates(alloc, N, *config.incrementalConfig);
+                buffers.m_guidingRefreshRange =
+                    CutpointGuidingTableBuffers::allocateRefreshRange(alloc);
+            }
+            if (config.compressedConfig.has_value()) {
+                buffers.m_compressedBuffers = CompressedCMFBuffers::allocate(
+                    alloc, memoryMapping, N, *config.compressedConfig);
+                buffers.m_compressedBuffers.cmf = buffers.m_cmf;
+            }
         } else {
-            buffers.samples = alloc->createBuffer(
-                SamplesLayout::size(S), vk::BufferUsageFlagBits::eTransferDst, memoryMapping);
+            buffers.samples = alloc->createBuffer(SamplesLayout::size(sampleWordCount),
+                                                  vk::BufferUsageFlagBits::eTransferDst,
+                                                  memoryMapping);
         }
         return buffers;
     }
@@ -89,27 +146,55 @@ class Cutpoint {
     using Buffers = CutpointBuffers;
     using Config = CutpointConfig;
 
+    /// With sampleParametersBuffer, S and the seed of the samples are read from a buffer
+    /// (see the sample overload with parameters).
     explicit Cutpoint(const merian::ContextHandle& context,
                       const merian::ShaderCompilerHandle& shaderCompiler,
-                      Config config)
-        : m_scan(context, shaderCompiler, config.prefixSumConfig),
-          m_guidingTable(
-              context, shaderCompiler, CutpointGuidingTableConfig(512, config.guidingEntrySize)),
-          m_sampling(
-              context, shaderCompiler, CutpointSamplingConfig(512, config.guidingEntrySize)) {}
+                      Config config,
+                      bool sampleParametersBuffer = false)
+        : Cutpoint(pipeline::parallel(
+              [&]() {
+                  return PrefixSum<host::glsl::f32>(context, shaderCompiler,
+                                                    config.prefixSumConfig);
+              },
+              [&]() {
+                  return CutpointGuidingTable(
+                      context, shaderCompiler,
+                      CutpointGuidingTableConfig(512, config.guidingEntrySize),
+                      incrementalPartitionSize(config));
+              },
+              [&]() {
+                  std::optional<host::glsl::uint> compressedBlockSize;
+                  if (config.compressedConfig.has_value()) {
+                      compressedBlockSize = config.compressedConfig->blockSize;
+                  }
+                  return CutpointSampling(context, shaderCompiler,
+                                          CutpointSamplingConfig(512, config.guidingEntrySize,
+                                                                 config.sampleIndexWidth,
+                                                                 config.rng),
+                                          incrementalPartitionSize(config), compressedBlockSize,
+                                          sampleParametersBuffer);
+              },
+              [&]() -> std::optional<IncrementalCMF> {
+                  if (config.incrementalConfig.has_value()) {
+                      return IncrementalCMF(context, shaderCompiler, *config.incrementalConfig);
+                  }
+                  return std::nullopt;
+              },
+              [&]() -> std::optional<CompressedCMF> {
+                  if (config.compressedConfig.has_value()) {
+                      return CompressedCMF(context, shaderCompiler, *config.compressedConfig);
+                  }
+                  return std::nullopt;
+              })) {}
 
     void build(const merian::CommandBufferHandle& cmd,
                const Buffers& buffers,
                host::glsl::uint N,
                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
-        if (profiler.has_value()) {
-            profiler.value()->start("Prefix-Sum");
-            profiler.value()->cmd_start(cmd, "Prefix-Sum");
-        }
-        m_scan.run(cmd, buffers.m_prefixSumBuffers, N, profiler);
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "Prefix-Sum");
+            m_scan.run(cmd, buffers.m_prefixSumBuffers, N, profiler);
         }
 
         cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
@@ -117,18 +202,61 @@ class Cutpoint {
                      buffers.m_prefixSumBuffers.prefixSum->buffer_barrier(
                          vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead));
 
+        if (m_incremental.has_value()) {
+            m_incremental->reset(cmd, incrementalBuffers(buffers));
+        }
+
         CutpointGuidingTable::Buffers guidingBuffers;
         guidingBuffers.cmf = buffers.m_cmf;
         guidingBuffers.guidingTable = buffers.m_guidingTable;
-        if (profiler.has_value()) {
-            profiler.value()->start("Guiding-Table");
-            profiler.value()->cmd_start(cmd, "Guiding-Table");
+        guidingBuffers.incrementalStates = buffers.m_incrementalStates;
+        guidingBuffers.refreshRange = buffers.m_guidingRefreshRange;
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "Guiding-Table");
+            m_guidingTable.run(cmd, guidingBuffers, N);
+        }
+
+        if (m_compressed.has_value()) {
+            {
+                WRS_PROFILE_SCOPE(profiler, cmd, "Compress-CMF");
+                m_compressed->run(cmd, buffers.m_compressedBuffers, N);
+            }
+            CompressedCMF::barrier(cmd, buffers.m_compressedBuffers);
+        }
+    }
+
+    /**
+     * Updates the CMF after the weights in [dirtyBegin, dirtyEnd) changed and
+     * refreshes the guiding table entries, which point into or behind the first dirty partition.
+     * Requires an incremental config and a previous build().
+     * Writes to the weights have to be visible to compute shaders.
+     */
+    void update(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint dirtyBegin,
+                host::glsl::uint dirtyEnd,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (!m_incremental.has_value()) {
+            throw std::runtime_error("Cutpoint was not configured for incremental updates");
         }
-        m_guidingTable.run(cmd, guidingBuffers, N);
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
+        const host::glsl::uint firstPartition = m_incremental->update(
+            cmd, incrementalBuffers(buffers), N, dirtyBegin, dirtyEnd, profiler);
+        refreshGuidingTable(cmd, buffers, N, firstPartition, profiler);
+    }
+
+    /// Same as above for an arbitrary list of changed weights.
+    void update(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                std::span<const host::glsl::uint> changedIndices,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (!m_incremental.has_value()) {
+            throw std::runtime_error("Cutpoint was not configured for incremental updates");
         }
+        const host::glsl::uint firstPartition =
+            m_incremental->update(cmd, incrementalBuffers(buffers), N, changedIndices, profiler);
+        refreshGuidingTable(cmd, buffers, N, firstPartition, profiler);
     }
 
     void
@@ -137,26 +265,114 @@ class Cutpoint {
            host::glsl::uint N,
            host::glsl::uint S,
            host::glsl::uint seed = 12345u,
-           [[maybe_unused]] std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+           std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        sample(cmd, buffers, N, S, seed, host::SampleSequence{}, profiler);
+    }
+
+    /// Samples from the points [offset, offset + S) of a low-discrepancy sequence, if the
+    /// sampling kernel uses one (see host::RNGAlgorithm).
+    void
+    sample(const merian::CommandBufferHandle& cmd,
+           const Buffers& buffers,
+           host::glsl::uint N,
+           host::glsl::uint S,
+           host::glsl::uint seed,
+           const host::SampleSequence& sequence,
+           std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        WRS_PROFILE_SCOPE(profiler, cmd, "Sampling");
+        m_sampling.run(cmd, samplingBuffers(buffers), N, S, seed, sequence);
+    }
+
+    /// Reads S and the seed from parameters and is dispatched for maxS samples,
+    /// requires a Cutpoint created with sampleParametersBuffer.
+    void sample(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint maxS,
+                const merian::BufferHandle& parameters,
+                const host::SampleSequence& sequence = {},
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        WRS_PROFILE_SCOPE(profiler, cmd, "Sampling");
+        m_sampling.run(cmd, samplingBuffers(buffers), N, maxS, parameters, sequence);
+    }
+
+    /// Bindings to sample from the built guiding table inline in user shaders
+    /// (see glsl/wrs.glsl).
+    WRSInlineBindings inlineBindings(const Buffers& buffers, host::glsl::uint N) const {
+        if (m_incremental.has_value() || m_compressed.has_value()) {
+            throw std::runtime_error("Cutpoint: inline sampling requires a plain CMF");
+        }
+        WRSInlineBindings bindings;
+        bindings.defines["WRS_CUTPOINT"];
+        bindings.buffers = {buffers.m_cmf, buffers.m_guidingTable};
+        bindings.parameters.N = N;
+        bindings.parameters.guidingTableSize = m_sampling.guidingTableSize(N);
+        return bindings;
+    }
+
+  private:
+    using Kernels = std::tuple<PrefixSum<host::glsl::f32>,
+                               CutpointGuidingTable,
+                               CutpointSampling,
+                               std::optional<IncrementalCMF>,
+                               std::optional<CompressedCMF>>;
+
+    explicit Cutpoint(Kernels&& kernels)
+        : m_scan(std::move(std::get<0>(kernels))),
+          m_guidingTable(std::move(std::get<1>(kernels))),
+          m_sampling(std::move(std::get<2>(kernels))),
+          m_incremental(std::move(std::get<3>(kernels))),
+          m_compressed(std::move(std::get<4>(kernels))) {}
+
+    static std::optional<host::glsl::uint> incrementalPartitionSize(const Config& config) {
+        if (config.incrementalConfig.has_value()) {
+            return config.incrementalConfig->partitionSize();
+        }
+        return std::nullopt;
+    }
+
+    CutpointSampling::Buffers samplingBuffers(const Buffers& buffers) const {
         CutpointSampling::Buffers samplingBuffers;
         samplingBuffers.samples = buffers.samples;
         samplingBuffers.cmf = buffers.m_cmf;
         samplingBuffers.guidingTable = buffers.m_guidingTable;
-        if (profiler.has_value()) {
-            profiler.value()->start("Sampling");
-            profiler.value()->cmd_start(cmd, "Sampling");
-        }
-        m_sampling.run(cmd, samplingBuffers, N, S, seed);
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
+        samplingBuffers.incrementalStates = buffers.m_incrementalStates;
+        if (m_compressed.has_value()) {
+            samplingBuffers.cmf = buffers.m_compressedBuffers.deltas;
+            samplingBuffers.blockBases = buffers.m_compressedBuffers.blockBases;
         }
+        return samplingBuffers;
+    }
+
+    static IncrementalCMF::Buffers incrementalBuffers(const Buffers& buffers) {
+        IncrementalCMF::Buffers incrementalBuffers;
+        incrementalBuffers.weights = buffers.weights;
+        incrementalBuffers.cmf = buffers.m_cmf;
+        incrementalBuffers.states = buffers.m_incrementalStates;
+        return incrementalBuffers;
+    }
+
+    // Entries in front of the first dirty partition still point to the same element,
+    // because the CMF did not change there. All others have to be searched again.
+    void refreshGuidingTable(const merian::CommandBufferHandle& cmd,
+                             const Buffers& buffers,
+                             host::glsl::uint N,
+                             host::glsl::uint firstPartition,
+                             std::optional<merian::ProfilerHandle> profiler) const {
+        CutpointGuidingTable::Buffers guidingBuffers;
+        guidingBuffers.cmf = buffers.m_cmf;
+        guidingBuffers.guidingTable = buffers.m_guidingTable;
+        guidingBuffers.incrementalStates = buffers.m_incrementalStates;
+        guidingBuffers.refreshRange = buffers.m_guidingRefreshRange;
+        WRS_PROFILE_SCOPE(profiler, cmd, "Guiding-Table-Refresh");
+        m_guidingTable.run(cmd, guidingBuffers, N, firstPartition * m_incremental->partitionSize());
     }
 
-  private:
     PrefixSum<host::glsl::f32> m_scan;
     CutpointGuidingTable m_guidingTable;
     CutpointSampling m_sampling;
+    std::optional<IncrementalCMF> m_incremental;
+    std::optional<CompressedCMF> m_compressed;
 };
 
 } // namespace device
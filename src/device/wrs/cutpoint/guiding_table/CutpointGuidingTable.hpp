@@ -18,10 +18,14 @@
 #include "merian/vk/pipeline/specialization_info.hpp"
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/types/glsl.hpp"
+#include <map>
 #include <memory>
+#include <optional>
+#include <stdexcept>
 #include <vulkan/vulkan_enums.hpp>
 #include <vulkan/vulkan_handles.hpp>
 
@@ -49,12 +53,34 @@ struct CutpointGuidingTableBuffers {
     merian::BufferHandle guidingTable;
     using GuidingTableLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
     using GuidingTableView = host::layout::BufferView<GuidingTableLayout>;
+
+    // only bound if the kernel was created for an incremental cmf (see IncrementalCMF.hpp).
+    merian::BufferHandle incrementalStates = nullptr;
+
+    // only incremental, indirect dispatch arguments and the first entry of a refresh.
+    merian::BufferHandle refreshRange = nullptr;
+    using RefreshRangeLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+
+    static merian::BufferHandle allocateRefreshRange(const merian::ResourceAllocatorHandle& alloc) {
+        return alloc->createBuffer(RefreshRangeLayout::size(4),
+                                   vk::BufferUsageFlagBits::eStorageBuffer |
+                                       vk::BufferUsageFlagBits::eIndirectBuffer,
+                                   merian::MemoryMappingType::NONE, "guiding-refresh-range");
+    }
 };
 
 class CutpointGuidingTable {
     struct PushConstants {
         host::glsl::uint N; // cmf size
         host::glsl::uint guidingTableSize;
+        host::glsl::uint refreshBegin;
+        host::glsl::uint partitionSize;
+    };
+
+    struct RefreshRangePushConstants {
+        host::glsl::uint guidingTableSize;
+        host::glsl::uint refreshBegin;
+        host::glsl::uint workgroupSize;
     };
 
   public:
@@ -63,54 +89,107 @@ class CutpointGuidingTable {
 
     explicit CutpointGuidingTable(const merian::ContextHandle& context,
                                   const merian::ShaderCompilerHandle& shaderCompiler,
-                                  Config config)
-        : m_workgroupSize(config.workgroupSize), m_guidingEntrySize(config.guidingEntrySize) {
-
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer()
-                .add_binding_storage_buffer()
-                .build_push_descriptor_layout(context);
+                                  Config config,
+                                  std::optional<host::glsl::uint> incrementalPartitionSize =
+                                      std::nullopt)
+        : m_workgroupSize(config.workgroupSize), m_guidingEntrySize(config.guidingEntrySize),
+          m_incrementalPartitionSize(incrementalPartitionSize) {
 
         const std::string shaderPath = "src/device/wrs/cutpoint/guiding_table/shader.comp";
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(m_workgroupSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
-
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        std::map<std::string, std::string> defines;
+        if (m_incrementalPartitionSize.has_value()) {
+            defines["INCREMENTAL"];
+        }
+
+        pipeline::ComputePipelineBuilder pipelineBuilder(context, shaderCompiler, shaderPath);
+        pipelineBuilder.setDefines(defines)
+            .addStorageBuffer()  // cmf
+            .addStorageBuffer(); // guiding table
+        if (m_incrementalPartitionSize.has_value()) {
+            pipelineBuilder.addStorageBuffer()  // incremental states
+                .addStorageBuffer();            // refresh range
+        }
+        m_pipeline = pipelineBuilder.addPushConstant<PushConstants>()
+                         .addSpecializationConstant(m_workgroupSize)
+                         .build();
+
+        if (m_incrementalPartitionSize.has_value()) {
+            m_refreshRangePipeline =
+                pipeline::ComputePipelineBuilder(
+                    context, shaderCompiler,
+                    "src/device/wrs/cutpoint/guiding_table/refresh_range.comp")
+                    .addStorageBuffer() // guiding table
+                    .addStorageBuffer() // refresh range
+                    .addPushConstant<RefreshRangePushConstants>()
+                    .build();
+        }
     }
 
-    void
-    run(const merian::CommandBufferHandle& cmd, const Buffers& buffers, host::glsl::uint N) const {
-
-        cmd->bind(m_pipeline);
-        cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.guidingTable);
-
+    /// With an incremental cmf and refreshBegin > 0 only the entries which
+    /// point to an element >= refreshBegin are recomputed. They are found by a binary search
+    /// over the guiding table on the device and refreshed with an indirect dispatch.
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint refreshBegin = 0) const {
         host::glsl::uint guidingTableSize = (N + m_guidingEntrySize - 1) / m_guidingEntrySize;
 
-        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
-                                                          .N = N,
-                                                          .guidingTableSize = guidingTableSize,
-                                                      });
+        if (refreshBegin > 0) {
+            if (!m_incrementalPartitionSize.has_value()) {
+                throw std::runtime_error(
+                    "CutpointGuidingTable: a refresh requires an incremental cmf");
+            }
+            cmd->bind(m_refreshRangePipeline);
+            cmd->push_descriptor_set(m_refreshRangePipeline, buffers.guidingTable,
+                                     buffers.refreshRange);
+            cmd->push_constant<RefreshRangePushConstants>(
+                m_refreshRangePipeline, RefreshRangePushConstants{
+                                            .guidingTableSize = guidingTableSize,
+                                            .refreshBegin = refreshBegin,
+                                            .workgroupSize = m_workgroupSize,
+                                        });
+            cmd->dispatch(1, 1, 1);
+            cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                         vk::PipelineStageFlagBits::eDrawIndirect |
+                             vk::PipelineStageFlagBits::eComputeShader,
+                         buffers.refreshRange->buffer_barrier(
+                             vk::AccessFlagBits::eShaderWrite,
+                             vk::AccessFlagBits::eIndirectCommandRead |
+                                 vk::AccessFlagBits::eShaderRead));
+        }
 
-        const uint32_t workgroupCount = (guidingTableSize + m_workgroupSize - 1) / m_workgroupSize;
-        cmd->dispatch(workgroupCount, 1, 1);
+        cmd->bind(m_pipeline);
+        if (m_incrementalPartitionSize.has_value()) {
+            cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.guidingTable,
+                                     buffers.incrementalStates, buffers.refreshRange);
+        } else {
+            cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.guidingTable);
+        }
+
+        cmd->push_constant<PushConstants>(
+            m_pipeline, PushConstants{
+                            .N = N,
+                            .guidingTableSize = guidingTableSize,
+                            .refreshBegin = refreshBegin,
+                            .partitionSize = m_incrementalPartitionSize.value_or(0),
+                        });
+
+        if (refreshBegin > 0) {
+            cmd->dispatch_indirect(buffers.refreshRange);
+        } else {
+            const uint32_t workgroupCount =
+                (guidingTableSize + m_workgroupSize - 1) / m_workgroupSize;
+            cmd->dispatch(workgroupCount, 1, 1);
+        }
     }
 
   private:
     merian::PipelineHandle m_pipeline;
+    merian::PipelineHandle m_refreshRangePipeline;
     host::glsl::uint m_workgroupSize;
     host::glsl::uint m_guidingEntrySize;
+    std::optional<host::glsl::uint> m_incrementalPartitionSize;
 };
 
 } // namespace device
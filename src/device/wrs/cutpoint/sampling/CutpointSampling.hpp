@@ -18,10 +18,17 @@
 #include "merian/vk/pipeline/specialization_info.hpp"
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
+#include "src/host/types/sample_index.hpp"
+#include <fmt/format.h>
+#include <map>
 #include <memory>
+#include <optional>
+#include <stdexcept>
 #include <vulkan/vulkan_enums.hpp>
 #include <vulkan/vulkan_handles.hpp>
 
@@ -33,10 +40,16 @@ class CutpointSamplingConfig {
   public:
     host::glsl::uint workgroupSize;
     host::glsl::uint guidingEntrySize;
+    host::SampleIndexWidth sampleIndexWidth;
+    host::RNGAlgorithm rng;
 
-    explicit constexpr CutpointSamplingConfig(host::glsl::uint workgroupSize,
-                                              host::glsl::uint guidingEntrySize)
-        : workgroupSize(workgroupSize), guidingEntrySize(guidingEntrySize) {}
+    explicit constexpr CutpointSamplingConfig(
+        host::glsl::uint workgroupSize,
+        host::glsl::uint guidingEntrySize,
+        host::SampleIndexWidth sampleIndexWidth = host::SampleIndexWidth::U32,
+        host::RNGAlgorithm rng = host::RNGAlgorithm::HASH)
+        : workgroupSize(workgroupSize), guidingEntrySize(guidingEntrySize),
+          sampleIndexWidth(sampleIndexWidth), rng(rng) {}
 
 };
 
@@ -44,7 +57,7 @@ struct CutpointSamplingBuffers {
     using Self = CutpointSamplingBuffers;
     static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
 
-    merian::BufferHandle cmf; // cummulative mass function
+    merian::BufferHandle cmf; // cummulative mass function (deltas of a compressed cmf)
     using CMFLayout = host::layout::ArrayLayout<float, storageQualifier>;
     using CMFView = host::layout::BufferView<CMFLayout>;
 
@@ -52,16 +65,22 @@ struct CutpointSamplingBuffers {
     using GuidingTableLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
     using GuidingTableView = host::layout::BufferView<GuidingTableLayout>;
 
-    merian::BufferHandle samples;
+    merian::BufferHandle samples; // packed for narrow sample indices (see sample_index.hpp)
     using SamplesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
     using SamplesView = host::layout::BufferView<SamplesLayout>;
 
+    // only bound if the kernel was created for an incremental cmf (see IncrementalCMF.hpp).
+    merian::BufferHandle incrementalStates = nullptr;
+    // only bound if the kernel was created for a compressed cmf (see CompressedCMF.hpp).
+    merian::BufferHandle blockBases = nullptr;
+
     static Self allocate(const merian::ResourceAllocatorHandle& alloc,
                          merian::MemoryMappingType memoryMapping,
                          std::size_t N,
                          std::size_t S,
                          CutpointSamplingConfig config) {
         Self buffers;
+        const std::size_t sampleWordCount = host::sampleWordCount(S, config.sampleIndexWidth);
         if (memoryMapping == merian::MemoryMappingType::NONE) {
             buffers.cmf = alloc->createBuffer(CMFLayout::size(N),
                                               vk::BufferUsageFlagBits::eStorageBuffer |
@@ -72,7 +91,7 @@ struct CutpointSamplingBuffers {
             buffers.guidingTable = alloc->createBuffer(GuidingTableLayout::size(guidingTableSize),
                                                        vk::BufferUsageFlagBits::eStorageBuffer,
                                                        merian::MemoryMappingType::NONE);
-            buffers.samples = alloc->createBuffer(SamplesLayout::size(S),
+            buffers.samples = alloc->createBuffer(SamplesLayout::size(sampleWordCount),
                                                   vk::BufferUsageFlagBits::eStorageBuffer |
                                                       vk::BufferUsageFlagBits::eTransferSrc,
                                                   merian::MemoryMappingType::NONE);
@@ -81,7 +100,8 @@ struct CutpointSamplingBuffers {
                                               vk::BufferUsageFlagBits::eTransferSrc, memoryMapping);
             buffers.guidingTable = nullptr;
             buffers.samples = alloc->createBuffer(
-                SamplesLayout::size(S), vk::BufferUsageFlagBits::eTransferDst, memoryMapping);
+                SamplesLayout::size(sampleWordCount), vk::BufferUsageFlagBits::eTransferDst,
+                memoryMapping);
         }
         return buffers;
     }
@@ -93,6 +113,9 @@ class CutpointSampling {
         host::glsl::uint S;
         host::glsl::uint guidingTableSize;
         host::glsl::uint seed;
+        host::glsl::uint partitionSize; // incremental partition or compressed block size
+        host::glsl::uint dimension;
+        host::glsl::uint sequenceOffset;
     };
 
   public:
@@ -101,59 +124,153 @@ class CutpointSampling {
 
     explicit CutpointSampling(const merian::ContextHandle& context,
                                       const merian::ShaderCompilerHandle& shaderCompiler,
-                                      Config config)
-        : m_workgroupSize(config.workgroupSize), m_guidingEntrySize(config.guidingEntrySize) {
-
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer() // cmf
-                .add_binding_storage_buffer() // guiding table
-                .add_binding_storage_buffer() // samples
-                .build_push_descriptor_layout(context);
+                                      Config config,
+                                      std::optional<host::glsl::uint> incrementalPartitionSize =
+                                          std::nullopt,
+                                      std::optional<host::glsl::uint> compressedBlockSize =
+                                          std::nullopt,
+                                      bool sampleParametersBuffer = false)
+        : m_workgroupSize(config.workgroupSize), m_guidingEntrySize(config.guidingEntrySize),
+          m_sampleIndexWidth(config.sampleIndexWidth),
+          m_sampleParametersBuffer(sampleParametersBuffer),
+          m_incrementalPartitionSize(incrementalPartitionSize),
+          m_compressedBlockSize(compressedBlockSize) {
+        if (m_incrementalPartitionSize.has_value() && m_compressedBlockSize.has_value()) {
+            throw std::runtime_error(
+                "CutpointSampling: a compressed cmf can't be updated incrementally");
+        }
 
         const std::string shaderPath = "src/device/wrs/cutpoint/sampling/shader.comp";
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(m_workgroupSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
+        std::map<std::string, std::string> defines;
+        if (m_incrementalPartitionSize.has_value()) {
+            defines["INCREMENTAL"];
+        }
+        if (m_compressedBlockSize.has_value()) {
+            defines["COMPRESSED"];
+        }
+        if (const auto define = host::sampleIndexDefine(m_sampleIndexWidth)) {
+            defines[*define];
+        }
+        if (m_sampleParametersBuffer) {
+            defines["SAMPLE_PARAMETERS_BUFFER"];
+        }
 
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        pipeline::ComputePipelineBuilder pipelineBuilder(context, shaderCompiler, shaderPath);
+        pipelineBuilder.addIncludePath("src/device/common/")
+            .setDefines(defines)
+            .addStorageBuffer()  // cmf
+            .addStorageBuffer()  // guiding table
+            .addStorageBuffer(); // samples
+        if (m_incrementalPartitionSize.has_value()) {
+            pipelineBuilder.addStorageBuffer(); // incremental states
+        }
+        if (m_compressedBlockSize.has_value()) {
+            pipelineBuilder.addStorageBuffer(); // block bases
+        }
+        if (m_sampleParametersBuffer) {
+            pipelineBuilder.addStorageBuffer(); // sample parameters
+        }
+        m_pipeline = pipelineBuilder.addPushConstant<PushConstants>()
+                         .addSpecializationConstant(m_workgroupSize)
+                         .addSpecializationConstant(host::rngSpecializationConstant(config.rng))
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd,
              const Buffers& buffers,
              host::glsl::uint N,
              host::glsl::uint S,
-             host::glsl::uint seed = 12345u) const {
+             host::glsl::uint seed = 12345u,
+             const host::SampleSequence& sequence = {}) const {
+        if (m_sampleParametersBuffer) {
+            throw std::runtime_error("CutpointSampling: the kernel reads S and seed from a buffer");
+        }
+        record(cmd, buffers, N, S, seed, sequence, nullptr);
+    }
+
+    /**
+     * Reads the sample count and the seed from parameters (see sample_parameters.comp),
+     * such that they can change between submits of the recorded commands.
+     * Dispatched for maxS samples, requires a kernel created with sampleParametersBuffer.
+     */
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint maxS,
+             const merian::BufferHandle& parameters,
+             const host::SampleSequence& sequence = {}) const {
+        if (!m_sampleParametersBuffer) {
+            throw std::runtime_error(
+                "CutpointSampling: the kernel reads S and seed from push constants");
+        }
+        record(cmd, buffers, N, maxS, 0, sequence, parameters);
+    }
+
+    host::glsl::uint guidingTableSize(host::glsl::uint N) const {
+        return (N + m_guidingEntrySize - 1) / m_guidingEntrySize;
+    }
+
+  private:
+    // S is the dispatched sample count, S and seed are ignored if the kernel reads them
+    // from the parameters.
+    void record(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint S,
+                host::glsl::uint seed,
+                const host::SampleSequence& sequence,
+                const merian::BufferHandle& parameters) const {
+        if (!host::sampleIndexWidthFits(N, m_sampleIndexWidth)) {
+            throw std::runtime_error(
+                fmt::format("CutpointSampling: N = {} exceeds the {} sample indices", N,
+                            host::sampleIndexWidthName(m_sampleIndexWidth)));
+        }
 
         cmd->bind(m_pipeline);
-        cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.guidingTable, buffers.samples);
+        const bool hasCMFState =
+            m_incrementalPartitionSize.has_value() || m_compressedBlockSize.has_value();
+        const merian::BufferHandle& cmfState = m_incrementalPartitionSize.has_value()
+                                                   ? buffers.incrementalStates
+                                                   : buffers.blockBases;
+        if (hasCMFState && m_sampleParametersBuffer) {
+            cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.guidingTable,
+                                     buffers.samples, cmfState, parameters);
+        } else if (hasCMFState) {
+            cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.guidingTable,
+                                     buffers.samples, cmfState);
+        } else if (m_sampleParametersBuffer) {
+            cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.guidingTable,
+                                     buffers.samples, parameters);
+        } else {
+            cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.guidingTable,
+                                     buffers.samples);
+        }
 
-        host::glsl::uint guidingTableSize = (N + m_guidingEntrySize - 1) / m_guidingEntrySize;
+        const host::glsl::uint guidingTableSize = this->guidingTableSize(N);
 
-        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
-                                                          .N = N,
-                                                          .S = S,
-                                                          .guidingTableSize = guidingTableSize,
-                                                          .seed = seed,
-                                                      });
+        cmd->push_constant<PushConstants>(
+            m_pipeline, PushConstants{
+                            .N = N,
+                            .S = S,
+                            .guidingTableSize = guidingTableSize,
+                            .seed = seed,
+                            .partitionSize = m_incrementalPartitionSize.value_or(
+                                m_compressedBlockSize.value_or(0)),
+                            .dimension = sequence.dimension,
+                            .sequenceOffset = sequence.offset,
+                        });
         const uint32_t workgroupCount = (S + m_workgroupSize - 1) / m_workgroupSize;
         cmd->dispatch(workgroupCount, 1, 1);
     }
 
-  private:
     merian::PipelineHandle m_pipeline;
     host::glsl::uint m_workgroupSize;
     host::glsl::uint m_guidingEntrySize;
+    host::SampleIndexWidth m_sampleIndexWidth;
+    bool m_sampleParametersBuffer;
+    std::optional<host::glsl::uint> m_incrementalPartitionSize;
+    std::optional<host::glsl::uint> m_compressedBlockSize;
 };
 
 } // namespace device
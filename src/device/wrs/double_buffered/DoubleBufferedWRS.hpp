@@ -0,0 +1,213 @@
+#pragma once
+/**
+ * @filename    : DoubleBufferedWRS.hpp
+ *
+ * Double buffered wrapper around WRS for frame loops, which rebuild the distribution
+ * every frame. Building and sampling in the same command buffer makes the sampling wait
+ * for the full build.
+ *
+ * The wrapper owns two sets of WRS buffers. While generation k is sampled on the
+ * sample queue from the front buffers, generation k+1 is built on the (async compute)
+ * build queue into the back buffers. swap() makes the last build the front.
+ *
+ * Synchronization is done with two timeline semaphores:
+ * - built   : signaled by every build, sampling waits for the build of the front buffers.
+ * - sampled : signaled by every sampling submit, a build waits for the last sampling,
+ *             which reads the buffers it is going to overwrite.
+ * Builds wait for the previous build, therefore they never overlap each other.
+ *
+ * Both queues have to be of the same queue family, the buffers are not transferred
+ * between queue families.
+ *
+ * Example:
+ * DoubleBufferedWRS wrs{context, shaderCompiler, alloc, config, N, S,
+ *                       context->get_queue_GCT(), context->get_queue_C()};
+ * wrs.build(N, uploadWeights);
+ * wrs.swap();
+ * for (frame) {
+ *     wrs.build(N, uploadWeights); // generation k+1
+ *     cmd->begin();
+ *     wrs.sample(cmd, S, seed);    // generation k
+ *     ... consume wrs.front().samples
+ *     cmd->end();
+ *     wrs.submitSampling(cmd);
+ *     wrs.swap();
+ * }
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/command/command_pool.hpp"
+#include "merian/vk/command/queue.hpp"
+#include "merian/vk/memory/resource_allocator.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "merian/vk/sync/semaphore_timeline.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/wrs/WRS.hpp"
+#include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace device {
+
+class DoubleBufferedWRS {
+  public:
+    using Buffers = WRS::Buffers;
+    using Config = WRS::Config;
+    /// Records writing the weights of the next generation into buffers.weights.
+    using RecordWeights =
+        std::function<void(const merian::CommandBufferHandle& cmd, const Buffers& buffers)>;
+
+    DoubleBufferedWRS(const merian::ContextHandle& context,
+                      const merian::ShaderCompilerHandle& shaderCompiler,
+                      const merian::ResourceAllocatorHandle& alloc,
+                      const Config& config,
+                      host::glsl::uint N,
+                      host::glsl::uint S,
+                      const merian::QueueHandle& sampleQueue,
+                      const merian::QueueHandle& buildQueue)
+        : m_wrs(context, shaderCompiler, config), m_sampleQueue(sampleQueue),
+          m_buildQueue(buildQueue),
+          m_buildCmdPool(std::make_shared<merian::CommandPool>(buildQueue)),
+          m_built(std::make_shared<merian::TimelineSemaphore>(context, 0)),
+          m_sampled(std::make_shared<merian::TimelineSemaphore>(context, 0)) {
+        if (sampleQueue->get_queue_family_index() != buildQueue->get_queue_family_index()) {
+            throw std::runtime_error(
+                "DoubleBufferedWRS: the sample and build queue have to be of the same family");
+        }
+        for (Slot& slot : m_slots) {
+            slot.buffers =
+                Buffers::allocate(alloc, merian::MemoryMappingType::NONE, N, S, config);
+        }
+    }
+
+    DoubleBufferedWRS(const DoubleBufferedWRS&) = delete;
+    DoubleBufferedWRS& operator=(const DoubleBufferedWRS&) = delete;
+
+    ~DoubleBufferedWRS() {
+        // the command buffers of pending builds and the semaphores have to outlive the submits.
+        wait();
+    }
+
+    /**
+     * Records the build of the next generation into the back buffers and submits it
+     * to the build queue, it does not wait for the build.
+     * Blocks only if the previous build into the back buffers is still executing.
+     * Calling build again before swap() replaces the pending generation.
+     */
+    void build(host::glsl::uint N,
+               const RecordWeights& recordWeights,
+               std::optional<merian::ProfilerHandle> profiler = std::nullopt) {
+        Slot& slot = m_slots[backIndex()];
+        // the previous command buffer of the slot is released below.
+        m_built->wait(slot.builtValue);
+
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(m_buildCmdPool);
+        cmd->begin();
+        recordWeights(cmd, slot.buffers);
+        m_wrs.build(cmd, slot.buffers, N, profiler);
+        cmd->end();
+
+        const std::uint64_t previousBuild = m_buildValue++;
+        m_buildQueue->submit(cmd, {}, {m_built}, {m_built, m_sampled},
+                             {vk::PipelineStageFlagBits::eAllCommands,
+                              vk::PipelineStageFlagBits::eAllCommands},
+                             {previousBuild, slot.sampledValue}, {m_buildValue});
+        slot.buildCmd = cmd;
+        slot.builtValue = m_buildValue;
+        slot.N = N;
+        m_pendingBuild = true;
+    }
+
+    /// Makes the last build the front, which is sampled from now on.
+    void swap() {
+        if (!m_pendingBuild) {
+            throw std::runtime_error("DoubleBufferedWRS: swap without a new build");
+        }
+        m_front = backIndex();
+        m_pendingBuild = false;
+    }
+
+    /// Records sampling from the front buffers into cmd, submit it with submitSampling().
+    void sample(const merian::CommandBufferHandle& cmd,
+                host::glsl::uint S,
+                host::glsl::uint seed = 12345u,
+                const host::SampleSequence& sequence = {},
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        const Slot& slot = frontSlot();
+        m_wrs.sample(cmd, slot.buffers, slot.N, S, seed, sequence, profiler);
+    }
+
+    /**
+     * Submits cmd, which contains sample() of the current front, to the sample queue.
+     * The submit waits on the device for the build of the front.
+     * The caller keeps cmd alive until it is executed.
+     */
+    void submitSampling(const merian::CommandBufferHandle& cmd) {
+        Slot& slot = frontSlot();
+        m_sampleQueue->submit(cmd, {}, {m_sampled}, {m_built},
+                              {vk::PipelineStageFlagBits::eComputeShader}, {slot.builtValue},
+                              {++m_sampleValue});
+        slot.sampledValue = m_sampleValue;
+    }
+
+    /// Buffers of the generation, which is sampled, samples are written into front().samples.
+    const Buffers& front() const {
+        return frontSlot().buffers;
+    }
+
+    host::glsl::uint frontN() const {
+        return frontSlot().N;
+    }
+
+    /// Blocks until all submitted builds and samplings are executed.
+    void wait() const {
+        m_built->wait(m_buildValue);
+        m_sampled->wait(m_sampleValue);
+    }
+
+  private:
+    struct Slot {
+        Buffers buffers;
+        host::glsl::uint N = 0;
+        merian::CommandBufferHandle buildCmd;
+        std::uint64_t builtValue = 0;   // value of m_built after the last build
+        std::uint64_t sampledValue = 0; // value of m_sampled after the last sampling
+    };
+
+    std::size_t backIndex() const {
+        return m_front.has_value() ? 1 - *m_front : 0;
+    }
+
+    const Slot& frontSlot() const {
+        if (!m_front.has_value()) {
+            throw std::runtime_error("DoubleBufferedWRS: sampling before the first swap");
+        }
+        return m_slots[*m_front];
+    }
+
+    Slot& frontSlot() {
+        return const_cast<Slot&>(std::as_const(*this).frontSlot());
+    }
+
+    WRS m_wrs;
+    merian::QueueHandle m_sampleQueue;
+    merian::QueueHandle m_buildQueue;
+    merian::CommandPoolHandle m_buildCmdPool;
+
+    merian::TimelineSemaphoreHandle m_built;
+    merian::TimelineSemaphoreHandle m_sampled;
+    std::uint64_t m_buildValue = 0;
+    std::uint64_t m_sampleValue = 0;
+
+    std::array<Slot, 2> m_slots;
+    std::optional<std::size_t> m_front;
+    bool m_pendingBuild = false;
+};
+
+} // namespace device
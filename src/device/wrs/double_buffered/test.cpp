@@ -0,0 +1,191 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/wrs/double_buffered/DoubleBufferedWRS.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include "src/host/memory/FallbackResource.hpp"
+#include "src/host/memory/SafeResource.hpp"
+#include "src/host/memory/StackResource.hpp"
+#include "src/host/statistics/js_divergence.hpp"
+#include <array>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <random>
+#include <spdlog/spdlog.h>
+
+namespace device::test::double_buffered {
+
+using Algorithm = DoubleBufferedWRS;
+using Buffers = Algorithm::Buffers;
+using Config = Algorithm::Config;
+
+struct TestCase {
+    Config config;
+    host::glsl::uint N;
+    host::Distribution distribution;
+    host::glsl::uint S;
+    uint32_t generations;
+};
+
+static const TestCase TEST_CASES[] = {
+    TestCase{
+        .config = CutpointConfig(DecoupledPrefixSumConfig(512, 8, BlockScanVariant::RANKED_STRIDED),
+                                 32),
+        .N = static_cast<host::glsl::uint>(1e6),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = static_cast<host::glsl::uint>(1e6),
+        .generations = 6,
+    },
+    TestCase{
+        .config = AliasTableConfig(PSAConfig(AtomicMeanConfig(),
+                                             DecoupledPrefixPartitionConfig(),
+                                             InlineSplitPackConfig(2),
+                                             false),
+                                   SampleAliasTableConfig(128)),
+        .N = static_cast<host::glsl::uint>(1e6) + 17,
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .S = static_cast<host::glsl::uint>(2e6),
+        .generations = 6,
+    },
+};
+
+/// The weights of generation g are zero for all indices with a different parity than g,
+/// therefore samples of the wrong generation are detected.
+static std::pmr::vector<float> generateWeights(const TestCase& testCase,
+                                               uint32_t generation,
+                                               std::pmr::memory_resource* resource) {
+    std::pmr::vector<float> weights =
+        host::pmr::generate_weights<float>(testCase.distribution, testCase.N, resource);
+    for (host::glsl::uint i = 0; i < testCase.N; ++i) {
+        if (i % 2 != generation % 2) {
+            weights[i] = 0.0f;
+        }
+    }
+    return weights;
+}
+
+static bool runTestCase(const host::test::TestContext& context,
+                        const TestCase& testCase,
+                        std::pmr::memory_resource* resource) {
+    const host::glsl::uint N = testCase.N;
+    const host::glsl::uint S = testCase.S;
+    std::string testName = fmt::format(
+        "{{{},N={},distribution={},S={}}}", wrsConfigName(testCase.config), N,
+        host::distribution_to_pretty_string(testCase.distribution), S);
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    const merian::QueueHandle buildQueue = context.context->get_queue_C();
+    Algorithm kernel{context.context, context.shaderCompiler, context.alloc, testCase.config,
+                     N, S, context.queue, buildQueue};
+
+    // one stage per generation parity, the build of a generation only reuses the stage of
+    // the generation before last, whose build has finished.
+    std::array<Buffers, 2> stages;
+    for (Buffers& stage : stages) {
+        stage = Buffers::allocate(context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+                                  N, S, testCase.config);
+    }
+
+    std::mt19937 rng{std::random_device{}()};
+    std::uniform_int_distribution<host::glsl::uint> seedDist;
+
+    std::vector<std::pmr::vector<float>> generationWeights;
+    const auto build = [&](uint32_t generation) {
+        generationWeights.push_back(generateWeights(testCase, generation, resource));
+        const Buffers& stage = stages[generation % 2];
+        const std::pmr::vector<float>& weights = generationWeights.back();
+        kernel.build(N, [&](const merian::CommandBufferHandle& cmd, const Buffers& buffers) {
+            Buffers::WeightsView stageView{stage.weights, N};
+            Buffers::WeightsView localView{buffers.weights, N};
+            stageView.upload<float>(weights);
+            stageView.copyTo(cmd, localView);
+            localView.expectComputeRead(cmd);
+        });
+    };
+
+    MERIAN_PROFILE_SCOPE(context.profiler, testName);
+    bool failed = false;
+    build(0);
+    kernel.swap();
+    for (uint32_t generation = 0; generation < testCase.generations; ++generation) {
+        // 1. Build the next generation, while the current one is sampled
+        if (generation + 1 < testCase.generations) {
+            build(generation + 1);
+        }
+
+        // 2. Sample the current generation
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        kernel.sample(cmd, S, seedDist(rng));
+        Buffers::SamplesView localSamples{kernel.front().samples, S};
+        Buffers::SamplesView stageSamples{stages[generation % 2].samples, S};
+        localSamples.expectComputeWrite();
+        localSamples.copyTo(cmd, stageSamples);
+        stageSamples.expectHostRead(cmd);
+        cmd->end();
+        kernel.submitSampling(cmd);
+        kernel.wait();
+
+        // 3. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            const std::vector<host::glsl::uint> samples =
+                stageSamples.download<host::glsl::uint>();
+            const std::pmr::vector<float>& weights = generationWeights[generation];
+            for (host::glsl::uint s = 0; s < S; ++s) {
+                if (samples[s] >= N || weights[samples[s]] == 0.0f) {
+                    SPDLOG_ERROR("Generation {}: invalid sample {} at {}", generation,
+                                 samples[s], s);
+                    failed = true;
+                    break;
+                }
+            }
+            const float jsDivergence =
+                host::js_divergence<host::glsl::uint, host::glsl::f32>(samples, weights);
+            SPDLOG_DEBUG("Generation {}: JS-Divergence: {}", generation, jsDivergence);
+            if (jsDivergence > 0.15) {
+                SPDLOG_ERROR("Generation {} displays a significant bias", generation);
+                failed = true;
+            }
+        }
+
+        if (generation + 1 < testCase.generations) {
+            kernel.swap();
+        }
+    }
+    context.profiler->collect(true, true);
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing double buffered WRS");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    host::memory::StackResource stackResource{4096 * 2048};
+    host::memory::FallbackResource fallbackResource{&stackResource};
+    host::memory::SafeResource safeResource{&fallbackResource};
+
+    std::pmr::memory_resource* resource = &safeResource;
+
+    uint32_t failCount = 0;
+    for (const auto& testCase : TEST_CASES) {
+        if (runTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+
+    testContext.profiler->collect(true, true);
+    SPDLOG_INFO(fmt::format("Profiler results: \n{}",
+                            merian::Profiler::get_report_str(testContext.profiler->get_report())));
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
+                                 sizeof(TEST_CASES) / sizeof(TestCase)));
+    }
+}
+
+} // namespace device::test::double_buffered
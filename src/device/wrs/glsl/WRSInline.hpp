@@ -0,0 +1,55 @@
+#pragma once
+/**
+ * @filename    : WRSInline.hpp
+ *
+ * Host side of the inline GLSL samplers (wrs.glsl, wrs_alias.glsl, wrs_its.glsl,
+ * wrs_cutpoint.glsl), which sample from a built table directly in user shaders,
+ * without writing S indices to a samples buffer.
+ *
+ * Example:
+ * const WRSInlineBindings bindings = wrs.inlineBindings(buffers, N);
+ * pipeline::ComputePipelineBuilder builder(context, shaderCompiler, "user.comp");
+ * builder.setDefines(bindings.defines).addStorageBuffer(); // user buffers first
+ * m_pipeline = bindings.addTo(builder).addPushConstant<PushConstants>().build();
+ * with #define WRS_BINDING 1 and #include "wrs.glsl" in user.comp.
+ */
+
+#include "merian/vk/memory/resource_allocations.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/host/types/glsl.hpp"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace device {
+
+/// Mirrors WRSParameters of wrs_common.glsl.
+struct WRSInlineParameters {
+    host::glsl::uint N;
+    host::glsl::uint guidingTableSize; // only cutpoint
+    host::glsl::uint aliasBits;        // only packed alias tables
+    host::glsl::uint probabilityBits;  // only packed alias tables
+};
+
+struct WRSInlineBindings {
+    static constexpr const char* INCLUDE_PATH = "src/device/wrs/glsl/";
+    // rng.comp, which wrs_random.glsl builds on.
+    static constexpr const char* COMMON_INCLUDE_PATH = "src/device/common/";
+
+    // select the sampler in wrs.glsl, have to be part of the defines of the user shader.
+    std::map<std::string, std::string> defines;
+    // bound to WRS_BINDING, WRS_BINDING + 1, ...
+    std::vector<merian::BufferHandle> buffers;
+    WRSInlineParameters parameters{};
+
+    /// Adds the include path and a storage buffer per binding to a user pipeline.
+    pipeline::ComputePipelineBuilder& addTo(pipeline::ComputePipelineBuilder& builder) const {
+        builder.addIncludePath(INCLUDE_PATH).addIncludePath(COMMON_INCLUDE_PATH);
+        for (std::size_t i = 0; i < buffers.size(); ++i) {
+            builder.addStorageBuffer();
+        }
+        return builder;
+    }
+};
+
+} // namespace device
@@ -0,0 +1,275 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/prefix_sum/block_scan/BlockScanVariant.hpp"
+#include "src/device/wrs/WRS.hpp"
+#include "src/device/wrs/glsl/WRSInline.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include "src/host/memory/FallbackResource.hpp"
+#include "src/host/memory/SafeResource.hpp"
+#include "src/host/memory/StackResource.hpp"
+#include "src/host/statistics/chi_square.hpp"
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <random>
+#include <spdlog/spdlog.h>
+
+namespace device::test::wrs_inline {
+
+using Buffers = WRS::Buffers;
+using Config = WRS::Config;
+
+struct TestCase {
+    Config config;
+    host::glsl::uint N;
+    host::Distribution distribution;
+    host::glsl::uint S;
+    uint32_t iterations;
+};
+
+static constexpr TestCase TEST_CASES[] = {
+    TestCase{
+        .config = AliasTableConfig(PSAConfig(AtomicMeanConfig(),
+                                             DecoupledPrefixPartitionConfig(),
+                                             InlineSplitPackConfig(2),
+                                             false),
+                                   SampleAliasTableConfig(128)),
+        .N = static_cast<host::glsl::uint>(1e5),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = static_cast<host::glsl::uint>(1e7),
+        .iterations = 2,
+    },
+    TestCase{
+        .config = AliasTableConfig(PSAConfig(AtomicMeanConfig(),
+                                             DecoupledPrefixPartitionConfig(),
+                                             InlineSplitPackConfig(2),
+                                             false),
+                                   SampleAliasTableConfig(128),
+                                   std::nullopt,
+                                   AliasTableQuantizeConfig()),
+        .N = static_cast<host::glsl::uint>(1e5),
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .S = static_cast<host::glsl::uint>(1e7),
+        .iterations = 2,
+    },
+    TestCase{
+        .config = ITSConfig(),
+        .N = static_cast<host::glsl::uint>(1e5),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = static_cast<host::glsl::uint>(1e7),
+        .iterations = 2,
+    },
+    TestCase{
+        .config = CutpointConfig( //
+            DecoupledPrefixSumConfig(512, 8, BlockScanVariant::RANKED_STRIDED),
+            32),
+        .N = static_cast<host::glsl::uint>(1e5),
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .S = static_cast<host::glsl::uint>(1e7),
+        .iterations = 2,
+    },
+};
+
+/// User kernel of the test, which draws the samples inline (see test.comp).
+class InlineHistogram {
+    struct PushConstants {
+        WRSInlineParameters wrs;
+        host::glsl::uint S;
+        host::glsl::uint seed;
+    };
+
+  public:
+    static constexpr host::glsl::uint WORKGROUP_SIZE = 512;
+
+    InlineHistogram(const merian::ContextHandle& context,
+                    const merian::ShaderCompilerHandle& shaderCompiler,
+                    const WRSInlineBindings& bindings) {
+        pipeline::ComputePipelineBuilder builder(context, shaderCompiler,
+                                                 "src/device/wrs/glsl/test.comp");
+        builder.setDefines(bindings.defines).addStorageBuffer(); // histogram
+        m_pipeline = bindings.addTo(builder)
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(WORKGROUP_SIZE)
+                         .build();
+    }
+
+    void run(const merian::CommandBufferHandle& cmd,
+             const merian::BufferHandle& histogram,
+             const WRSInlineBindings& bindings,
+             host::glsl::uint S,
+             host::glsl::uint seed) const {
+        cmd->bind(m_pipeline);
+        if (bindings.buffers.size() == 1) {
+            cmd->push_descriptor_set(m_pipeline, histogram, bindings.buffers[0]);
+        } else {
+            cmd->push_descriptor_set(m_pipeline, histogram, bindings.buffers[0],
+                                     bindings.buffers[1]);
+        }
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
+                                                          .wrs = bindings.parameters,
+                                                          .S = S,
+                                                          .seed = seed,
+                                                      });
+        cmd->dispatch((S + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+};
+
+using HistogramLayout =
+    host::layout::ArrayLayout<host::glsl::uint, host::glsl::StorageQualifier::std430>;
+using HistogramView = host::layout::BufferView<HistogramLayout>;
+
+static bool runTestCase(const host::test::TestContext& context,
+                        const TestCase& testCase,
+                        std::pmr::memory_resource* resource) {
+    const host::glsl::uint N = testCase.N;
+    const host::glsl::uint S = testCase.S;
+    std::string testName = fmt::format("{{{},N={},S={}}}", wrsConfigName(testCase.config), N, S);
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    // the samples buffer is never written, such that it only has to hold a single sample.
+    Buffers buffers =
+        Buffers::allocate(context.alloc, merian::MemoryMappingType::NONE, N, 1, testCase.config);
+    Buffers stage = Buffers::allocate(context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+                                      N, 1, testCase.config);
+    const merian::BufferHandle histogram = context.alloc->createBuffer(
+        HistogramLayout::size(N),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst |
+            vk::BufferUsageFlagBits::eTransferSrc,
+        merian::MemoryMappingType::NONE);
+    const merian::BufferHandle histogramStage =
+        context.alloc->createBuffer(HistogramLayout::size(N), vk::BufferUsageFlagBits::eTransferDst,
+                                    merian::MemoryMappingType::HOST_ACCESS_RANDOM);
+
+    WRS wrs{context.context, context.shaderCompiler, testCase.config};
+    const WRSInlineBindings bindings = wrs.inlineBindings(buffers, N);
+    InlineHistogram kernel{context.context, context.shaderCompiler, bindings};
+
+    std::mt19937 rng{std::random_device{}()};
+    std::uniform_int_distribution<host::glsl::uint> seedDist;
+
+    bool failed = false;
+    for (size_t it = 0; it < testCase.iterations; ++it) {
+        MERIAN_PROFILE_SCOPE(context.profiler, testName);
+        context.queue->wait_idle();
+
+        // 1. Generate input
+        context.profiler->start("Generate test input");
+        const auto weights = host::pmr::generate_weights<float>(testCase.distribution, N, resource);
+        context.profiler->end();
+
+        // 2. Begin recoding
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        std::string recordingLabel = fmt::format("Recording : {}", testName);
+        context.profiler->start(recordingLabel);
+        context.profiler->cmd_start(cmd, recordingLabel);
+
+        // 3. Upload weights and build
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Upload test case");
+            Buffers::WeightsView stageView{stage.weights, N};
+            Buffers::WeightsView localView{buffers.weights, N};
+            stageView.upload<float>(weights);
+            stageView.copyTo(cmd, localView);
+            localView.expectComputeRead(cmd);
+        }
+        wrs.build(cmd, buffers, N, context.profiler);
+
+        // 4. Sample inline
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Inline sampling");
+            HistogramView localView{histogram, N};
+            localView.zero(cmd);
+            localView.expectComputeRead(cmd);
+            kernel.run(cmd, histogram, bindings, S, seedDist(rng));
+        }
+
+        // 5. Download results to stage
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Download results to stage");
+            HistogramView localView{histogram, N};
+            HistogramView stageView{histogramStage, N};
+            localView.expectComputeWrite();
+            localView.copyTo(cmd, stageView);
+            stageView.expectHostRead(cmd);
+        }
+
+        // 6. Submit to device
+        context.profiler->end();
+        context.profiler->cmd_end(cmd);
+        cmd->end();
+        context.queue->submit_wait(cmd);
+
+        // 7. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            const auto counts =
+                HistogramView{histogramStage, N}
+                    .download<host::glsl::uint, host::pmr_alloc<host::glsl::uint>>(resource);
+            double totalWeight = 0.0;
+            for (const float w : weights) {
+                totalWeight += w;
+            }
+            uint64_t total = 0;
+            double chi2 = 0.0;
+            std::size_t df = 0;
+            for (host::glsl::uint i = 0; i < N; ++i) {
+                total += counts[i];
+                if (weights[i] == 0.0f) {
+                    continue;
+                }
+                const double expected = weights[i] / totalWeight * S;
+                chi2 += (counts[i] - expected) * (counts[i] - expected) / expected;
+                df++;
+            }
+            if (total != S) {
+                SPDLOG_ERROR("Expected {} samples, got {}", S, total);
+                failed = true;
+            }
+            const double zScore = host::chi_square_z_score(chi2, df - 1);
+            SPDLOG_INFO("Chi-Square z-score: {}", zScore);
+            if (zScore > 6.0) {
+                SPDLOG_ERROR("{} displays a significant bias", wrsConfigName(testCase.config));
+                failed = true;
+            }
+        }
+        context.profiler->collect(true, true);
+    }
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing inline GLSL sampling");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    host::memory::StackResource stackResource{4096 * 2048};
+    host::memory::FallbackResource fallbackResource{&stackResource};
+    host::memory::SafeResource safeResource{&fallbackResource};
+
+    std::pmr::memory_resource* resource = &safeResource;
+
+    uint32_t failCount = 0;
+    for (const auto& testCase : TEST_CASES) {
+        if (runTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+
+    testContext.profiler->collect(true, true);
+    SPDLOG_INFO(fmt::format("Profiler results: \n{}",
+                            merian::Profiler::get_report_str(testContext.profiler->get_report())));
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
+                                 sizeof(TEST_CASES) / sizeof(TestCase)));
+    }
+}
+
+} // namespace device::test::wrs_inline
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "merian/vk/context.hpp"
+
+namespace device::test::wrs_inline {
+
+void test(const merian::ContextHandle& context);
+
+}
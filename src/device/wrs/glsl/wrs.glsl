@@ -0,0 +1,26 @@
+#ifndef WRS_GLSL
+#define WRS_GLSL
+
+// Includes the inline sampler selected by the defines of device::WRSInlineBindings,
+// such that user shaders do not depend on the method:
+//
+//   #include "wrs.glsl"
+//   ...
+//   uint state = wrs_seed(pc.seed, gl_GlobalInvocationID.x);
+//   const uint i = wrs_sample(pc.wrs, state);
+//
+// The random state builds on src/device/common/rng.comp, which is included as well.
+// Shaders, which select a generator of rng.comp with RNG_CONSTANT_ID, have to define it
+// before including wrs.glsl.
+
+#if defined(WRS_ALIAS)
+#include "wrs_alias.glsl"
+#elif defined(WRS_ITS)
+#include "wrs_its.glsl"
+#elif defined(WRS_CUTPOINT)
+#include "wrs_cutpoint.glsl"
+#else
+#error "wrs.glsl requires one of WRS_ALIAS, WRS_ITS or WRS_CUTPOINT"
+#endif
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef WRS_ALIAS_GLSL
+#define WRS_ALIAS_GLSL
+
+// Inline sampling from an alias table built by device::AliasTable.
+//
+// Bindings:
+//   WRS_BINDING + 0 : alias table, or the packed table (WRS_ALIAS_PACKED)
+//                     or the unorm16 probabilities (WRS_ALIAS_SPLIT16)
+//   WRS_BINDING + 1 : aliases (only WRS_ALIAS_SPLIT16)
+// see host::AliasTableQuantization for the quantized formats.
+
+#include "wrs_common.glsl"
+
+#if defined(WRS_ALIAS_PACKED)
+layout(set = WRS_SET, binding = WRS_BINDING) readonly buffer WRSPackedAliasTable {
+    uint wrs_packedAliasTable[]; // (quantized p << aliasBits) | a
+};
+#elif defined(WRS_ALIAS_SPLIT16)
+layout(set = WRS_SET, binding = WRS_BINDING) readonly buffer WRSAliasProbabilities {
+    uint wrs_aliasProbabilities[]; // two unorm16 per uint
+};
+
+layout(set = WRS_SET, binding = WRS_BINDING + 1) readonly buffer WRSAliases {
+    uint wrs_aliases[];
+};
+#else
+struct WRSAliasTableEntry {
+    float p;
+    uint a;
+};
+
+layout(set = WRS_SET, binding = WRS_BINDING) readonly buffer WRSAliasTable {
+    WRSAliasTableEntry wrs_aliasTable[];
+};
+#endif
+
+// u in [0,1)^2, u.x selects the entry and u.y decides between the entry and its alias.
+uint wrs_sample(const WRSParameters params, const vec2 u) {
+    const uint i = min(uint(u.x * float(params.N)), params.N - 1);
+#if defined(WRS_ALIAS_PACKED)
+    const uint entry = wrs_packedAliasTable[i];
+    const float p = float(entry >> params.aliasBits) /
+                    float((1u << params.probabilityBits) - 1);
+    return u.y < p ? i : entry & ((1u << params.aliasBits) - 1);
+#elif defined(WRS_ALIAS_SPLIT16)
+    const float p = float((wrs_aliasProbabilities[i / 2] >> (16 * (i % 2))) & 0xFFFFu) / 65535.0;
+    return u.y < p ? i : wrs_aliases[i];
+#else
+    const WRSAliasTableEntry entry = wrs_aliasTable[i];
+    return u.y < entry.p ? i : entry.a;
+#endif
+}
+
+uint wrs_sample(const WRSParameters params, inout uint state) {
+    return wrs_sample(params, wrs_uniform2(state));
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef WRS_CMF_GLSL
+#define WRS_CMF_GLSL
+
+// CMF binding shared by the ITS and cutpoint samplers.
+
+#include "wrs_common.glsl"
+
+layout(set = WRS_SET, binding = WRS_BINDING) readonly buffer WRSCMF {
+    float wrs_cmf[]; // inclusive
+};
+
+// First index in [lo, hi] with cmf > target, requires cmf[hi] > target.
+uint wrs_searchCMF(uint lo, uint hi, const float target) {
+    while (lo < hi) {
+        const uint mid = (lo + hi) / 2;
+        if (target >= wrs_cmf[mid]) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+#endif
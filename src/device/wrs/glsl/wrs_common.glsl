@@ -0,0 +1,26 @@
+#ifndef WRS_COMMON_GLSL
+#define WRS_COMMON_GLSL
+
+// Shared declarations of the inline samplers.
+// The buffers of a sampler are bound to consecutive bindings starting at WRS_BINDING
+// in the set WRS_SET, see device::WRSInlineBindings for the host side.
+
+#ifndef WRS_SET
+#define WRS_SET 0
+#endif
+
+#ifndef WRS_BINDING
+#define WRS_BINDING 0
+#endif
+
+#include "wrs_random.glsl"
+
+// Mirrors device::WRSInlineParameters, usually part of the push constants of the user shader.
+struct WRSParameters {
+    uint N;
+    uint guidingTableSize; // only cutpoint
+    uint aliasBits;        // only packed alias tables
+    uint probabilityBits;  // only packed alias tables
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef WRS_CUTPOINT_GLSL
+#define WRS_CUTPOINT_GLSL
+
+// Inline cutpoint sampling, the guiding table built by device::Cutpoint narrows
+// the binary search over the CMF to a single guide interval.
+//
+// Bindings:
+//   WRS_BINDING + 0 : cmf
+//   WRS_BINDING + 1 : guiding table
+
+#include "wrs_cmf.glsl"
+
+layout(set = WRS_SET, binding = WRS_BINDING + 1) readonly buffer WRSGuidingTable {
+    uint wrs_guidingTable[];
+};
+
+// u in [0,1)^2, only u.x is used.
+uint wrs_sample(const WRSParameters params, const vec2 u) {
+    const float target = u.x * wrs_cmf[params.N - 1];
+    const uint guide = min(uint(u.x * float(params.guidingTableSize)),
+                           params.guidingTableSize - 1);
+    // the guides are computed in float, fall back to the full range on rounding.
+    uint lo = wrs_guidingTable[guide];
+    if (lo > 0 && target < wrs_cmf[lo - 1]) {
+        lo = 0;
+    }
+    uint hi = params.N - 1;
+    if (guide + 1 < params.guidingTableSize) {
+        hi = wrs_guidingTable[guide + 1];
+        if (target >= wrs_cmf[hi]) {
+            hi = params.N - 1;
+        }
+    }
+    return wrs_searchCMF(lo, hi, target);
+}
+
+uint wrs_sample(const WRSParameters params, inout uint state) {
+    return wrs_sample(params, vec2(wrs_uniform(state), 0.0));
+}
+
+#endif
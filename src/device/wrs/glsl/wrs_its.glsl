@@ -0,0 +1,21 @@
+#ifndef WRS_ITS_GLSL
+#define WRS_ITS_GLSL
+
+// Inline inverse transform sampling from the (inclusive) CMF built by device::ITS.
+//
+// Bindings:
+//   WRS_BINDING + 0 : cmf
+
+#include "wrs_cmf.glsl"
+
+// u in [0,1)^2, only u.x is used.
+uint wrs_sample(const WRSParameters params, const vec2 u) {
+    const float target = u.x * wrs_cmf[params.N - 1];
+    return wrs_searchCMF(0, params.N - 1, target);
+}
+
+uint wrs_sample(const WRSParameters params, inout uint state) {
+    return wrs_sample(params, vec2(wrs_uniform(state), 0.0));
+}
+
+#endif
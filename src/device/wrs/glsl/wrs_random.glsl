@@ -0,0 +1,25 @@
+#ifndef WRS_RANDOM_GLSL
+#define WRS_RANDOM_GLSL
+
+// Minimal random state for the inline samplers, seeded with wrs_seed(seed, id).
+// It is the RNG_PCG generator of the sampling kernels (rng.comp) on a single uint,
+// instead of an RNGState, which keeps the register footprint in user shaders small.
+
+#include "rng.comp"
+
+uint wrs_seed(uint seed, uint id) {
+    // same seeding as rng_init with RNG_PCG.
+    return pcg_hash(seed ^ pcg_hash(id));
+}
+
+// uniform in [0,1), 24 bits such that 1.0 is never reached.
+float wrs_uniform(inout uint state) {
+    return rng_toFloat(pcg_next(state));
+}
+
+vec2 wrs_uniform2(inout uint state) {
+    const float x = wrs_uniform(state);
+    return vec2(x, wrs_uniform(state));
+}
+
+#endif
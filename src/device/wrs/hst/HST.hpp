@@ -0,0 +1,430 @@
+#pragma once
+/**
+ * @filename    : HST.hpp
+ *
+ * Hierarchical sum tree (HST) method.
+ * Builds a tree of partial sums with fanout children per node over the weights
+ * and samples by descending from the root (see HSTSampling.hpp).
+ *
+ * In contrast to all other methods a point update only has to recompute
+ * the log_fanout(N) ancestors of the changed weights, which makes this method
+ * a good fit for distributions which change every frame.
+ *
+ * With a multinomial config sampleCounts() generates only the amount of times every
+ * weight was drawn (see HSTMultinomial.hpp), optionally exploded into sorted samples.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/memory/resource_allocator.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ThreadPool.hpp"
+#include "src/device/wrs/hst/HSTRepr.hpp"
+#include "src/device/wrs/hst/construction/HSTConstruction.hpp"
+#include "src/device/wrs/hst/multinomial/HSTMultinomial.hpp"
+#include "src/device/wrs/hst/sampling/HSTSampling.hpp"
+#include "src/device/wrs/sorted/SortedSamples.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include <algorithm>
+#include <fmt/format.h>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+class HSTConfig {
+  public:
+    // children per node, must not be larger than the subgroup size.
+    host::glsl::uint fanout;
+    HSTConstructionConfig constructionConfig;
+    HSTSamplingConfig samplingConfig;
+    // maximum amount of changed weights per point update, more changes require a full build.
+    host::glsl::uint maxChangedCount;
+    // enables sampleCounts().
+    std::optional<HSTMultinomialConfig> multinomialConfig;
+
+    constexpr HSTConfig()
+        : fanout(32), constructionConfig{}, samplingConfig{}, maxChangedCount(4096),
+          multinomialConfig(std::nullopt) {}
+    explicit constexpr HSTConfig(
+        host::glsl::uint fanout,
+        HSTConstructionConfig constructionConfig,
+        HSTSamplingConfig samplingConfig,
+        host::glsl::uint maxChangedCount = 4096,
+        std::optional<HSTMultinomialConfig> multinomialConfig = std::nullopt)
+        : fanout(fanout), constructionConfig(constructionConfig), samplingConfig(samplingConfig),
+          maxChangedCount(maxChangedCount), multinomialConfig(multinomialConfig) {}
+
+    inline std::string name() const {
+        std::string name = fmt::format("HST-{}-Construction-{}-Sampling-{}", fanout,
+                                       constructionConfig.workgroupSize,
+                                       samplingConfig.workgroupSize);
+        if (multinomialConfig.has_value()) {
+            name += multinomialConfig->explode ? "-Multinomial-Explode" : "-Multinomial";
+            if (multinomialConfig->rng != host::RNGAlgorithm::PCG) {
+                name += "-" + host::rngAlgorithmName(multinomialConfig->rng);
+            }
+        }
+        if (samplingConfig.rng != host::RNGAlgorithm::HASH) {
+            name += "-" + host::rngAlgorithmName(samplingConfig.rng);
+        }
+        return name;
+    }
+};
+
+struct HSTBuffers {
+    using Self = HSTBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle weights;
+    using WeightsLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using WeightsView = host::layout::BufferView<WeightsLayout>;
+
+    merian::BufferHandle samples;
+    using SamplesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using SamplesView = host::layout::BufferView<SamplesLayout>;
+
+    merian::BufferHandle m_tree;
+    using TreeLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using TreeView = host::layout::BufferView<TreeLayout>;
+
+    // written through the command buffer by update(), see BufferView::update.
+    merian::BufferHandle m_changedIndices;
+    using ChangedIndicesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using ChangedIndicesView = host::layout::BufferView<ChangedIndicesLayout>;
+
+    // only with a multinomial config, amount of samples of every weight.
+    merian::BufferHandle counts;
+    using CountsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using CountsView = host::layout::BufferView<CountsLayout>;
+
+    merian::BufferHandle m_countTree;
+    using CountTreeLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using CountTreeView = host::layout::BufferView<CountTreeLayout>;
+
+    // only with explode, the counts are exploded into the samples.
+    SortedSamples::Buffers m_explode;
+
+    static constexpr SortedSamplesConfig EXPLODE_CONFIG{SortedSamplesOutput::SORTED};
+
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         merian::MemoryMappingType memoryMapping,
+                         std::size_t N,
+                         std::size_t S,
+                         HSTConfig config) {
+        Self buffers;
+        const HSTRepr repr{static_cast<host::glsl::uint>(N), config.fanout};
+        // N = 1 does not have any internal nodes.
+        const std::size_t treeSize = std::max<std::size_t>(repr.size(), 1);
+        if (memoryMapping == merian::MemoryMappingType::NONE) {
+            buffers.weights = alloc->createBuffer(WeightsLayout::size(N),
+                                                  vk::BufferUsageFlagBits::eStorageBuffer |
+                                                      vk::BufferUsageFlagBits::eTransferDst,
+                                                  memoryMapping, "hst-weights");
+            buffers.samples = alloc->createBuffer(SamplesLayout::size(S),
+                                                  vk::BufferUsageFlagBits::eStorageBuffer |
+                                                      vk::BufferUsageFlagBits::eTransferSrc,
+                                                  memoryMapping, "samples");
+            buffers.m_tree = alloc->createBuffer(TreeLayout::size(treeSize),
+                                                 vk::BufferUsageFlagBits::eStorageBuffer |
+                                                     vk::BufferUsageFlagBits::eTransferSrc,
+                                                 memoryMapping, "hst-tree");
+            buffers.m_changedIndices = alloc->createBuffer(
+                ChangedIndicesLayout::size(config.maxChangedCount),
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                memoryMapping, "hst-changed-indices");
+            if (config.multinomialConfig.has_value()) {
+                buffers.counts = alloc->createBuffer(CountsLayout::size(N),
+                                                     vk::BufferUsageFlagBits::eStorageBuffer |
+                                                         vk::BufferUsageFlagBits::eTransferSrc |
+                                                         vk::BufferUsageFlagBits::eTransferDst,
+                                                     memoryMapping, "hst-counts");
+                buffers.m_countTree = alloc->createBuffer(CountTreeLayout::size(treeSize),
+                                                          vk::BufferUsageFlagBits::eStorageBuffer,
+                                                          memoryMapping, "hst-count-tree");
+                if (config.multinomialConfig->explode) {
+                    using ExplodeBuffers = SortedSamples::Buffers;
+                    buffers.m_explode.m_counts = buffers.counts;
+                    buffers.m_explode.sorted = buffers.samples;
+                    buffers.m_explode.totals = alloc->createBuffer(
+                        ExplodeBuffers::TotalsLayout::size(2),
+                        vk::BufferUsageFlagBits::eStorageBuffer, memoryMapping,
+                        "hst-explode-totals");
+                    buffers.m_explode.m_partials = alloc->createBuffer(
+                        ExplodeBuffers::PartialsLayout::size(
+                            2 * EXPLODE_CONFIG.partitionCount(static_cast<host::glsl::uint>(N))),
+                        vk::BufferUsageFlagBits::eStorageBuffer, memoryMapping,
+                        "hst-explode-partials");
+                }
+            }
+        } else {
+            buffers.weights =
+                alloc->createBuffer(WeightsLayout::size(N), vk::BufferUsageFlagBits::eTransferSrc,
+                                    memoryMapping, "hst-weights");
+            buffers.samples =
+                alloc->createBuffer(SamplesLayout::size(S), vk::BufferUsageFlagBits::eTransferDst,
+                                    memoryMapping, "samples");
+            buffers.m_tree = alloc->createBuffer(TreeLayout::size(treeSize),
+                                                 vk::BufferUsageFlagBits::eTransferDst,
+                                                 memoryMapping, "hst-tree");
+            if (config.multinomialConfig.has_value()) {
+                buffers.counts = alloc->createBuffer(CountsLayout::size(N),
+                                                     vk::BufferUsageFlagBits::eTransferDst,
+                                                     memoryMapping, "hst-counts");
+            }
+        }
+        return buffers;
+    }
+};
+
+class HST {
+  public:
+    using Buffers = HSTBuffers;
+    using Config = HSTConfig;
+
+    /// With sampleParametersBuffer, S and the seed of the samples are read from a buffer
+    /// (see the sample overload with parameters).
+    explicit HST(const merian::ContextHandle& context,
+                 const merian::ShaderCompilerHandle& shaderCompiler,
+                 Config config = {},
+                 bool sampleParametersBuffer = false)
+        : HST(pipeline::parallel(
+                  [&]() {
+                      return HSTConstruction(context, shaderCompiler, config.fanout,
+                                             config.constructionConfig);
+                  },
+                  [&]() {
+                      return HSTSampling(context, shaderCompiler, config.fanout,
+                                         config.samplingConfig, sampleParametersBuffer);
+                  },
+                  [&]() -> std::optional<HSTMultinomial> {
+                      if (!config.multinomialConfig.has_value()) {
+                          return std::nullopt;
+                      }
+                      return HSTMultinomial(context, shaderCompiler, config.fanout,
+                                            config.multinomialConfig.value());
+                  },
+                  [&]() -> std::optional<SortedSamples> {
+                      if (!config.multinomialConfig.has_value() ||
+                          !config.multinomialConfig->explode) {
+                          return std::nullopt;
+                      }
+                      return SortedSamples(context, shaderCompiler, Buffers::EXPLODE_CONFIG);
+                  }),
+              config) {}
+
+    void build(const merian::CommandBufferHandle& cmd,
+               const Buffers& buffers,
+               host::glsl::uint N,
+               std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        const HSTRepr repr{N, m_fanout};
+        WRS_PROFILE_SCOPE(profiler, cmd, "HST-Construction");
+        for (host::glsl::uint level = 1; level <= repr.levelCount(); ++level) {
+            m_construction.run(cmd, constructionBuffers(buffers), N, level, 0,
+                               repr.levelSize(level));
+            treeBarrier(cmd, buffers);
+        }
+    }
+
+    /**
+     * Updates the tree after the weights in [dirtyBegin, dirtyEnd) changed,
+     * only the ancestors of the range are recomputed.
+     * Writes to the weights have to be visible to compute shaders.
+     */
+    void update(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint dirtyBegin,
+                host::glsl::uint dirtyEnd,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (dirtyBegin >= dirtyEnd || dirtyEnd > N) {
+            throw std::runtime_error("HST: invalid dirty range");
+        }
+        const HSTRepr repr{N, m_fanout};
+        WRS_PROFILE_SCOPE(profiler, cmd, "HST-Update");
+        for (host::glsl::uint level = 1; level <= repr.levelCount(); ++level) {
+            const host::glsl::uint first = repr.ancestor(dirtyBegin, level);
+            const host::glsl::uint last = repr.ancestor(dirtyEnd - 1, level);
+            m_construction.run(cmd, constructionBuffers(buffers), N, level, first,
+                               last - first + 1);
+            treeBarrier(cmd, buffers);
+        }
+    }
+
+    /**
+     * Updates the tree after the weights at the given indices changed (batched point updates).
+     * The indices don't have to be sorted or unique,
+     * more than maxChangedCount indices fall back to a full build.
+     * The indices are recorded into cmd, therefore several updates can be recorded into
+     * one command buffer and resubmitted without waiting for the previous submit.
+     */
+    void update(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                std::span<const host::glsl::uint> changedIndices,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (changedIndices.empty()) {
+            return;
+        }
+        if (changedIndices.size() > m_maxChangedCount) {
+            build(cmd, buffers, N, profiler);
+            return;
+        }
+        const host::glsl::uint changedCount = static_cast<host::glsl::uint>(changedIndices.size());
+        // a previous update in the same command buffer might still read the indices.
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eTransfer,
+                     buffers.m_changedIndices->buffer_barrier(vk::AccessFlagBits::eShaderRead,
+                                                              vk::AccessFlagBits::eTransferWrite));
+        Buffers::ChangedIndicesView localView{buffers.m_changedIndices, changedCount};
+        localView.update<host::glsl::uint>(cmd, changedIndices);
+        localView.expectComputeRead(cmd);
+
+        const HSTRepr repr{N, m_fanout};
+        WRS_PROFILE_SCOPE(profiler, cmd, "HST-Update");
+        for (host::glsl::uint level = 1; level <= repr.levelCount(); ++level) {
+            m_construction.runChanged(cmd, constructionBuffers(buffers), N, level, changedCount);
+            treeBarrier(cmd, buffers);
+        }
+    }
+
+    void sample(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint S,
+                host::glsl::uint seed = 12345u,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        sample(cmd, buffers, N, S, seed, host::SampleSequence{}, profiler);
+    }
+
+    /// Samples from the points [offset, offset + S) of a low-discrepancy sequence, if the
+    /// sampling kernel uses one (see host::RNGAlgorithm).
+    void sample(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint S,
+                host::glsl::uint seed,
+                const host::SampleSequence& sequence,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        HSTSampling::Buffers samplingBuffers;
+        samplingBuffers.weights = buffers.weights;
+        samplingBuffers.tree = buffers.m_tree;
+        samplingBuffers.samples = buffers.samples;
+        WRS_PROFILE_SCOPE(profiler, cmd, "Sampling");
+        m_sampling.run(cmd, samplingBuffers, N, S, seed, sequence);
+    }
+
+    /// Reads S and the seed from parameters and is dispatched for maxS samples,
+    /// requires an HST created with sampleParametersBuffer.
+    void sample(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint maxS,
+                const merian::BufferHandle& parameters,
+                const host::SampleSequence& sequence = {},
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        HSTSampling::Buffers samplingBuffers;
+        samplingBuffers.weights = buffers.weights;
+        samplingBuffers.tree = buffers.m_tree;
+        samplingBuffers.samples = buffers.samples;
+        WRS_PROFILE_SCOPE(profiler, cmd, "Sampling");
+        m_sampling.run(cmd, samplingBuffers, N, maxS, parameters, sequence);
+    }
+
+    /**
+     * Draws S samples, but only writes the amount of times every weight was drawn
+     * into the counts (and with explode the sorted samples).
+     * Requires a multinomial config, the work is independent of S.
+     */
+    void sampleCounts(const merian::CommandBufferHandle& cmd,
+                      const Buffers& buffers,
+                      host::glsl::uint N,
+                      host::glsl::uint S,
+                      host::glsl::uint seed = 12345u,
+                      std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (!m_multinomial.has_value()) {
+            throw std::runtime_error("HST: sampleCounts requires a multinomial config");
+        }
+        const HSTRepr repr{N, m_fanout};
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "Multinomial");
+            if (repr.levelCount() == 0) {
+                // a single weight receives all samples.
+                cmd->fill(buffers.counts, S);
+            } else {
+                HSTMultinomial::Buffers multinomialBuffers;
+                multinomialBuffers.weights = buffers.weights;
+                multinomialBuffers.tree = buffers.m_tree;
+                multinomialBuffers.countTree = buffers.m_countTree;
+                multinomialBuffers.counts = buffers.counts;
+                for (host::glsl::uint level = repr.levelCount(); level >= 1; --level) {
+                    m_multinomial->run(cmd, multinomialBuffers, N, S, seed, level,
+                                       repr.levelSize(level));
+                    if (level > 1) {
+                        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                                     vk::PipelineStageFlagBits::eComputeShader,
+                                     buffers.m_countTree->buffer_barrier(
+                                         vk::AccessFlagBits::eShaderWrite,
+                                         vk::AccessFlagBits::eShaderRead));
+                    }
+                }
+            }
+        }
+        if (m_explode.has_value()) {
+            const vk::PipelineStageFlags srcStage = repr.levelCount() == 0
+                                                        ? vk::PipelineStageFlagBits::eTransfer
+                                                        : vk::PipelineStageFlagBits::eComputeShader;
+            const vk::AccessFlags srcAccess = repr.levelCount() == 0
+                                                  ? vk::AccessFlagBits::eTransferWrite
+                                                  : vk::AccessFlagBits::eShaderWrite;
+            cmd->barrier(srcStage, vk::PipelineStageFlagBits::eComputeShader,
+                         buffers.counts->buffer_barrier(srcAccess,
+                                                        vk::AccessFlagBits::eShaderRead));
+            m_explode->explode(cmd, buffers.m_explode, N, S, profiler);
+        }
+    }
+
+  private:
+    using Kernels = std::tuple<HSTConstruction,
+                               HSTSampling,
+                               std::optional<HSTMultinomial>,
+                               std::optional<SortedSamples>>;
+
+    explicit HST(Kernels&& kernels, const Config& config)
+        : m_construction(std::move(std::get<0>(kernels))),
+          m_sampling(std::move(std::get<1>(kernels))),
+          m_multinomial(std::move(std::get<2>(kernels))),
+          m_explode(std::move(std::get<3>(kernels))), m_fanout(config.fanout),
+          m_maxChangedCount(config.maxChangedCount) {}
+
+    static HSTConstruction::Buffers constructionBuffers(const Buffers& buffers) {
+        HSTConstruction::Buffers constructionBuffers;
+        constructionBuffers.weights = buffers.weights;
+        constructionBuffers.tree = buffers.m_tree;
+        constructionBuffers.changedIndices = buffers.m_changedIndices;
+        return constructionBuffers;
+    }
+
+    static void treeBarrier(const merian::CommandBufferHandle& cmd, const Buffers& buffers) {
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     buffers.m_tree->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                    vk::AccessFlagBits::eShaderRead |
+                                                        vk::AccessFlagBits::eShaderWrite));
+    }
+
+    HSTConstruction m_construction;
+    HSTSampling m_sampling;
+    std::optional<HSTMultinomial> m_multinomial;
+    std::optional<SortedSamples> m_explode;
+    host::glsl::uint m_fanout;
+    host::glsl::uint m_maxChangedCount;
+};
+
+} // namespace device
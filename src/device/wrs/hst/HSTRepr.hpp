@@ -0,0 +1,77 @@
+#pragma once
+/**
+ * @filename    : HSTRepr.hpp
+ *
+ * Layout of the hierarchical sum tree (HST).
+ *
+ * Level 0 are the weights themselves, every node of level l + 1 is the sum of
+ * (up to) fanout consecutive nodes of level l, the last level contains only the root.
+ * The internal levels 1..L are stored back to back in a single buffer,
+ * the weights are not duplicated.
+ *
+ * Must match levelSize() and levelOffset() of the construction and sampling shaders.
+ */
+
+#include "src/host/types/glsl.hpp"
+#include <cassert>
+#include <vector>
+
+namespace device {
+
+class HSTRepr {
+  public:
+    HSTRepr(host::glsl::uint N, host::glsl::uint fanout) : m_fanout(fanout) {
+        assert(N > 0);
+        assert(fanout > 1);
+        m_levelSizes.push_back(N);
+        m_levelOffsets.push_back(0);
+        host::glsl::uint offset = 0;
+        while (m_levelSizes.back() > 1) {
+            const host::glsl::uint size = (m_levelSizes.back() + fanout - 1) / fanout;
+            m_levelOffsets.push_back(offset);
+            m_levelSizes.push_back(size);
+            offset += size;
+        }
+        m_size = offset;
+    }
+
+    /// Amount of internal levels, the root is at level levelCount().
+    host::glsl::uint levelCount() const {
+        return static_cast<host::glsl::uint>(m_levelSizes.size()) - 1;
+    }
+
+    host::glsl::uint levelSize(host::glsl::uint level) const {
+        return m_levelSizes[level];
+    }
+
+    /// Offset of an internal level (level >= 1) into the tree buffer.
+    host::glsl::uint levelOffset(host::glsl::uint level) const {
+        assert(level >= 1);
+        return m_levelOffsets[level];
+    }
+
+    /// Amount of internal nodes, which have to be stored in the tree buffer.
+    host::glsl::uint size() const {
+        return m_size;
+    }
+
+    host::glsl::uint fanout() const {
+        return m_fanout;
+    }
+
+    /// Returns the ancestor of a weight at the given level.
+    host::glsl::uint ancestor(host::glsl::uint i, host::glsl::uint level) const {
+        for (host::glsl::uint l = 0; l < level; ++l) {
+            i /= m_fanout;
+        }
+        return i;
+    }
+
+  private:
+    host::glsl::uint m_fanout;
+    std::vector<host::glsl::uint> m_levelSizes;
+    std::vector<host::glsl::uint> m_levelOffsets;
+    host::glsl::uint m_size;
+};
+
+} // namespace device
@@ -0,0 +1,144 @@
+#pragma once
+/**
+ * @filename    : HSTConstruction.hpp
+ *
+ * Computes one level of the hierarchical sum tree from the level below.
+ * Every subgroup computes a single node with a subgroupAdd over its children,
+ * therefore the fanout of the tree is bounded by the subgroup size.
+ *
+ * Either recomputes a contiguous range of nodes (full build / dirty range)
+ * or only the ancestors of a list of changed weights (point updates).
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+class HSTConstructionConfig {
+  public:
+    host::glsl::uint workgroupSize;
+
+    constexpr HSTConstructionConfig() : workgroupSize(512) {}
+    explicit constexpr HSTConstructionConfig(host::glsl::uint workgroupSize)
+        : workgroupSize(workgroupSize) {}
+};
+
+struct HSTConstructionBuffers {
+    using Self = HSTConstructionBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle weights;
+    using WeightsLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using WeightsView = host::layout::BufferView<WeightsLayout>;
+
+    merian::BufferHandle tree;
+    using TreeLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using TreeView = host::layout::BufferView<TreeLayout>;
+
+    // only bound for point updates.
+    merian::BufferHandle changedIndices;
+    using ChangedIndicesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using ChangedIndicesView = host::layout::BufferView<ChangedIndicesLayout>;
+};
+
+class HSTConstruction {
+    struct PushConstants {
+        host::glsl::uint N;
+        host::glsl::uint level;
+        host::glsl::uint nodeBegin;
+        host::glsl::uint nodeCount;
+    };
+
+  public:
+    using Buffers = HSTConstructionBuffers;
+    using Config = HSTConstructionConfig;
+
+    explicit HSTConstruction(const merian::ContextHandle& context,
+                             const merian::ShaderCompilerHandle& shaderCompiler,
+                             host::glsl::uint fanout,
+                             Config config = {})
+        : m_workgroupSize(config.workgroupSize) {
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+        if (fanout > subgroupSize) {
+            throw std::runtime_error("HSTConstruction: fanout must not exceed the subgroup size");
+        }
+        m_nodesPerWorkgroup = m_workgroupSize / subgroupSize;
+
+        const std::string shaderPath = "src/device/wrs/hst/construction/shader.comp";
+
+        m_rangePipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                              .addStorageBuffer() // weights
+                              .addStorageBuffer() // tree
+                              .addPushConstant<PushConstants>()
+                              .addSpecializationConstant(m_workgroupSize)
+                              .addSpecializationConstant(fanout)
+                              .build();
+
+        std::map<std::string, std::string> defines;
+        defines["CHANGED_INDICES"];
+        m_listPipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                             .setDefines(defines)
+                             .addStorageBuffer() // weights
+                             .addStorageBuffer() // tree
+                             .addStorageBuffer() // changed indices
+                             .addPushConstant<PushConstants>()
+                             .addSpecializationConstant(m_workgroupSize)
+                             .addSpecializationConstant(fanout)
+                             .build();
+    }
+
+    /// Recomputes the nodes [nodeBegin, nodeBegin + nodeCount) of the level.
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint level,
+             host::glsl::uint nodeBegin,
+             host::glsl::uint nodeCount) const {
+        cmd->bind(m_rangePipeline);
+        cmd->push_descriptor_set(m_rangePipeline, buffers.weights, buffers.tree);
+        cmd->push_constant<PushConstants>(m_rangePipeline, PushConstants{
+                                                               .N = N,
+                                                               .level = level,
+                                                               .nodeBegin = nodeBegin,
+                                                               .nodeCount = nodeCount,
+                                                           });
+        cmd->dispatch((nodeCount + m_nodesPerWorkgroup - 1) / m_nodesPerWorkgroup, 1, 1);
+    }
+
+    /// Recomputes the ancestors at the given level of the first changedCount changed indices.
+    void runChanged(const merian::CommandBufferHandle& cmd,
+                    const Buffers& buffers,
+                    host::glsl::uint N,
+                    host::glsl::uint level,
+                    host::glsl::uint changedCount) const {
+        cmd->bind(m_listPipeline);
+        cmd->push_descriptor_set(m_listPipeline, buffers.weights, buffers.tree,
+                                 buffers.changedIndices);
+        cmd->push_constant<PushConstants>(m_listPipeline, PushConstants{
+                                                              .N = N,
+                                                              .level = level,
+                                                              .nodeBegin = 0,
+                                                              .nodeCount = changedCount,
+                                                          });
+        cmd->dispatch((changedCount + m_nodesPerWorkgroup - 1) / m_nodesPerWorkgroup, 1, 1);
+    }
+
+  private:
+    merian::PipelineHandle m_rangePipeline;
+    merian::PipelineHandle m_listPipeline;
+    host::glsl::uint m_workgroupSize;
+    host::glsl::uint m_nodesPerWorkgroup;
+};
+
+} // namespace device
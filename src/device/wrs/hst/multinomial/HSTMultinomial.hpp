@@ -0,0 +1,124 @@
+#pragma once
+/**
+ * @filename    : HSTMultinomial.hpp
+ *
+ * Output sensitive sampling of the hierarchical sum tree method.
+ * Instead of S indices only the amount of times every weight was drawn is generated,
+ * by splitting the sample count of every node over its children with conditional binomials
+ * from the root downwards. Requires O(N + log S) work independent of S.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
+#include <stdexcept>
+#include <string>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+class HSTMultinomialConfig {
+  public:
+    host::glsl::uint workgroupSize;
+    // expands the counts into S sorted samples afterwards.
+    bool explode;
+    // stream of the binomial samplers, low-discrepancy sequences are not supported.
+    host::RNGAlgorithm rng;
+
+    constexpr HSTMultinomialConfig()
+        : workgroupSize(256), explode(false), rng(host::RNGAlgorithm::PCG) {}
+    explicit constexpr HSTMultinomialConfig(host::glsl::uint workgroupSize,
+                                            bool explode = false,
+                                            host::RNGAlgorithm rng = host::RNGAlgorithm::PCG)
+        : workgroupSize(workgroupSize), explode(explode), rng(rng) {}
+};
+
+struct HSTMultinomialBuffers {
+    using Self = HSTMultinomialBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle weights;
+    using WeightsLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using WeightsView = host::layout::BufferView<WeightsLayout>;
+
+    merian::BufferHandle tree;
+    using TreeLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using TreeView = host::layout::BufferView<TreeLayout>;
+
+    // same layout as the tree.
+    merian::BufferHandle countTree;
+    using CountTreeLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using CountTreeView = host::layout::BufferView<CountTreeLayout>;
+
+    merian::BufferHandle counts;
+    using CountsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using CountsView = host::layout::BufferView<CountsLayout>;
+};
+
+class HSTMultinomial {
+    struct PushConstants {
+        host::glsl::uint N;
+        host::glsl::uint S;
+        host::glsl::uint seed;
+        host::glsl::uint level;
+    };
+
+  public:
+    using Buffers = HSTMultinomialBuffers;
+    using Config = HSTMultinomialConfig;
+
+    explicit HSTMultinomial(const merian::ContextHandle& context,
+                            const merian::ShaderCompilerHandle& shaderCompiler,
+                            host::glsl::uint fanout,
+                            Config config = {})
+        : m_workgroupSize(config.workgroupSize) {
+        if (host::rngIsSequence(config.rng)) {
+            throw std::runtime_error("HSTMultinomial: the binomial samplers require a stream RNG");
+        }
+        const std::string shaderPath = "src/device/wrs/hst/multinomial/shader.comp";
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addIncludePath("src/device/common/")
+                         .addStorageBuffer() // weights
+                         .addStorageBuffer() // tree
+                         .addStorageBuffer() // count tree
+                         .addStorageBuffer() // counts
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(m_workgroupSize)
+                         .addSpecializationConstant(fanout)
+                         .addSpecializationConstant(host::rngSpecializationConstant(config.rng))
+                         .build();
+    }
+
+    /// Splits the counts of the nodeCount nodes at the given level (>= 1) over their children.
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint S,
+             host::glsl::uint seed,
+             host::glsl::uint level,
+             host::glsl::uint nodeCount) const {
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.weights, buffers.tree, buffers.countTree,
+                                 buffers.counts);
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
+                                                          .N = N,
+                                                          .S = S,
+                                                          .seed = seed,
+                                                          .level = level,
+                                                      });
+        // every invocation splits one node.
+        cmd->dispatch((nodeCount + m_workgroupSize - 1) / m_workgroupSize, 1, 1);
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+    host::glsl::uint m_workgroupSize;
+};
+
+} // namespace device
@@ -0,0 +1,164 @@
+#pragma once
+/**
+ * @filename    : HSTSampling.hpp
+ *
+ * The sampling step of the hierarchical sum tree method.
+ * Every subgroup cooperatively traverses the tree from the root for one sample at a time,
+ * which requires one coalesced load of fanout nodes per level instead of
+ * a divergent binary search per invocation.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+class HSTSamplingConfig {
+  public:
+    host::glsl::uint workgroupSize;
+    host::RNGAlgorithm rng;
+
+    constexpr HSTSamplingConfig() : workgroupSize(512), rng(host::RNGAlgorithm::HASH) {}
+    explicit constexpr HSTSamplingConfig(host::glsl::uint workgroupSize,
+                                         host::RNGAlgorithm rng = host::RNGAlgorithm::HASH)
+        : workgroupSize(workgroupSize), rng(rng) {}
+};
+
+struct HSTSamplingBuffers {
+    using Self = HSTSamplingBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle weights;
+    using WeightsLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using WeightsView = host::layout::BufferView<WeightsLayout>;
+
+    merian::BufferHandle tree;
+    using TreeLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using TreeView = host::layout::BufferView<TreeLayout>;
+
+    merian::BufferHandle samples;
+    using SamplesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using SamplesView = host::layout::BufferView<SamplesLayout>;
+};
+
+class HSTSampling {
+    struct PushConstants {
+        host::glsl::uint N;
+        host::glsl::uint S;
+        host::glsl::uint seed;
+        host::glsl::uint dimension;
+        host::glsl::uint sequenceOffset;
+    };
+
+  public:
+    using Buffers = HSTSamplingBuffers;
+    using Config = HSTSamplingConfig;
+
+    /// With sampleParametersBuffer, S and the seed are read from a buffer
+    /// (see the run overload with parameters).
+    explicit HSTSampling(const merian::ContextHandle& context,
+                         const merian::ShaderCompilerHandle& shaderCompiler,
+                         host::glsl::uint fanout,
+                         Config config = {},
+                         bool sampleParametersBuffer = false)
+        : m_workgroupSize(config.workgroupSize), m_sampleParametersBuffer(sampleParametersBuffer) {
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+        if (fanout > subgroupSize) {
+            throw std::runtime_error("HSTSampling: fanout must not exceed the subgroup size");
+        }
+
+        const std::string shaderPath = "src/device/wrs/hst/sampling/shader.comp";
+
+        std::map<std::string, std::string> defines;
+        if (m_sampleParametersBuffer) {
+            defines["SAMPLE_PARAMETERS_BUFFER"];
+        }
+
+        pipeline::ComputePipelineBuilder pipelineBuilder(context, shaderCompiler, shaderPath);
+        pipelineBuilder.addIncludePath("src/device/common/")
+            .setDefines(defines)
+            .addStorageBuffer()  // weights
+            .addStorageBuffer()  // tree
+            .addStorageBuffer(); // samples
+        if (m_sampleParametersBuffer) {
+            pipelineBuilder.addStorageBuffer(); // sample parameters
+        }
+        m_pipeline = pipelineBuilder.addPushConstant<PushConstants>()
+                         .addSpecializationConstant(m_workgroupSize)
+                         .addSpecializationConstant(fanout)
+                         .addSpecializationConstant(host::rngSpecializationConstant(config.rng))
+                         .build();
+    }
+
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint S,
+             host::glsl::uint seed = 12345u,
+             const host::SampleSequence& sequence = {}) const {
+        if (m_sampleParametersBuffer) {
+            throw std::runtime_error("HSTSampling: the kernel reads S and seed from a buffer");
+        }
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.weights, buffers.tree, buffers.samples);
+        record(cmd, N, S, seed, sequence);
+    }
+
+    /**
+     * Reads the sample count and the seed from parameters (see sample_parameters.comp),
+     * such that they can change between submits of the recorded commands.
+     * Dispatched for maxS samples, requires a kernel created with sampleParametersBuffer.
+     */
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint maxS,
+             const merian::BufferHandle& parameters,
+             const host::SampleSequence& sequence = {}) const {
+        if (!m_sampleParametersBuffer) {
+            throw std::runtime_error(
+                "HSTSampling: the kernel reads S and seed from push constants");
+        }
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.weights, buffers.tree, buffers.samples,
+                                 parameters);
+        record(cmd, N, maxS, 0, sequence);
+    }
+
+  private:
+    // S is the dispatched sample count, S and seed are ignored if the kernel reads them
+    // from the parameters.
+    void record(const merian::CommandBufferHandle& cmd,
+                host::glsl::uint N,
+                host::glsl::uint S,
+                host::glsl::uint seed,
+                const host::SampleSequence& sequence) const {
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
+                                                          .N = N,
+                                                          .S = S,
+                                                          .seed = seed,
+                                                          .dimension = sequence.dimension,
+                                                          .sequenceOffset = sequence.offset,
+                                                      });
+        // every invocation writes exactly one sample.
+        const uint32_t workgroupCount = (S + m_workgroupSize - 1) / m_workgroupSize;
+        cmd->dispatch(workgroupCount, 1, 1);
+    }
+
+    merian::PipelineHandle m_pipeline;
+    host::glsl::uint m_workgroupSize;
+    bool m_sampleParametersBuffer;
+};
+
+} // namespace device
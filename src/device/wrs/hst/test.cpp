@@ -0,0 +1,428 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/wrs/hst/HST.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include "src/host/memory/FallbackResource.hpp"
+#include "src/host/memory/SafeResource.hpp"
+#include "src/host/memory/StackResource.hpp"
+#include "src/host/statistics/chi_square.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <random>
+#include <span>
+#include <spdlog/spdlog.h>
+
+namespace device::test::hst {
+
+using Algorithm = HST;
+using Buffers = Algorithm::Buffers;
+using Config = Algorithm::Config;
+
+struct TestCase {
+    Config config;
+    host::glsl::uint N;
+    host::Distribution distribution;
+    host::glsl::uint S;
+    // amount of random point updates after the build, 0 only tests the build.
+    host::glsl::uint changedCount;
+    uint32_t iterations;
+};
+
+static constexpr TestCase TEST_CASES[] = {
+    TestCase{
+        .config = {},
+        .N = static_cast<host::glsl::uint>(1e6),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = static_cast<host::glsl::uint>(1e6),
+        .changedCount = 0,
+        .iterations = 4,
+    },
+    TestCase{
+        .config = {},
+        .N = static_cast<host::glsl::uint>(1e6) + 17,
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .S = static_cast<host::glsl::uint>(1e6),
+        .changedCount = 1000,
+        .iterations = 4,
+    },
+    TestCase{
+        .config = HSTConfig(8, HSTConstructionConfig(256), HSTSamplingConfig(256)),
+        .N = 4096 * 100 + 3,
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = 4096,
+        .changedCount = 64,
+        .iterations = 4,
+    },
+};
+
+struct MultinomialTestCase {
+    Config config;
+    host::glsl::uint N;
+    host::Distribution distribution;
+    host::glsl::uint S;
+    uint32_t iterations;
+};
+
+static constexpr MultinomialTestCase MULTINOMIAL_TEST_CASES[] = {
+    MultinomialTestCase{
+        .config = HSTConfig(32, HSTConstructionConfig(), HSTSamplingConfig(), 4096,
+                            HSTMultinomialConfig()),
+        .N = static_cast<host::glsl::uint>(1e5) + 3,
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = static_cast<host::glsl::uint>(2e9),
+        .iterations = 4,
+    },
+    MultinomialTestCase{
+        .config = HSTConfig(8, HSTConstructionConfig(), HSTSamplingConfig(), 4096,
+                            HSTMultinomialConfig(256, true)),
+        .N = static_cast<host::glsl::uint>(1e4),
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .S = static_cast<host::glsl::uint>(1e6),
+        .iterations = 4,
+    },
+    MultinomialTestCase{
+        .config = HSTConfig(32, HSTConstructionConfig(), HSTSamplingConfig(), 4096,
+                            HSTMultinomialConfig(256, true)),
+        .N = 1,
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = 1000,
+        .iterations = 1,
+    },
+};
+
+/// Sums of all internal levels in the layout of HSTRepr.
+static std::pmr::vector<float> referenceTree(const HSTRepr& repr,
+                                             std::span<const float> weights,
+                                             std::pmr::memory_resource* resource) {
+    std::pmr::vector<float> tree(repr.size(), 0.0f, resource);
+    for (host::glsl::uint level = 1; level <= repr.levelCount(); ++level) {
+        const host::glsl::uint childCount = repr.levelSize(level - 1);
+        for (host::glsl::uint child = 0; child < childCount; ++child) {
+            const float w =
+                level == 1 ? weights[child] : tree[repr.levelOffset(level - 1) + child];
+            tree[repr.levelOffset(level) + child / repr.fanout()] += w;
+        }
+    }
+    return tree;
+}
+
+static bool runTestCase(const host::test::TestContext& context,
+                        const TestCase& testCase,
+                        std::pmr::memory_resource* resource) {
+    std::string testName = fmt::format("{{{},N={},distribution={},S={},changed={}}}",
+                                       testCase.config.name(), testCase.N,
+                                       host::distribution_to_pretty_string(testCase.distribution),
+                                       testCase.S, testCase.changedCount);
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    Algorithm kernel{context.context, context.shaderCompiler, testCase.config};
+
+    const host::glsl::uint N = testCase.N;
+    const host::glsl::uint S = testCase.S;
+    const HSTRepr repr{N, testCase.config.fanout};
+
+    Buffers buffers = Buffers::allocate(context.alloc, merian::MemoryMappingType::NONE, N, S,
+                                        testCase.config);
+    Buffers stage = Buffers::allocate(context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+                                      N, S, testCase.config);
+    const merian::BufferHandle updatedStageWeights = context.alloc->createBuffer(
+        Buffers::WeightsLayout::size(N), vk::BufferUsageFlagBits::eTransferSrc,
+        merian::MemoryMappingType::HOST_ACCESS_RANDOM);
+
+    std::mt19937 rng{std::random_device{}()};
+
+    bool failed = false;
+    for (size_t it = 0; it < testCase.iterations; ++it) {
+        MERIAN_PROFILE_SCOPE(context.profiler, testName);
+        context.queue->wait_idle();
+
+        // 1. Generate input
+        context.profiler->start("Generate test input");
+        std::pmr::vector<float> weights =
+            host::pmr::generate_weights<float>(testCase.distribution, N, resource);
+        std::pmr::vector<float> updatedWeights = weights;
+        std::uniform_int_distribution<host::glsl::uint> indexDist{0, N - 1};
+        std::uniform_real_distribution<float> weightDist{0.0f, 2.0f};
+        std::pmr::vector<host::glsl::uint> changedIndices{resource};
+        for (host::glsl::uint i = 0; i < testCase.changedCount; ++i) {
+            changedIndices.push_back(indexDist(rng));
+            updatedWeights[changedIndices.back()] = weightDist(rng);
+        }
+        const std::pmr::vector<float> reference = referenceTree(repr, updatedWeights, resource);
+        context.profiler->end();
+
+        // 2. Begin recoding
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        std::string recordingLabel = fmt::format("Recording : {}", testName);
+        context.profiler->start(recordingLabel);
+        context.profiler->cmd_start(cmd, recordingLabel);
+
+        // 3. Upload weights and build
+        Buffers::WeightsView stageWeights{stage.weights, N};
+        Buffers::WeightsView localWeights{buffers.weights, N};
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Upload test case");
+            stageWeights.upload<float>(weights);
+            stageWeights.copyTo(cmd, localWeights);
+            localWeights.expectComputeRead(cmd);
+        }
+        kernel.build(cmd, buffers, N, context.profiler);
+
+        // 4. Point updates, the updated weights overwrite the weights after the build.
+        if (testCase.changedCount != 0) {
+            {
+                MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Upload updated weights");
+                Buffers::WeightsView updatedStage{updatedStageWeights, N};
+                updatedStage.upload<float>(updatedWeights);
+                cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                             vk::PipelineStageFlagBits::eTransfer,
+                             buffers.weights->buffer_barrier(vk::AccessFlagBits::eShaderRead,
+                                                             vk::AccessFlagBits::eTransferWrite));
+                updatedStage.copyTo(cmd, localWeights);
+                localWeights.expectComputeRead(cmd);
+            }
+            // two batches in one command buffer, the second must not overwrite the indices
+            // of the first.
+            const std::span<const host::glsl::uint> indices = changedIndices;
+            const std::size_t firstBatch = indices.size() / 2;
+            kernel.update(cmd, buffers, N, indices.first(firstBatch), context.profiler);
+            kernel.update(cmd, buffers, N, indices.subspan(firstBatch), context.profiler);
+        }
+
+        kernel.sample(cmd, buffers, N, S, static_cast<host::glsl::uint>(it),
+                      context.profiler);
+
+        // 5. Download results to stage
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Download results to stage");
+            Buffers::TreeView localTree{buffers.m_tree, repr.size()};
+            Buffers::TreeView stageTree{stage.m_tree, repr.size()};
+            localTree.expectComputeWrite();
+            localTree.copyTo(cmd, stageTree);
+            stageTree.expectHostRead(cmd);
+
+            Buffers::SamplesView localSamples{buffers.samples, S};
+            Buffers::SamplesView stageSamples{stage.samples, S};
+            localSamples.expectComputeWrite();
+            localSamples.copyTo(cmd, stageSamples);
+            stageSamples.expectHostRead(cmd);
+        }
+
+        // 6. Submit to device
+        context.profiler->end();
+        context.profiler->cmd_end(cmd);
+        cmd->end();
+        context.queue->submit_wait(cmd);
+
+        // 7. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            const auto tree = Buffers::TreeView{stage.m_tree, repr.size()}
+                                  .download<float, host::pmr_alloc<float>>(resource);
+            for (host::glsl::uint i = 0; i < repr.size(); ++i) {
+                const float err = std::abs(tree[i] - reference[i]);
+                if (err > 1e-3f * std::max(1.0f, std::abs(reference[i]))) {
+                    SPDLOG_ERROR("Invalid tree node {}: expected {}, got {}", i, reference[i],
+                                 tree[i]);
+                    failed = true;
+                    break;
+                }
+            }
+            const auto samples = Buffers::SamplesView{stage.samples, S}
+                                     .download<host::glsl::uint, host::pmr_alloc<host::glsl::uint>>(
+                                         resource);
+            for (host::glsl::uint s = 0; s < S; ++s) {
+                if (samples[s] >= N || updatedWeights[samples[s]] == 0.0f) {
+                    SPDLOG_ERROR("Invalid sample {} at {}", samples[s], s);
+                    failed = true;
+                    break;
+                }
+            }
+        }
+        context.profiler->collect(true, true);
+    }
+    return failed;
+}
+
+static bool runMultinomialTestCase(const host::test::TestContext& context,
+                                   const MultinomialTestCase& testCase,
+                                   std::pmr::memory_resource* resource) {
+    std::string testName = fmt::format("{{{},N={},distribution={},S={}}}", testCase.config.name(),
+                                       testCase.N,
+                                       host::distribution_to_pretty_string(testCase.distribution),
+                                       testCase.S);
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    Algorithm kernel{context.context, context.shaderCompiler, testCase.config};
+
+    const host::glsl::uint N = testCase.N;
+    const host::glsl::uint S = testCase.S;
+    const bool explode = testCase.config.multinomialConfig->explode;
+    // the samples are only written by explode.
+    const host::glsl::uint sampleBufferSize = explode ? S : 1;
+
+    Buffers buffers = Buffers::allocate(context.alloc, merian::MemoryMappingType::NONE, N,
+                                        sampleBufferSize, testCase.config);
+    Buffers stage = Buffers::allocate(context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+                                      N, sampleBufferSize, testCase.config);
+
+    std::mt19937 rng{std::random_device{}()};
+    std::uniform_int_distribution<host::glsl::uint> seedDist;
+
+    bool failed = false;
+    for (size_t it = 0; it < testCase.iterations; ++it) {
+        MERIAN_PROFILE_SCOPE(context.profiler, testName);
+        context.queue->wait_idle();
+
+        // 1. Generate input
+        context.profiler->start("Generate test input");
+        std::pmr::vector<float> weights =
+            host::pmr::generate_weights<float>(testCase.distribution, N, resource);
+        context.profiler->end();
+
+        // 2. Begin recoding
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        std::string recordingLabel = fmt::format("Recording : {}", testName);
+        context.profiler->start(recordingLabel);
+        context.profiler->cmd_start(cmd, recordingLabel);
+
+        // 3. Upload weights, build and sample counts
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Upload test case");
+            Buffers::WeightsView stageWeights{stage.weights, N};
+            Buffers::WeightsView localWeights{buffers.weights, N};
+            stageWeights.upload<float>(weights);
+            stageWeights.copyTo(cmd, localWeights);
+            localWeights.expectComputeRead(cmd);
+        }
+        kernel.build(cmd, buffers, N, context.profiler);
+        kernel.sampleCounts(cmd, buffers, N, S, seedDist(rng), context.profiler);
+
+        // 4. Download results to stage
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Download results to stage");
+            Buffers::CountsView localCounts{buffers.counts, N};
+            Buffers::CountsView stageCounts{stage.counts, N};
+            localCounts.expectComputeWrite();
+            localCounts.copyTo(cmd, stageCounts);
+            stageCounts.expectHostRead(cmd);
+            if (explode) {
+                Buffers::SamplesView localSamples{buffers.samples, S};
+                Buffers::SamplesView stageSamples{stage.samples, S};
+                localSamples.expectComputeWrite();
+                localSamples.copyTo(cmd, stageSamples);
+                stageSamples.expectHostRead(cmd);
+            }
+        }
+
+        // 5. Submit to device
+        context.profiler->end();
+        context.profiler->cmd_end(cmd);
+        cmd->end();
+        context.queue->submit_wait(cmd);
+
+        // 6. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            const auto counts = Buffers::CountsView{stage.counts, N}
+                                    .download<host::glsl::uint, host::pmr_alloc<host::glsl::uint>>(
+                                        resource);
+            double totalWeight = 0.0;
+            for (const float w : weights) {
+                totalWeight += w;
+            }
+            uint64_t total = 0;
+            double chi2 = 0.0;
+            std::size_t df = 0;
+            for (host::glsl::uint i = 0; i < N; ++i) {
+                total += counts[i];
+                if (weights[i] == 0.0f) {
+                    if (counts[i] != 0) {
+                        SPDLOG_ERROR("Weight {} is zero, but was drawn {} times", i, counts[i]);
+                        failed = true;
+                    }
+                    continue;
+                }
+                const double expected = weights[i] / totalWeight * S;
+                chi2 += (counts[i] - expected) * (counts[i] - expected) / expected;
+                df++;
+            }
+            if (total != S) {
+                SPDLOG_ERROR("Expected {} samples, got {}", S, total);
+                failed = true;
+            }
+            if (df > 1) {
+                const double zScore = host::chi_square_z_score(chi2, df - 1);
+                SPDLOG_INFO("Chi-Square z-score: {}", zScore);
+                if (zScore > 6.0) {
+                    SPDLOG_ERROR("{} displays a significant bias", testCase.config.name());
+                    failed = true;
+                }
+            }
+            if (explode) {
+                const auto samples =
+                    Buffers::SamplesView{stage.samples, S}
+                        .download<host::glsl::uint, host::pmr_alloc<host::glsl::uint>>(resource);
+                std::size_t s = 0;
+                for (host::glsl::uint i = 0; i < N && !failed; ++i) {
+                    for (host::glsl::uint c = 0; c < counts[i]; ++c, ++s) {
+                        if (samples[s] != i) {
+                            SPDLOG_ERROR("Invalid exploded sample {} at {}, expected {}",
+                                         samples[s], s, i);
+                            failed = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        context.profiler->collect(true, true);
+    }
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing HST");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    host::memory::StackResource stackResource{4096 * 2048};
+    host::memory::FallbackResource fallbackResource{&stackResource};
+    host::memory::SafeResource safeResource{&fallbackResource};
+
+    std::pmr::memory_resource* resource = &safeResource;
+
+    uint32_t failCount = 0;
+    for (const auto& testCase : TEST_CASES) {
+        if (runTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+    for (const auto& testCase : MULTINOMIAL_TEST_CASES) {
+        if (runMultinomialTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+
+    testContext.profiler->collect(true, true);
+    SPDLOG_INFO(fmt::format("Profiler results: \n{}",
+                            merian::Profiler::get_report_str(testContext.profiler->get_report())));
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
+                                 sizeof(TEST_CASES) / sizeof(TestCase) +
+                                     sizeof(MULTINOMIAL_TEST_CASES) /
+                                         sizeof(MultinomialTestCase)));
+    }
+}
+
+} // namespace device::test::hst
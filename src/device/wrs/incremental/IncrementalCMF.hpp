@@ -0,0 +1,229 @@
+#pragma once
+/**
+ * @filename    : IncrementalCMF.hpp
+ *
+ * Keeps a CMF up to date after partial weight updates without rescanning all N weights.
+ *
+ * The CMF is stored in partitions of partitionSize elements,
+ * where cmf[i] is the partition local inclusive prefix sum and
+ * the effective CMF value is cmf[i] + partitions[i / partitionSize].offset.
+ * A full build (any prefix sum) followed by reset() is a valid state, because all offsets are 0.
+ *
+ * update() rescans only the partitions which contain changed weights and
+ * afterwards propagates the changed partition aggregates into the offsets
+ * of all following partitions (one float per partition instead of one per element).
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/memory/resource_allocator.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ThreadPool.hpp"
+#include "src/device/wrs/incremental/propagation/OffsetPropagation.hpp"
+#include "src/device/wrs/incremental/rescan/PartitionRescan.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/Attribute.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/layout/StructLayout.hpp"
+#include "src/host/types/glsl.hpp"
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+class IncrementalCMFConfig {
+  public:
+    PartitionRescanConfig rescanConfig;
+    OffsetPropagationConfig propagationConfig;
+
+    constexpr IncrementalCMFConfig() : rescanConfig{}, propagationConfig{} {}
+    explicit constexpr IncrementalCMFConfig(PartitionRescanConfig rescanConfig,
+                                            OffsetPropagationConfig propagationConfig)
+        : rescanConfig(rescanConfig), propagationConfig(propagationConfig) {}
+
+    constexpr host::glsl::uint partitionSize() const {
+        return rescanConfig.partitionSize();
+    }
+};
+
+struct IncrementalCMFBuffers {
+    using Self = IncrementalCMFBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle weights;
+    using WeightsLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using WeightsView = host::layout::BufferView<WeightsLayout>;
+
+    merian::BufferHandle cmf;
+    using CMFLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using CMFView = host::layout::BufferView<CMFLayout>;
+
+    merian::BufferHandle states;
+    using _PartitionStateLayout = host::layout::StructLayout<
+        storageQualifier,
+        host::layout::Attribute<float, host::layout::StaticString("offset")>,
+        host::layout::Attribute<float, host::layout::StaticString("oldEnd")>,
+        host::layout::Attribute<host::glsl::uint, host::layout::StaticString("dirty")>>;
+    using _PartitionStatesArrayLayout =
+        host::layout::ArrayLayout<_PartitionStateLayout, storageQualifier>;
+    using StatesLayout = host::layout::StructLayout<
+        storageQualifier,
+        // total weight at the time the guiding table was build (only used by Cutpoint).
+        host::layout::Attribute<float, host::layout::StaticString("buildTotal")>,
+        host::layout::Attribute<_PartitionStatesArrayLayout,
+                                host::layout::StaticString("partitions")>>;
+    using StatesView = host::layout::BufferView<StatesLayout>;
+
+    /// Allocates only the states, weights and cmf are owned by the surrounding method.
+    static merian::BufferHandle allocateStates(const merian::ResourceAllocatorHandle& alloc,
+                                               std::size_t N,
+                                               IncrementalCMFConfig config) {
+        const std::size_t partitionCount =
+            (N + config.partitionSize() - 1) / config.partitionSize();
+        return alloc->createBuffer(StatesLayout::size(partitionCount),
+                                   vk::BufferUsageFlagBits::eStorageBuffer |
+                                       vk::BufferUsageFlagBits::eTransferDst,
+                                   merian::MemoryMappingType::NONE);
+    }
+};
+
+class IncrementalCMF {
+  public:
+    using Buffers = IncrementalCMFBuffers;
+    using Config = IncrementalCMFConfig;
+
+    explicit IncrementalCMF(const merian::ContextHandle& context,
+                            const merian::ShaderCompilerHandle& shaderCompiler,
+                            Config config = {})
+        : IncrementalCMF(pipeline::parallel(
+              [&]() { return PartitionRescan(context, shaderCompiler, config.rescanConfig); },
+              [&]() {
+                  return OffsetPropagation(context, shaderCompiler, config.propagationConfig);
+              })) {}
+
+    /// Clears all partition offsets, has to be recorded after every full build of the cmf.
+    void reset(const merian::CommandBufferHandle& cmd, const Buffers& buffers) const {
+        cmd->fill(buffers.states, 0);
+        cmd->barrier(vk::PipelineStageFlagBits::eTransfer,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     buffers.states->buffer_barrier(vk::AccessFlagBits::eTransferWrite,
+                                                    vk::AccessFlagBits::eShaderRead |
+                                                        vk::AccessFlagBits::eShaderWrite));
+    }
+
+    /// Updates the cmf after the weights in [dirtyBegin, dirtyEnd) changed.
+    /// Returns the first rescanned partition, all partitions after it have a new offset.
+    host::glsl::uint update(const merian::CommandBufferHandle& cmd,
+                            const Buffers& buffers,
+                            host::glsl::uint N,
+                            host::glsl::uint dirtyBegin,
+                            host::glsl::uint dirtyEnd,
+                            std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (dirtyBegin >= dirtyEnd || dirtyEnd > N) {
+            throw std::runtime_error("IncrementalCMF: invalid dirty range");
+        }
+        const host::glsl::uint P = partitionSize();
+        const host::glsl::uint firstPartition = dirtyBegin / P;
+        const host::glsl::uint lastPartition = (dirtyEnd - 1) / P;
+        const std::pair<host::glsl::uint, host::glsl::uint> run{firstPartition,
+                                                                lastPartition - firstPartition + 1};
+        record(cmd, buffers, N, std::span(&run, 1), profiler);
+        return firstPartition;
+    }
+
+    /// Updates the cmf after the weights at the given indices changed.
+    /// The indices are reduced to runs of consecutive dirty partitions on the host,
+    /// therefore they don't have to be sorted or unique.
+    /// Returns the first rescanned partition, all partitions after it have a new offset.
+    host::glsl::uint update(const merian::CommandBufferHandle& cmd,
+                            const Buffers& buffers,
+                            host::glsl::uint N,
+                            std::span<const host::glsl::uint> changedIndices,
+                            std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (changedIndices.empty()) {
+            throw std::runtime_error("IncrementalCMF: no changed indices");
+        }
+        const host::glsl::uint P = partitionSize();
+        std::vector<host::glsl::uint> dirtyPartitions(changedIndices.size());
+        for (std::size_t i = 0; i < changedIndices.size(); ++i) {
+            if (changedIndices[i] >= N) {
+                throw std::runtime_error("IncrementalCMF: changed index out of bounds");
+            }
+            dirtyPartitions[i] = changedIndices[i] / P;
+        }
+        std::ranges::sort(dirtyPartitions);
+        const auto [last, end] = std::ranges::unique(dirtyPartitions);
+        dirtyPartitions.erase(last, end);
+
+        std::vector<std::pair<host::glsl::uint, host::glsl::uint>> runs;
+        for (const host::glsl::uint p : dirtyPartitions) {
+            if (!runs.empty() && runs.back().first + runs.back().second == p) {
+                runs.back().second++;
+            } else {
+                runs.emplace_back(p, 1);
+            }
+        }
+        record(cmd, buffers, N, runs, profiler);
+        return runs.front().first;
+    }
+
+    host::glsl::uint partitionSize() const {
+        return m_rescan.getPartitionSize();
+    }
+
+  private:
+    using Kernels = std::tuple<PartitionRescan, OffsetPropagation>;
+
+    explicit IncrementalCMF(Kernels&& kernels)
+        : m_rescan(std::move(std::get<0>(kernels))),
+          m_propagation(std::move(std::get<1>(kernels))) {}
+
+    // runs of (firstPartition, partitionCount), sorted and disjoint.
+    void record(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                std::span<const std::pair<host::glsl::uint, host::glsl::uint>> runs,
+                std::optional<merian::ProfilerHandle> profiler) const {
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "Partition-Rescan");
+            PartitionRescan::Buffers rescanBuffers{
+                .weights = buffers.weights, .cmf = buffers.cmf, .states = buffers.states};
+            // runs are disjoint, therefore the dispatches don't require barriers in between.
+            for (const auto& [firstPartition, partitionCount] : runs) {
+                m_rescan.run(cmd, rescanBuffers, N, firstPartition, partitionCount);
+            }
+        }
+
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     {
+                         buffers.cmf->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                     vk::AccessFlagBits::eShaderRead),
+                         buffers.states->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                        vk::AccessFlagBits::eShaderRead |
+                                                            vk::AccessFlagBits::eShaderWrite),
+                     });
+
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "Offset-Propagation");
+            OffsetPropagation::Buffers propagationBuffers{.cmf = buffers.cmf,
+                                                          .states = buffers.states};
+            m_propagation.run(cmd, propagationBuffers, N, partitionSize(), runs.front().first);
+        }
+
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     buffers.states->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                    vk::AccessFlagBits::eShaderRead));
+    }
+
+    PartitionRescan m_rescan;
+    OffsetPropagation m_propagation;
+};
+
+} // namespace device
@@ -0,0 +1,81 @@
+#pragma once
+/**
+ * @filename    : OffsetPropagation.hpp
+ *
+ * Single workgroup kernel, which propagates the aggregate changes of
+ * rescanned partitions into the partition offsets of all following partitions.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/host/types/glsl.hpp"
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+class OffsetPropagationConfig {
+  public:
+    host::glsl::uint workgroupSize;
+
+    constexpr OffsetPropagationConfig() : workgroupSize(512) {}
+    explicit constexpr OffsetPropagationConfig(host::glsl::uint workgroupSize)
+        : workgroupSize(workgroupSize) {}
+};
+
+struct OffsetPropagationBuffers {
+    merian::BufferHandle cmf;
+    merian::BufferHandle states; // see IncrementalCMFBuffers::StatesLayout
+};
+
+class OffsetPropagation {
+    struct PushConstants {
+        host::glsl::uint N;
+        host::glsl::uint partitionSize;
+        host::glsl::uint firstPartition;
+        host::glsl::uint partitionCount;
+    };
+
+  public:
+    using Buffers = OffsetPropagationBuffers;
+    using Config = OffsetPropagationConfig;
+
+    explicit OffsetPropagation(const merian::ContextHandle& context,
+                               const merian::ShaderCompilerHandle& shaderCompiler,
+                               Config config = {}) {
+        const std::string shaderPath = "src/device/wrs/incremental/propagation/shader.comp";
+
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addStorageBuffer() // cmf
+                         .addStorageBuffer() // states
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(subgroupSize)
+                         .build();
+    }
+
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint partitionSize,
+             host::glsl::uint firstPartition) const {
+        const host::glsl::uint partitionCount = (N + partitionSize - 1) / partitionSize;
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.states);
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
+                                                          .N = N,
+                                                          .partitionSize = partitionSize,
+                                                          .firstPartition = firstPartition,
+                                                          .partitionCount = partitionCount,
+                                                      });
+        cmd->dispatch(1, 1, 1);
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+};
+
+} // namespace device
@@ -0,0 +1,91 @@
+#pragma once
+/**
+ * @filename    : PartitionRescan.hpp
+ *
+ * Recomputes the partition local CMF of a consecutive run of dirty partitions.
+ * One workgroup scans one partition of workgroupSize * rows weights.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/host/types/glsl.hpp"
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+class PartitionRescanConfig {
+  public:
+    host::glsl::uint workgroupSize;
+    host::glsl::uint rows;
+
+    constexpr PartitionRescanConfig() : workgroupSize(512), rows(8) {}
+    explicit constexpr PartitionRescanConfig(host::glsl::uint workgroupSize, host::glsl::uint rows)
+        : workgroupSize(workgroupSize), rows(rows) {}
+
+    constexpr host::glsl::uint partitionSize() const {
+        return workgroupSize * rows;
+    }
+};
+
+struct PartitionRescanBuffers {
+    merian::BufferHandle weights;
+    merian::BufferHandle cmf;
+    merian::BufferHandle states; // see IncrementalCMFBuffers::StatesLayout
+};
+
+class PartitionRescan {
+    struct PushConstants {
+        host::glsl::uint N;
+        host::glsl::uint firstPartition;
+    };
+
+  public:
+    using Buffers = PartitionRescanBuffers;
+    using Config = PartitionRescanConfig;
+
+    explicit PartitionRescan(const merian::ContextHandle& context,
+                             const merian::ShaderCompilerHandle& shaderCompiler,
+                             Config config = {})
+        : m_partitionSize(config.partitionSize()) {
+        const std::string shaderPath = "src/device/wrs/incremental/rescan/shader.comp";
+
+        const host::glsl::uint subgroupSize =
+            context->physical_device.physical_device_subgroup_properties.subgroupSize;
+
+        m_pipeline = pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderPath)
+                         .addStorageBuffer() // weights
+                         .addStorageBuffer() // cmf
+                         .addStorageBuffer() // states
+                         .addPushConstant<PushConstants>()
+                         .addSpecializationConstant(config.workgroupSize)
+                         .addSpecializationConstant(config.rows)
+                         .addSpecializationConstant(subgroupSize)
+                         .build();
+    }
+
+    /// Rescans the partitions [firstPartition, firstPartition + partitionCount).
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint firstPartition,
+             host::glsl::uint partitionCount) const {
+        cmd->bind(m_pipeline);
+        cmd->push_descriptor_set(m_pipeline, buffers.weights, buffers.cmf, buffers.states);
+        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
+                                                          .N = N,
+                                                          .firstPartition = firstPartition,
+                                                      });
+        cmd->dispatch(partitionCount, 1, 1);
+    }
+
+    host::glsl::uint getPartitionSize() const {
+        return m_partitionSize;
+    }
+
+  private:
+    merian::PipelineHandle m_pipeline;
+    host::glsl::uint m_partitionSize;
+};
+
+} // namespace device
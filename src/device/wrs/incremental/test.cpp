@@ -0,0 +1,258 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/wrs/incremental/IncrementalCMF.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include "src/host/memory/FallbackResource.hpp"
+#include "src/host/memory/SafeResource.hpp"
+#include "src/host/memory/StackResource.hpp"
+#include "src/host/reference/prefix_sum.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <random>
+#include <spdlog/spdlog.h>
+
+namespace device::test::incremental_cmf {
+
+using Algorithm = IncrementalCMF;
+using Buffers = Algorithm::Buffers;
+using Config = Algorithm::Config;
+
+struct TestCase {
+    Config config;
+    host::glsl::uint N;
+    host::Distribution distribution;
+    // if 0 a random range of at most maxDirtyRange weights is changed,
+    // otherwise changedCount random weights.
+    host::glsl::uint changedCount;
+    host::glsl::uint maxDirtyRange;
+    uint32_t iterations;
+};
+
+static constexpr TestCase TEST_CASES[] = {
+    TestCase{
+        .config = {},
+        .N = static_cast<host::glsl::uint>(1e6),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .changedCount = 0,
+        .maxDirtyRange = 10000,
+        .iterations = 4,
+    },
+    TestCase{
+        .config = {},
+        .N = static_cast<host::glsl::uint>(1e6),
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .changedCount = 64,
+        .maxDirtyRange = 0,
+        .iterations = 4,
+    },
+    TestCase{
+        .config = IncrementalCMFConfig(PartitionRescanConfig(256, 4), OffsetPropagationConfig(128)),
+        .N = 4096 * 100 + 17,
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .changedCount = 1000,
+        .maxDirtyRange = 0,
+        .iterations = 4,
+    },
+};
+
+template <typename T>
+static void uploadArray(const merian::CommandBufferHandle& cmd,
+                        const merian::BufferHandle& local,
+                        const merian::BufferHandle& stage,
+                        std::span<const T> elements) {
+    Buffers::CMFView stageView{stage, elements.size()};
+    Buffers::CMFView localView{local, elements.size()};
+    stageView.upload<T>(elements);
+    stageView.copyTo(cmd, localView);
+    localView.expectComputeRead(cmd);
+}
+
+static bool runTestCase(const host::test::TestContext& context,
+                        const TestCase& testCase,
+                        std::pmr::memory_resource* resource) {
+    std::string testName =
+        fmt::format("{{partitionSize={},N={},distribution={},changed={}}}",
+                    testCase.config.partitionSize(), testCase.N,
+                    host::distribution_to_pretty_string(testCase.distribution),
+                    testCase.changedCount == 0 ? fmt::format("range<={}", testCase.maxDirtyRange)
+                                               : fmt::format("{}", testCase.changedCount));
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    Algorithm kernel{context.context, context.shaderCompiler, testCase.config};
+
+    const host::glsl::uint N = testCase.N;
+    const host::glsl::uint partitionCount =
+        (N + testCase.config.partitionSize() - 1) / testCase.config.partitionSize();
+    // the states are downloaded as raw floats, buildTotal followed by 3 words per partition.
+    const std::size_t stateWords = 1 + 3 * partitionCount;
+
+    Buffers buffers;
+    buffers.weights = context.alloc->createBuffer(Buffers::WeightsLayout::size(N),
+                                                  vk::BufferUsageFlagBits::eStorageBuffer |
+                                                      vk::BufferUsageFlagBits::eTransferDst,
+                                                  merian::MemoryMappingType::NONE);
+    buffers.cmf = context.alloc->createBuffer(Buffers::CMFLayout::size(N),
+                                              vk::BufferUsageFlagBits::eStorageBuffer |
+                                                  vk::BufferUsageFlagBits::eTransferDst |
+                                                  vk::BufferUsageFlagBits::eTransferSrc,
+                                              merian::MemoryMappingType::NONE);
+    buffers.states = context.alloc->createBuffer(Buffers::StatesLayout::size(partitionCount),
+                                                 vk::BufferUsageFlagBits::eStorageBuffer |
+                                                     vk::BufferUsageFlagBits::eTransferDst |
+                                                     vk::BufferUsageFlagBits::eTransferSrc,
+                                                 merian::MemoryMappingType::NONE);
+    Buffers stage;
+    stage.weights = context.alloc->createBuffer(Buffers::WeightsLayout::size(N),
+                                                vk::BufferUsageFlagBits::eTransferSrc,
+                                                merian::MemoryMappingType::HOST_ACCESS_RANDOM);
+    stage.cmf = context.alloc->createBuffer(Buffers::CMFLayout::size(N),
+                                            vk::BufferUsageFlagBits::eTransferSrc |
+                                                vk::BufferUsageFlagBits::eTransferDst,
+                                            merian::MemoryMappingType::HOST_ACCESS_RANDOM);
+    stage.states = context.alloc->createBuffer(Buffers::StatesLayout::size(partitionCount),
+                                               vk::BufferUsageFlagBits::eTransferDst,
+                                               merian::MemoryMappingType::HOST_ACCESS_RANDOM);
+
+    std::mt19937 rng{std::random_device{}()};
+
+    bool failed = false;
+    for (size_t it = 0; it < testCase.iterations; ++it) {
+        MERIAN_PROFILE_SCOPE(context.profiler, testName);
+        context.queue->wait_idle();
+
+        // 1. Generate input
+        context.profiler->start("Generate test input");
+        std::pmr::vector<float> weights =
+            host::pmr::generate_weights<float>(testCase.distribution, N, resource);
+        const std::pmr::vector<float> initialCMF =
+            host::reference::pmr::prefix_sum<float>(weights, resource);
+
+        std::uniform_int_distribution<host::glsl::uint> indexDist{0, N - 1};
+        std::uniform_real_distribution<float> weightDist{0.0f, 2.0f};
+        std::pmr::vector<host::glsl::uint> changedIndices{resource};
+        host::glsl::uint dirtyBegin = 0;
+        host::glsl::uint dirtyEnd = 0;
+        if (testCase.changedCount == 0) {
+            dirtyBegin = indexDist(rng);
+            dirtyEnd = std::min(N, dirtyBegin + 1 +
+                                       std::uniform_int_distribution<host::glsl::uint>{
+                                           0, testCase.maxDirtyRange - 1}(rng));
+            for (host::glsl::uint i = dirtyBegin; i < dirtyEnd; ++i) {
+                weights[i] = weightDist(rng);
+            }
+        } else {
+            for (host::glsl::uint i = 0; i < testCase.changedCount; ++i) {
+                changedIndices.push_back(indexDist(rng));
+                weights[changedIndices.back()] = weightDist(rng);
+            }
+        }
+        const std::pmr::vector<float> reference =
+            host::reference::pmr::prefix_sum<float>(weights, resource);
+        context.profiler->end();
+
+        // 2. Begin recoding
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        std::string recordingLabel = fmt::format("Recording : {}", testName);
+        context.profiler->start(recordingLabel);
+        context.profiler->cmd_start(cmd, recordingLabel);
+
+        // 3. Upload test case, the initial cmf stands in for a full build.
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Upload test case");
+            uploadArray<float>(cmd, buffers.cmf, stage.cmf, initialCMF);
+            uploadArray<float>(cmd, buffers.weights, stage.weights, weights);
+            kernel.reset(cmd, buffers);
+        }
+
+        // 4. Run test case
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Incremental update");
+            if (testCase.changedCount == 0) {
+                kernel.update(cmd, buffers, N, dirtyBegin, dirtyEnd, context.profiler);
+            } else {
+                kernel.update(cmd, buffers, N, changedIndices, context.profiler);
+            }
+        }
+
+        // 5. Download results to stage
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Download results to stage");
+            Buffers::CMFView localView{buffers.cmf, N};
+            Buffers::CMFView stageView{stage.cmf, N};
+            localView.expectComputeWrite();
+            localView.copyTo(cmd, stageView);
+            stageView.expectHostRead(cmd);
+
+            Buffers::CMFView localStatesView{buffers.states, stateWords};
+            Buffers::CMFView stageStatesView{stage.states, stateWords};
+            localStatesView.expectComputeWrite();
+            localStatesView.copyTo(cmd, stageStatesView);
+            stageStatesView.expectHostRead(cmd);
+        }
+
+        // 6. Submit to device
+        context.profiler->end();
+        context.profiler->cmd_end(cmd);
+        cmd->end();
+        context.queue->submit_wait(cmd);
+
+        // 7. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            const auto cmf = Buffers::CMFView{stage.cmf, N}.download<float, host::pmr_alloc<float>>(
+                resource);
+            const auto states = Buffers::CMFView{stage.states, stateWords}
+                                    .download<float, host::pmr_alloc<float>>(resource);
+            for (host::glsl::uint i = 0; i < N; ++i) {
+                const host::glsl::uint p = i / testCase.config.partitionSize();
+                const float effective = cmf[i] + states[1 + 3 * p];
+                const float err = std::abs(effective - reference[i]);
+                if (err > 1e-3f * std::max(1.0f, std::abs(reference[i]))) {
+                    SPDLOG_ERROR("Invalid CMF at {}: expected {}, got {}", i, reference[i],
+                                 effective);
+                    failed = true;
+                    break;
+                }
+            }
+        }
+        context.profiler->collect(true, true);
+    }
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing incremental CMF");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    host::memory::StackResource stackResource{4096 * 2048};
+    host::memory::FallbackResource fallbackResource{&stackResource};
+    host::memory::SafeResource safeResource{&fallbackResource};
+
+    std::pmr::memory_resource* resource = &safeResource;
+
+    uint32_t failCount = 0;
+    for (const auto& testCase : TEST_CASES) {
+        if (runTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+
+    testContext.profiler->collect(true, true);
+    SPDLOG_INFO(fmt::format("Profiler results: \n{}",
+                            merian::Profiler::get_report_str(testContext.profiler->get_report())));
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
+                                 sizeof(TEST_CASES) / sizeof(TestCase)));
+    }
+}
+
+} // namespace device::test::incremental_cmf
@@ -14,17 +14,48 @@
 
 #include "merian/vk/memory/memory_allocator.hpp"
 #include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ThreadPool.hpp"
 #include "src/device/prefix_sum/PrefixSum.hpp"
+#include "src/device/wrs/compressed_cmf/CompressedCMF.hpp"
+#include "src/device/wrs/glsl/WRSInline.hpp"
+#include "src/device/wrs/incremental/IncrementalCMF.hpp"
 #include "src/device/wrs/its/sampling/InverseTransformSampling.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
+#include "src/host/types/sample_index.hpp"
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include <vulkan/vulkan_handles.hpp>
 
 #include "merian/vk/memory/resource_allocator.hpp"
 
 namespace device {
 
+class ITSConfig {
+  public:
+    PrefixSumConfig prefixSumConfig;
+    InverseTransformSamplingConfig samplingConfig;
+    // enables update() after partial weight changes.
+    std::optional<IncrementalCMFConfig> incrementalConfig;
+    // samples from a compressed cmf, can't be combined with incremental updates.
+    std::optional<CompressedCMFConfig> compressedConfig;
+
+    constexpr ITSConfig()
+        : prefixSumConfig{}, samplingConfig{}, incrementalConfig{}, compressedConfig{} {}
+    explicit constexpr ITSConfig(PrefixSumConfig prefixSumConfig,
+                                 InverseTransformSamplingConfig samplingConfig,
+                                 std::optional<IncrementalCMFConfig> incrementalConfig =
+                                     std::nullopt,
+                                 std::optional<CompressedCMFConfig> compressedConfig =
+                                     std::nullopt)
+        : prefixSumConfig(prefixSumConfig), samplingConfig(samplingConfig),
+          incrementalConfig(incrementalConfig), compressedConfig(compressedConfig) {}
+};
+
 struct ITSBuffers {
     using Self = ITSBuffers;
     static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
@@ -33,17 +64,44 @@ struct ITSBuffers {
     using WeightsLayout = host::layout::ArrayLayout<float, storageQualifier>;
     using WeightsView = host::layout::BufferView<WeightsLayout>;
 
-    merian::BufferHandle samples;
+    merian::BufferHandle samples; // packed for narrow sample indices (see sample_index.hpp)
     using SamplesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
     using SamplesView = host::layout::BufferView<SamplesLayout>;
 
     PrefixSumBuffers m_prefixSumBuffers;
     InverseTransformSamplingBuffers m_samplingBuffers;
+    merian::BufferHandle m_incrementalStates = nullptr;
+    CompressedCMFBuffers m_compressedBuffers;
 
     static Self allocate(const merian::ResourceAllocatorHandle& alloc,
                          merian::MemoryMappingType memoryMapping,
                          std::size_t N,
                          std::size_t S,
+                         ITSConfig config) {
+        Self buffers = allocate(alloc, memoryMapping, N,
+                                host::sampleWordCount(S, config.samplingConfig.sampleIndexWidth),
+                                config.prefixSumConfig);
+        if (config.incrementalConfig.has_value() &&
+            memoryMapping == merian::MemoryMappingType::NONE) {
+            buffers.m_incrementalStates =
+                IncrementalCMFBuffers::allocateStates(alloc, N, *config.incrementalConfig);
+            buffers.m_samplingBuffers.incrementalStates = buffers.m_incrementalStates;
+        }
+        if (config.compressedConfig.has_value() &&
+            memoryMapping == merian::MemoryMappingType::NONE) {
+            buffers.m_compressedBuffers = CompressedCMFBuffers::allocate(
+                alloc, memoryMapping, N, *config.compressedConfig);
+            buffers.m_compressedBuffers.cmf = buffers.m_prefixSumBuffers.prefixSum;
+            buffers.m_samplingBuffers.cmf = buffers.m_compressedBuffers.deltas;
+            buffers.m_samplingBuffers.blockBases = buffers.m_compressedBuffers.blockBases;
+        }
+        return buffers;
+    }
+
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         merian::MemoryMappingType memoryMapping,
+                         std::size_t N,
+                         std::size_t S, // sample words
                          PrefixSumConfig prefixSumConfig) {
         Self buffers;
         buffers.m_prefixSumBuffers =
@@ -65,46 +123,104 @@ struct ITSBuffers {
     }
 };
 
-class ITSConfig {
-  public:
-    PrefixSumConfig prefixSumConfig;
-    InverseTransformSamplingConfig samplingConfig;
-
-    constexpr ITSConfig() : prefixSumConfig{}, samplingConfig{} {}
-    explicit constexpr ITSConfig(PrefixSumConfig prefixSumConfig,
-                                 InverseTransformSamplingConfig samplingConfig)
-        : prefixSumConfig(prefixSumConfig), samplingConfig(samplingConfig) {}
-};
-
 class ITS {
   public:
     using Buffers = ITSBuffers;
     using Config = ITSConfig;
 
+    /// With sampleParametersBuffer, S and the seed of the samples are read from a buffer
+    /// (see the sample overload with parameters).
     explicit ITS(const merian::ContextHandle& context,
                  const merian::ShaderCompilerHandle& shaderCompiler,
-                 ITSConfig config = {})
-        : m_prefixSumKernel(context, shaderCompiler, config.prefixSumConfig),
-          m_samplingKernel(context, shaderCompiler, config.samplingConfig) {}
+                 ITSConfig config = {},
+                 bool sampleParametersBuffer = false)
+        : ITS(pipeline::parallel(
+              [&]() {
+                  return PrefixSum<host::glsl::f32>(context, shaderCompiler,
+                                                    config.prefixSumConfig);
+              },
+              [&]() {
+                  std::optional<host::glsl::uint> incrementalPartitionSize;
+                  if (config.incrementalConfig.has_value()) {
+                      incrementalPartitionSize = config.incrementalConfig->partitionSize();
+                  }
+                  std::optional<host::glsl::uint> compressedBlockSize;
+                  if (config.compressedConfig.has_value()) {
+                      compressedBlockSize = config.compressedConfig->blockSize;
+                  }
+                  return InverseTransformSampling(context, shaderCompiler, config.samplingConfig,
+                                                  incrementalPartitionSize, compressedBlockSize,
+                                                  sampleParametersBuffer);
+              },
+              [&]() -> std::optional<IncrementalCMF> {
+                  if (config.incrementalConfig.has_value()) {
+                      return IncrementalCMF(context, shaderCompiler, *config.incrementalConfig);
+                  }
+                  return std::nullopt;
+              },
+              [&]() -> std::optional<CompressedCMF> {
+                  if (config.compressedConfig.has_value()) {
+                      return CompressedCMF(context, shaderCompiler, *config.compressedConfig);
+                  }
+                  return std::nullopt;
+              })) {}
 
     void build(const merian::CommandBufferHandle& cmd,
                const Buffers& buffers,
                host::glsl::uint N,
                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
-        if (profiler.has_value()) {
-            profiler.value()->start("Prefix Sum");
-            profiler.value()->cmd_start(cmd, "Prefix Sum");
-        }
-        m_prefixSumKernel.run(cmd, buffers.m_prefixSumBuffers, N, profiler);
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "Prefix Sum");
+            m_prefixSumKernel.run(cmd, buffers.m_prefixSumBuffers, N, profiler);
         }
 
         cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
                      vk::PipelineStageFlagBits::eComputeShader,
                      buffers.m_prefixSumBuffers.prefixSum->buffer_barrier(
-                         vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eShaderWrite));
+                         vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead));
+
+        if (m_incremental.has_value()) {
+            m_incremental->reset(cmd, incrementalBuffers(buffers));
+        }
+
+        if (m_compressed.has_value()) {
+            {
+                WRS_PROFILE_SCOPE(profiler, cmd, "Compress-CMF");
+                m_compressed->run(cmd, buffers.m_compressedBuffers, N);
+            }
+            CompressedCMF::barrier(cmd, buffers.m_compressedBuffers);
+        }
+    }
+
+    /**
+     * Updates the CMF after the weights in [dirtyBegin, dirtyEnd) changed,
+     * only the partitions covering the range are rescanned.
+     * Requires an incremental config and a previous build().
+     * Writes to the weights have to be visible to compute shaders.
+     */
+    void update(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint dirtyBegin,
+                host::glsl::uint dirtyEnd,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (!m_incremental.has_value()) {
+            throw std::runtime_error("ITS was not configured for incremental updates");
+        }
+        m_incremental->update(cmd, incrementalBuffers(buffers), N, dirtyBegin, dirtyEnd,
+                              profiler);
+    }
+
+    /// Same as above for an arbitrary list of changed weights.
+    void update(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                std::span<const host::glsl::uint> changedIndices,
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (!m_incremental.has_value()) {
+            throw std::runtime_error("ITS was not configured for incremental updates");
+        }
+        m_incremental->update(cmd, incrementalBuffers(buffers), N, changedIndices, profiler);
     }
 
     void
@@ -113,25 +229,84 @@ class ITS {
            host::glsl::uint N,
            host::glsl::uint S,
            host::glsl::uint seed = 12345u,
-           [[maybe_unused]] std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
-        using SamplingBuffers = InverseTransformSampling::Buffers;
-        SamplingBuffers samplingBuffers;
+           std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        sample(cmd, buffers, N, S, seed, host::SampleSequence{}, profiler);
+    }
+
+    /// Samples from the points [offset, offset + S) of a low-discrepancy sequence, if the
+    /// sampling kernel uses one (see host::RNGAlgorithm).
+    void
+    sample(const merian::CommandBufferHandle& cmd,
+           const Buffers& buffers,
+           host::glsl::uint N,
+           host::glsl::uint S,
+           host::glsl::uint seed,
+           const host::SampleSequence& sequence,
+           std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        m_samplingKernel.run(cmd, samplingBuffers(buffers), N, S, seed, sequence, profiler);
+    }
+
+    /// Reads S and the seed from parameters and is dispatched for maxS samples,
+    /// requires an ITS created with sampleParametersBuffer.
+    void sample(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint maxS,
+                const merian::BufferHandle& parameters,
+                const host::SampleSequence& sequence = {},
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        m_samplingKernel.run(cmd, samplingBuffers(buffers), N, maxS, parameters, sequence,
+                             profiler);
+    }
+
+    /// Bindings to sample from the built CMF inline in user shaders (see glsl/wrs.glsl).
+    WRSInlineBindings inlineBindings(const Buffers& buffers, host::glsl::uint N) const {
+        if (m_incremental.has_value() || m_compressed.has_value()) {
+            throw std::runtime_error("ITS: inline sampling requires a plain CMF");
+        }
+        WRSInlineBindings bindings;
+        bindings.defines["WRS_ITS"];
+        bindings.buffers = {buffers.m_prefixSumBuffers.prefixSum};
+        bindings.parameters.N = N;
+        return bindings;
+    }
+
+  private:
+    using Kernels = std::tuple<PrefixSum<host::glsl::f32>,
+                               InverseTransformSampling,
+                               std::optional<IncrementalCMF>,
+                               std::optional<CompressedCMF>>;
+
+    explicit ITS(Kernels&& kernels)
+        : m_prefixSumKernel(std::move(std::get<0>(kernels))),
+          m_samplingKernel(std::move(std::get<1>(kernels))),
+          m_incremental(std::move(std::get<2>(kernels))),
+          m_compressed(std::move(std::get<3>(kernels))) {}
+
+    InverseTransformSampling::Buffers samplingBuffers(const Buffers& buffers) const {
+        InverseTransformSampling::Buffers samplingBuffers;
         samplingBuffers.cmf = buffers.m_prefixSumBuffers.prefixSum;
         samplingBuffers.samples = buffers.samples;
-        if (profiler.has_value()) {
-            profiler.value()->start("Sampling");
-            profiler.value()->cmd_start(cmd, "Sampling");
-        }
-        m_samplingKernel.run(cmd, samplingBuffers, N, S, seed);
-        if (profiler.has_value()) {
-            profiler.value()->end();
-            profiler.value()->cmd_end(cmd);
+        samplingBuffers.incrementalStates = buffers.m_incrementalStates;
+        if (m_compressed.has_value()) {
+            samplingBuffers.cmf = buffers.m_compressedBuffers.deltas;
+            samplingBuffers.blockBases = buffers.m_compressedBuffers.blockBases;
         }
+        return samplingBuffers;
+    }
+
+    static IncrementalCMF::Buffers incrementalBuffers(const Buffers& buffers) {
+        IncrementalCMF::Buffers incrementalBuffers;
+        incrementalBuffers.weights = buffers.weights;
+        incrementalBuffers.cmf = buffers.m_prefixSumBuffers.prefixSum;
+        incrementalBuffers.states = buffers.m_incrementalStates;
+        return incrementalBuffers;
     }
 
-  private:
     PrefixSum<host::glsl::f32> m_prefixSumKernel;
     InverseTransformSampling m_samplingKernel;
+    std::optional<IncrementalCMF> m_incremental;
+    std::optional<CompressedCMF> m_compressed;
 };
 
 } // namespace device
@@ -0,0 +1,158 @@
+#pragma once
+/**
+ * @filename    : ITS64.hpp
+ *
+ * Inverse Transform Sampling with 64-bit weight and sample indices, for distributions,
+ * which exceed a single storage buffer binding (maxStorageBufferRange) or 2^32 weights.
+ *
+ * The weights, the CMF and the samples are not bound, instead the kernels access them
+ * by their device address (see DecoupledPrefixSum::runIndex64 and
+ * InverseTransformSampling::runIndex64). Every sample is written as a uint64.
+ * Requires the shaderInt64 and bufferDeviceAddress features (see meson option index64).
+ *
+ * Only a plain CMF is supported, the incremental and compressed CMFs and the
+ * Cutpoint and AliasTable methods keep 32-bit indices.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/memory/resource_allocator.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/prefix_sum/decoupled/DecoupledPrefixSum.hpp"
+#include "src/device/wrs/its/sampling/InverseTransformSampling.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <vulkan/vulkan_enums.hpp>
+
+namespace device {
+
+class ITS64Config {
+  public:
+    DecoupledPrefixSumConfig prefixSumConfig;
+    InverseTransformSamplingConfig samplingConfig; // requires index64
+
+    constexpr ITS64Config()
+        : prefixSumConfig{}, samplingConfig(512, 4096, true, host::SampleIndexWidth::U32,
+                                            host::RNGAlgorithm::HASH, true) {}
+    explicit constexpr ITS64Config(DecoupledPrefixSumConfig prefixSumConfig,
+                                   InverseTransformSamplingConfig samplingConfig)
+        : prefixSumConfig(prefixSumConfig), samplingConfig(samplingConfig) {}
+};
+
+struct ITS64Buffers {
+    using Self = ITS64Buffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    merian::BufferHandle weights;
+    using WeightsLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using WeightsView = host::layout::BufferView<WeightsLayout>;
+
+    merian::BufferHandle cmf;
+    using CMFLayout = host::layout::ArrayLayout<float, storageQualifier>;
+    using CMFView = host::layout::BufferView<CMFLayout>;
+
+    merian::BufferHandle samples;
+    using SamplesLayout = host::layout::ArrayLayout<host::glsl::uint64, storageQualifier>;
+    using SamplesView = host::layout::BufferView<SamplesLayout>;
+
+    merian::BufferHandle m_decoupledStates;
+
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         merian::MemoryMappingType memoryMapping,
+                         std::size_t N,
+                         std::size_t S,
+                         const ITS64Config& config = {}) {
+        Self buffers;
+        if (memoryMapping == merian::MemoryMappingType::NONE) {
+            buffers.weights = alloc->createBuffer(WeightsLayout::size(N),
+                                                  vk::BufferUsageFlagBits::eShaderDeviceAddress |
+                                                      vk::BufferUsageFlagBits::eTransferDst,
+                                                  memoryMapping);
+            buffers.cmf = alloc->createBuffer(CMFLayout::size(N),
+                                              vk::BufferUsageFlagBits::eShaderDeviceAddress |
+                                                  vk::BufferUsageFlagBits::eTransferSrc,
+                                              memoryMapping);
+            buffers.samples = alloc->createBuffer(SamplesLayout::size(S),
+                                                  vk::BufferUsageFlagBits::eShaderDeviceAddress |
+                                                      vk::BufferUsageFlagBits::eTransferSrc,
+                                                  memoryMapping);
+            buffers.m_decoupledStates =
+                DecoupledPrefixSumBuffers::allocate(alloc, memoryMapping, N,
+                                                    config.prefixSumConfig.partitionSize(),
+                                                    PrefixSumAllocFlags::ALLOC_NONE)
+                    .decoupledStates;
+        } else {
+            buffers.weights = alloc->createBuffer(
+                WeightsLayout::size(N), vk::BufferUsageFlagBits::eTransferSrc, memoryMapping);
+            buffers.cmf = alloc->createBuffer(CMFLayout::size(N),
+                                              vk::BufferUsageFlagBits::eTransferDst, memoryMapping);
+            buffers.samples = alloc->createBuffer(
+                SamplesLayout::size(S), vk::BufferUsageFlagBits::eTransferDst, memoryMapping);
+        }
+        return buffers;
+    }
+};
+
+class ITS64 {
+  public:
+    using Buffers = ITS64Buffers;
+    using Config = ITS64Config;
+
+    explicit ITS64(const merian::ContextHandle& context,
+                   const merian::ShaderCompilerHandle& shaderCompiler,
+                   const Config& config = {})
+        : m_prefixSum(context, shaderCompiler, config.prefixSumConfig, false, true),
+          m_sampling(context, shaderCompiler, config.samplingConfig) {
+        if (!config.samplingConfig.index64) {
+            throw std::runtime_error("ITS64: the sampling config has to enable index64");
+        }
+    }
+
+    void build(const merian::CommandBufferHandle& cmd,
+               const Buffers& buffers,
+               std::uint64_t N,
+               std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        DecoupledPrefixSum::Buffers prefixSumBuffers;
+        prefixSumBuffers.elements = buffers.weights;
+        prefixSumBuffers.prefixSum = buffers.cmf;
+        prefixSumBuffers.decoupledStates = buffers.m_decoupledStates;
+        {
+            WRS_PROFILE_SCOPE(profiler, cmd, "Prefix Sum");
+            m_prefixSum.runIndex64(cmd, prefixSumBuffers, N);
+        }
+
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     buffers.cmf->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                 vk::AccessFlagBits::eShaderRead));
+    }
+
+    void sample(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                std::uint64_t N,
+                host::glsl::uint S,
+                host::glsl::uint seed = 12345u,
+                const host::SampleSequence& sequence = {},
+                std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        InverseTransformSampling::Buffers samplingBuffers;
+        samplingBuffers.cmf = buffers.cmf;
+        samplingBuffers.samples = buffers.samples;
+        m_sampling.runIndex64(cmd, samplingBuffers, N, S, seed, sequence, profiler);
+    }
+
+    inline std::size_t maxElementCount() const {
+        return m_prefixSum.maxElementCount();
+    }
+
+  private:
+    DecoupledPrefixSum m_prefixSum;
+    InverseTransformSampling m_sampling;
+};
+
+} // namespace device
@@ -0,0 +1,217 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/wrs/its/index64/ITS64.hpp"
+#include "src/host/assert/is_prefix.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include "src/host/memory/FallbackResource.hpp"
+#include "src/host/memory/SafeResource.hpp"
+#include "src/host/memory/StackResource.hpp"
+#include "src/host/statistics/chi_square.hpp"
+#include <cstdint>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+namespace device::test::its64 {
+
+using Algorithm = ITS64;
+using Buffers = Algorithm::Buffers;
+using Config = Algorithm::Config;
+
+struct TestCase {
+    Config config;
+    host::glsl::uint N;
+    host::Distribution distribution;
+    host::glsl::uint S;
+    uint32_t iterations;
+};
+
+// amount of equally sized index ranges, in which the samples are counted.
+static constexpr host::glsl::uint HISTOGRAM_BUCKETS = 64;
+
+static constexpr TestCase TEST_CASES[] = {
+    TestCase{
+        .config = {},
+        .N = static_cast<host::glsl::uint>(1e6),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = static_cast<host::glsl::uint>(1e6),
+        .iterations = 2,
+    },
+    // chains the prefix sum over 64 partitions per dispatch, such that the carry
+    // between the dispatches is tested.
+    TestCase{
+        .config = ITS64Config(DecoupledPrefixSumConfig(512, 8, BlockScanVariant::RANKED_STRIDED,
+                                                       32, 64),
+                              InverseTransformSamplingConfig(512, 4096, true,
+                                                             host::SampleIndexWidth::U32,
+                                                             host::RNGAlgorithm::HASH, true)),
+        .N = (1u << 22) + 5,
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .S = 1u << 20,
+        .iterations = 2,
+    },
+};
+
+static bool runTestCase(const host::test::TestContext& context,
+                        const TestCase& testCase,
+                        std::pmr::memory_resource* resource) {
+    std::string testName = fmt::format("{{ITS64,N={},distribution={},S={}}}", testCase.N,
+                                       host::distribution_to_pretty_string(testCase.distribution),
+                                       testCase.S);
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    Algorithm kernel{context.context, context.shaderCompiler, testCase.config};
+
+    const host::glsl::uint N = testCase.N;
+    const host::glsl::uint S = testCase.S;
+    if (N > kernel.maxElementCount()) {
+        SPDLOG_WARN("N={} exceeds the maxElementCount={}, skipping", N, kernel.maxElementCount());
+        return false;
+    }
+
+    Buffers buffers = Buffers::allocate(context.alloc, merian::MemoryMappingType::NONE, N, S,
+                                        testCase.config);
+    Buffers stage = Buffers::allocate(context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+                                      N, S, testCase.config);
+
+    bool failed = false;
+    for (size_t it = 0; it < testCase.iterations; ++it) {
+        MERIAN_PROFILE_SCOPE(context.profiler, testName);
+        context.queue->wait_idle();
+
+        // 1. Generate input
+        context.profiler->start("Generate test input");
+        std::pmr::vector<float> weights =
+            host::pmr::generate_weights<float>(testCase.distribution, N, resource);
+        context.profiler->end();
+
+        // 2. Begin recoding
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        std::string recordingLabel = fmt::format("Recording : {}", testName);
+        context.profiler->start(recordingLabel);
+        context.profiler->cmd_start(cmd, recordingLabel);
+
+        // 3. Upload weights, build and sample
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Upload test case");
+            Buffers::WeightsView stageWeights{stage.weights, N};
+            Buffers::WeightsView localWeights{buffers.weights, N};
+            stageWeights.upload<float>(weights);
+            stageWeights.copyTo(cmd, localWeights);
+            localWeights.expectComputeRead(cmd);
+        }
+        kernel.build(cmd, buffers, N, context.profiler);
+        kernel.sample(cmd, buffers, N, S, static_cast<host::glsl::uint>(it), {},
+                      context.profiler);
+
+        // 4. Download results to stage
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Download results to stage");
+            Buffers::CMFView localCMF{buffers.cmf, N};
+            Buffers::CMFView stageCMF{stage.cmf, N};
+            localCMF.expectComputeWrite();
+            localCMF.copyTo(cmd, stageCMF);
+            stageCMF.expectHostRead(cmd);
+
+            Buffers::SamplesView localSamples{buffers.samples, S};
+            Buffers::SamplesView stageSamples{stage.samples, S};
+            localSamples.expectComputeWrite();
+            localSamples.copyTo(cmd, stageSamples);
+            stageSamples.expectHostRead(cmd);
+        }
+
+        // 5. Submit to device
+        context.profiler->end();
+        context.profiler->cmd_end(cmd);
+        cmd->end();
+        context.queue->submit_wait(cmd);
+
+        // 6. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            const auto cmf =
+                Buffers::CMFView{stage.cmf, N}.download<float, host::pmr_alloc<float>>(resource);
+            auto err = host::test::pmr::assert_is_inclusive_prefix<float>(weights, cmf, resource);
+            if (err) {
+                SPDLOG_ERROR("Invalid CMF: \n{}", err.message());
+                failed = true;
+            }
+
+            const auto samples =
+                Buffers::SamplesView{stage.samples, S}
+                    .download<host::glsl::uint64, host::pmr_alloc<host::glsl::uint64>>(resource);
+            const host::glsl::uint bucketSize = (N + HISTOGRAM_BUCKETS - 1) / HISTOGRAM_BUCKETS;
+            std::pmr::vector<double> histogram(HISTOGRAM_BUCKETS, 0.0, resource);
+            for (host::glsl::uint s = 0; s < S; ++s) {
+                if (samples[s] >= N || weights[samples[s]] == 0.0f) {
+                    SPDLOG_ERROR("Invalid sample {} at {}", samples[s], s);
+                    failed = true;
+                    break;
+                }
+                histogram[samples[s] / bucketSize] += 1.0;
+            }
+
+            std::pmr::vector<double> bucketWeights(HISTOGRAM_BUCKETS, 0.0, resource);
+            double totalWeight = 0.0;
+            for (host::glsl::uint i = 0; i < N; ++i) {
+                bucketWeights[i / bucketSize] += weights[i];
+                totalWeight += weights[i];
+            }
+            double chi2 = 0.0;
+            std::size_t df = 0;
+            for (host::glsl::uint b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+                const double expected = bucketWeights[b] / totalWeight * S;
+                if (expected == 0.0) {
+                    continue;
+                }
+                chi2 += (histogram[b] - expected) * (histogram[b] - expected) / expected;
+                df++;
+            }
+            if (df > 1) {
+                const double zScore = host::chi_square_z_score(chi2, df - 1);
+                SPDLOG_INFO("Chi-Square z-score: {}", zScore);
+                if (zScore > 6.0) {
+                    SPDLOG_ERROR("ITS64 displays a significant bias");
+                    failed = true;
+                }
+            }
+        }
+        context.profiler->collect(true, true);
+    }
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing ITS64");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    host::memory::StackResource stackResource{4096 * 2048};
+    host::memory::FallbackResource fallbackResource{&stackResource};
+    host::memory::SafeResource safeResource{&fallbackResource};
+
+    std::pmr::memory_resource* resource = &safeResource;
+
+    uint32_t failCount = 0;
+    for (const auto& testCase : TEST_CASES) {
+        if (runTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+
+    testContext.profiler->collect(true, true);
+    SPDLOG_INFO(fmt::format("Profiler results: \n{}",
+                            merian::Profiler::get_report_str(testContext.profiler->get_report())));
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
+                                 sizeof(TEST_CASES) / sizeof(TestCase)));
+    }
+}
+
+} // namespace device::test::its64
@@ -18,10 +18,20 @@
 #include "merian/vk/pipeline/specialization_info.hpp"
 #include "merian/vk/pipeline/specialization_info_builder.hpp"
 #include "merian/vk/shader/shader_compiler.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
 #include "src/host/layout/ArrayLayout.hpp"
 #include "src/host/layout/BufferView.hpp"
 #include "src/host/types/glsl.hpp"
+#include "src/host/types/rng.hpp"
+#include "src/host/types/sample_index.hpp"
+#include <cstdint>
+#include <fmt/format.h>
+#include <map>
 #include <memory>
+#include <optional>
+#include <stdexcept>
 #include <vulkan/vulkan_enums.hpp>
 #include <vulkan/vulkan_handles.hpp>
 
@@ -33,25 +43,32 @@ struct InverseTransformSamplingBuffers {
     using Self = InverseTransformSamplingBuffers;
     static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
 
-    merian::BufferHandle cmf; // cummulative mass function
+    merian::BufferHandle cmf; // cummulative mass function (deltas of a compressed cmf)
     using CMFLayout = host::layout::ArrayLayout<float, storageQualifier>;
     using CMFView = host::layout::BufferView<CMFLayout>;
 
-    merian::BufferHandle samples;
+    merian::BufferHandle samples; // packed for narrow sample indices (see sample_index.hpp)
     using SamplesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
     using SamplesView = host::layout::BufferView<SamplesLayout>;
 
+    // only bound if the kernel was created for an incremental cmf (see IncrementalCMF.hpp).
+    merian::BufferHandle incrementalStates = nullptr;
+    // only bound if the kernel was created for a compressed cmf (see CompressedCMF.hpp).
+    merian::BufferHandle blockBases = nullptr;
+
     static Self allocate(const merian::ResourceAllocatorHandle& alloc,
                          merian::MemoryMappingType memoryMapping,
                          std::size_t cmfSize,
-                         std::size_t sampleCount) {
+                         std::size_t sampleCount,
+                         host::SampleIndexWidth sampleIndexWidth = host::SampleIndexWidth::U32) {
+        const std::size_t sampleWordCount = host::sampleWordCount(sampleCount, sampleIndexWidth);
         Self buffers;
         if (memoryMapping == merian::MemoryMappingType::NONE) {
             buffers.cmf = alloc->createBuffer(CMFLayout::size(cmfSize),
                                               vk::BufferUsageFlagBits::eStorageBuffer |
                                                   vk::BufferUsageFlagBits::eTransferDst,
                                               merian::MemoryMappingType::NONE);
-            buffers.samples = alloc->createBuffer(SamplesLayout::size(sampleCount),
+            buffers.samples = alloc->createBuffer(SamplesLayout::size(sampleWordCount),
                                                   vk::BufferUsageFlagBits::eStorageBuffer |
                                                       vk::BufferUsageFlagBits::eTransferSrc,
                                                   merian::MemoryMappingType::NONE);
@@ -59,7 +76,7 @@ struct InverseTransformSamplingBuffers {
             buffers.cmf = alloc->createBuffer(CMFLayout::size(cmfSize),
                                               vk::BufferUsageFlagBits::eTransferSrc, memoryMapping);
             buffers.samples =
-                alloc->createBuffer(SamplesLayout::size(sampleCount),
+                alloc->createBuffer(SamplesLayout::size(sampleWordCount),
                                     vk::BufferUsageFlagBits::eTransferDst, memoryMapping);
         }
         return buffers;
@@ -71,13 +88,27 @@ class InverseTransformSamplingConfig {
     host::glsl::uint workgroupSize;
     host::glsl::uint cooperativeSamplingSize;
     bool pArraySearch;
+    host::SampleIndexWidth sampleIndexWidth;
+    host::RNGAlgorithm rng;
+    // 64-bit weight and sample indices, the cmf and the samples are accessed by their
+    // device address (see InverseTransformSampling::runIndex64).
+    // Requires the shaderInt64 and bufferDeviceAddress features and u32 sampleIndexWidth.
+    bool index64;
 
     constexpr InverseTransformSamplingConfig()
-        : workgroupSize(512), cooperativeSamplingSize(4096), pArraySearch(true) {}
-    explicit constexpr InverseTransformSamplingConfig(host::glsl::uint workgroupSize,
-                                                      host::glsl::uint cooperativeSamplingSize,
-                                                      bool pArraySearch = false)
-        : workgroupSize(workgroupSize), cooperativeSamplingSize(cooperativeSamplingSize), pArraySearch(pArraySearch) {}
+        : workgroupSize(512), cooperativeSamplingSize(4096), pArraySearch(true),
+          sampleIndexWidth(host::SampleIndexWidth::U32), rng(host::RNGAlgorithm::HASH),
+          index64(false) {}
+    explicit constexpr InverseTransformSamplingConfig(
+        host::glsl::uint workgroupSize,
+        host::glsl::uint cooperativeSamplingSize,
+        bool pArraySearch = false,
+        host::SampleIndexWidth sampleIndexWidth = host::SampleIndexWidth::U32,
+        host::RNGAlgorithm rng = host::RNGAlgorithm::HASH,
+        bool index64 = false)
+        : workgroupSize(workgroupSize), cooperativeSamplingSize(cooperativeSamplingSize),
+          pArraySearch(pArraySearch), sampleIndexWidth(sampleIndexWidth), rng(rng),
+          index64(index64) {}
 };
 
 class InverseTransformSampling {
@@ -85,6 +116,20 @@ class InverseTransformSampling {
         host::glsl::uint N; // cmf size
         host::glsl::uint S; // sample count
         host::glsl::uint seed;
+        host::glsl::uint partitionSize; // incremental partition or compressed block size
+        host::glsl::uint dimension;
+        host::glsl::uint sequenceOffset;
+    };
+
+    struct Index64PushConstants {
+        vk::DeviceAddress cmf;
+        vk::DeviceAddress samples; // one uint64 per sample
+        std::uint64_t N;
+        host::glsl::uint S;
+        host::glsl::uint seed;
+        host::glsl::uint partitionSize;
+        host::glsl::uint dimension;
+        host::glsl::uint sequenceOffset;
     };
 
   public:
@@ -92,54 +137,204 @@ class InverseTransformSampling {
 
     explicit InverseTransformSampling(const merian::ContextHandle& context,
                                       const merian::ShaderCompilerHandle& shaderCompiler,
-                                      InverseTransformSamplingConfig config = {})
-        : m_workgroupSize(config.workgroupSize) {
-
-        const merian::DescriptorSetLayoutHandle descriptorSet0Layout =
-            merian::DescriptorSetLayoutBuilder()
-                .add_binding_storage_buffer()
-                .add_binding_storage_buffer()
-                .build_push_descriptor_layout(context);
+                                      InverseTransformSamplingConfig config = {},
+                                      std::optional<host::glsl::uint> incrementalPartitionSize =
+                                          std::nullopt,
+                                      std::optional<host::glsl::uint> compressedBlockSize =
+                                          std::nullopt,
+                                      bool sampleParametersBuffer = false)
+        : m_workgroupSize(config.workgroupSize), m_sampleIndexWidth(config.sampleIndexWidth),
+          m_index64(config.index64), m_sampleParametersBuffer(sampleParametersBuffer),
+          m_incrementalPartitionSize(incrementalPartitionSize),
+          m_compressedBlockSize(compressedBlockSize) {
+        if (m_incrementalPartitionSize.has_value() && m_compressedBlockSize.has_value()) {
+            throw std::runtime_error(
+                "InverseTransformSampling: a compressed cmf can't be updated incrementally");
+        }
+        if (m_index64 &&
+            (m_incrementalPartitionSize.has_value() || m_compressedBlockSize.has_value() ||
+             m_sampleIndexWidth != host::SampleIndexWidth::U32)) {
+            throw std::runtime_error(
+                "InverseTransformSampling: 64-bit indices only support a plain cmf");
+        }
+        if (m_index64 && m_sampleParametersBuffer) {
+            throw std::runtime_error(
+                "InverseTransformSampling: 64-bit indices require push constant parameters");
+        }
 
         const std::string shaderPath = "src/device/wrs/its/sampling/shader.comp";
 
-        const merian::ShaderModuleHandle shader = shaderCompiler->find_compile_glsl_to_shadermodule(
-            context, shaderPath, vk::ShaderStageFlagBits::eCompute);
-
-        const merian::PipelineLayoutHandle pipelineLayout =
-            merian::PipelineLayoutBuilder(context)
-                .add_descriptor_set_layout(descriptorSet0Layout)
-                .add_push_constant<PushConstants>()
-                .build_pipeline_layout();
-
-        merian::SpecializationInfoBuilder specInfoBuilder;
-        specInfoBuilder.add_entry(m_workgroupSize);
-        specInfoBuilder.add_entry(config.cooperativeSamplingSize);
-        const merian::SpecializationInfoHandle specInfo = specInfoBuilder.build();
+        std::map<std::string, std::string> defines;
+        if (m_incrementalPartitionSize.has_value()) {
+            defines["INCREMENTAL"];
+        }
+        if (m_compressedBlockSize.has_value()) {
+            defines["COMPRESSED"];
+        }
+        if (const auto define = host::sampleIndexDefine(m_sampleIndexWidth)) {
+            defines[*define];
+        }
+        if (m_index64) {
+            defines["INDEX_64"];
+        }
+        if (m_sampleParametersBuffer) {
+            defines["SAMPLE_PARAMETERS_BUFFER"];
+        }
 
-        m_pipeline = std::make_shared<merian::ComputePipeline>(pipelineLayout, shader, specInfo);
+        pipeline::ComputePipelineBuilder pipelineBuilder(context, shaderCompiler, shaderPath);
+        pipelineBuilder.addIncludePath("src/device/common/").setDefines(defines);
+        if (m_index64) {
+            // nothing is bound, see runIndex64.
+            pipelineBuilder.addPushConstant<Index64PushConstants>();
+        } else {
+            pipelineBuilder.addStorageBuffer()  // cmf
+                .addStorageBuffer(); // samples
+            if (m_incrementalPartitionSize.has_value()) {
+                pipelineBuilder.addStorageBuffer(); // incremental states
+            }
+            if (m_compressedBlockSize.has_value()) {
+                pipelineBuilder.addStorageBuffer(); // block bases
+            }
+            if (m_sampleParametersBuffer) {
+                pipelineBuilder.addStorageBuffer(); // sample parameters
+            }
+            pipelineBuilder.addPushConstant<PushConstants>();
+        }
+        m_pipeline = pipelineBuilder.addSpecializationConstant(m_workgroupSize)
+                         .addSpecializationConstant(config.cooperativeSamplingSize)
+                         .addSpecializationConstant(
+                             static_cast<host::glsl::uint>(config.pArraySearch)) // VkBool32
+                         .addSpecializationConstant(host::rngSpecializationConstant(config.rng))
+                         .build();
     }
 
     void run(const merian::CommandBufferHandle& cmd,
              const Buffers& buffers,
              host::glsl::uint N,
              host::glsl::uint S,
-             host::glsl::uint seed = 12345u) const {
+             host::glsl::uint seed = 12345u,
+             const host::SampleSequence& sequence = {},
+             std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (m_index64) {
+            runIndex64(cmd, buffers, N, S, seed, sequence, profiler);
+            return;
+        }
+        if (m_sampleParametersBuffer) {
+            throw std::runtime_error(
+                "InverseTransformSampling: the kernel reads S and seed from a buffer");
+        }
+        record(cmd, buffers, N, S, seed, sequence, nullptr, profiler);
+    }
+
+    /**
+     * Reads the sample count and the seed from parameters (see sample_parameters.comp),
+     * such that they can change between submits of the recorded commands.
+     * Dispatched for maxS samples, requires a kernel created with sampleParametersBuffer.
+     */
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint maxS,
+             const merian::BufferHandle& parameters,
+             const host::SampleSequence& sequence = {},
+             std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (!m_sampleParametersBuffer) {
+            throw std::runtime_error(
+                "InverseTransformSampling: the kernel reads S and seed from push constants");
+        }
+        record(cmd, buffers, N, maxS, 0, sequence, parameters, profiler);
+    }
 
+    /**
+     * Samples from a cmf of more than 2^32 weights, only for index64 kernels.
+     * The cmf and the samples (one uint64 per sample) are accessed by their device address,
+     * therefore they have to be created with eShaderDeviceAddress.
+     */
+    void runIndex64(const merian::CommandBufferHandle& cmd,
+                    const Buffers& buffers,
+                    std::uint64_t N,
+                    host::glsl::uint S,
+                    host::glsl::uint seed = 12345u,
+                    const host::SampleSequence& sequence = {},
+                    std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        if (!m_index64) {
+            throw std::runtime_error("InverseTransformSampling: the kernel uses 32-bit indices");
+        }
         cmd->bind(m_pipeline);
-        cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.samples);
-        cmd->push_constant<PushConstants>(m_pipeline, PushConstants{
-                                                          .N = N,
-                                                          .S = S,
-                                                          .seed = seed,
-                                                      });
+        cmd->push_constant<Index64PushConstants>(m_pipeline,
+                                                 Index64PushConstants{
+                                                     .cmf = buffers.cmf->get_device_address(),
+                                                     .samples =
+                                                         buffers.samples->get_device_address(),
+                                                     .N = N,
+                                                     .S = S,
+                                                     .seed = seed,
+                                                     .partitionSize = 0,
+                                                     .dimension = sequence.dimension,
+                                                     .sequenceOffset = sequence.offset,
+                                                 });
         const uint32_t workgroupCount = (S + m_workgroupSize - 1) / m_workgroupSize;
+
+        WRS_PROFILE_SCOPE(profiler, cmd, "Sampling");
         cmd->dispatch(workgroupCount, 1, 1);
     }
 
   private:
+    // S is the dispatched sample count, S and seed are ignored if the kernel reads them
+    // from the parameters.
+    void record(const merian::CommandBufferHandle& cmd,
+                const Buffers& buffers,
+                host::glsl::uint N,
+                host::glsl::uint S,
+                host::glsl::uint seed,
+                const host::SampleSequence& sequence,
+                const merian::BufferHandle& parameters,
+                const std::optional<merian::ProfilerHandle>& profiler) const {
+        if (!host::sampleIndexWidthFits(N, m_sampleIndexWidth)) {
+            throw std::runtime_error(
+                fmt::format("InverseTransformSampling: N = {} exceeds the {} sample indices", N,
+                            host::sampleIndexWidthName(m_sampleIndexWidth)));
+        }
+
+        cmd->bind(m_pipeline);
+        const bool hasCMFState =
+            m_incrementalPartitionSize.has_value() || m_compressedBlockSize.has_value();
+        const merian::BufferHandle& cmfState = m_incrementalPartitionSize.has_value()
+                                                   ? buffers.incrementalStates
+                                                   : buffers.blockBases;
+        if (hasCMFState && m_sampleParametersBuffer) {
+            cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.samples, cmfState,
+                                     parameters);
+        } else if (hasCMFState) {
+            cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.samples, cmfState);
+        } else if (m_sampleParametersBuffer) {
+            cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.samples, parameters);
+        } else {
+            cmd->push_descriptor_set(m_pipeline, buffers.cmf, buffers.samples);
+        }
+        cmd->push_constant<PushConstants>(
+            m_pipeline, PushConstants{
+                            .N = N,
+                            .S = S,
+                            .seed = seed,
+                            .partitionSize = m_incrementalPartitionSize.value_or(
+                                m_compressedBlockSize.value_or(0)),
+                            .dimension = sequence.dimension,
+                            .sequenceOffset = sequence.offset,
+                        });
+        const uint32_t workgroupCount = (S + m_workgroupSize - 1) / m_workgroupSize;
+
+        WRS_PROFILE_SCOPE(profiler, cmd, "Sampling");
+        cmd->dispatch(workgroupCount, 1, 1);
+    }
+
     merian::PipelineHandle m_pipeline;
     host::glsl::uint m_workgroupSize;
+    host::SampleIndexWidth m_sampleIndexWidth;
+    bool m_index64;
+    bool m_sampleParametersBuffer;
+    std::optional<host::glsl::uint> m_incrementalPartitionSize;
+    std::optional<host::glsl::uint> m_compressedBlockSize;
 };
 
 } // namespace device
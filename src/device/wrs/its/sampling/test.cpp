@@ -13,6 +13,10 @@
 #include "src/host/memory/SafeResource.hpp"
 #include "src/host/memory/StackResource.hpp"
 #include "src/host/reference/prefix_sum.hpp"
+#include "src/host/types/rng.hpp"
+#include "src/host/types/sample_index.hpp"
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <fmt/base.h>
 #include <fmt/format.h>
@@ -42,6 +46,36 @@ static constexpr TestCase TEST_CASES[] = {
         .sampleCount = static_cast<host::glsl::uint>(1e6),
         .iterations = 16,
     },
+    TestCase{
+        .config = InverseTransformSamplingConfig(512, 4096, true, host::SampleIndexWidth::U16),
+        .weightCount = 60000,
+        .distribution = host::Distribution::SEEDED_RANDOM_UNIFORM,
+        .sampleCount = static_cast<host::glsl::uint>(1e6) + 1,
+        .iterations = 4,
+    },
+    TestCase{
+        .config = InverseTransformSamplingConfig(512, 4096, true, host::SampleIndexWidth::U8),
+        .weightCount = 200,
+        .distribution = host::Distribution::SEEDED_RANDOM_UNIFORM,
+        .sampleCount = static_cast<host::glsl::uint>(1e6) + 3,
+        .iterations = 4,
+    },
+    TestCase{
+        .config = InverseTransformSamplingConfig(
+            512, 4096, true, host::SampleIndexWidth::U32, host::RNGAlgorithm::SOBOL),
+        .weightCount = static_cast<host::glsl::uint>(1e5),
+        .distribution = host::Distribution::SEEDED_RANDOM_UNIFORM,
+        .sampleCount = 1 << 20,
+        .iterations = 4,
+    },
+    TestCase{
+        .config = InverseTransformSamplingConfig(
+            512, 4096, true, host::SampleIndexWidth::U32, host::RNGAlgorithm::STRATIFIED),
+        .weightCount = static_cast<host::glsl::uint>(1e5),
+        .distribution = host::Distribution::SEEDED_RANDOM_UNIFORM,
+        .sampleCount = static_cast<host::glsl::uint>(1e6),
+        .iterations = 4,
+    },
 };
 
 static std::tuple<Buffers, Buffers> allocateBuffers(const host::test::TestContext& context) {
@@ -74,9 +108,9 @@ static void uploadTestCase(const merian::CommandBufferHandle& cmd,
 static void downloadToStage(const merian::CommandBufferHandle& cmd,
                             Buffers& buffers,
                             Buffers& stage,
-                            std::size_t sampleCount) {
-    Buffers::SamplesView stageView{stage.samples, sampleCount};
-    Buffers::SamplesView localView{buffers.samples, sampleCount};
+                            std::size_t sampleWordCount) {
+    Buffers::SamplesView stageView{stage.samples, sampleWordCount};
+    Buffers::SamplesView localView{buffers.samples, sampleWordCount};
     localView.copyTo(cmd, stageView);
     stageView.expectHostRead(cmd);
 }
@@ -86,11 +120,23 @@ struct Results {
     std::pmr::vector<host::glsl::uint> samples;
 };
 
-static Results
-downloadFromStage(Buffers& stage, std::pmr::memory_resource* resource, std::size_t sampleCount) {
-    Buffers::SamplesView stageView{stage.samples, sampleCount};
-    std::pmr::vector<host::glsl::uint> samples =
-        stageView.download<host::glsl::uint, std::pmr::polymorphic_allocator<host::glsl::uint>>(resource);
+static Results downloadFromStage(Buffers& stage,
+                                 std::pmr::memory_resource* resource,
+                                 std::size_t sampleCount,
+                                 host::SampleIndexWidth sampleIndexWidth) {
+    Buffers::SamplesView stageView{stage.samples,
+                                   host::sampleWordCount(sampleCount, sampleIndexWidth)};
+    std::pmr::vector<host::glsl::uint> samples{resource};
+    if (sampleIndexWidth == host::SampleIndexWidth::U16) {
+        const auto narrow = stageView.downloadPacked<std::uint16_t>(sampleCount);
+        samples.assign(narrow.begin(), narrow.end());
+    } else if (sampleIndexWidth == host::SampleIndexWidth::U8) {
+        const auto narrow = stageView.downloadPacked<std::uint8_t>(sampleCount);
+        samples.assign(narrow.begin(), narrow.end());
+    } else {
+        samples = stageView.download<host::glsl::uint,
+                                     std::pmr::polymorphic_allocator<host::glsl::uint>>(resource);
+    }
     return Results{
         .samples = std::move(samples),
     };
@@ -102,9 +148,12 @@ static bool runTestCase(const host::test::TestContext& context,
                         Buffers& stage,
                         std::pmr::memory_resource* resource) {
     std::string testName =
-        fmt::format("{{workgroupSize={},weightCount={},distribution={},sampleCount={}}}",
+        fmt::format("{{workgroupSize={},weightCount={},distribution={},sampleCount={},index={},"
+                    "rng={}}}",
                     testCase.config.workgroupSize, testCase.weightCount,
-                    distribution_to_pretty_string(testCase.distribution), testCase.sampleCount);
+                    distribution_to_pretty_string(testCase.distribution), testCase.sampleCount,
+                    host::sampleIndexWidthName(testCase.config.sampleIndexWidth),
+                    host::rngAlgorithmName(testCase.config.rng));
     SPDLOG_INFO("Running test case:{}", testName);
 
     Algorithm kernel{context.context, context.shaderCompiler, testCase.config};
@@ -156,7 +205,9 @@ static bool runTestCase(const host::test::TestContext& context,
         {
             MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Download results to stage");
             SPDLOG_DEBUG("Downloading results to stage...");
-            downloadToStage(cmd, buffers, stage, testCase.sampleCount);
+            downloadToStage(
+                cmd, buffers, stage,
+                host::sampleWordCount(testCase.sampleCount, testCase.config.sampleIndexWidth));
         }
 
         // 6. Submit to device
@@ -169,7 +220,8 @@ static bool runTestCase(const host::test::TestContext& context,
         // 7. Download from stage
         context.profiler->start("Download results from stage");
         SPDLOG_DEBUG("Downloading results from stage...");
-        Results results = downloadFromStage(stage, resource, testCase.sampleCount);
+        Results results = downloadFromStage(stage, resource, testCase.sampleCount,
+                                            testCase.config.sampleIndexWidth);
         context.profiler->end();
 
         // 7. Test results
@@ -180,6 +232,33 @@ static bool runTestCase(const host::test::TestContext& context,
             /* for (glsl::uint s : results.samples) { */
             // fmt::println("Sample: {}", s);
             /* } */
+            const auto invalid = std::ranges::find_if(
+                results.samples, [&](host::glsl::uint s) { return s >= testCase.weightCount; });
+            if (invalid != results.samples.end()) {
+                SPDLOG_ERROR("Invalid sample {} at {}", *invalid,
+                             std::distance(results.samples.begin(), invalid));
+                failed = true;
+            }
+            if (host::rngIsSequence(testCase.config.rng) && invalid == results.samples.end()) {
+                // every weight covers an interval of the stratified [0,1), which contains
+                // S * p samples up to the partial strata at both ends.
+                std::pmr::vector<host::glsl::uint> counts(testCase.weightCount, 0, resource);
+                for (const host::glsl::uint s : results.samples) {
+                    counts[s]++;
+                }
+                const double total = cmf.back();
+                double maxDeviation = 0;
+                for (host::glsl::uint i = 0; i < testCase.weightCount; ++i) {
+                    const double expected = weights[i] / total * testCase.sampleCount;
+                    maxDeviation = std::max(maxDeviation, std::abs(counts[i] - expected));
+                }
+                if (maxDeviation > 2.0) {
+                    SPDLOG_ERROR("Samples are not stratified, max deviation {} from the expected "
+                                 "sample count",
+                                 maxDeviation);
+                    failed = true;
+                }
+            }
             // TODO
         }
         context.profiler->collect(true, true);
@@ -203,7 +282,9 @@ void test(const merian::ContextHandle& context) {
 
     uint32_t failCount = 0;
     for (const auto& testCase : TEST_CASES) {
-        runTestCase(testContext, testCase, buffers, stage, resource);
+        if (runTestCase(testContext, testCase, buffers, stage, resource)) {
+            failCount++;
+        }
         stackResource.reset();
     }
 
@@ -0,0 +1,228 @@
+#pragma once
+/**
+ * @filename    : ReplayableWRS.hpp
+ *
+ * Pre-recorded, replayable build and sample of a WRS for loops, in which the weights
+ * and the sample parameters change but the workload does not. Recording the build and
+ * the sampling costs CPU time every frame, although the commands stay the same.
+ *
+ * The constructor records one command buffer per frame in flight:
+ *   copy weights stage -> weights, WRS::build, WRS::sample
+ * replay() only writes the parameters buffer (S, seed) of the next frame and resubmits it.
+ *
+ * The configured sampling kernel is compiled with SAMPLE_PARAMETERS_BUFFER
+ * (see sample_parameters.comp), it reads S and the seed from the parameters buffer
+ * instead of push constants and is dispatched for maxS samples. Therefore every method
+ * and every sampling option (RNG, index width, cooperative, ...) of the config is replayed,
+ * except for the 64-bit indices of ITS.
+ * N is fixed at record time, because the dispatch sizes and push constants of the build
+ * kernels depend on it. Smaller weight sets can be padded with zeros.
+ *
+ * Every replay signals its own value on timeline(), replay() blocks only if all frames
+ * are still in flight. The recorded commands begin with a full barrier, such that the
+ * replays execute in submission order and all share the same WRS buffers.
+ * The recorded commands are not profiled, they are replayed without collecting the profiler.
+ *
+ * Example:
+ * ReplayableWRS wrs{context, shaderCompiler, alloc, queue, config, N, maxS};
+ * for (frame) {
+ *     wrs.uploadWeights(weights);
+ *     const uint64_t replayed = wrs.replay(S, seed);
+ *     ... submit consumers of wrs.samples(), which wait for replayed on wrs.timeline()
+ * }
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/command/command_pool.hpp"
+#include "merian/vk/command/queue.hpp"
+#include "merian/vk/memory/resource_allocator.hpp"
+#include "merian/vk/sync/semaphore_timeline.hpp"
+#include "src/device/wrs/WRS.hpp"
+#include "src/host/layout/Attribute.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/layout/StructLayout.hpp"
+#include "src/host/types/glsl.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace device {
+
+/// Mirrors in_sampleParameters of sample_parameters.comp.
+struct ReplayParameters {
+    host::glsl::uint S;
+    host::glsl::uint seed;
+
+    static constexpr host::glsl::StorageQualifier storage_qualifier =
+        host::glsl::StorageQualifier::std430;
+
+    static constexpr std::size_t size(host::glsl::StorageQualifier) {
+        return sizeof(ReplayParameters);
+    }
+    static constexpr std::size_t alignment(host::glsl::StorageQualifier) {
+        return alignof(ReplayParameters);
+    }
+};
+
+class ReplayableWRS {
+  public:
+    using Buffers = WRS::Buffers;
+    using Config = WRS::Config;
+
+    using ParametersLayout =
+        host::layout::StructLayout<host::glsl::StorageQualifier::std430,
+                                   host::layout::Attribute<host::glsl::uint, "S">,
+                                   host::layout::Attribute<host::glsl::uint, "seed">>;
+    using ParametersView = host::layout::BufferView<ParametersLayout>;
+
+    ReplayableWRS(const merian::ContextHandle& context,
+                  const merian::ShaderCompilerHandle& shaderCompiler,
+                  const merian::ResourceAllocatorHandle& alloc,
+                  const merian::QueueHandle& queue,
+                  const Config& config,
+                  host::glsl::uint N,
+                  host::glsl::uint maxS,
+                  std::uint32_t framesInFlight = 2)
+        : m_wrs(context, shaderCompiler, config, true), m_queue(queue),
+          m_cmdPool(std::make_shared<merian::CommandPool>(queue)),
+          m_timeline(std::make_shared<merian::TimelineSemaphore>(context, 0)), m_N(N),
+          m_maxS(maxS), m_weights(N, 0.0f) {
+        if (framesInFlight == 0) {
+            throw std::runtime_error("ReplayableWRS: requires at least one frame in flight");
+        }
+        m_buffers = Buffers::allocate(alloc, merian::MemoryMappingType::NONE, N, maxS, config);
+        m_frames.resize(framesInFlight);
+        for (Frame& frame : m_frames) {
+            frame.weightsStage = alloc->createBuffer(Buffers::WeightsLayout::size(N),
+                                                     vk::BufferUsageFlagBits::eTransferSrc,
+                                                     merian::MemoryMappingType::HOST_ACCESS_RANDOM);
+            frame.parameters = alloc->createBuffer(ParametersLayout::size(),
+                                                   vk::BufferUsageFlagBits::eStorageBuffer,
+                                                   merian::MemoryMappingType::HOST_ACCESS_RANDOM);
+            record(frame);
+        }
+    }
+
+    ReplayableWRS(const ReplayableWRS&) = delete;
+    ReplayableWRS& operator=(const ReplayableWRS&) = delete;
+
+    ~ReplayableWRS() {
+        // the recorded command buffers have to outlive the last replay.
+        wait();
+    }
+
+    /// Sets the weights, which are built by the next replay(), has to hold N weights.
+    /// Does not block, the weights are written to the stage of the frame, which replays them.
+    void uploadWeights(std::span<const float> weights) {
+        if (weights.size() != m_N) {
+            throw std::runtime_error("ReplayableWRS: the number of weights has to match N");
+        }
+        std::ranges::copy(weights, m_weights.begin());
+        ++m_weightsVersion;
+    }
+
+    /**
+     * Submits the recorded build and sampling of S samples, it does not wait for it.
+     * Returns the timeline value, which is signaled once this replay is executed.
+     * Blocks only if the next frame is still pending, i.e. if framesInFlight replays
+     * are executing.
+     */
+    std::uint64_t replay(host::glsl::uint S, host::glsl::uint seed = 12345u) {
+        if (S > m_maxS) {
+            throw std::runtime_error("ReplayableWRS: S exceeds the recorded maxS");
+        }
+        Frame& frame = m_frames[m_submitted % m_frames.size()];
+        m_timeline->wait(frame.submitted);
+
+        if (frame.weightsVersion != m_weightsVersion) {
+            Buffers::WeightsView{frame.weightsStage, m_N}.upload<float>(m_weights);
+            frame.weightsVersion = m_weightsVersion;
+        }
+        ParametersView{frame.parameters}.upload<ReplayParameters>(ReplayParameters{
+            .S = S,
+            .seed = seed,
+        });
+
+        frame.submitted = ++m_submitted;
+        m_queue->submit(frame.cmd, {}, {m_timeline}, {}, {}, {}, {frame.submitted});
+        return frame.submitted;
+    }
+
+    /// Blocks until the replay, which returned value, is executed.
+    void wait(std::uint64_t value) const {
+        m_timeline->wait(value);
+    }
+
+    /// Blocks until the last replay is executed.
+    void wait() const {
+        wait(m_submitted);
+    }
+
+    /// Signals the values returned by replay(), consumers on the GPU can wait on it.
+    const merian::TimelineSemaphoreHandle& timeline() const {
+        return m_timeline;
+    }
+
+    /// Samples of the last replay, the first S are valid. Consumers, which are submitted
+    /// after the replay, have to insert a barrier after the compute shader writes.
+    const merian::BufferHandle& samples() const {
+        return m_buffers.samples;
+    }
+
+    const Buffers& buffers() const {
+        return m_buffers;
+    }
+
+  private:
+    struct Frame {
+        merian::CommandBufferHandle cmd;
+        merian::BufferHandle weightsStage;
+        merian::BufferHandle parameters;
+        std::uint64_t weightsVersion = 0;
+        std::uint64_t submitted = 0;
+    };
+
+    void record(Frame& frame) {
+        frame.cmd = std::make_shared<merian::CommandBuffer>(m_cmdPool);
+        // without eOneTimeSubmit, such that the command buffer can be submitted repeatedly.
+        frame.cmd->begin(vk::CommandBufferUsageFlags{});
+
+        // the frames share the WRS buffers, a replay must not start before the previous
+        // replay and the consumers of its samples are executed.
+        frame.cmd->barrier(vk::PipelineStageFlagBits::eAllCommands,
+                           vk::PipelineStageFlagBits::eAllCommands,
+                           vk::MemoryBarrier{vk::AccessFlagBits::eMemoryWrite,
+                                             vk::AccessFlagBits::eMemoryRead |
+                                                 vk::AccessFlagBits::eMemoryWrite});
+
+        Buffers::WeightsView stageView{frame.weightsStage, m_N};
+        Buffers::WeightsView localView{m_buffers.weights, m_N};
+        stageView.expectHostWrite();
+        stageView.copyTo(frame.cmd, localView);
+        localView.expectComputeRead(frame.cmd);
+
+        m_wrs.build(frame.cmd, m_buffers, m_N);
+        m_wrs.sample(frame.cmd, m_buffers, m_N, m_maxS, frame.parameters);
+
+        frame.cmd->end();
+    }
+
+    WRS m_wrs;
+    merian::QueueHandle m_queue;
+    merian::CommandPoolHandle m_cmdPool;
+    merian::TimelineSemaphoreHandle m_timeline;
+    std::uint64_t m_submitted = 0;
+
+    const host::glsl::uint m_N;
+    const host::glsl::uint m_maxS;
+    Buffers m_buffers;
+    std::vector<float> m_weights;
+    // ahead of the frames, such that the first replay uploads the zero weights.
+    std::uint64_t m_weightsVersion = 1;
+    std::vector<Frame> m_frames;
+};
+
+} // namespace device
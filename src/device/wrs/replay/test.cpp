@@ -0,0 +1,167 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/prefix_sum/block_scan/BlockScanVariant.hpp"
+#include "src/device/wrs/replay/ReplayableWRS.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include "src/host/memory/FallbackResource.hpp"
+#include "src/host/memory/SafeResource.hpp"
+#include "src/host/memory/StackResource.hpp"
+#include "src/host/statistics/js_divergence.hpp"
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <random>
+#include <spdlog/spdlog.h>
+
+namespace device::test::replay {
+
+using Algorithm = ReplayableWRS;
+using Buffers = Algorithm::Buffers;
+using Config = Algorithm::Config;
+
+struct TestCase {
+    Config config;
+    host::glsl::uint N;
+    host::Distribution distribution;
+    host::glsl::uint maxS;
+    uint32_t replays;
+};
+
+static const TestCase TEST_CASES[] = {
+    TestCase{
+        .config = ITSConfig(),
+        .N = static_cast<host::glsl::uint>(1e5),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .maxS = static_cast<host::glsl::uint>(1e6),
+        .replays = 4,
+    },
+    TestCase{
+        .config = AliasTableConfig(PSAConfig(AtomicMeanConfig(),
+                                             DecoupledPrefixPartitionConfig(),
+                                             InlineSplitPackConfig(2),
+                                             false),
+                                   SampleAliasTableConfig(128)),
+        .N = static_cast<host::glsl::uint>(1e6) + 17,
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .maxS = static_cast<host::glsl::uint>(2e6),
+        .replays = 4,
+    },
+    TestCase{
+        .config = CutpointConfig(DecoupledPrefixSumConfig(512, 8, BlockScanVariant::RANKED_STRIDED),
+                                 32),
+        .N = static_cast<host::glsl::uint>(1e6),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .maxS = static_cast<host::glsl::uint>(1e6),
+        .replays = 4,
+    },
+    TestCase{
+        .config = HSTConfig(8, HSTConstructionConfig(256), HSTSamplingConfig(256)),
+        .N = static_cast<host::glsl::uint>(1e5),
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .maxS = static_cast<host::glsl::uint>(1e6),
+        .replays = 4,
+    },
+};
+
+static bool runTestCase(const host::test::TestContext& context,
+                        const TestCase& testCase,
+                        std::pmr::memory_resource* resource) {
+    const host::glsl::uint N = testCase.N;
+    const host::glsl::uint maxS = testCase.maxS;
+    std::string testName = fmt::format(
+        "{{{},N={},distribution={},maxS={}}}", wrsConfigName(testCase.config), N,
+        host::distribution_to_pretty_string(testCase.distribution), maxS);
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    Algorithm kernel{context.context, context.shaderCompiler, context.alloc, context.queue,
+                     testCase.config, N, maxS};
+    const merian::BufferHandle samplesStage = context.alloc->createBuffer(
+        Buffers::SamplesLayout::size(maxS), vk::BufferUsageFlagBits::eTransferDst,
+        merian::MemoryMappingType::HOST_ACCESS_RANDOM);
+
+    std::mt19937 rng{std::random_device{}()};
+    std::uniform_int_distribution<host::glsl::uint> seedDist;
+    std::uniform_int_distribution<host::glsl::uint> sampleCountDist{maxS / 2, maxS};
+
+    MERIAN_PROFILE_SCOPE(context.profiler, testName);
+    bool failed = false;
+    for (uint32_t r = 0; r < testCase.replays; ++r) {
+        // 1. Update the weights and the parameters and replay the recorded commands
+        const auto weights = host::pmr::generate_weights<float>(testCase.distribution, N, resource);
+        const host::glsl::uint S = sampleCountDist(rng);
+        std::uint64_t replayed;
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Replay");
+            kernel.uploadWeights(weights);
+            replayed = kernel.replay(S, seedDist(rng));
+        }
+
+        // 2. Download results to stage
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        Buffers::SamplesView localSamples{kernel.samples(), S};
+        Buffers::SamplesView stageSamples{samplesStage, S};
+        localSamples.expectComputeWrite();
+        localSamples.copyTo(cmd, stageSamples);
+        stageSamples.expectHostRead(cmd);
+        cmd->end();
+        kernel.wait(replayed);
+        context.queue->submit_wait(cmd);
+
+        // 3. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            const std::vector<host::glsl::uint> samples =
+                stageSamples.download<host::glsl::uint>();
+            for (host::glsl::uint s = 0; s < S; ++s) {
+                if (samples[s] >= N || weights[samples[s]] == 0.0f) {
+                    SPDLOG_ERROR("Replay {}: invalid sample {} at {}", r, samples[s], s);
+                    failed = true;
+                    break;
+                }
+            }
+            const float jsDivergence =
+                host::js_divergence<host::glsl::uint, host::glsl::f32>(samples, weights);
+            SPDLOG_DEBUG("Replay {} (S={}): JS-Divergence: {}", r, S, jsDivergence);
+            if (jsDivergence > 0.15) {
+                SPDLOG_ERROR("Replay {} displays a significant bias", r);
+                failed = true;
+            }
+        }
+    }
+    context.profiler->collect(true, true);
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing replayable WRS");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    host::memory::StackResource stackResource{4096 * 2048};
+    host::memory::FallbackResource fallbackResource{&stackResource};
+    host::memory::SafeResource safeResource{&fallbackResource};
+
+    std::pmr::memory_resource* resource = &safeResource;
+
+    uint32_t failCount = 0;
+    for (const auto& testCase : TEST_CASES) {
+        if (runTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+
+    testContext.profiler->collect(true, true);
+    SPDLOG_INFO(fmt::format("Profiler results: \n{}",
+                            merian::Profiler::get_report_str(testContext.profiler->get_report())));
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
+                                 sizeof(TEST_CASES) / sizeof(TestCase)));
+    }
+}
+
+} // namespace device::test::replay
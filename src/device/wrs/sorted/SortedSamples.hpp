@@ -0,0 +1,341 @@
+#pragma once
+/**
+ * @filename    : SortedSamples.hpp
+ *
+ * Sorted and run-length encoded output of the samples of any method.
+ * The input samples may be packed as u16 / u8 (see host::SampleIndexWidth), the width has
+ * to match the sampling config. The sorted output is always written as uint.
+ * Consumers which gather a payload per sampled index otherwise read random memory,
+ * with sorted samples the gather is coalesced and for S >> N the run-length encoding
+ * (index, count) shrinks the output to the amount of distinct indices.
+ *
+ * All samples are indices in [0, N), therefore the sort is a counting sort
+ * (a radix sort with a single digit over all log2(N) bits):
+ * 1. count : histogram of the samples (atomics).
+ * 2. reduce: (sample count, distinct index count) of every partition of the histogram.
+ * 3. scan  : exclusive scan over the partitions (a single workgroup).
+ * 4. scatter: every partition rescans its counts in shared memory and writes
+ *            the runs and the sorted samples.
+ */
+
+#include "merian/vk/command/command_buffer.hpp"
+#include "merian/vk/memory/resource_allocator.hpp"
+#include "merian/vk/shader/shader_compiler.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/instrumentation/Instrumentation.hpp"
+#include "src/device/pipeline/ComputePipelineBuilder.hpp"
+#include "src/host/layout/ArrayLayout.hpp"
+#include "src/host/layout/BufferView.hpp"
+#include "src/host/types/glsl.hpp"
+#include "src/host/types/sample_index.hpp"
+#include <map>
+#include <optional>
+#include <string>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+namespace device {
+
+enum class SortedSamplesOutput {
+    SORTED,
+    RUN_LENGTH,
+    SORTED_AND_RUN_LENGTH,
+};
+
+struct SortedSamplesConfig {
+    const host::glsl::uint workgroupSize;
+    const host::glsl::uint rows;
+    const SortedSamplesOutput output;
+    // width of the input samples.
+    const host::SampleIndexWidth sampleIndexWidth;
+
+    constexpr SortedSamplesConfig()
+        : workgroupSize(512), rows(4), output(SortedSamplesOutput::SORTED),
+          sampleIndexWidth(host::SampleIndexWidth::U32) {}
+    constexpr explicit SortedSamplesConfig(
+        SortedSamplesOutput output,
+        host::glsl::uint workgroupSize = 512,
+        host::glsl::uint rows = 4,
+        host::SampleIndexWidth sampleIndexWidth = host::SampleIndexWidth::U32)
+        : workgroupSize(workgroupSize), rows(rows), output(output),
+          sampleIndexWidth(sampleIndexWidth) {}
+
+    constexpr host::glsl::uint partitionSize() const {
+        return workgroupSize * rows;
+    }
+
+    constexpr host::glsl::uint partitionCount(host::glsl::uint N) const {
+        return (N + partitionSize() - 1) / partitionSize();
+    }
+
+    constexpr bool sorted() const {
+        return output != SortedSamplesOutput::RUN_LENGTH;
+    }
+
+    constexpr bool runLength() const {
+        return output != SortedSamplesOutput::SORTED;
+    }
+};
+
+struct SortedSamplesBuffers {
+    using Self = SortedSamplesBuffers;
+    static constexpr auto storageQualifier = host::glsl::StorageQualifier::std430;
+
+    // sampleWordCount(S, sampleIndexWidth) words.
+    merian::BufferHandle samples;
+    using SamplesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using SamplesView = host::layout::BufferView<SamplesLayout>;
+
+    // only SORTED, S samples in ascending order.
+    merian::BufferHandle sorted;
+    using SortedLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using SortedView = host::layout::BufferView<SortedLayout>;
+
+    // only RUN_LENGTH, the first totals[1] entries are valid.
+    merian::BufferHandle runIndices;
+    using RunIndicesLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using RunIndicesView = host::layout::BufferView<RunIndicesLayout>;
+
+    merian::BufferHandle runCounts;
+    using RunCountsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using RunCountsView = host::layout::BufferView<RunCountsLayout>;
+
+    // (sample count, run count)
+    merian::BufferHandle totals;
+    using TotalsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using TotalsView = host::layout::BufferView<TotalsLayout>;
+
+    merian::BufferHandle m_counts;
+    using CountsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using CountsView = host::layout::BufferView<CountsLayout>;
+
+    // (sample count, run count) of every partition.
+    merian::BufferHandle m_partials;
+    using PartialsLayout = host::layout::ArrayLayout<host::glsl::uint, storageQualifier>;
+    using PartialsView = host::layout::BufferView<PartialsLayout>;
+
+    static Self allocate(const merian::ResourceAllocatorHandle& alloc,
+                         merian::MemoryMappingType memoryMapping,
+                         const SortedSamplesConfig& config,
+                         host::glsl::uint N,
+                         host::glsl::uint S) {
+        Self buffers;
+        const host::glsl::uint partitionCount = config.partitionCount(N);
+        const std::size_t sampleWordCount = host::sampleWordCount(S, config.sampleIndexWidth);
+        if (memoryMapping == merian::MemoryMappingType::NONE) {
+            const vk::BufferUsageFlags outputUsage =
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc;
+            buffers.samples = alloc->createBuffer(SamplesLayout::size(sampleWordCount),
+                                                  vk::BufferUsageFlagBits::eStorageBuffer |
+                                                      vk::BufferUsageFlagBits::eTransferDst,
+                                                  memoryMapping, "samples");
+            if (config.sorted()) {
+                buffers.sorted = alloc->createBuffer(SortedLayout::size(S), outputUsage,
+                                                     memoryMapping, "sorted-samples");
+            }
+            if (config.runLength()) {
+                buffers.runIndices = alloc->createBuffer(RunIndicesLayout::size(N), outputUsage,
+                                                         memoryMapping, "sorted-run-indices");
+                buffers.runCounts = alloc->createBuffer(RunCountsLayout::size(N), outputUsage,
+                                                        memoryMapping, "sorted-run-counts");
+            }
+            buffers.totals =
+                alloc->createBuffer(TotalsLayout::size(2), outputUsage, memoryMapping,
+                                    "sorted-totals");
+            buffers.m_counts = alloc->createBuffer(CountsLayout::size(N),
+                                                   vk::BufferUsageFlagBits::eStorageBuffer |
+                                                       vk::BufferUsageFlagBits::eTransferDst,
+                                                   memoryMapping, "sorted-counts");
+            buffers.m_partials =
+                alloc->createBuffer(PartialsLayout::size(2 * partitionCount),
+                                    vk::BufferUsageFlagBits::eStorageBuffer, memoryMapping,
+                                    "sorted-partials");
+        } else {
+            const vk::BufferUsageFlags outputUsage = vk::BufferUsageFlagBits::eTransferDst;
+            buffers.samples = alloc->createBuffer(SamplesLayout::size(sampleWordCount),
+                                                  vk::BufferUsageFlagBits::eTransferSrc,
+                                                  memoryMapping, "samples");
+            if (config.sorted()) {
+                buffers.sorted = alloc->createBuffer(SortedLayout::size(S), outputUsage,
+                                                     memoryMapping, "sorted-samples");
+            }
+            if (config.runLength()) {
+                buffers.runIndices = alloc->createBuffer(RunIndicesLayout::size(N), outputUsage,
+                                                         memoryMapping, "sorted-run-indices");
+                buffers.runCounts = alloc->createBuffer(RunCountsLayout::size(N), outputUsage,
+                                                        memoryMapping, "sorted-run-counts");
+            }
+            buffers.totals =
+                alloc->createBuffer(TotalsLayout::size(2), outputUsage, memoryMapping,
+                                    "sorted-totals");
+        }
+        return buffers;
+    }
+};
+
+class SortedSamples {
+    struct PushConstants {
+        host::glsl::uint N;
+        host::glsl::uint S;
+    };
+
+    struct ScanPushConstants {
+        host::glsl::uint partitionCount;
+    };
+
+  public:
+    using Buffers = SortedSamplesBuffers;
+    using Config = SortedSamplesConfig;
+
+    explicit SortedSamples(const merian::ContextHandle& context,
+                           const merian::ShaderCompilerHandle& shaderCompiler,
+                           Config config = {})
+        : m_workgroupSize(config.workgroupSize), m_partitionSize(config.partitionSize()),
+          m_sorted(config.sorted()), m_runLength(config.runLength()) {
+        const std::string shaderDir = "src/device/wrs/sorted/";
+
+        std::map<std::string, std::string> countDefines;
+        if (const auto define = host::sampleIndexDefine(config.sampleIndexWidth)) {
+            countDefines[*define];
+        }
+        m_countPipeline =
+            pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderDir + "count.comp")
+                .addIncludePath("src/device/common/")
+                .setDefines(countDefines)
+                .addStorageBuffer() // samples
+                .addStorageBuffer() // counts
+                .addPushConstant<PushConstants>()
+                .addSpecializationConstant(m_workgroupSize)
+                .build();
+
+        m_reducePipeline =
+            pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderDir + "reduce.comp")
+                .addStorageBuffer() // counts
+                .addStorageBuffer() // partials
+                .addPushConstant<PushConstants>()
+                .addSpecializationConstant(m_workgroupSize)
+                .addSpecializationConstant(config.rows)
+                .build();
+
+        m_scanPipeline =
+            pipeline::ComputePipelineBuilder(context, shaderCompiler, shaderDir + "scan.comp")
+                .addStorageBuffer() // partials
+                .addStorageBuffer() // totals
+                .addPushConstant<ScanPushConstants>()
+                .addSpecializationConstant(m_workgroupSize)
+                .build();
+
+        std::map<std::string, std::string> defines;
+        pipeline::ComputePipelineBuilder scatterBuilder(context, shaderCompiler,
+                                                        shaderDir + "scatter.comp");
+        scatterBuilder
+            .addStorageBuffer()  // counts
+            .addStorageBuffer(); // partials
+        if (m_sorted) {
+            defines["SORTED"];
+            scatterBuilder.addStorageBuffer(); // sorted
+        }
+        if (m_runLength) {
+            defines["RUN_LENGTH"];
+            scatterBuilder
+                .addStorageBuffer()  // run indices
+                .addStorageBuffer(); // run counts
+        }
+        m_scatterPipeline = scatterBuilder.setDefines(defines)
+                                .addPushConstant<PushConstants>()
+                                .addSpecializationConstant(m_workgroupSize)
+                                .addSpecializationConstant(config.rows)
+                                .build();
+    }
+
+    /// Expects that the writes to the samples are visible to compute shaders.
+    void run(const merian::CommandBufferHandle& cmd,
+             const Buffers& buffers,
+             host::glsl::uint N,
+             host::glsl::uint S,
+             std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        WRS_PROFILE_SCOPE(profiler, cmd, "SortedSamples");
+        cmd->fill(buffers.m_counts, 0);
+        cmd->barrier(vk::PipelineStageFlagBits::eTransfer,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     buffers.m_counts->buffer_barrier(vk::AccessFlagBits::eTransferWrite,
+                                                      vk::AccessFlagBits::eShaderRead |
+                                                          vk::AccessFlagBits::eShaderWrite));
+        cmd->bind(m_countPipeline);
+        cmd->push_descriptor_set(m_countPipeline, buffers.samples, buffers.m_counts);
+        cmd->push_constant<PushConstants>(m_countPipeline, PushConstants{.N = N, .S = S});
+        cmd->dispatch((S + m_workgroupSize - 1) / m_workgroupSize, 1, 1);
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     buffers.m_counts->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                      vk::AccessFlagBits::eShaderRead));
+        scatter(cmd, buffers, N, S);
+    }
+
+    /**
+     * Expands per-index counts (e.g. of a multinomial count pass) into sorted samples
+     * and / or runs without the histogram, the counts are expected in buffers.m_counts
+     * and have to be visible to compute shaders.
+     */
+    void explode(const merian::CommandBufferHandle& cmd,
+                 const Buffers& buffers,
+                 host::glsl::uint N,
+                 host::glsl::uint S,
+                 std::optional<merian::ProfilerHandle> profiler = std::nullopt) const {
+        WRS_PROFILE_SCOPE(profiler, cmd, "Explode");
+        scatter(cmd, buffers, N, S);
+    }
+
+  private:
+    void scatter(const merian::CommandBufferHandle& cmd,
+                 const Buffers& buffers,
+                 host::glsl::uint N,
+                 host::glsl::uint S) const {
+        const host::glsl::uint partitionCount = (N + m_partitionSize - 1) / m_partitionSize;
+
+        cmd->bind(m_reducePipeline);
+        cmd->push_descriptor_set(m_reducePipeline, buffers.m_counts, buffers.m_partials);
+        cmd->push_constant<PushConstants>(m_reducePipeline, PushConstants{.N = N, .S = S});
+        cmd->dispatch(partitionCount, 1, 1);
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     buffers.m_partials->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                        vk::AccessFlagBits::eShaderRead |
+                                                            vk::AccessFlagBits::eShaderWrite));
+
+        cmd->bind(m_scanPipeline);
+        cmd->push_descriptor_set(m_scanPipeline, buffers.m_partials, buffers.totals);
+        cmd->push_constant<ScanPushConstants>(
+            m_scanPipeline, ScanPushConstants{.partitionCount = partitionCount});
+        cmd->dispatch(1, 1, 1);
+        cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                     vk::PipelineStageFlagBits::eComputeShader,
+                     buffers.m_partials->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                        vk::AccessFlagBits::eShaderRead));
+
+        cmd->bind(m_scatterPipeline);
+        if (m_sorted && m_runLength) {
+            cmd->push_descriptor_set(m_scatterPipeline, buffers.m_counts, buffers.m_partials,
+                                     buffers.sorted, buffers.runIndices, buffers.runCounts);
+        } else if (m_sorted) {
+            cmd->push_descriptor_set(m_scatterPipeline, buffers.m_counts, buffers.m_partials,
+                                     buffers.sorted);
+        } else {
+            cmd->push_descriptor_set(m_scatterPipeline, buffers.m_counts, buffers.m_partials,
+                                     buffers.runIndices, buffers.runCounts);
+        }
+        cmd->push_constant<PushConstants>(m_scatterPipeline, PushConstants{.N = N, .S = S});
+        cmd->dispatch(partitionCount, 1, 1);
+    }
+
+    merian::PipelineHandle m_countPipeline;
+    merian::PipelineHandle m_reducePipeline;
+    merian::PipelineHandle m_scanPipeline;
+    merian::PipelineHandle m_scatterPipeline;
+    host::glsl::uint m_workgroupSize;
+    host::glsl::uint m_partitionSize;
+    bool m_sorted;
+    bool m_runLength;
+};
+
+} // namespace device
@@ -0,0 +1,237 @@
+#include "./test.hpp"
+#include "merian/vk/utils/profiler.hpp"
+#include "src/device/wrs/sorted/SortedSamples.hpp"
+#include "src/host/assert/test.hpp"
+#include "src/host/gen/weight_generator.h"
+#include "src/host/memory/FallbackResource.hpp"
+#include "src/host/memory/SafeResource.hpp"
+#include "src/host/memory/StackResource.hpp"
+#include <algorithm>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+namespace device::test::sorted {
+
+using Algorithm = SortedSamples;
+using Buffers = Algorithm::Buffers;
+using Config = Algorithm::Config;
+
+struct TestCase {
+    Config config;
+    host::glsl::uint N;
+    host::Distribution distribution;
+    host::glsl::uint S;
+    uint32_t iterations;
+};
+
+static constexpr TestCase TEST_CASES[] = {
+    TestCase{
+        .config = SortedSamplesConfig(SortedSamplesOutput::SORTED),
+        .N = static_cast<host::glsl::uint>(1e6),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = static_cast<host::glsl::uint>(1e6),
+        .iterations = 2,
+    },
+    TestCase{
+        .config = SortedSamplesConfig(SortedSamplesOutput::SORTED_AND_RUN_LENGTH),
+        .N = static_cast<host::glsl::uint>(1e5) + 17,
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .S = static_cast<host::glsl::uint>(4e6),
+        .iterations = 2,
+    },
+    TestCase{
+        .config = SortedSamplesConfig(SortedSamplesOutput::RUN_LENGTH, 256, 2),
+        .N = static_cast<host::glsl::uint>(1e6) + 3,
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = static_cast<host::glsl::uint>(1e4),
+        .iterations = 2,
+    },
+    TestCase{
+        .config = SortedSamplesConfig(SortedSamplesOutput::SORTED_AND_RUN_LENGTH, 512, 4,
+                                      host::SampleIndexWidth::U16),
+        .N = (1 << 16) - 5,
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .S = static_cast<host::glsl::uint>(1e6) + 1,
+        .iterations = 2,
+    },
+};
+
+static bool runTestCase(const host::test::TestContext& context,
+                        const TestCase& testCase,
+                        std::pmr::memory_resource* resource) {
+    const host::glsl::uint N = testCase.N;
+    const host::glsl::uint S = testCase.S;
+    std::string testName =
+        fmt::format("{{N={},distribution={},S={},sorted={},runLength={},width={}}}", N,
+                    host::distribution_to_pretty_string(testCase.distribution), S,
+                    testCase.config.sorted(), testCase.config.runLength(),
+                    host::sampleIndexWidthName(testCase.config.sampleIndexWidth));
+    SPDLOG_INFO("Running test case:{}", testName);
+
+    Algorithm kernel{context.context, context.shaderCompiler, testCase.config};
+    Buffers buffers =
+        Buffers::allocate(context.alloc, merian::MemoryMappingType::NONE, testCase.config, N, S);
+    Buffers stage = Buffers::allocate(context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+                                      testCase.config, N, S);
+
+    std::mt19937 rng{std::random_device{}()};
+
+    bool failed = false;
+    for (size_t it = 0; it < testCase.iterations; ++it) {
+        MERIAN_PROFILE_SCOPE(context.profiler, testName);
+        context.queue->wait_idle();
+
+        // 1. Generate input
+        context.profiler->start("Generate test input");
+        const std::pmr::vector<float> weights =
+            host::pmr::generate_weights<float>(testCase.distribution, N, resource);
+        std::discrete_distribution<host::glsl::uint> dist{weights.begin(), weights.end()};
+        std::pmr::vector<host::glsl::uint> samples(S, resource);
+        std::ranges::generate(samples, [&]() { return dist(rng); });
+        std::pmr::vector<host::glsl::uint> reference = samples;
+        std::ranges::sort(reference);
+        std::pmr::vector<host::glsl::uint> referenceRunIndices{resource};
+        std::pmr::vector<host::glsl::uint> referenceRunCounts{resource};
+        for (const host::glsl::uint s : reference) {
+            if (referenceRunIndices.empty() || referenceRunIndices.back() != s) {
+                referenceRunIndices.push_back(s);
+                referenceRunCounts.push_back(0);
+            }
+            referenceRunCounts.back()++;
+        }
+        const host::glsl::uint runCount =
+            static_cast<host::glsl::uint>(referenceRunIndices.size());
+        context.profiler->end();
+
+        // 2. Begin recoding
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        std::string recordingLabel = fmt::format("Recording : {}", testName);
+        context.profiler->start(recordingLabel);
+        context.profiler->cmd_start(cmd, recordingLabel);
+
+        // 3. Upload samples and sort
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Upload test case");
+            const std::vector<host::glsl::uint> words =
+                host::packSampleIndices(samples, testCase.config.sampleIndexWidth);
+            Buffers::SamplesView stageSamples{stage.samples, words.size()};
+            Buffers::SamplesView localSamples{buffers.samples, words.size()};
+            stageSamples.upload<host::glsl::uint>(words);
+            stageSamples.copyTo(cmd, localSamples);
+            localSamples.expectComputeRead(cmd);
+        }
+        kernel.run(cmd, buffers, N, S, context.profiler);
+
+        // 4. Download results to stage
+        {
+            MERIAN_PROFILE_SCOPE_GPU(context.profiler, cmd, "Download results to stage");
+            Buffers::TotalsView localTotals{buffers.totals, 2};
+            Buffers::TotalsView stageTotals{stage.totals, 2};
+            localTotals.expectComputeWrite();
+            localTotals.copyTo(cmd, stageTotals);
+            stageTotals.expectHostRead(cmd);
+            if (testCase.config.sorted()) {
+                Buffers::SortedView localSorted{buffers.sorted, S};
+                Buffers::SortedView stageSorted{stage.sorted, S};
+                localSorted.expectComputeWrite();
+                localSorted.copyTo(cmd, stageSorted);
+                stageSorted.expectHostRead(cmd);
+            }
+            if (testCase.config.runLength()) {
+                Buffers::RunIndicesView localRunIndices{buffers.runIndices, runCount};
+                Buffers::RunIndicesView stageRunIndices{stage.runIndices, runCount};
+                localRunIndices.expectComputeWrite();
+                localRunIndices.copyTo(cmd, stageRunIndices);
+                stageRunIndices.expectHostRead(cmd);
+                Buffers::RunCountsView localRunCounts{buffers.runCounts, runCount};
+                Buffers::RunCountsView stageRunCounts{stage.runCounts, runCount};
+                localRunCounts.expectComputeWrite();
+                localRunCounts.copyTo(cmd, stageRunCounts);
+                stageRunCounts.expectHostRead(cmd);
+            }
+        }
+
+        // 5. Submit to device
+        context.profiler->end();
+        context.profiler->cmd_end(cmd);
+        cmd->end();
+        context.queue->submit_wait(cmd);
+
+        // 6. Test results
+        {
+            MERIAN_PROFILE_SCOPE(context.profiler, "Testing results");
+            const auto totals = Buffers::TotalsView{stage.totals, 2}
+                                    .download<host::glsl::uint, host::pmr_alloc<host::glsl::uint>>(
+                                        resource);
+            if (totals[0] != S || totals[1] != runCount) {
+                SPDLOG_ERROR("Invalid totals: expected ({}, {}), got ({}, {})", S, runCount,
+                             totals[0], totals[1]);
+                failed = true;
+            }
+            if (testCase.config.sorted()) {
+                const auto sorted =
+                    Buffers::SortedView{stage.sorted, S}
+                        .download<host::glsl::uint, host::pmr_alloc<host::glsl::uint>>(resource);
+                const auto mismatch = std::ranges::mismatch(sorted, reference);
+                if (mismatch.in1 != sorted.end()) {
+                    const auto i = std::distance(sorted.begin(), mismatch.in1);
+                    SPDLOG_ERROR("Invalid sorted sample at {}: expected {}, got {}", i,
+                                 *mismatch.in2, *mismatch.in1);
+                    failed = true;
+                }
+            }
+            if (testCase.config.runLength()) {
+                const auto runIndices =
+                    Buffers::RunIndicesView{stage.runIndices, runCount}
+                        .download<host::glsl::uint, host::pmr_alloc<host::glsl::uint>>(resource);
+                const auto runCounts =
+                    Buffers::RunCountsView{stage.runCounts, runCount}
+                        .download<host::glsl::uint, host::pmr_alloc<host::glsl::uint>>(resource);
+                if (!std::ranges::equal(runIndices, referenceRunIndices) ||
+                    !std::ranges::equal(runCounts, referenceRunCounts)) {
+                    SPDLOG_ERROR("Invalid run-length encoding");
+                    failed = true;
+                }
+            }
+        }
+        context.profiler->collect(true, true);
+    }
+    return failed;
+}
+
+void test(const merian::ContextHandle& context) {
+    SPDLOG_INFO("Testing sorted samples");
+
+    const host::test::TestContext testContext = host::test::setupTestContext(context);
+
+    host::memory::StackResource stackResource{4096 * 2048};
+    host::memory::FallbackResource fallbackResource{&stackResource};
+    host::memory::SafeResource safeResource{&fallbackResource};
+
+    std::pmr::memory_resource* resource = &safeResource;
+
+    uint32_t failCount = 0;
+    for (const auto& testCase : TEST_CASES) {
+        if (runTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
+
+    testContext.profiler->collect(true, true);
+    SPDLOG_INFO(fmt::format("Profiler results: \n{}",
+                            merian::Profiler::get_report_str(testContext.profiler->get_report())));
+
+    if (failCount == 0) {
+        SPDLOG_INFO("All tests passed");
+    } else {
+        SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
+                                 sizeof(TEST_CASES) / sizeof(TestCase)));
+    }
+}
+
+} // namespace device::test::sorted
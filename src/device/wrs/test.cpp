@@ -9,6 +9,7 @@
 #include "src/host/memory/SafeResource.hpp"
 #include "src/host/memory/StackResource.hpp"
 #include "src/host/statistics/chi_square.hpp"
+#include <algorithm>
 #include <cstring>
 #include <fmt/base.h>
 #include <fmt/format.h>
@@ -49,6 +50,30 @@ static constexpr TestCase TEST_CASES[] = {
         .iterations = 5,
     },
 
+    TestCase{
+        .config = CutpointConfig( //
+            DecoupledPrefixSumConfig(512, 8, BlockScanVariant::RANKED_STRIDED),
+            32,
+            std::nullopt,
+            CompressedCMFConfig()),
+        .N = static_cast<uint32_t>(1e7),
+        .distribution = host::Distribution::PSEUDO_RANDOM_UNIFORM,
+        .S = static_cast<uint32_t>(1e7),
+        .iterations = 5,
+    },
+
+    TestCase{
+        .config = ITSConfig( //
+            DecoupledPrefixSumConfig(512, 8, BlockScanVariant::RANKED_STRIDED),
+            InverseTransformSamplingConfig(512, 4096, true),
+            std::nullopt,
+            CompressedCMFConfig()),
+        .N = 1024 * 2048,
+        .distribution = host::Distribution::SEEDED_RANDOM_EXPONENTIAL,
+        .S = 1024 * 2048,
+        .iterations = 5,
+    },
+
     /* TestCase{ */
     /*     .config = ITSConfig( // */
     /*         DecoupledPrefixSumConfig(512, 8, BlockScanVariant::RANKED_STRIDED), */
@@ -164,6 +189,26 @@ static constexpr TestCase TEST_CASES[] = {
 
 };
 
+/// Samples a low-discrepancy sequence in two dispatches, the second continues the first
+/// at an offset. Fails if a method ignores the host::SampleSequence.
+struct SequenceTestCase {
+    Config config;
+    host::glsl::uint N;
+    host::glsl::uint S;
+    host::SampleSequence sequence;
+};
+
+static constexpr SequenceTestCase SEQUENCE_TEST_CASES[] = {
+    SequenceTestCase{
+        .config = HSTConfig(8,
+                            HSTConstructionConfig(),
+                            HSTSamplingConfig(512, host::RNGAlgorithm::SOBOL)),
+        .N = static_cast<host::glsl::uint>(1e5),
+        .S = 1 << 16,
+        .sequence = host::SampleSequence{.dimension = 3, .offset = 1 << 20},
+    },
+};
+
 static void uploadTestCase(const merian::CommandBufferHandle& cmd,
                            const Buffers& buffers,
                            const Buffers& stage,
@@ -355,6 +400,84 @@ static bool runTestCase(const host::test::TestContext& context,
     return failed;
 }
 
+static std::pmr::vector<host::glsl::uint> sampleSequence(const host::test::TestContext& context,
+                                                         const Algorithm& kernel,
+                                                         const Buffers& buffers,
+                                                         const Buffers& stage,
+                                                         host::glsl::uint N,
+                                                         host::glsl::uint S,
+                                                         const host::SampleSequence& sequence,
+                                                         std::pmr::memory_resource* resource) {
+    merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+    cmd->begin();
+    kernel.sample(cmd, buffers, N, S, 12345u, sequence);
+    Buffers::SamplesView localView{buffers.samples, S};
+    Buffers::SamplesView stageView{stage.samples, S};
+    localView.expectComputeWrite();
+    localView.copyTo(cmd, stageView);
+    stageView.expectHostRead(cmd);
+    cmd->end();
+    context.queue->submit_wait(cmd);
+    return stageView.download<host::glsl::uint, host::pmr_alloc<host::glsl::uint>>(resource);
+}
+
+static bool runSequenceTestCase(const host::test::TestContext& context,
+                                const SequenceTestCase& testCase,
+                                std::pmr::memory_resource* resource) {
+    const host::glsl::uint N = testCase.N;
+    const host::glsl::uint S = testCase.S;
+    const host::glsl::uint half = S / 2;
+    std::string testName = fmt::format("{{{},N={},S={},dimension={},offset={}}}",
+                                       wrsConfigName(testCase.config), N, S,
+                                       testCase.sequence.dimension, testCase.sequence.offset);
+    SPDLOG_INFO("Running sequence test case:{}", testName);
+
+    Buffers buffers =
+        Buffers::allocate(context.alloc, merian::MemoryMappingType::NONE, N, S, testCase.config);
+    Buffers stage = Buffers::allocate(context.alloc, merian::MemoryMappingType::HOST_ACCESS_RANDOM,
+                                      N, S, testCase.config);
+    Algorithm kernel{context.context, context.shaderCompiler, testCase.config};
+
+    const auto weights =
+        host::pmr::generate_weights<float>(host::Distribution::PSEUDO_RANDOM_UNIFORM, N, resource);
+    {
+        merian::CommandBufferHandle cmd = std::make_shared<merian::CommandBuffer>(context.cmdPool);
+        cmd->begin();
+        uploadTestCase(cmd, buffers, stage, weights);
+        kernel.build(cmd, buffers, N);
+        cmd->end();
+        context.queue->submit_wait(cmd);
+    }
+
+    const host::SampleSequence& sequence = testCase.sequence;
+    const auto full = sampleSequence(context, kernel, buffers, stage, N, S, sequence, resource);
+    // continues the sequence, has to reproduce the second half of full.
+    const auto continued = sampleSequence(
+        context, kernel, buffers, stage, N, half,
+        host::SampleSequence{.dimension = sequence.dimension, .offset = sequence.offset + half},
+        resource);
+    // an independent dimension, has to differ from the first half of full.
+    const auto otherDimension = sampleSequence(
+        context, kernel, buffers, stage, N, half,
+        host::SampleSequence{.dimension = sequence.dimension + 1, .offset = sequence.offset},
+        resource);
+
+    bool failed = false;
+    for (host::glsl::uint s = 0; s < half; ++s) {
+        if (continued[s] != full[half + s]) {
+            SPDLOG_ERROR("Sample {} of the continued sequence is {}, expected {}", s,
+                         continued[s], full[half + s]);
+            failed = true;
+            break;
+        }
+    }
+    if (std::equal(otherDimension.begin(), otherDimension.end(), full.begin())) {
+        SPDLOG_ERROR("{} ignores the dimension of the sequence", wrsConfigName(testCase.config));
+        failed = true;
+    }
+    return failed;
+}
+
 void test(const merian::ContextHandle& context) {
     SPDLOG_INFO("Testing TODO algorithm");
 
@@ -373,6 +496,12 @@ void test(const merian::ContextHandle& context) {
         runTestCase(testContext, testCase, chiSquare, resource);
         stackResource.reset();
     }
+    for (const auto& testCase : SEQUENCE_TEST_CASES) {
+        if (runSequenceTestCase(testContext, testCase, resource)) {
+            failCount++;
+        }
+        stackResource.reset();
+    }
 
     testContext.profiler->collect(true, true);
     SPDLOG_INFO(fmt::format("Profiler results: \n{}",
@@ -382,7 +511,8 @@ void test(const merian::ContextHandle& context) {
         SPDLOG_INFO("All tests passed");
     } else {
         SPDLOG_ERROR(fmt::format("Failed {} out of {} tests", failCount,
-                                 sizeof(TEST_CASES) / sizeof(TestCase)));
+                                 sizeof(TEST_CASES) / sizeof(TestCase) +
+                                     sizeof(SEQUENCE_TEST_CASES) / sizeof(SequenceTestCase)));
     }
 }
 
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "merian/vk/utils/profiler.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <fmt/format.h>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace host::exp {
+
+/// A measured scope, begin and end are raw timestamps in ns.
+struct TraceSlice {
+    std::string name;
+    std::uint64_t beginNs;
+    std::uint64_t endNs;
+};
+
+/**
+ * Writes Chrome trace event JSON, which can be opened in ui.perfetto.dev or chrome://tracing.
+ * Every pushed trace becomes a process with a CPU and a GPU track.
+ *
+ * pushTimestamps() writes measured slices, e.g. of device::instrumentation::TimestampTrace.
+ * All processes share one timeline per track, which starts at the first pushed timestamp,
+ * therefore consecutive traces do not overlap and the gaps between slices are measured.
+ * The CPU and the GPU clock are not calibrated against each other, the tracks are only
+ * comparable among themselves.
+ *
+ * pushSyntheticReport() writes aggregated merian::Profiler reports, which only contain the
+ * mean and standard deviation of every scope. Their slices are laid out back to back from 0
+ * and the time of a parent, which is not covered by its children, is written as an
+ * "[unattributed]" slice. The process is marked as synthetic, none of it was measured.
+ *
+ * Example:
+ * host::exp::ChromeTraceWriter trace{"wrs_trace.json"};
+ * trace.pushTimestamps("PSA N=1000000", cpuSlices, gpuSlices);
+ */
+class ChromeTraceWriter {
+    static constexpr int CPU_TRACK = 0;
+    static constexpr int GPU_TRACK = 1;
+
+  public:
+    explicit ChromeTraceWriter(const std::string& filePath) : file(filePath) {
+        if (!file.is_open()) {
+            throw std::ios_base::failure("Failed to open file: " + filePath);
+        }
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    }
+
+    ChromeTraceWriter(const ChromeTraceWriter&) = delete;
+    ChromeTraceWriter& operator=(const ChromeTraceWriter&) = delete;
+
+    ~ChromeTraceWriter() {
+        file << "\n]}\n";
+    }
+
+    void pushTimestamps(const std::string& name,
+                        std::span<const TraceSlice> cpuSlices,
+                        std::span<const TraceSlice> gpuSlices) {
+        const int pid = pushProcess(name);
+        pushMeasured(pid, CPU_TRACK, cpuSlices, cpuOrigin);
+        pushMeasured(pid, GPU_TRACK, gpuSlices, gpuOrigin);
+        if (file.fail()) {
+            throw std::ios_base::failure("Failed to write to the file.");
+        }
+    }
+
+    void pushSyntheticReport(const merian::Profiler::Report& report, const std::string& name) {
+        const int pid = pushProcess(name + " [synthetic: mean durations]");
+        pushEntries(pid, CPU_TRACK, report.cpu_report, 0.0);
+        pushEntries(pid, GPU_TRACK, report.gpu_report, 0.0);
+        if (file.fail()) {
+            throw std::ios_base::failure("Failed to write to the file.");
+        }
+    }
+
+  private:
+    std::ofstream file;
+    int processCount = 0;
+    bool firstEvent = true;
+    std::optional<std::uint64_t> cpuOrigin;
+    std::optional<std::uint64_t> gpuOrigin;
+
+    int pushProcess(const std::string& name) {
+        const int pid = processCount++;
+        pushMetadata(pid, CPU_TRACK, "process_name", name);
+        pushMetadata(pid, CPU_TRACK, "thread_name", "CPU");
+        pushMetadata(pid, GPU_TRACK, "thread_name", "GPU");
+        return pid;
+    }
+
+    static std::string escape(const std::string& str) {
+        std::string escaped;
+        escaped.reserve(str.size());
+        for (const char c : str) {
+            if (c == '"' || c == '\\') {
+                escaped.push_back('\\');
+                escaped.push_back(c);
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                escaped.append(fmt::format("\\u{:04x}", static_cast<unsigned int>(c)));
+            } else {
+                escaped.push_back(c);
+            }
+        }
+        return escaped;
+    }
+
+    void beginEvent() {
+        if (!firstEvent) {
+            file << ',';
+        }
+        firstEvent = false;
+        file << "\n";
+    }
+
+    void pushMetadata(int pid, int tid, const std::string& type, const std::string& name) {
+        beginEvent();
+        file << fmt::format(R"({{"ph":"M","pid":{},"tid":{},"name":"{}","args":{{"name":"{}"}}}})",
+                            pid, tid, type, escape(name));
+    }
+
+    void pushMeasured(int pid,
+                      int tid,
+                      std::span<const TraceSlice> slices,
+                      std::optional<std::uint64_t>& origin) {
+        if (slices.empty()) {
+            return;
+        }
+        if (!origin.has_value()) {
+            origin = std::ranges::min(slices, {}, &TraceSlice::beginNs).beginNs;
+        }
+        for (const auto& slice : slices) {
+            const double begin =
+                static_cast<double>(static_cast<std::int64_t>(slice.beginNs - *origin));
+            const double duration =
+                static_cast<double>(slice.endNs >= slice.beginNs ? slice.endNs - slice.beginNs : 0);
+            beginEvent();
+            // trace events are in us.
+            file << fmt::format(R"({{"ph":"X","pid":{},"tid":{},"name":"{}","ts":{},"dur":{}}})",
+                                pid, tid, escape(slice.name), begin * 1e-3, duration * 1e-3);
+        }
+    }
+
+    // durations of the report are in ms, trace events in us.
+    void pushSlice(int pid,
+                   int tid,
+                   const std::string& name,
+                   double start,
+                   double duration,
+                   double stdDeviation,
+                   uint32_t captures) {
+        beginEvent();
+        file << fmt::format(
+            R"({{"ph":"X","pid":{},"tid":{},"name":"{}","ts":{},"dur":{},)"
+            R"("args":{{"synthetic":true,"std_deviation_ms":{},"captures":{}}}}})",
+            pid, tid, escape(name), start * 1e3, duration * 1e3, stdDeviation, captures);
+    }
+
+    /// Returns the end of the last entry.
+    double pushEntries(int pid,
+                       int tid,
+                       const std::vector<merian::Profiler::ReportEntry>& entries,
+                       double start) {
+        double cursor = start;
+        for (const auto& entry : entries) {
+            pushSlice(pid, tid, entry.name, cursor, entry.duration, entry.std_deviation,
+                      entry.num_captures);
+            if (!entry.children.empty()) {
+                const double childEnd = pushEntries(pid, tid, entry.children, cursor);
+                const double gap = cursor + entry.duration - childEnd;
+                if (gap > 0.0) {
+                    pushSlice(pid, tid, "[unattributed]", childEnd, gap, 0.0,
+                              entry.num_captures);
+                }
+            }
+            cursor += entry.duration;
+        }
+        return cursor;
+    }
+};
+
+} // namespace host::exp
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "src/host/types/kernel_cost.hpp"
+
+namespace host::exp {
+
+/// A measured kernel run placed on the roofline of the device.
+struct RooflinePoint {
+    double memoryBandwidth;     // GB per second
+    double peakFraction;        // memoryBandwidth / peakBandwidth
+    double operationThroughput; // billion operations per second
+    double arithmeticIntensity; // operations per byte
+};
+
+/**
+ * @param latency in ms
+ * @param peakBandwidth in GB per second, see device::peak_bandwidth::measure
+ */
+inline RooflinePoint roofline(const KernelCost& cost, double latency, double peakBandwidth) {
+    const double seconds = latency * 1e-3;
+    const double memoryBandwidth = (static_cast<double>(cost.bytes()) * 1e-9) / seconds;
+    return RooflinePoint{
+        .memoryBandwidth = memoryBandwidth,
+        .peakFraction = peakBandwidth > 0.0 ? memoryBandwidth / peakBandwidth : 0.0,
+        .operationThroughput = (static_cast<double>(cost.operations) * 1e-9) / seconds,
+        .arithmeticIntensity = cost.arithmeticIntensity(),
+    };
+}
+
+} // namespace host::exp
@@ -5,7 +5,12 @@
 #include "merian/vk/memory/resource_allocations.hpp"
 #include "src/host/layout/layout_traits.hpp"
 #include "src/host/why.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
 #include <utility>
+#include <vector>
 
 namespace host::layout {
 
@@ -120,6 +125,24 @@ template <layout::traits::any_layout Layout> class BufferView {
         return out;
     }
 
+    /// Downloads count narrow elements, which are packed into a uint array
+    /// (e.g. u16 or u8 samples, see host::SampleIndexWidth).
+    template <typename T, typed_allocator<T> Allocator = std::allocator<T>>
+    std::vector<T, Allocator> downloadPacked(std::size_t count, const Allocator& alloc = {})
+        requires(traits::IsPrimitiveArrayLayout<Layout> &&
+                 std::same_as<typename Layout::base_type, glsl::uint> &&
+                 (std::same_as<T, std::uint16_t> || std::same_as<T, std::uint8_t>))
+    {
+        assert(!m_barrierState->postTransferWrite);
+        assert(!m_barrierState->postShaderWrite);
+        assert(count * sizeof(T) <= size());
+        const std::byte* mapped = m_buffer->get_memory()->map_as<std::byte>() + layout.offset();
+        std::vector<T, Allocator> out(count, alloc);
+        std::memcpy(out.data(), mapped, count * sizeof(T));
+        m_buffer->get_memory()->unmap();
+        return out;
+    }
+
     template <IsStorageCompatibleStruct<typename Layout::base_type> S,
               typed_allocator<S> Allocator = std::allocator<S>>
     std::vector<S, Allocator> download(const Allocator& alloc = {})
@@ -207,6 +230,36 @@ template <layout::traits::any_layout Layout> class BufferView {
         m_barrierState->postTransferWrite = true;
     }
 
+    /// Records the primitives into the command buffer (vkCmdUpdateBuffer), the data is
+    /// copied at record time. Unlike upload() into a stage, every recorded update keeps
+    /// its own data, even if the view is updated again before the submit is executed.
+    /// Meant for small arrays, which are rewritten every frame (e.g. changed indices).
+    template <typename T>
+    void update(const merian::CommandBufferHandle& cmd, std::span<const T> primitives)
+        requires(traits::IsPrimitiveArrayLayout<Layout> &&
+                 std::same_as<T, typename Layout::base_type> && sizeof(T) % 4 == 0)
+    {
+        assert(primitives.size_bytes() <= size());
+        // the primitives are written as is, which requires a tightly packed array.
+        assert(Layout::size(primitives.size()) == primitives.size_bytes());
+        if (m_barrierState->postShaderWrite) {
+            cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
+                         vk::PipelineStageFlagBits::eTransfer,
+                         m_buffer->buffer_barrier(vk::AccessFlagBits::eShaderWrite,
+                                                  vk::AccessFlagBits::eTransferWrite));
+            m_barrierState->postShaderWrite = false;
+        }
+        // vkCmdUpdateBuffer is limited to 65536 bytes per command.
+        constexpr std::size_t maxUpdateSize = 65536;
+        const std::byte* data = reinterpret_cast<const std::byte*>(primitives.data());
+        for (std::size_t offset = 0; offset < primitives.size_bytes(); offset += maxUpdateSize) {
+            const std::size_t updateSize =
+                std::min(maxUpdateSize, primitives.size_bytes() - offset);
+            cmd->update(m_buffer, layout.offset() + offset, updateSize, data + offset);
+        }
+        m_barrierState->postTransferWrite = true;
+    }
+
     void copyTo(const merian::CommandBufferHandle& cmd, const merian::BufferHandle& o) {
         if (m_barrierState->postShaderWrite) {
             cmd->barrier(vk::PipelineStageFlagBits::eComputeShader,
@@ -50,6 +50,38 @@ imperfect_prefix_sum(const Range& elements, T std_deviation, const Allocator& al
     return prefixSum;
 }
 
+/// Inclusive prefix sum, which restarts at every segment offset.
+template <arithmetic T,
+          typed_allocator<T> Allocator = std::allocator<T>,
+          std::ranges::random_access_range Range = std::span<const T>>
+    requires(std::convertible_to<std::ranges::range_value_t<Range>, T>)
+std::vector<T, Allocator> segmented_prefix_sum(const Range& elements,
+                                               std::span<const uint32_t> segmentOffsets,
+                                               const Allocator& alloc = {}) {
+    std::vector<T, Allocator> prefix(elements.begin(), elements.end(), alloc);
+    const uint64_t N = elements.size();
+
+    T sum = 0.0f;
+    T c = 0.0f; // compensation term
+    auto nextHead = segmentOffsets.begin();
+    for (uint64_t i = 0; i < N; ++i) {
+        while (nextHead != segmentOffsets.end() && *nextHead <= i) {
+            if (*nextHead == i) {
+                sum = 0.0f;
+                c = 0.0f;
+            }
+            ++nextHead;
+        }
+        T y = prefix[i] - c;
+        T t = sum + y;
+        c = (t - sum) - y;
+        sum = t;
+
+        prefix[i] = sum;
+    }
+    return prefix;
+}
+
 namespace pmr {
 
 template <arithmetic T, std::ranges::random_access_range Range>
@@ -69,6 +101,15 @@ std::pmr::vector<T> imperfect_prefix_sum(const Range& elements,
         elements, std_deviation, alloc);
 }
 
+template <arithmetic T, std::ranges::random_access_range Range = std::span<const T>>
+    requires(std::convertible_to<std::ranges::range_value_t<Range>, T>)
+std::pmr::vector<T> segmented_prefix_sum(const Range& elements,
+                                         std::span<const uint32_t> segmentOffsets,
+                                         const std::pmr::polymorphic_allocator<T>& alloc = {}) {
+    return reference::segmented_prefix_sum<T, std::pmr::polymorphic_allocator<T>, Range>(
+        elements, segmentOffsets, alloc);
+}
+
 } // namespace pmr
 
 } // namespace wrs::reference
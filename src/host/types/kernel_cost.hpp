@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+namespace host {
+
+/**
+ * Analytical cost of a single kernel run, declared by the kernels through cost(N).
+ *
+ * Only counts the global memory traffic, which is required by the algorithm
+ * (i.e. every element is read and written once), small internal buffers
+ * like block reductions or decoupled states are ignored.
+ */
+struct KernelCost {
+    std::size_t bytesRead = 0;
+    std::size_t bytesWritten = 0;
+    std::size_t operations = 0;
+
+    constexpr std::size_t bytes() const {
+        return bytesRead + bytesWritten;
+    }
+
+    /// operations per byte
+    constexpr double arithmeticIntensity() const {
+        return bytes() == 0 ? 0.0
+                            : static_cast<double>(operations) / static_cast<double>(bytes());
+    }
+
+    constexpr KernelCost operator+(const KernelCost& o) const {
+        return KernelCost{
+            .bytesRead = bytesRead + o.bytesRead,
+            .bytesWritten = bytesWritten + o.bytesWritten,
+            .operations = operations + o.operations,
+        };
+    }
+};
+
+} // namespace host
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "src/host/types/alias_table.hpp"
+#include "src/host/types/glsl.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <span>
+#include <vector>
+
+namespace host {
+
+/**
+ * Quantized alias table formats, which halve the amount of memory read per sample.
+ *
+ * PACKED : one uint per entry, the alias index in the lower aliasBits bits and
+ *          the probability as a unorm of probabilityBits bits above it.
+ * SPLIT16: for N, which leave not enough bits for the probability,
+ *          the probabilities are stored as unorm16 (two per uint) next to a uint alias array.
+ */
+enum class AliasTableFormat {
+    PACKED,
+    SPLIT16,
+};
+
+struct AliasTableQuantization {
+    AliasTableFormat format;
+    glsl::uint aliasBits;       // only PACKED
+    glsl::uint probabilityBits; // bits of the quantized probability
+
+    /// Packs entries as long as at least minProbabilityBits remain for the probability.
+    /// More than 24 bits are never used, because they exceed the precision of the float weights.
+    static AliasTableQuantization select(glsl::uint N, glsl::uint minProbabilityBits = 8) {
+        const glsl::uint aliasBits = std::max<glsl::uint>(std::bit_width(N - 1), 1);
+        if (32 - aliasBits >= std::max<glsl::uint>(minProbabilityBits, 1)) {
+            return AliasTableQuantization{AliasTableFormat::PACKED, aliasBits,
+                                          std::min<glsl::uint>(32 - aliasBits, 24)};
+        }
+        return AliasTableQuantization{AliasTableFormat::SPLIT16, 0, 16};
+    }
+
+    glsl::uint maxQuantizedProbability() const {
+        return (1u << probabilityBits) - 1;
+    }
+
+    /// Round to nearest, p = 1 is represented exactly.
+    glsl::uint quantize(float p) const {
+        const double q = std::round(static_cast<double>(std::clamp(p, 0.0f, 1.0f)) *
+                                    maxQuantizedProbability());
+        return static_cast<glsl::uint>(q);
+    }
+
+    float dequantize(glsl::uint q) const {
+        return static_cast<float>(static_cast<double>(q) / maxQuantizedProbability());
+    }
+
+    /// Maximum absolute error of a single quantized probability.
+    double probabilityErrorBound() const {
+        return 0.5 / maxQuantizedProbability();
+    }
+
+    /**
+     * Bound of the absolute error of the probability to sample element i,
+     * where aliasCount is the amount of entries using i as their alias.
+     * Every entry contributes either p or 1 - p times 1/N.
+     */
+    double sampleProbabilityErrorBound(glsl::uint N, glsl::uint aliasCount) const {
+        return probabilityErrorBound() * (1 + aliasCount) / N;
+    }
+
+    glsl::uint pack(const AliasTableEntry<float, glsl::uint>& entry) const {
+        return (quantize(entry.p) << aliasBits) | entry.a;
+    }
+
+    AliasTableEntry<float, glsl::uint> unpack(glsl::uint packed) const {
+        const glsl::uint aliasMask = (1u << aliasBits) - 1;
+        return AliasTableEntry<float, glsl::uint>(dequantize(packed >> aliasBits),
+                                                  packed & aliasMask);
+    }
+};
+
+/// Host reference of the PACKED format, must match alias/quantize/shader.comp.
+inline std::vector<glsl::uint>
+packAliasTable(std::span<const AliasTableEntry<float, glsl::uint>> table,
+               const AliasTableQuantization& quantization) {
+    std::vector<glsl::uint> packed(table.size());
+    std::ranges::transform(table, packed.begin(),
+                           [&](const auto& entry) { return quantization.pack(entry); });
+    return packed;
+}
+
+/// Host reference of the SPLIT16 probabilities, two unorm16 per uint (even index in the low half).
+inline std::vector<glsl::uint>
+splitAliasTableProbabilities(std::span<const AliasTableEntry<float, glsl::uint>> table,
+                             const AliasTableQuantization& quantization) {
+    std::vector<glsl::uint> probabilities((table.size() + 1) / 2, 0);
+    for (std::size_t i = 0; i < table.size(); ++i) {
+        probabilities[i / 2] |= quantization.quantize(table[i].p) << (16 * (i % 2));
+    }
+    return probabilities;
+}
+
+/// Effective probability of sampling every element from an alias table.
+inline std::vector<double>
+aliasTableDistribution(std::span<const AliasTableEntry<float, glsl::uint>> table) {
+    const double N = static_cast<double>(table.size());
+    std::vector<double> distribution(table.size(), 0.0);
+    for (std::size_t i = 0; i < table.size(); ++i) {
+        const double p = std::clamp(table[i].p, 0.0f, 1.0f);
+        distribution[i] += p / N;
+        distribution[table[i].a] += (1.0 - p) / N;
+    }
+    return distribution;
+}
+
+} // namespace host
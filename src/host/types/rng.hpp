@@ -0,0 +1,67 @@
+#pragma once
+
+#include "src/host/types/glsl.hpp"
+#include <string>
+
+namespace host {
+
+/**
+ * Random number generator of the sampling kernels,
+ * selects the generator of src/device/common/rng.comp (values match RNG_*).
+ *
+ * Ordered by quality, PHILOX passes BigCrush and is counter based,
+ * HASH is a single integer hash per uniform and only meant for throughput.
+ *
+ * SOBOL, R2 and STRATIFIED are low-discrepancy sources, the samples of a single sample()
+ * call are stratified against each other, which reduces the variance of estimators
+ * built from them. The kernels skip their cooperative narrowing for these sources.
+ */
+enum class RNGAlgorithm : glsl::uint {
+    PHILOX = 0,
+    PCG = 1,
+    XOSHIRO = 2,
+    HASH = 3,
+    SOBOL = 4,      // owen scrambled, best with power of two sample counts
+    R2 = 5,         // randomly shifted
+    STRATIFIED = 6, // jittered, S strata per sample() call
+};
+
+/**
+ * Position of the samples of a sample() call within a low-discrepancy sequence.
+ * Ignored by the pseudo random generators, which are decorrelated by the seed.
+ */
+struct SampleSequence {
+    glsl::uint dimension = 0; // independent sequence per dimension
+    glsl::uint offset = 0;    // index of the first point, continues a progressive sequence
+};
+
+inline bool rngIsSequence(RNGAlgorithm algorithm) {
+    return static_cast<glsl::uint>(algorithm) >= static_cast<glsl::uint>(RNGAlgorithm::SOBOL);
+}
+
+/// Value of the RNG_ALGORITHM specialization constant.
+inline glsl::uint rngSpecializationConstant(RNGAlgorithm algorithm) {
+    return static_cast<glsl::uint>(algorithm);
+}
+
+inline std::string rngAlgorithmName(RNGAlgorithm algorithm) {
+    switch (algorithm) {
+    case RNGAlgorithm::PHILOX:
+        return "philox";
+    case RNGAlgorithm::PCG:
+        return "pcg";
+    case RNGAlgorithm::XOSHIRO:
+        return "xoshiro";
+    case RNGAlgorithm::HASH:
+        return "hash";
+    case RNGAlgorithm::SOBOL:
+        return "sobol";
+    case RNGAlgorithm::R2:
+        return "r2";
+    case RNGAlgorithm::STRATIFIED:
+        return "stratified";
+    }
+    return "philox";
+}
+
+} // namespace host
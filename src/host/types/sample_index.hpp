@@ -0,0 +1,119 @@
+#pragma once
+
+#include "src/host/types/glsl.hpp"
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace host {
+
+/**
+ * Width of the sample indices written by the sampling kernels.
+ *
+ * U16 and U8 pack 2 or 4 indices into every uint, sample i is stored in the bits
+ * [(i % perWord) * bits, (i % perWord + 1) * bits) of word i / perWord.
+ * On little endian hosts the packed words are therefore plain uint16_t / uint8_t arrays.
+ */
+enum class SampleIndexWidth {
+    U32,
+    U16,
+    U8,
+};
+
+inline glsl::uint sampleIndexBits(SampleIndexWidth width) {
+    switch (width) {
+    case SampleIndexWidth::U32:
+        return 32;
+    case SampleIndexWidth::U16:
+        return 16;
+    case SampleIndexWidth::U8:
+        return 8;
+    }
+    return 32;
+}
+
+inline glsl::uint samplesPerWord(SampleIndexWidth width) {
+    return 32 / sampleIndexBits(width);
+}
+
+/// Amount of uints required to store S samples.
+inline std::size_t sampleWordCount(std::size_t S, SampleIndexWidth width) {
+    const std::size_t perWord = samplesPerWord(width);
+    return (S + perWord - 1) / perWord;
+}
+
+/// Narrowest width, which can represent every index in [0,N).
+inline SampleIndexWidth selectSampleIndexWidth(std::size_t N) {
+    const auto bits = std::bit_width(N > 0 ? N - 1 : 0);
+    if (bits <= 8) {
+        return SampleIndexWidth::U8;
+    }
+    if (bits <= 16) {
+        return SampleIndexWidth::U16;
+    }
+    return SampleIndexWidth::U32;
+}
+
+inline bool sampleIndexWidthFits(std::size_t N, SampleIndexWidth width) {
+    return width == SampleIndexWidth::U32 ||
+           std::bit_width(N > 0 ? N - 1 : 0) <= sampleIndexBits(width);
+}
+
+/// Shader define, which selects the width in src/device/common/sample_index.comp.
+inline std::optional<std::string> sampleIndexDefine(SampleIndexWidth width) {
+    switch (width) {
+    case SampleIndexWidth::U32:
+        return std::nullopt;
+    case SampleIndexWidth::U16:
+        return "SAMPLES_U16";
+    case SampleIndexWidth::U8:
+        return "SAMPLES_U8";
+    }
+    return std::nullopt;
+}
+
+inline std::string sampleIndexWidthName(SampleIndexWidth width) {
+    switch (width) {
+    case SampleIndexWidth::U32:
+        return "u32";
+    case SampleIndexWidth::U16:
+        return "u16";
+    case SampleIndexWidth::U8:
+        return "u8";
+    }
+    return "u32";
+}
+
+/// Host reference of the packing, must match src/device/common/sample_index.comp.
+inline std::vector<glsl::uint> packSampleIndices(std::span<const glsl::uint> samples,
+                                                 SampleIndexWidth width) {
+    const glsl::uint bits = sampleIndexBits(width);
+    const glsl::uint perWord = samplesPerWord(width);
+    std::vector<glsl::uint> words(sampleWordCount(samples.size(), width), 0);
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        words[i / perWord] |= samples[i] << ((i % perWord) * bits);
+    }
+    return words;
+}
+
+/// Expands the first S packed samples to one uint per sample.
+template <typename Allocator = std::allocator<glsl::uint>>
+std::vector<glsl::uint, Allocator> unpackSampleIndices(std::span<const glsl::uint> words,
+                                                       std::size_t S,
+                                                       SampleIndexWidth width,
+                                                       const Allocator& alloc = {}) {
+    const glsl::uint bits = sampleIndexBits(width);
+    const glsl::uint perWord = samplesPerWord(width);
+    const glsl::uint mask = bits == 32 ? ~0u : (1u << bits) - 1;
+    std::vector<glsl::uint, Allocator> samples(S, alloc);
+    for (std::size_t i = 0; i < S; ++i) {
+        samples[i] = (words[i / perWord] >> ((i % perWord) * bits)) & mask;
+    }
+    return samples;
+}
+
+} // namespace host
@@ -1,15 +1,18 @@
 #include "merian/vk/context.hpp"
 
+#include "src/bench/alias_quantization.hpp"
 #include "src/bench/cutpoint_latency.hpp"
 #include "src/bench/sample_throughput.hpp"
 #include "src/bench/psa_split.hpp"
 #include "src/bench/psa_split2.hpp"
+#include "src/bench/rng_throughput.hpp"
 #include "merian/vk/extension/extension.hpp"
 #include "merian/vk/extension/extension_resources.hpp"
 #include "merian/vk/extension/extension_vk_core.hpp"
 #include "merian/vk/extension/extension_vk_debug_utils.hpp"
 #include "merian/vk/extension/extension_vk_float_atomics.hpp"
 #include "merian/vk/extension/extension_vk_push_descriptor.hpp"
+#include "src/device/pipeline/PipelineCache.hpp"
 #include "src/device/wrs/test.hpp"
 #include <dlfcn.h>
 #include <fmt/base.h>
@@ -23,9 +26,16 @@ int main() {
     spdlog::set_level(spdlog::level::debug);
 
     // Setup Vulkan context
-    const auto core = std::make_shared<merian::ExtensionVkCore>(
-        std::set<std::string>{"vk12/vulkanMemoryModel", "vk12/vulkanMemoryModelDeviceScope",
-                              "vk12/shaderBufferInt64Atomics"});
+    const auto core = std::make_shared<merian::ExtensionVkCore>(std::set<std::string>{
+        "vk12/vulkanMemoryModel", "vk12/vulkanMemoryModelDeviceScope",
+        "vk12/shaderBufferInt64Atomics",
+#ifdef WRS_PIPELINE_STATISTICS
+        "vk10/pipelineStatisticsQuery",
+#endif
+#ifdef WRS_INDEX_64
+        "vk10/shaderInt64", "vk12/bufferDeviceAddress",
+#endif
+    });
 
     const auto floatAtomics =
         std::make_shared<merian::ExtensionVkFloatAtomics>(std::set<std::string>{
@@ -52,15 +62,32 @@ int main() {
         throw std::runtime_error("Failed to create context!!!");
     }
 
+    // keeps the pipeline cache alive (and in memory) until the end of the process.
+    const auto pipelineCache = device::pipeline::PipelineCache::acquire(context);
+
     /* host::test::testTests(); */
+    /* device::test::pipeline_registry::test(context); */
+    /* device::test::instrumentation::test(context); */
 
 
     /* device::test::mean::test(context); */
     /* device::test::partition::test(context); */
     /* device::test::prefix_sum::test(context); */
+    /* device::test::segmented_prefix_sum::test(context); */
     /* device::test::prefix_partition::test(context); */
 
     /* device::test::wrs::test(context); */
+    /* device::test::batched_wrs::test(context); */
+    /* device::test::incremental_cmf::test(context); */
+    /* device::test::compressed_cmf::test(context); */
+    /* device::test::chunked::test(context); */
+    /* device::test::double_buffered::test(context); */
+    /* device::test::blocked::test(context); */
+    /* device::test::sorted::test(context); */
+    /* device::test::wrs_inline::test(context); */
+    /* device::test::replay::test(context); */
+    /* device::test::hst::test(context); */
+    /* device::test::its64::test(context); */
 
     /* device::wrs::benchmark(context); */
     /* device::scan::benchmark(context); */
@@ -70,9 +97,12 @@ int main() {
     /* device::memcpy::benchmark(context); */
 
     /* device::test::psa::test(context); */
+    /* device::test::split_repack::test(context); */
     /* device::sample_throughput::benchmark(context); */
     /* device::cutpoint_latency::benchmark(context); */
+    /* device::alias_quantization::benchmark(context); */
     /* device::psa_split::benchmark(context); */
+    /* device::rng_throughput::benchmark(context); */
     device::psa_split2::benchmark(context);
 
 }